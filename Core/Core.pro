@@ -50,7 +50,8 @@ HEADERS += \
     qcontour.h \
     animationlabel.h \
     reinforcementProblem.h \
-    kmeans.h \
+    neighborIndex.h \
+    neighborGraph.h \
     glwidget.h \
     glUtils.h
 
@@ -71,7 +72,8 @@ SOURCES += \
     qcontour.cpp \
     animationlabel.cpp \
     reinforcementProblem.cpp \
-    kmeans.cpp \
+    neighborIndex.cpp \
+    neighborGraph.cpp \
     glwidget.cpp \
     glUtils.cpp \
     clusterer.cpp \
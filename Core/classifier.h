@@ -36,6 +36,9 @@ protected:
 	bool bSingleClass;
 	bool bUsesDrawTimer;
 	bool bMultiClass;
+	bool bThreadSafe; // Test/TestBatch can be called concurrently on the same model
+	bool bConcurrentTraining; // separate models can be trained at the same time (no shared state, e.g. the global rand())
+	int threadCount; // threads Train may use, 0: one per core
 
 public:
     std::map<int,int> classMap, inverseMap;
@@ -46,7 +49,7 @@ public:
 	std::vector<const char *> roclabels;
     std::map<int, std::map<int, int> > confusionMatrix[2];
 
-    Classifier(): posClass(0), bSingleClass(true), bUsesDrawTimer(true), bMultiClass(false)
+    Classifier(): posClass(0), bSingleClass(true), bUsesDrawTimer(true), bMultiClass(false), bThreadSafe(false), bConcurrentTraining(false), threadCount(0)
 	{
 		rocdata.push_back(std::vector<f32pair>());
 		rocdata.push_back(std::vector<f32pair>());
@@ -61,12 +64,45 @@ public:
     virtual fvec TestMulti(const fvec &sample) const { return fvec(1,Test(sample));}
     virtual float Test(const fvec &sample) const { return 0; }
     virtual float Test(const fVec &sample) const { if(dim==2) return Test((fvec)sample); fvec s = (fvec)sample; s.resize(dim,0); return Test(s);}
+
+    // batched inference on a row-major (count x dim) matrix, the default implementation loops over Test/TestMulti
+    // TestBatch writes one response per sample in out, TestMultiBatch fills out with count x resDim values and returns resDim
+    virtual void TestBatch(const float *rowMajor, int count, int dim, float *out) const
+    {
+        fvec sample(dim);
+        FOR(i, count)
+        {
+            FOR(d, dim) sample[d] = rowMajor[i*dim + d];
+            out[i] = Test(sample);
+        }
+    }
+    virtual int TestMultiBatch(const float *rowMajor, int count, int dim, fvec &out) const
+    {
+        int resDim = 0;
+        out.clear();
+        fvec sample(dim);
+        FOR(i, count)
+        {
+            FOR(d, dim) sample[d] = rowMajor[i*dim + d];
+            fvec res = TestMulti(sample);
+            if(!i)
+            {
+                resDim = res.size();
+                out.resize(count*resDim);
+            }
+            FOR(d, min((int)res.size(), resDim)) out[i*resDim + d] = res[d];
+        }
+        return resDim;
+    }
     virtual const char *GetInfoString() const {return NULL;}
     virtual void SaveModel(const std::string filename) const {}
     virtual bool LoadModel(const std::string filename){return false;}
     bool SingleClass() const {return bSingleClass;}
     bool UsesDrawTimer() const {return bUsesDrawTimer;}
     bool IsMultiClass() const {return bMultiClass;}
+    bool IsThreadSafe() const {return bThreadSafe;}
+    bool CanTrainConcurrently() const {return bConcurrentTraining;}
+    void SetThreadCount(int count){threadCount = count;}
     int Dim() const {return dim;}
 };
 
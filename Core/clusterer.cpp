@@ -8,8 +8,8 @@ fvec Clusterer::TestMany(const fvec &sampleMatrix, const int dim, const int coun
     fvec results;
     int resDim = -1;
     if(sampleMatrix.size() != dim*count) return results;
+    fvec sample(dim);
     FOR(i, count) {
-        fvec sample(dim);
         FOR(d,dim) sample[d] = sampleMatrix[i*dim + d];
         fvec res = Test(sample);
         if(resDim == -1) {
@@ -21,12 +21,25 @@ fvec Clusterer::TestMany(const fvec &sampleMatrix, const int dim, const int coun
     return results;
 }
 
+std::vector<fvec> Clusterer::TestAll(const std::vector<fvec> &samples)
+{
+    vector<fvec> results(samples.size());
+    if(!samples.size()) return results;
+    int dim = samples[0].size();
+    fvec res = TestMany(flatten(samples, dim), dim, samples.size());
+    if(!res.size()) return results;
+    int resDim = res.size() / samples.size();
+    FOR(i, samples.size()) results[i] = fvec(res.begin() + i*resDim, res.begin() + (i+1)*resDim);
+    return results;
+}
+
 float Clusterer::GetLogLikelihood(std::vector<fvec> samples){
     if(!samples.size()) return 0;
 
     vector< vector<fvec> > samplesPerCluster(nbClusters);
+    vector<fvec> allScores = TestAll(samples);
     FOR(i, samples.size()) {
-        fvec scores = Test(samples[i]);
+        fvec &scores = allScores[i];
         float maxScore = 0;
         int clusterIndex = 0;
         FOR(j, nbClusters) {
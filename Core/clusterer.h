@@ -41,10 +41,12 @@ public:
     virtual fvec Test( const fvec &/*sample*/){ return fvec(); }
     virtual fvec Test(const fVec &sample){ return Test((fvec)sample); }
     virtual fvec TestMany( const fvec& sampleMatrix, const int dim, const int count);
+    std::vector<fvec> TestAll(const std::vector<fvec> &samples); // one TestMany call, split per sample
     virtual const char *GetInfoString(){ return NULL; }
     virtual bool SetClusterTestValue(int count, int /*max*/){ nbClusters = count; return true;}
     virtual float GetLogLikelihood(std::vector<fvec> samples);
     virtual float GetParameterCount(){return nbClusters*dim;}
+    virtual bool IsStreaming() const {return false;} // Train continues the current model instead of refitting it
 };
 
 #endif // _CLUSTERING_H_
@@ -103,7 +103,7 @@ void DataImporter::Parse(QString filename)
     categorical.clear();
     int separatorType = gui->separatorCombo->currentIndex();
     inputParser->parse(filename.toStdString().c_str(), separatorType);
-    vector<vector<string> > rawData = inputParser->getRawData();
+    vector<vector<string> > rawData = inputParser->getRawData(CSV_PREVIEW_ROWS);
     if(rawData.size() < 2) return;
     bool bUseHeader = gui->headerCheck->isChecked();
 
@@ -173,7 +173,7 @@ void DataImporter::classIgnoreChanged()
 void DataImporter::headerChanged()
 {
     headers.clear();
-    vector<vector<string> > rawData = inputParser->getRawData();
+    vector<vector<string> > rawData = inputParser->getRawData(CSV_PREVIEW_ROWS);
     if(rawData.size() < 2) return;
     bool bUseHeader = gui->headerCheck->isChecked();
 
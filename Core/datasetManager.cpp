@@ -24,6 +24,9 @@ Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
 #include <fstream>
 #include <algorithm>
 #include <map>
+#include <QFile>
+#include <QMutex>
+#include <QMutexLocker>
 
 using namespace std;
 
@@ -40,11 +43,16 @@ DatasetManager::DatasetManager(const int dimension)
     bProjected = false;
 	ID = IDCount++;
 	perm = NULL;
+	bBufferValid = bColumnsValid = false;
+	mappedFile = NULL;
+	mappedSamples = NULL;
+	bufferMutex = new QMutex();
 }
 
 DatasetManager::~DatasetManager()
 {
 	Clear();
+	DEL(bufferMutex);
 }
 
 void DatasetManager::Clear()
@@ -58,6 +66,9 @@ void DatasetManager::Clear()
 	rewards.Clear();
     categorical.clear();
 	KILL(perm);
+	InvalidateBuffers();
+	sampleBuffer.clear();
+	columnBuffer.clear();
 }
 
 void DatasetManager::AddSample(const fvec sample, const int label, const dsmFlags flag)
@@ -77,6 +88,7 @@ void DatasetManager::AddSample(const fvec sample, const int label, const dsmFlag
 	flags.push_back(flag);
 	KILL(perm);
 	perm = randPerm(samples.size());
+	InvalidateBuffers();
 }
 
 void DatasetManager::AddSamples(const std::vector< fvec > newSamples, const ivec newLabels, const std::vector<dsmFlags> newFlags)
@@ -104,6 +116,7 @@ void DatasetManager::AddSamples(const std::vector< fvec > newSamples, const ivec
 	else FOR(i, newSamples.size()) labels.push_back(0);
 	KILL(perm);
 	perm = randPerm(samples.size());
+	InvalidateBuffers();
 }
 
 void DatasetManager::AddSamples(const DatasetManager &newSamples)
@@ -119,6 +132,7 @@ void DatasetManager::RemoveSample(const unsigned int index)
 		Clear();
 		return;
 	}
+	InvalidateBuffers();
 	samples[index].clear();
 	for (unsigned int i = index; i < samples.size()-1; i++)
 	{
@@ -295,6 +309,7 @@ void DatasetManager::ResetFlags()
 void DatasetManager::SetSample(const int index, const fvec sample)
 {
     if(index >= 0 && index < samples.size()) samples[index] = sample;
+    InvalidateBuffers();
 }
 
 string DatasetManager::GetCategorical(const int dimension, const int value) const
@@ -355,6 +370,72 @@ std::vector<fvec> DatasetManager::GetSamples() const
     return samples;
 }
 
+void DatasetManager::SetSamples(const std::vector<fvec> samples)
+{
+    this->samples = samples;
+    InvalidateBuffers();
+}
+
+void DatasetManager::InvalidateBuffers()
+{
+    QMutexLocker lock(bufferMutex);
+    bBufferValid = bColumnsValid = false;
+    mappedSamples = NULL;
+    DEL(mappedFile); // this unmaps the file
+}
+
+const float *DatasetManager::GetSampleBuffer() const
+{
+    QMutexLocker lock(bufferMutex);
+    return BuildSampleBuffer();
+}
+
+const float *DatasetManager::BuildSampleBuffer() const
+{
+    if(!samples.size()) return 0;
+    if(mappedSamples) return mappedSamples;
+    int dim = GetDimCount();
+    if(!bBufferValid || sampleBuffer.size() != samples.size()*dim)
+    {
+        sampleBuffer.resize(samples.size()*dim);
+        FOR(i, samples.size())
+        {
+            float *sample = &sampleBuffer[i*dim];
+            int sampleDim = min(dim, (int)samples[i].size());
+            FOR(d, sampleDim) sample[d] = samples[i][d];
+            for(int d=sampleDim; d<dim; d++) sample[d] = 0.f;
+        }
+        bBufferValid = true;
+    }
+    return &sampleBuffer[0];
+}
+
+const float *DatasetManager::GetColumnBuffer() const
+{
+    QMutexLocker lock(bufferMutex);
+    if(!samples.size()) return 0;
+    int dim = GetDimCount();
+    if(!bColumnsValid || columnBuffer.size() != samples.size()*dim)
+    {
+        const float *rows = BuildSampleBuffer();
+        int count = samples.size();
+        columnBuffer.resize(count*dim);
+        FOR(d, dim)
+        {
+            FOR(i, count) columnBuffer[d*count + i] = rows[i*dim + d];
+        }
+        bColumnsValid = true;
+    }
+    return &columnBuffer[0];
+}
+
+SampleView DatasetManager::GetSampleView(const ivec inputDims, const ivec indices) const
+{
+    const float *buffer = GetSampleBuffer();
+    if(!buffer) return SampleView();
+    return SampleView(buffer, samples.size(), GetDimCount(), inputDims, indices);
+}
+
 std::vector< fvec > DatasetManager::GetSampleDims(const ivec inputDims, const int outputDim) const
 {
     if ( !inputDims.size() ) return samples;
@@ -628,15 +709,16 @@ std::vector< std::vector < fvec > > DatasetManager::GetTrajectories(const int re
 }
 
 
-void DatasetManager::Save(const char *filename)
+bool DatasetManager::Save(const char *filename)
 {
-    if(!samples.size() && rewards.Empty()) return;
+	// we may be overwriting the file we have mapped: the samples are read from memory from now on
+	InvalidateBuffers();
+	ofstream file(filename);
+	if(!file.is_open()) return false;
+    if(!samples.size() && rewards.Empty()) return true;
 	u32 sampleCnt = samples.size();
     if(sampleCnt) size = samples[0].size();
 
-	ofstream file(filename);
-	if(!file.is_open()) return;
-
 	file << sampleCnt << " " << size << "\n";
 	FOR(i, sampleCnt)
 	{
@@ -687,6 +769,7 @@ void DatasetManager::Save(const char *filename)
     }
 
 	file.close();
+	return !file.fail();
 }
 
 bool DatasetManager::Load(const char *filename)
@@ -798,6 +881,290 @@ bool DatasetManager::Load(const char *filename)
 	return samples.size() > 0;
 }
 
+/******************************************/
+/*                                        */
+/*    BINARY DATASETS                     */
+/*                                        */
+/******************************************/
+// binary datasets start with this header, followed by 8-byte aligned blocks:
+// samples (float32, sampleCount x dim), labels (int32), flags (int32), sequences (2 x int32),
+// obstacles, reward map and categorical dictionaries, all in little-endian order
+struct BinaryDatasetHeader
+{
+	char magic[8];
+	u32 version;
+	u32 headerSize; // offset of the sample block
+	u32 sampleCount;
+	u32 dim;
+	u32 sequenceCount;
+	u32 obstacleCount;
+	u32 rewardDim;
+	u32 rewardLength;
+	u32 categoricalCount;
+	u32 dataSizeLow, dataSizeHigh; // size of the binary part of the file
+	u32 reserved[3];
+};
+
+static const char binaryMagic[8] = {'M','L','D','E','M','O','S','B'};
+static const u32 binaryVersion = 1;
+
+template <typename T>
+static void WriteBlock(ofstream &file, const T *data, const size_t count)
+{
+	if(count) file.write((const char *)data, count*sizeof(T));
+}
+
+static void WritePadding(ofstream &file)
+{
+	static const char zeros[8] = {0};
+	long long position = file.tellp();
+	if(position % 8) file.write(zeros, 8 - position % 8);
+}
+
+// walks through a mapped binary dataset, never reading past its end
+struct BinaryReader
+{
+	const uchar *data, *cursor, *end;
+	bool bValid;
+	BinaryReader(const uchar *data, const long long length) : data(data), cursor(data), end(data+length), bValid(true){}
+	template <typename T> const T *Read(const size_t count)
+	{
+		if(!bValid || count > (size_t)(end - cursor) / sizeof(T))
+		{
+			bValid = false;
+			return NULL;
+		}
+		const T *block = (const T *)cursor;
+		cursor += count*sizeof(T);
+		return block;
+	}
+	void Align()
+	{
+		size_t offset = (cursor - data) % 8;
+		if(offset) Read<char>(8 - offset);
+	}
+};
+
+bool DatasetManager::SaveBinary(const char *filename)
+{
+	// truncating the file we have mapped would pull the sample buffer from under us,
+	// so the mapping is dropped first and the buffer is rebuilt from the samples
+	InvalidateBuffers();
+	ofstream file(filename, ios::out | ios::binary);
+	if(!file.is_open()) return false;
+	if(!samples.size() && rewards.Empty()) return true;
+	u32 sampleCnt = samples.size();
+	if(sampleCnt) size = samples[0].size();
+
+	BinaryDatasetHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, binaryMagic, sizeof(binaryMagic));
+	header.version = binaryVersion;
+	header.headerSize = sizeof(header);
+	header.sampleCount = sampleCnt;
+	header.dim = size;
+	header.sequenceCount = sequences.size();
+	header.obstacleCount = obstacles.size();
+	header.rewardDim = rewards.Empty() ? 0 : rewards.dim;
+	header.rewardLength = rewards.Empty() ? 0 : rewards.length;
+	header.categoricalCount = categorical.size();
+	WriteBlock(file, &header, 1);
+
+	// the samples are written in a single block
+	const float *buffer = GetSampleBuffer();
+	WriteBlock(file, buffer, sampleCnt*size);
+	WritePadding(file);
+	WriteBlock(file, &labels[0], sampleCnt);
+	WritePadding(file);
+	vector<s32> flagBlock(flags.begin(), flags.end());
+	WriteBlock(file, &flagBlock[0], sampleCnt);
+	WritePadding(file);
+	vector<s32> sequenceBlock(sequences.size()*2);
+	FOR(i, sequences.size())
+	{
+		sequenceBlock[i*2] = sequences[i].first;
+		sequenceBlock[i*2+1] = sequences[i].second;
+	}
+	WriteBlock(file, &sequenceBlock[0], sequenceBlock.size());
+	WritePadding(file);
+
+	FOR(i, obstacles.size())
+	{
+		const Obstacle &o = obstacles[i];
+		u32 lengths[4] = {(u32)o.center.size(), (u32)o.axes.size(), (u32)o.power.size(), (u32)o.repulsion.size()};
+		WriteBlock(file, lengths, 4);
+		WriteBlock(file, &o.center[0], lengths[0]);
+		WriteBlock(file, &o.axes[0], lengths[1]);
+		WriteBlock(file, &o.power[0], lengths[2]);
+		WriteBlock(file, &o.repulsion[0], lengths[3]);
+		WriteBlock(file, &o.angle, 1);
+	}
+	WritePadding(file);
+
+	if(header.rewardDim)
+	{
+		vector<s32> rewardSize(rewards.size.begin(), rewards.size.end());
+		WriteBlock(file, &rewardSize[0], rewards.dim);
+		WriteBlock(file, &rewards.lowerBoundary[0], rewards.dim);
+		WriteBlock(file, &rewards.higherBoundary[0], rewards.dim);
+		WritePadding(file);
+		WriteBlock(file, rewards.rewards, rewards.length);
+	}
+
+	for(map<int, vector<string> >::const_iterator it = categorical.begin(); it != categorical.end(); it++)
+	{
+		s32 dimension = it->first;
+		u32 count = it->second.size();
+		WriteBlock(file, &dimension, 1);
+		WriteBlock(file, &count, 1);
+		FOR(i, count)
+		{
+			u32 length = it->second[i].size();
+			WriteBlock(file, &length, 1);
+			WriteBlock(file, it->second[i].c_str(), length);
+		}
+	}
+	WritePadding(file);
+
+	// now that we know the full size we can complete the header
+	long long dataSize = file.tellp();
+	header.dataSizeLow = (u32)(dataSize & 0xffffffff);
+	header.dataSizeHigh = (u32)(dataSize >> 32);
+	file.seekp(0);
+	WriteBlock(file, &header, 1);
+	file.close();
+	return !file.fail();
+}
+
+bool DatasetManager::LoadBinary(const char *filename)
+{
+	QFile *file = new QFile(filename);
+	if(!file->open(QIODevice::ReadOnly))
+	{
+		delete file;
+		return false;
+	}
+	long long fileSize = file->size();
+	uchar *data = fileSize ? file->map(0, fileSize) : NULL;
+	BinaryReader reader(data, data ? fileSize : 0);
+	const BinaryDatasetHeader *header = reader.Read<BinaryDatasetHeader>(1);
+	if(!header || memcmp(header->magic, binaryMagic, sizeof(binaryMagic)) || header->version > binaryVersion)
+	{
+		delete file;
+		return false;
+	}
+	Clear();
+	size = header->dim;
+	int sampleCnt = header->dim ? header->sampleCount : 0;
+
+	reader.cursor = data;
+	reader.Read<char>(header->headerSize);
+	const float *sampleBlock = reader.Read<float>((size_t)sampleCnt*size);
+	reader.Align();
+	const s32 *labelBlock = reader.Read<s32>(sampleCnt);
+	reader.Align();
+	const s32 *flagBlock = reader.Read<s32>(sampleCnt);
+	reader.Align();
+	const s32 *sequenceBlock = reader.Read<s32>(header->sequenceCount*2);
+	reader.Align();
+	if(!reader.bValid)
+	{
+		delete file;
+		return false;
+	}
+
+	samples.resize(sampleCnt);
+	FOR(i, sampleCnt) samples[i].assign(sampleBlock + i*size, sampleBlock + (i+1)*size);
+	labels.assign(labelBlock, labelBlock + sampleCnt);
+	flags.resize(sampleCnt);
+	FOR(i, sampleCnt) flags[i] = (dsmFlags)flagBlock[i];
+	FOR(i, header->sequenceCount) sequences.push_back(ipair(sequenceBlock[i*2], sequenceBlock[i*2+1]));
+
+	FOR(i, header->obstacleCount)
+	{
+		const u32 *lengths = reader.Read<u32>(4);
+		if(!lengths) break;
+		const float *center = reader.Read<float>(lengths[0]);
+		const float *axes = reader.Read<float>(lengths[1]);
+		const float *power = reader.Read<float>(lengths[2]);
+		const float *repulsion = reader.Read<float>(lengths[3]);
+		const float *angle = reader.Read<float>(1);
+		if(!reader.bValid) break;
+		Obstacle obstacle;
+		obstacle.center.assign(center, center + lengths[0]);
+		obstacle.axes.assign(axes, axes + lengths[1]);
+		obstacle.power.assign(power, power + lengths[2]);
+		obstacle.repulsion.assign(repulsion, repulsion + lengths[3]);
+		obstacle.angle = *angle;
+		obstacles.push_back(obstacle);
+	}
+	reader.Align();
+
+	if(header->rewardDim)
+	{
+		int dims = header->rewardDim;
+		const s32 *rewardSize = reader.Read<s32>(dims);
+		const float *lowerBoundary = reader.Read<float>(dims);
+		const float *higherBoundary = reader.Read<float>(dims);
+		reader.Align();
+		const double *rewardData = reader.Read<double>(header->rewardLength);
+		if(reader.bValid)
+		{
+			ivec size(rewardSize, rewardSize + dims);
+			int testLength = 1;
+			FOR(i, dims) testLength *= size[i];
+			if(testLength == header->rewardLength)
+			{
+				rewards.SetReward(rewardData, size, fvec(lowerBoundary, lowerBoundary + dims), fvec(higherBoundary, higherBoundary + dims));
+			}
+		}
+	}
+
+	FOR(i, header->categoricalCount)
+	{
+		const s32 *dimension = reader.Read<s32>(1);
+		const u32 *count = reader.Read<u32>(1);
+		if(!reader.bValid) break;
+		vector<string> names;
+		FOR(j, *count)
+		{
+			const u32 *length = reader.Read<u32>(1);
+			const char *name = length ? reader.Read<char>(*length) : NULL;
+			if(!name) break;
+			names.push_back(string(name, *length));
+		}
+		if(!reader.bValid) break;
+		categorical[*dimension] = names;
+	}
+
+	// the samples stay mapped and are used as contiguous buffer until the dataset is modified
+	QMutexLocker lock(bufferMutex);
+	mappedFile = file;
+	mappedSamples = sampleCnt ? sampleBlock : NULL;
+	KILL(perm);
+	perm = randPerm(samples.size());
+	return samples.size() > 0;
+}
+
+bool DatasetManager::IsBinary(const char *filename)
+{
+	ifstream file(filename, ios::in | ios::binary);
+	if(!file.is_open()) return false;
+	char magic[8];
+	file.read(magic, sizeof(magic));
+	return file.gcount() == sizeof(magic) && !memcmp(magic, binaryMagic, sizeof(binaryMagic));
+}
+
+long long DatasetManager::GetBinarySize(const char *filename)
+{
+	ifstream file(filename, ios::in | ios::binary);
+	if(!file.is_open()) return 0;
+	BinaryDatasetHeader header;
+	file.read((char *)&header, sizeof(header));
+	if(file.gcount() != sizeof(header) || memcmp(header.magic, binaryMagic, sizeof(binaryMagic))) return 0;
+	return (long long)header.dataSizeLow | ((long long)header.dataSizeHigh << 32);
+}
+
 int DatasetManager::GetDimCount() const
 {
 	int dim = 2;
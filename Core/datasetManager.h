@@ -23,6 +23,9 @@ Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
 #include "public.h"
 #include <string.h>
 
+class QFile;
+class QMutex;
+
 enum DatasetManagerFlags
 {
 	_UNUSED = 0x0000,
@@ -134,6 +137,49 @@ struct TimeSerie
     TimeSerie& operator<< (const fvec& v) {return *this += v;}
 };
 
+// non-owning view over a row-major sample buffer: the selected dimensions of a subset of the rows.
+// The view is only valid as long as the buffer it points to is left untouched
+struct SampleView
+{
+	const float *data;
+	int rows; // rows in the buffer
+	int stride; // floats between two consecutive rows
+	ivec dims; // selected dimensions (all if empty)
+	ivec indices; // selected rows (all if empty)
+	SampleView(const float *data=0, const int rows=0, const int stride=0, const ivec dims=ivec(), const ivec indices=ivec())
+		: data(data), rows(rows), stride(stride), dims(dims), indices(indices){}
+
+	int size() const {return indices.size() ? indices.size() : rows;}
+	int dim() const {return dims.size() ? dims.size() : stride;}
+	const float *row(const int i) const {return data + (indices.size() ? indices[i] : i)*stride;}
+	float operator()(const int i, const int d) const {return row(i)[dims.size() ? dims[d] : d];}
+	void Get(const int i, float *sample) const {
+		const float *r = row(i);
+		if(dims.size()) for(int d=0; d<dims.size(); d++) sample[d] = r[dims[d]];
+		else for(int d=0; d<stride; d++) sample[d] = r[d];
+	}
+	fvec Sample(const int i) const {fvec sample(dim()); if(sample.size()) Get(i, &sample[0]); return sample;}
+
+	// view on a subset of the current rows (indices relative to this view)
+	SampleView Subset(const ivec &subset) const {
+		ivec newIndices(subset.size());
+		for(int i=0; i<subset.size(); i++) newIndices[i] = indices.size() ? indices[subset[i]] : subset[i];
+		return SampleView(data, rows, stride, dims, newIndices);
+	}
+	// the samples are only copied when an algorithm needs them in its own format
+	std::vector<fvec> ToSamples() const {
+		std::vector<fvec> samples(size());
+		for(int i=0; i<samples.size(); i++) samples[i] = Sample(i);
+		return samples;
+	}
+	fvec ToMatrix() const {
+		int count = size(), d = dim();
+		fvec matrix(count*d);
+		for(int i=0; i<count; i++) Get(i, &matrix[i*d]);
+		return matrix;
+	}
+};
+
 class DatasetManager
 {
 protected:
@@ -154,6 +200,16 @@ protected:
 
 	u32 *perm;
 
+	// contiguous copies of the samples, rebuilt on demand after each modification
+	mutable fvec sampleBuffer; // row-major, GetCount() x GetDimCount()
+	mutable fvec columnBuffer; // column-major mirror, GetDimCount() x GetCount()
+	mutable bool bBufferValid, bColumnsValid;
+	QMutex *bufferMutex; // the buffers are built on the first request, which may come from several threads
+	QFile *mappedFile; // binary dataset mapped in memory
+	const float *mappedSamples; // its sample block, used as sample buffer until the data is modified
+	void InvalidateBuffers();
+	const float *BuildSampleBuffer() const;
+
 public:
     bool bProjected;
     std::map<int, std::vector<std::string> > categorical;
@@ -186,7 +242,12 @@ public:
     std::vector< fvec > GetSampleDims(const ivec inputDims, const int outputDim=-1) const ;
     std::vector< fvec > GetSampleDims(const std::vector<fvec> samples, const ivec inputDims, const int outputDim=-1) const ;
     void SetSample(const int index, const fvec sample);
-    void SetSamples(const std::vector<fvec> samples){this->samples = samples;}
+    void SetSamples(const std::vector<fvec> samples);
+
+    // contiguous access to the samples, invalidated by any change to the dataset
+    const float *GetSampleBuffer() const;
+    const float *GetColumnBuffer() const;
+    SampleView GetSampleView(const ivec inputDims=ivec(), const ivec indices=ivec()) const;
 
     int GetLabel(const int index) const {return index < labels.size() ? labels[index] : 0;}
     ivec GetLabels() const {return labels;}
@@ -232,8 +293,14 @@ public:
     std::vector<bool> GetFreeFlags() const ;
 	void ResetFlags();
 
-    void Save(const char *filename);
+    bool Save(const char *filename);
 	bool Load(const char *filename);
+
+    // versioned binary format, mapped in memory when loading
+    bool SaveBinary(const char *filename);
+    bool LoadBinary(const char *filename);
+    static bool IsBinary(const char *filename);
+    static long long GetBinarySize(const char *filename); // bytes used by the dataset, anything after it is free text
 };
 
 #endif // _DATASET_MANAGER_H_
@@ -47,17 +47,27 @@ DrawTimer::DrawTimer(Canvas *canvas, QMutex *mutex)
       bPaused(false),
       bRunning(false),
       bColorMap(true),
-      maximumVisitedCount(0)
-{}
+      bQuadTree(true),
+      maximumVisitedCount(0),
+      tilesX(0), tilesY(0),
+      tileStop(0),
+      bQuadPass(false)
+{
+    tilePool.setMaxThreadCount(QThread::idealThreadCount());
+}
 
 DrawTimer::~DrawTimer()
 {
+    bRunning = false;
+    tilePool.waitForDone();
     KILL(perm);
 }
 
 void DrawTimer::Stop()
 {
     bRunning = false;
+    // the workers give up after their current job: once they are done the caller can delete the model
+    QMutexLocker passLock(&passMutex);
 }
 
 void DrawTimer::Clear()
@@ -69,11 +79,17 @@ void DrawTimer::Clear()
     //    KILL(perm);
     //    perm = randPerm(w*h);
     //}
+    QMutexLocker passLock(&passMutex);
     w = canvas->width();
     h = canvas->height();
     drawMutex.lock();
+    tilesX = (w + tileSize - 1) / tileSize;
+    tilesY = (h + tileSize - 1) / tileSize;
     KILL(perm);
-    perm = randPerm(w*h);
+    perm = randPerm(TileCount());
+    quadBlocks.clear();
+    quadColors.clear();
+    quadKnown.clear();
     bigMap = QImage(QSize(w,h), QImage::Format_ARGB32);
     bigMap.fill(0xffffff);
     modelMap = QImage(QSize(w,h), QImage::Format_ARGB32);
@@ -386,10 +402,10 @@ void DrawTimer::Refine()
             refineMax = 32;
         }
     } else {
-        int count = (w*h) / refineMax;
-        int start = count * (refineLevel-1);
-        int stop = count * refineLevel;
-        if(refineLevel == refineMax) stop = w*h; // we want to be sure we paint everything in the end
+        // each pass renders its share of the (randomly ordered) tiles
+        int start = TileCount() * (refineLevel-1) / refineMax;
+        int stop = TileCount() * refineLevel / refineMax;
+        if(refineLevel == refineMax) stop = TileCount(); // we want to be sure we paint everything in the end
 
         if(maximizer && (*maximizer)) {
             Maximization();
@@ -410,7 +426,13 @@ void DrawTimer::Refine()
         if(inputDims.size() == 2) dim = inputDims.size();
         mutex->unlock();
 
-        if(dim == 2) {
+        // classifiers and clusterers are refined block by block, only where the map changes
+        bool bQuad = bQuadTree && !(dynamical && (*dynamical)) &&
+                ((classifier && (*classifier)) || (clusterer && (*clusterer)));
+        if(dim == 2 && bQuad) {
+            if(RefineQuadTree()) refineLevel = refineMax;
+            else if(refineLevel == refineMax) refineLevel--; // we keep going until all blocks are resolved
+        } else if(dim == 2) {
             bRefined &= TestFast(start,stop); // we finish the current batch
             if(dynamical && (*dynamical)) {
                 int cnt = 10000 / refineMax;
@@ -773,6 +795,40 @@ bool DrawTimer::VectorsFast(int count, int steps)
     return true;
 }
 
+QColor DrawTimer::GetColor(Classifier *classifier, const float *val, int valDim)
+{
+    if(!valDim) return QColor(0,0,0);
+    if(valDim == 1)
+    {
+        float v = val[0];
+        int color = (int)(fabs(v)*128);
+        color = max(0,min(color, 255));
+        if(v > 0) return QColor(color,0,0);
+        return QColor(color,color,color);
+    }
+    // we find the max
+    int maxVal = 0;
+    FOR(i, valDim) if (val[maxVal] < val[i]) maxVal = i;
+    float sum = 0;
+    FOR(i, valDim) sum += fabs(val[i]);
+    sum += fabs(val[maxVal])*2; // the winning class counts three times
+    sum = 1.f/sum;
+
+    float r=0,g=0,b=0;
+    FOR(j, valDim)
+    {
+        float v = j == maxVal ? val[j]*3 : val[j];
+        int index = (classifier->inverseMap[j]%SampleColorCnt);
+        r += SampleColor[index].red()*v*sum;
+        g += SampleColor[index].green()*v*sum;
+        b += SampleColor[index].blue()*v*sum;
+    }
+    r = max(0.f, min(255.f, r));
+    g = max(0.f, min(255.f, g));
+    b = max(0.f, min(255.f, b));
+    return QColor(r,g,b);
+}
+
 QColor DrawTimer::GetColor(Classifier *classifier, fvec sample, std::vector<Classifier*> *classifierMulti, ivec sourceDims)
 {
     if(sourceDims.size())
@@ -782,176 +838,119 @@ QColor DrawTimer::GetColor(Classifier *classifier, fvec sample, std::vector<Clas
         sample = newSample;
     }
 
-    QColor c;
     if(classifier->IsMultiClass())
     {
         fvec val = classifier->TestMulti(sample);
-        if(!val.size()) return QColor(0,0,0);
-        else if(val.size() == 1)
-        {
-            float v = val[0];
-            int color = fabs(v)*128;
-            color = max(0,min(color, 255));
-            if(v > 0) c = QColor(color,0,0);
-            else c = QColor(color,color,color);
-        }
-        else
-        {
-            // we find the max
-            int maxVal = 0;
-            FOR(i, val.size()) if (val[maxVal] < val[i]) maxVal = i;
-            val[maxVal] *= 3;
-            float sum = 0;
-            FOR(i, val.size()) sum += fabs(val[i]);
-            sum = 1.f/sum;
+        return GetColor(classifier, val.size() ? &val[0] : 0, val.size());
+    }
+    if(classifierMulti && (*classifierMulti).size())
+    {
+        fvec val((*classifierMulti).size(),0);
+        FOR(j, (*classifierMulti).size()) val[j] = (*classifierMulti)[j]->Test(sample);
+        return GetColor(classifier, &val[0], val.size());
+    }
+    float v = classifier->Test(sample);
+    return GetColor(classifier, &v, 1);
+}
 
-            float r=0,g=0,b=0;
-            FOR(j, val.size())
-            {
-                int index = (classifier->inverseMap[j]%SampleColorCnt);
-                r += SampleColor[index].red()*val[j]*sum;
-                g += SampleColor[index].green()*val[j]*sum;
-                b += SampleColor[index].blue()*val[j]*sum;
-            }
-            r = max(0.f, min(255.f, r));
-            g = max(0.f, min(255.f, g));
-            b = max(0.f, min(255.f, b));
-            c = QColor(r,g,b);
+void DrawTimer::GetColors(Classifier *classifier, const fvec &sampleMatrix, int dim, std::vector<QColor> &colors, std::vector<Classifier*> *classifierMulti)
+{
+    int count = dim ? sampleMatrix.size() / dim : 0;
+    colors.resize(count);
+    if(!count) return;
+    if(classifier->IsMultiClass())
+    {
+        fvec val;
+        int valDim = classifier->TestMultiBatch(&sampleMatrix[0], count, dim, val);
+        FOR(i, count) colors[i] = GetColor(classifier, valDim ? &val[i*valDim] : 0, valDim);
+    }
+    else if(classifierMulti && (*classifierMulti).size())
+    {
+        // we evaluate each one-vs-all classifier on the whole batch and interleave the responses
+        int valDim = (*classifierMulti).size();
+        fvec responses(count);
+        fvec val(count*valDim);
+        FOR(j, valDim)
+        {
+            (*classifierMulti)[j]->TestBatch(&sampleMatrix[0], count, dim, &responses[0]);
+            FOR(i, count) val[i*valDim + j] = responses[i];
         }
+        FOR(i, count) colors[i] = GetColor(classifier, &val[i*valDim], valDim);
     }
     else
     {
-        if(classifierMulti && (*classifierMulti).size())
-        {
-            // we find the max
-            int maxClass = 0;
-            float maxRes = -FLT_MAX;
-            fvec val((*classifierMulti).size(),0);
-            FOR(j, (*classifierMulti).size())
-            {
-                float res = (*classifierMulti)[j]->Test(sample);
-                val[j] = res;
-                if(res > maxRes)
-                {
-                    maxRes = res;
-                    maxClass = j;
-                }
-            }
-            val[maxClass] *= 3;
-            float sum = 0;
-            FOR(i, val.size()) sum += fabs(val[i]);
-            sum = 1.f/sum;
+        fvec val(count);
+        classifier->TestBatch(&sampleMatrix[0], count, dim, &val[0]);
+        FOR(i, count) colors[i] = GetColor(classifier, &val[i], 1);
+    }
+}
 
-            float r=0,g=0,b=0;
-            FOR(j, val.size())
-            {
-                //int index = j%SampleColorCnt;
-                int index = classifier->inverseMap[j]%SampleColorCnt;
-                r += SampleColor[index].red()*val[j]*sum;
-                g += SampleColor[index].green()*val[j]*sum;
-                b += SampleColor[index].blue()*val[j]*sum;
-            }
-            r = max(0.f, min(255.f, r));
-            g = max(0.f, min(255.f, g));
-            b = max(0.f, min(255.f, b));
-            c = QColor(r,g,b);
-        }
-        else
-        {
-            float v = classifier->Test(sample);
-            int color = (int)(fabs(v)*128);
-            color = max(0,min(color, 255));
-            if(v > 0) c = QColor(color,0,0);
-            else c = QColor(color,color,color);
-        }
+// workers pull jobs (tiles, or chunks of quadtree corners) from a shared counter until the pass
+// is exhausted, so that a slow job (e.g. near a decision boundary) does not stall the others
+class TileWorker : public QRunnable
+{
+    DrawTimer *timer;
+public:
+    TileWorker(DrawTimer *timer) : timer(timer) {}
+    void run() { timer->RenderTiles(); }
+};
+
+void DrawTimer::RenderTiles()
+{
+    int t;
+    while(bRunning && (t = nextTile.fetchAndAddOrdered(1)) < tileStop) {
+        if(bQuadPass) EvaluateQuadChunk(t);
+        else RenderTile(perm[t]);
     }
-    return c;
 }
 
-inline void fromCanvas(fvec &sample, const float x, const float y,
-                       const int height, const int width,
-                       const float zxh, const float zyh,
-                       int xIndex, int yIndex, const fvec &center, const bool bRestrictedDims)
+void DrawTimer::RunJobs(int start, int stop, bool bParallel)
 {
-    sample = center;
-    if(bRestrictedDims) {
-        sample[0] += (x - width*0.5f)*zxh;
-        sample[1] += (-y + height*0.5f)*zyh;
+    nextTile = start;
+    tileStop = stop;
+    int threadCount = bParallel ? min(tilePool.maxThreadCount(), stop-start) : 0;
+    if(threadCount > 1) {
+        FOR(i, threadCount) tilePool.start(new TileWorker(this));
+        // we publish the finished tiles while the workers are busy, bigMap itself is not shared until they are done
+        while(!tilePool.waitForDone(40)) emit MapReady(bigMap.copy());
     } else {
-        sample[xIndex] += (x - width*0.5f)*zxh;
-        sample[yIndex] += (-y + height*0.5f)*zyh;
+        RenderTiles();
     }
 }
 
-bool DrawTimer::TestFast(int start, int stop)
+inline void DrawTimer::SampleAt(float x, float y, float *sample) const
 {
-    if(stop < 0 || stop > w*h) stop = w*h;
-    mutex->lock();
-    int dim=canvas->data->GetDimCount();
-    vector<Obstacle> obstacles = canvas->data->GetObstacles();
-    int xIndex = canvas->xIndex;
-    int yIndex = canvas->yIndex;
-    bool bRestrictedDims = false;
-    if(inputDims.size() == 2 && xIndex == inputDims.front() && yIndex == inputDims.back()) {
-        bRestrictedDims = true;
-        dim = 2;
-    }
-    int cheight = canvas->height();
-    int cwidth = canvas->width();
-    float zxh = 1.f / (canvas->zoom*canvas->zooms[xIndex]*cheight);
-    float zyh = 1.f / (canvas->zoom*canvas->zooms[yIndex]*cheight);
-    fvec center = canvas->center;
-    if(bRestrictedDims) {
-        fvec newCenter(2,0);
-        newCenter[0] = center[xIndex];
-        newCenter[1] = center[yIndex];
-        center = newCenter;
-    }
-    mutex->unlock();
-    if(dim > 2) return false; // we dont want to draw multidimensional stuff, it's ... problematic
-    fvec sampleMatrix(dim*(stop-start));
-    vector<fvec> samples(stop-start);
-    vector<int> X(stop-start);
-    vector<int> Y(stop-start);
-    FOR(i, stop-start) {
-        drawMutex.lock();
-        if(!perm) perm = randPerm(w*h);
-        int x = perm[i+start]%w;
-        int y = perm[i+start]/w;
-        if(x >= bigMap.width() || y >= bigMap.height())
-        {
-            drawMutex.unlock();
-            continue;
-        }
-        drawMutex.unlock();
-        X[i] = x;
-        Y[i] = y;
-        fromCanvas(samples[i], x, y, cheight, cwidth, zxh, zyh, xIndex, yIndex, center, bRestrictedDims);
+    const TileSnapshot &snap = snapshot;
+    FOR(d, snap.dim) sample[d] = snap.center[d];
+    if(snap.bRestrictedDims) {
+        sample[0] += (x - snap.width*0.5f)*snap.zxh;
+        sample[1] += (-y + snap.height*0.5f)*snap.zyh;
+    } else {
+        sample[snap.xIndex] += (x - snap.width*0.5f)*snap.zxh;
+        sample[snap.yIndex] += (-y + snap.height*0.5f)*snap.zyh;
     }
+}
 
-    FOR(i, stop-start) {
-        fvec& sample = samples[i];
-        int x = X[i];
-        int y = Y[i];
-
-        QMutexLocker lock(mutex);
-        if((*classifier)) {
-            QColor c = GetColor(*classifier, sample, classifierMulti);
-            drawMutex.lock();
-            bigMap.setPixel(x,y,c.rgb());
-            drawMutex.unlock();
-        } else if(*regressor) {
-            //fvec val = (*regressor)->Test(sample);
-        } else if(*clusterer) {
-            fvec res = (*clusterer)->Test(sample);
+bool DrawTimer::EvaluateColors(const fvec &sampleMatrix, std::vector<QColor> &colors)
+{
+    int dim = snapshot.dim;
+    int count = sampleMatrix.size() / dim;
+    colors.resize(count);
+    if(classifier && (*classifier)) {
+        GetColors(*classifier, sampleMatrix, dim, colors, classifierMulti);
+    } else if(clusterer && (*clusterer)) {
+        fvec results = (*clusterer)->TestMany(sampleMatrix, dim, count);
+        int resDim = count ? results.size() / count : 0;
+        FOR(i, count) {
+            const float *res = resDim ? &results[i*resDim] : 0;
             float r=0,g=0,b=0;
-            if(res.size() > 1) {
-                FOR(j, res.size()) {
+            if(resDim > 1) {
+                FOR(j, resDim) {
                     r += SampleColor[(j+1)%SampleColorCnt].red()*res[j];
                     g += SampleColor[(j+1)%SampleColorCnt].green()*res[j];
                     b += SampleColor[(j+1)%SampleColorCnt].blue()*res[j];
                 }
-            } else if(res.size()) {
+            } else if(resDim) {
                 r = (1-res[0])*255 + res[0]* 255;
                 g = (1-res[0])*255;
                 b = (1-res[0])*255;
@@ -960,15 +959,16 @@ bool DrawTimer::TestFast(int start, int stop)
             r = max(0.f,min(255.f, r));
             g = max(0.f,min(255.f, g));
             b = max(0.f,min(255.f, b));
-            QColor c(r,g,b);
-            drawMutex.lock();
-            bigMap.setPixel(x,y,c.rgb());
-            drawMutex.unlock();
-        } else if(*dynamical && bColorMap) {
+            colors[i] = QColor(r,g,b);
+        }
+    } else if(dynamical && (*dynamical) && bColorMap) {
+        fvec sample(dim);
+        FOR(i, count) {
+            FOR(d, dim) sample[d] = sampleMatrix[i*dim + d];
             QColor color;
             fvec val = (*dynamical)->Test(sample);
             if((*dynamical)->avoid) {
-                (*dynamical)->avoid->SetObstacles(obstacles);
+                (*dynamical)->avoid->SetObstacles(snapshot.obstacles);
                 fVec newRes = (*dynamical)->avoid->Avoid(sample, val);
                 val = newRes;
             }
@@ -985,10 +985,203 @@ bool DrawTimer::TestFast(int start, int stop)
             } else if(colorStyle == 1) {// speed as color
                 color = QColor(Canvas::GetColorMapValue(speed, 2));
             }
-            drawMutex.lock();
-            bigMap.setPixel(x,y,color.rgb());
-            drawMutex.unlock();
+            colors[i] = color;
         }
+    } else return false;
+    return true;
+}
+
+void DrawTimer::RenderTile(int tileIndex)
+{
+    const TileSnapshot &snap = snapshot;
+    int x0 = (tileIndex % tilesX)*tileSize;
+    int y0 = (tileIndex / tilesX)*tileSize;
+    int x1 = min(x0 + tileSize, snap.width);
+    int y1 = min(y0 + tileSize, snap.height);
+    if(x0 >= x1 || y0 >= y1) return;
+    int tileW = x1-x0, tileH = y1-y0;
+    int count = tileW*tileH;
+
+    // we generate the samples for the whole tile
+    fvec sampleMatrix(count*snap.dim);
+    FOR(i, count) SampleAt(x0 + i%tileW, y0 + i/tileW, &sampleMatrix[i*snap.dim]);
+    vector<QColor> colors;
+    if(!EvaluateColors(sampleMatrix, colors)) return;
+
+    // each tile owns its own pixels, so we can write straight into the scanlines
+    FOR(y, tileH) {
+        QRgb *line = (QRgb*)(snap.bits + (y0+y)*snap.bytesPerLine) + x0;
+        FOR(x, tileW) line[x] = colors[x + y*tileW].rgb();
+    }
+}
+
+void DrawTimer::EvaluateQuadChunk(int chunkIndex)
+{
+    int start = chunkIndex*quadChunkSize;
+    int stop = min(start + quadChunkSize, (int)quadPoints.size());
+    if(start >= stop) return;
+    int stride = w+1;
+    fvec sampleMatrix((stop-start)*snapshot.dim);
+    FOR(i, stop-start) {
+        int index = quadPoints[start+i];
+        SampleAt(index % stride, index / stride, &sampleMatrix[i*snapshot.dim]);
+    }
+    vector<QColor> colors;
+    if(!EvaluateColors(sampleMatrix, colors)) return;
+    FOR(i, stop-start) quadColors[quadPoints[start+i]] = colors[i].rgb();
+}
+
+bool DrawTimer::TakeSnapshot()
+{
+    int dim=canvas->data->GetDimCount();
+    int xIndex = canvas->xIndex;
+    int yIndex = canvas->yIndex;
+    bool bRestrictedDims = false;
+    if(inputDims.size() == 2 && xIndex == inputDims.front() && yIndex == inputDims.back()) {
+        bRestrictedDims = true;
+        dim = 2;
+    }
+    if(dim > 2) return false; // we dont want to draw multidimensional stuff, it's ... problematic
+    int cheight = canvas->height();
+    int cwidth = canvas->width();
+    snapshot.width = cwidth;
+    snapshot.height = cheight;
+    snapshot.dim = dim;
+    snapshot.xIndex = xIndex;
+    snapshot.yIndex = yIndex;
+    snapshot.zxh = 1.f / (canvas->zoom*canvas->zooms[xIndex]*cheight);
+    snapshot.zyh = 1.f / (canvas->zoom*canvas->zooms[yIndex]*cheight);
+    snapshot.center = canvas->center;
+    snapshot.bRestrictedDims = bRestrictedDims;
+    if(bRestrictedDims) {
+        fvec newCenter(2,0);
+        newCenter[0] = snapshot.center[xIndex];
+        newCenter[1] = snapshot.center[yIndex];
+        snapshot.center = newCenter;
     }
+    snapshot.obstacles = canvas->data->GetObstacles();
     return true;
 }
+
+bool DrawTimer::IsParallel() const
+{
+    // only the classifiers that declare themselves thread-safe are evaluated concurrently
+    bool bParallel = classifier && (*classifier) && (*classifier)->IsThreadSafe();
+    if(bParallel && classifierMulti) {
+        FOR(i, classifierMulti->size()) bParallel &= (*classifierMulti)[i]->IsThreadSafe();
+    }
+    return bParallel;
+}
+
+bool DrawTimer::TestFast(int start, int stop)
+{
+    if(stop < 0 || stop > TileCount()) stop = TileCount();
+    if(start >= stop) return true;
+    // the canvas transform is copied under the lock, the pass itself only holds passMutex,
+    // which Stop() waits for before the model can be deleted
+    QMutexLocker lock(mutex);
+    if(!TakeSnapshot()) return false;
+    if(!(classifier && *classifier) && !(clusterer && *clusterer) && !(dynamical && *dynamical)) return true;
+    QMutexLocker passLock(&passMutex);
+    if(!bRunning) return false;
+    {
+        QMutexLocker drawLock(&drawMutex);
+        if(bigMap.width() != snapshot.width || bigMap.height() != snapshot.height) return false;
+        if(!perm) perm = randPerm(TileCount());
+        // detaches bigMap from the copies already handed to the canvas
+        snapshot.bits = bigMap.bits();
+        snapshot.bytesPerLine = bigMap.bytesPerLine();
+    }
+    lock.unlock();
+
+    bQuadPass = false;
+    RunJobs(start, stop, IsParallel());
+    return bRunning;
+}
+
+static inline int QuadColorSpread(QRgb a, QRgb b, QRgb c, QRgb d)
+{
+    int rMax = MAX3(qRed(a), qRed(b), max(qRed(c), qRed(d))), rMin = MIN3(qRed(a), qRed(b), min(qRed(c), qRed(d)));
+    int gMax = MAX3(qGreen(a), qGreen(b), max(qGreen(c), qGreen(d))), gMin = MIN3(qGreen(a), qGreen(b), min(qGreen(c), qGreen(d)));
+    int bMax = MAX3(qBlue(a), qBlue(b), max(qBlue(c), qBlue(d))), bMin = MIN3(qBlue(a), qBlue(b), min(qBlue(c), qBlue(d)));
+    return MAX3(rMax-rMin, gMax-gMin, bMax-bMin);
+}
+
+bool DrawTimer::RefineQuadTree()
+{
+    QMutexLocker lock(mutex);
+    if(!TakeSnapshot()) return true;
+    QMutexLocker passLock(&passMutex);
+    if(!bRunning) return false;
+    {
+        QMutexLocker drawLock(&drawMutex);
+        // the canvas was resized: the next Refine will start over
+        if(bigMap.width() != snapshot.width || bigMap.height() != snapshot.height) return false;
+        if(w != snapshot.width || h != snapshot.height) return false;
+        snapshot.bits = bigMap.bits();
+        snapshot.bytesPerLine = bigMap.bytesPerLine();
+    }
+    lock.unlock();
+    int stride = w+1;
+    if((int)quadColors.size() != stride*(h+1)) {
+        quadColors.assign(stride*(h+1), 0);
+        quadKnown.assign(stride*(h+1), 0);
+        quadBlocks.clear();
+        for(int y=0; y<h; y+=quadBlockSize) {
+            for(int x=0; x<w; x+=quadBlockSize) {
+                QuadBlock b = {x, y, min(quadBlockSize, w-x), min(quadBlockSize, h-y)};
+                quadBlocks.push_back(b);
+            }
+        }
+    }
+    if(!quadBlocks.size()) return true;
+
+    // we gather the corners that have not been evaluated yet
+    quadPoints.clear();
+    FOR(i, quadBlocks.size()) {
+        const QuadBlock &b = quadBlocks[i];
+        int corners[4] = {b.x + b.y*stride, b.x+b.w + b.y*stride, b.x + (b.y+b.h)*stride, b.x+b.w + (b.y+b.h)*stride};
+        FOR(c, 4) {
+            if(quadKnown[corners[c]]) continue;
+            quadKnown[corners[c]] = 1;
+            quadPoints.push_back(corners[c]);
+        }
+    }
+    bQuadPass = true;
+    RunJobs(0, (quadPoints.size() + quadChunkSize - 1) / quadChunkSize, IsParallel());
+    if(!bRunning) {
+        // the corners we did not get to will have to be evaluated again
+        FOR(i, quadPoints.size()) quadKnown[quadPoints[i]] = 0;
+        return false;
+    }
+
+    // blocks with agreeing corners are interpolated, the others are split in four
+    std::vector<QuadBlock> nextBlocks;
+    FOR(i, quadBlocks.size()) {
+        const QuadBlock &b = quadBlocks[i];
+        QRgb c00 = quadColors[b.x + b.y*stride], c10 = quadColors[b.x+b.w + b.y*stride];
+        QRgb c01 = quadColors[b.x + (b.y+b.h)*stride], c11 = quadColors[b.x+b.w + (b.y+b.h)*stride];
+        if(b.w > 1 || b.h > 1) {
+            if(QuadColorSpread(c00, c10, c01, c11) > quadTolerance) {
+                int hw = (b.w+1)/2, hh = (b.h+1)/2;
+                QuadBlock children[4] = {{b.x, b.y, hw, hh}, {b.x+hw, b.y, b.w-hw, hh},
+                                         {b.x, b.y+hh, hw, b.h-hh}, {b.x+hw, b.y+hh, b.w-hw, b.h-hh}};
+                FOR(c, 4) if(children[c].w > 0 && children[c].h > 0) nextBlocks.push_back(children[c]);
+            }
+        }
+        // we paint the block anyway, the children will overwrite it with the finer details
+        FOR(y, b.h) {
+            float fy = y / (float)b.h;
+            QRgb *line = (QRgb*)(snapshot.bits + (b.y+y)*snapshot.bytesPerLine) + b.x;
+            FOR(x, b.w) {
+                float fx = x / (float)b.w;
+                float w00 = (1-fx)*(1-fy), w10 = fx*(1-fy), w01 = (1-fx)*fy, w11 = fx*fy;
+                line[x] = qRgb(qRed(c00)*w00 + qRed(c10)*w10 + qRed(c01)*w01 + qRed(c11)*w11,
+                               qGreen(c00)*w00 + qGreen(c10)*w10 + qGreen(c01)*w01 + qGreen(c11)*w11,
+                               qBlue(c00)*w00 + qBlue(c10)*w10 + qBlue(c01)*w01 + qBlue(c11)*w11);
+            }
+        }
+    }
+    quadBlocks = nextBlocks;
+    return !quadBlocks.size();
+}
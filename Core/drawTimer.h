@@ -31,10 +31,33 @@ Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
 #include "glwidget.h"
 #include <QMutex>
 #include <QMutexLocker>
+#include <QThreadPool>
+#include <QAtomicInt>
+
+// canvas transform and target image captured once per refinement pass,
+// so that the tiles can be evaluated without going back to the canvas
+struct TileSnapshot
+{
+    int width, height, dim;
+    int xIndex, yIndex;
+    float zxh, zyh;
+    fvec center;
+    bool bRestrictedDims;
+    std::vector<Obstacle> obstacles;
+    uchar *bits;
+    int bytesPerLine;
+};
+
+// block of the quadtree refinement, in pixels
+struct QuadBlock
+{
+    int x, y, w, h;
+};
 
 class DrawTimer : public QThread
 {
 	Q_OBJECT
+    friend class TileWorker;
 private:
 	int refineLevel;
 	int refineMax;
@@ -44,6 +67,24 @@ private:
 	u32 *perm;
 	Canvas *canvas;
 	int w, h, dim;
+    int tilesX, tilesY;
+    QThreadPool tilePool;
+    QAtomicInt nextTile;
+    int tileStop;
+    TileSnapshot snapshot;
+    std::vector<QuadBlock> quadBlocks;
+    std::vector<QRgb> quadColors; // colors at the block corners, (w+1)*(h+1)
+    std::vector<u8> quadKnown; // corners already evaluated (or queued for the current pass)
+    ivec quadPoints;
+    bool bQuadPass;
+    void RenderTiles();
+    void RenderTile(int tileIndex);
+    void EvaluateQuadChunk(int chunkIndex);
+    void RunJobs(int start, int stop, bool bParallel);
+    void SampleAt(float x, float y, float *sample) const;
+    bool EvaluateColors(const fvec &sampleMatrix, std::vector<QColor> &colors);
+    bool TakeSnapshot();
+    bool IsParallel() const;
 
 public:
 	DrawTimer(Canvas *canvas, QMutex *mutex);
@@ -53,6 +94,12 @@ public:
     void Animate();
 	void Clear();
     bool TestFast(int start, int stop);
+    int TileCount() const {return tilesX*tilesY;}
+    bool RefineQuadTree();
+    static const int tileSize = 32;
+    static const int quadBlockSize = 8;
+    static const int quadChunkSize = 1024;
+    static const int quadTolerance = 6;
     bool Vectors(int count, int steps);
     bool VectorsGL(int count, int steps);
     bool VectorsFast(int count, int steps);
@@ -60,6 +107,8 @@ public:
     void Reinforce();
 	void Stop();
     static QColor GetColor(Classifier *classifier, fvec sample, std::vector<Classifier*> *classifierMulti=0, ivec sourceDims=ivec());
+    static QColor GetColor(Classifier *classifier, const float *val, int valDim);
+    static void GetColors(Classifier *classifier, const fvec &sampleMatrix, int dim, std::vector<QColor> &colors, std::vector<Classifier*> *classifierMulti=0);
 
 	Classifier **classifier;
 	Regressor **regressor;
@@ -71,10 +120,12 @@ public:
     std::vector<Classifier*> *classifierMulti;
 
 	QMutex *mutex, drawMutex;
+    QMutex passMutex; // held while the workers evaluate the model and write into bigMap
     GLWidget *glw;
     bool bPaused;
 	bool bRunning;
 	bool bColorMap;
+    bool bQuadTree;
     int maximumVisitedCount;
     ivec inputDims;
 
@@ -23,7 +23,6 @@ Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
 #include <QBitmap>
 #include <QDebug>
 #include "qcontour.h"
-#include "kmeans.h"
 #include <jacgrid/jacgrid.h>
 using namespace std;
 
@@ -677,6 +676,9 @@ void Draw3DClassifier(GLWidget *glw, Classifier *classifier)
     float *maxVals = new float[steps];
     double *values = new double[steps*steps*steps];
     printf("Generating volumetric data: ");
+    // each y slice is evaluated as a single batch
+    fvec sliceMatrix(steps*steps*dim);
+    fvec sliceResults(steps*steps);
     FOR(y, steps)
     {
         //        values[y] = new double[steps*steps];
@@ -689,38 +691,36 @@ void Draw3DClassifier(GLWidget *glw, Classifier *classifier)
             FOR(x, steps)
             {
                 sample[xIndex] = x/(float)steps*(maxes[xIndex]-mins[xIndex]) + mins[xIndex];
-                if(classifier->IsMultiClass())
-                {
-                    fvec res = classifier->TestMulti(sample);
-                    if(res.size() == 1)
-                    {
-                        values[x + (y + z*steps)*steps] = res[0];
-                    }
-                    else
-                    {
-                        // we mostly want to know if the sample is close to the boundary
-                        float maxVal = res[0];
-                        int maxInd = 0;
-                        FOR(d, res.size())
-                        {
-                            if(maxVal < res[d])
-                            {
-                                maxInd = d;
-                                maxVal = res[d];
-                            }
-                        }
-                        // we keep the class with the highest score
-                        values[x + (y + z*steps)*steps] = maxInd;
-                        bMultiClass = true;
-                    }
-                }
-                else
+                FOR(d, dim) sliceMatrix[(x + z*steps)*dim + d] = sample[d];
+            }
+        }
+        if(classifier->IsMultiClass())
+        {
+            fvec res;
+            int resDim = classifier->TestMultiBatch(&sliceMatrix[0], steps*steps, dim, res);
+            if(resDim == 1)
+            {
+                FOR(i, steps*steps) sliceResults[i] = res[i];
+            }
+            else
+            {
+                FOR(i, steps*steps)
                 {
-                    float res = classifier->Test(sample);
-                    values[x + (y + z*steps)*steps] = res;
+                    // we mostly want to know if the sample is close to the boundary
+                    float *r = &res[i*resDim];
+                    int maxInd = 0;
+                    FOR(d, resDim) if(r[maxInd] < r[d]) maxInd = d;
+                    // we keep the class with the highest score
+                    sliceResults[i] = maxInd;
                 }
+                if(resDim) bMultiClass = true;
             }
         }
+        else classifier->TestBatch(&sliceMatrix[0], steps*steps, dim, &sliceResults[0]);
+        FOR(z, steps)
+        {
+            FOR(x, steps) values[x + (y + z*steps)*steps] = sliceResults[x + z*steps];
+        }
     }
     printf("done.\n");
     fflush(stdout);
@@ -877,6 +877,8 @@ void Draw3DClusterer(GLWidget *glw, Clusterer *clusterer)
     printf("Generating volumetric data: ");
     bool bOneClass = true;
     int clusterCount = clusterer->NbClusters();
+    // each y slice is evaluated as a single batch
+    fvec sliceMatrix(steps*steps*dim);
     FOR(y, steps)
     {
         //        values[y] = new double[steps*steps];
@@ -889,21 +891,22 @@ void Draw3DClusterer(GLWidget *glw, Clusterer *clusterer)
             FOR(x, steps)
             {
                 sample[xIndex] = x/(float)steps*(maxes[xIndex]-mins[xIndex]) + mins[xIndex];
-                fvec res = clusterer->Test(sample);
-                if(res.size() == 1) values[x + (y + z*steps)*steps] = res[0];
+                FOR(d, dim) sliceMatrix[(x + z*steps)*dim + d] = sample[d];
+            }
+        }
+        fvec res = clusterer->TestMany(sliceMatrix, dim, steps*steps);
+        if(!res.size()) res.resize(steps*steps, 0.f);
+        int resDim = res.size() / (steps*steps);
+        FOR(z, steps)
+        {
+            FOR(x, steps)
+            {
+                float *r = &res[(x + z*steps)*resDim];
+                if(resDim == 1) values[x + (y + z*steps)*steps] = r[0];
                 else
                 {
-
-                    float maxVal = res[0];
                     int maxInd = 0;
-                    FOR(d, res.size())
-                    {
-                        if(maxVal < res[d])
-                        {
-                            maxInd = d;
-                            maxVal = res[d];
-                        }
-                    }
+                    FOR(d, resDim) if(r[maxInd] < r[d]) maxInd = d;
                     // we keep the class with the highest score
                     values[x + (y + z*steps)*steps] = maxInd;
                     bOneClass = false;
@@ -222,6 +222,19 @@ fvec RandCovMatrix(int dim, float minLambda=1.f)
     return CS;
 }
 
+fvec flatten(const std::vector<fvec> &samples, int dim)
+{
+    if(!samples.size()) return fvec();
+    if(dim < 0) dim = samples[0].size();
+    fvec matrix(samples.size()*dim, 0.f);
+    FOR(i, samples.size())
+    {
+        int sampleDim = min(dim, (int)samples[i].size());
+        FOR(d, sampleDim) matrix[i*dim + d] = samples[i][d];
+    }
+    return matrix;
+}
+
 std::vector<fvec> interpolate(std::vector<fvec> a, int count)
 {
 	// basic interpolation
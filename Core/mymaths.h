@@ -138,6 +138,8 @@ bool operator != (const fvec a, const float b);
 
 std::vector<fvec> interpolate(std::vector<fvec> a, int count);
 std::vector<fvec> interpolateSpline(std::vector<fvec> a, int count);
+// copies the samples into a single row-major (count x dim) matrix, for the batched Test functions
+fvec flatten(const std::vector<fvec> &samples, int dim=-1);
 
 // generate random sample from normal distribution
 static inline float ranf()
@@ -0,0 +1,324 @@
+/*********************************************************************
+MLDemos: A User-Friendly visualization toolkit for machine learning
+Copyright (C) 2010  Basilio Noris
+Contact: mldemos@b4silio.com
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public License,
+version 3 as published by the Free Software Foundation.
+
+This library is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free
+Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*********************************************************************/
+#include "neighborGraph.h"
+#include <algorithm>
+#include <functional>
+#include <string>
+#include <cmath>
+
+using namespace std;
+
+typedef pair<float,int> Candidate;
+
+NeighborGraph::NeighborGraph(int links, int buildBreadth, int searchBreadth)
+    : distMetric(NeighborIndex::METRIC_L2), distPower(2.f), count(0), dim(0), entry(-1), topLayer(-1), seed(2463534242u)
+{
+    SetParams(links, buildBreadth, searchBreadth);
+}
+
+void NeighborGraph::SetParams(int links, int buildBreadth, int searchBreadth)
+{
+    maxLinks = max(2, links);
+    efBuild = max(maxLinks, buildBreadth);
+    efSearch = max(1, searchBreadth);
+}
+
+void NeighborGraph::SetMetric(NeighborIndex::Metric metric, float power)
+{
+    distMetric = metric;
+    distPower = power;
+    if(metric == NeighborIndex::METRIC_LP && power == 1) distMetric = NeighborIndex::METRIC_L1;
+    if(metric == NeighborIndex::METRIC_LP && power == 2) distMetric = NeighborIndex::METRIC_L2;
+}
+
+void NeighborGraph::Clear()
+{
+    count = dim = 0;
+    data.clear();
+    neighbors.clear();
+    entry = topLayer = -1;
+    seed = 2463534242u;
+}
+
+void NeighborGraph::Build(const float *data, int count, int dim)
+{
+    Clear();
+    if(!data || count <= 0 || dim <= 0) return;
+    this->data.reserve((size_t)count*dim);
+    neighbors.reserve(count);
+    FOR(i, count) Insert(data + (size_t)i*dim, dim);
+}
+
+inline float NeighborGraph::Distance(const float *a, const float *b) const
+{
+    return NeighborIndex::Distance(distMetric, distPower, a, b, dim);
+}
+
+// layers are drawn from a geometric distribution, each one holding about 1/links of the points of the one below
+int NeighborGraph::RandomLayer()
+{
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    double u = (seed + 1.) / 4294967297.;
+    return min(16, (int)(-log(u) / log((double)maxLinks)));
+}
+
+// walks from start to the closest point it can reach on the layer
+int NeighborGraph::Greedy(const float *query, int start, int layer) const
+{
+    int current = start;
+    float dist = Distance(query, row(current));
+    bool bChanged = true;
+    while(bChanged)
+    {
+        bChanged = false;
+        const ivec &links = neighbors[current][layer];
+        FOR(i, links.size())
+        {
+            float d = Distance(query, row(links[i]));
+            if(d >= dist) continue;
+            dist = d;
+            current = links[i];
+            bChanged = true;
+        }
+    }
+    return current;
+}
+
+// best-first search of the layer from start, the breadth closest points found are left in scratch.heap
+void NeighborGraph::SearchLayer(const float *query, int start, int breadth, int layer, NeighborQuery &scratch) const
+{
+    vector<u32> &visited = scratch.visited;
+    if((int)visited.size() < count) visited.resize(count, 0);
+    if(++scratch.visitMark == 0)
+    {
+        fill(visited.begin(), visited.end(), 0);
+        scratch.visitMark = 1;
+    }
+    u32 mark = scratch.visitMark;
+    vector<Candidate> &best = scratch.heap; // max-heap, the worst result on top
+    vector<Candidate> &frontier = scratch.candidates; // min-heap, the closest point to expand on top
+    best.clear();
+    frontier.clear();
+    float dist = Distance(query, row(start));
+    visited[start] = mark;
+    best.push_back(make_pair(dist, start));
+    frontier.push_back(make_pair(dist, start));
+    while(frontier.size())
+    {
+        Candidate current = frontier.front();
+        if(current.first > best.front().first) break; // nothing closer can be reached anymore
+        pop_heap(frontier.begin(), frontier.end(), greater<Candidate>());
+        frontier.pop_back();
+        const ivec &links = neighbors[current.second][layer];
+        FOR(i, links.size())
+        {
+            int n = links[i];
+            if(visited[n] == mark) continue;
+            visited[n] = mark;
+            float d = Distance(query, row(n));
+            if((int)best.size() == breadth && d >= best.front().first) continue;
+            frontier.push_back(make_pair(d, n));
+            push_heap(frontier.begin(), frontier.end(), greater<Candidate>());
+            best.push_back(make_pair(d, n));
+            push_heap(best.begin(), best.end());
+            if((int)best.size() > breadth)
+            {
+                pop_heap(best.begin(), best.end());
+                best.pop_back();
+            }
+        }
+    }
+}
+
+// keeps at most maxCount candidates, sorted by distance, skipping those closer to an already kept one
+// than to the point itself so that the links spread around the point instead of piling up on one side
+void NeighborGraph::SelectNeighbors(vector<Candidate> &candidates, int maxCount) const
+{
+    sort(candidates.begin(), candidates.end());
+    int kept = 0;
+    FOR(i, candidates.size())
+    {
+        if(kept == maxCount) break;
+        const float *point = row(candidates[i].second);
+        bool bKeep = true;
+        for(int j=0; j<kept && bKeep; j++)
+        {
+            bKeep = Distance(point, row(candidates[j].second)) >= candidates[i].first;
+        }
+        if(bKeep) candidates[kept++] = candidates[i];
+    }
+    candidates.resize(kept);
+}
+
+// adds the link from -> to, pruning the links of from when it has too many
+void NeighborGraph::Link(int from, int to, int layer)
+{
+    ivec &links = neighbors[from][layer];
+    links.push_back(to);
+    int maxCount = layer ? maxLinks : 2*maxLinks;
+    if((int)links.size() <= maxCount) return;
+    pruned.resize(links.size());
+    FOR(i, links.size()) pruned[i] = make_pair(Distance(row(from), row(links[i])), links[i]);
+    SelectNeighbors(pruned, maxCount);
+    links.resize(pruned.size());
+    FOR(i, pruned.size()) links[i] = pruned[i].second;
+}
+
+int NeighborGraph::Insert(const float *point, int dim)
+{
+    if(!count) this->dim = dim;
+    if(dim != this->dim || dim <= 0) return -1;
+    int index = count++;
+    data.insert(data.end(), point, point + dim);
+    int layer = RandomLayer();
+    neighbors.push_back(vector<ivec>(layer+1));
+    if(!index)
+    {
+        entry = index;
+        topLayer = layer;
+        return index;
+    }
+    const float *query = row(index);
+    int current = entry;
+    for(int l=topLayer; l>layer; l--) current = Greedy(query, current, l);
+    for(int l=min(layer, topLayer); l>=0; l--)
+    {
+        SearchLayer(query, current, efBuild, l, buildQuery);
+        vector<Candidate> &found = buildQuery.heap;
+        SelectNeighbors(found, l ? maxLinks : 2*maxLinks);
+        current = found[0].second; // the closest point found, where the search resumes on the layer below
+        ivec &links = neighbors[index][l];
+        FOR(i, found.size())
+        {
+            links.push_back(found[i].second);
+            Link(found[i].second, index, l);
+        }
+    }
+    if(layer > topLayer)
+    {
+        entry = index;
+        topLayer = layer;
+    }
+    return index;
+}
+
+void NeighborGraph::KNearest(const float *query, int k, NeighborQuery &scratch) const
+{
+    scratch.indices.clear();
+    scratch.distances.clear();
+    if(!count || k <= 0) return;
+    int current = entry;
+    for(int l=topLayer; l>0; l--) current = Greedy(query, current, l);
+    SearchLayer(query, current, max(efSearch, k), 0, scratch);
+    vector<Candidate> &best = scratch.heap;
+    sort_heap(best.begin(), best.end());
+    int found = min(k, (int)best.size());
+    scratch.indices.resize(found);
+    scratch.distances.resize(found);
+    FOR(i, found)
+    {
+        scratch.indices[i] = best[i].second;
+        scratch.distances[i] = best[i].first;
+    }
+}
+
+void NeighborGraph::KNearest(const float *query, int k, ivec &result, fvec *distances) const
+{
+    NeighborQuery scratch;
+    KNearest(query, k, scratch);
+    result.swap(scratch.indices);
+    if(distances) distances->swap(scratch.distances);
+}
+
+void NeighborGraph::Save(ostream &file) const
+{
+    streamsize precision = file.precision(9);
+    file << "NeighborGraph " << dim << " " << count << " " << maxLinks << " " << efBuild << " " << efSearch << " ";
+    file << (int)distMetric << " " << distPower << " " << entry << " " << topLayer << " " << seed << "\n";
+    FOR(i, count)
+    {
+        FOR(d, dim) file << data[(size_t)i*dim + d] << " ";
+        file << neighbors[i].size();
+        FOR(l, neighbors[i].size())
+        {
+            file << " " << neighbors[i][l].size();
+            FOR(j, neighbors[i][l].size()) file << " " << neighbors[i][l][j];
+        }
+        file << "\n";
+    }
+    file.precision(precision);
+}
+
+bool NeighborGraph::Load(istream &file)
+{
+    Clear();
+    string header;
+    int metric;
+    file >> header;
+    if(header != "NeighborGraph") return false;
+    file >> dim >> count >> maxLinks >> efBuild >> efSearch >> metric >> distPower >> entry >> topLayer >> seed;
+    if(!file || dim < 0 || count < 0 || (count && (dim == 0 || entry < 0 || entry >= count || topLayer < 0)))
+    {
+        Clear();
+        return false;
+    }
+    distMetric = (NeighborIndex::Metric)metric;
+    data.resize((size_t)count*dim);
+    neighbors.resize(count);
+    FOR(i, count)
+    {
+        FOR(d, dim) file >> data[(size_t)i*dim + d];
+        int layers = 0;
+        file >> layers;
+        if(layers <= 0 || layers > topLayer+1) file.setstate(ios::failbit);
+        if(!file) break;
+        neighbors[i].resize(layers);
+        FOR(l, layers)
+        {
+            int linkCount = 0;
+            file >> linkCount;
+            if(linkCount < 0 || linkCount > count) file.setstate(ios::failbit);
+            if(!file) break;
+            neighbors[i][l].resize(linkCount);
+            FOR(j, linkCount) file >> neighbors[i][l][j];
+        }
+    }
+    // every point needs its layers, and the searches only follow links to points that exist on that layer
+    bool bValid = file && (!count || (int)neighbors[entry].size() == topLayer+1);
+    for(int i=0; bValid && i<count; i++)
+    {
+        if(neighbors[i].empty()) bValid = false;
+        FOR(l, neighbors[i].size())
+        {
+            FOR(j, neighbors[i][l].size())
+            {
+                int n = neighbors[i][l][j];
+                if(n < 0 || n >= count || neighbors[n].size() <= l) bValid = false;
+            }
+        }
+    }
+    if(!bValid)
+    {
+        Clear();
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,85 @@
+/*********************************************************************
+MLDemos: A User-Friendly visualization toolkit for machine learning
+Copyright (C) 2010  Basilio Noris
+Contact: mldemos@b4silio.com
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public License,
+version 3 as published by the Free Software Foundation.
+
+This library is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free
+Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*********************************************************************/
+#ifndef _NEIGHBOR_GRAPH_H_
+#define _NEIGHBOR_GRAPH_H_
+
+#include <vector>
+#include <iostream>
+#include "neighborIndex.h"
+
+/*!
+ * Approximate nearest neighbor search on a hierarchical navigable small world graph
+ * (Malkov and Yashunin). Every point is linked to its closest neighbors on the bottom
+ * layer, and to a decreasing number of points on the sparser layers above it, which a
+ * query descends greedily before exploring the bottom layer with a candidate list of
+ * searchBreadth points. Larger links, buildBreadth and searchBreadth trade speed for recall.
+ * Unlike the kd-tree the graph keeps a copy of the points and Insert adds one point at a time
+ * to an existing graph, which is how KNNSearch extends a graph with new samples instead of
+ * building a new one. Queries do not modify the graph and
+ * can be run concurrently, insertions cannot. Distances follow the NeighborIndex conventions.
+ */
+class NeighborGraph
+{
+public:
+    NeighborGraph(int links=16, int buildBreadth=100, int searchBreadth=50);
+
+    void SetParams(int links, int buildBreadth, int searchBreadth);
+    void SetMetric(NeighborIndex::Metric metric, float power=2.f);
+    void Clear();
+    void Build(const float *data, int count, int dim);
+    // adds a point of dimension() coordinates (or sets the dimension of an empty graph) and returns its index
+    int Insert(const float *point, int dim);
+    int size() const {return count;}
+    int dimension() const {return dim;}
+    const float *row(int i) const {return &data[(size_t)i*dim];}
+    int links() const {return maxLinks;}
+    int buildBreadth() const {return efBuild;}
+    int searchBreadth() const {return efSearch;}
+    NeighborIndex::Metric metric() const {return distMetric;}
+    float power() const {return distPower;}
+
+    // the (approximately) k nearest points sorted by increasing distance, in query.indices and query.distances
+    void KNearest(const float *query, int k, NeighborQuery &scratch) const;
+    void KNearest(const float *query, int k, ivec &result, fvec *distances=0) const;
+
+    void Save(std::ostream &file) const;
+    // false, and an empty graph, if the stream does not hold a consistent graph
+    bool Load(std::istream &file);
+
+private:
+    int maxLinks, efBuild, efSearch;
+    NeighborIndex::Metric distMetric;
+    float distPower;
+    int count, dim;
+    fvec data;
+    std::vector< std::vector<ivec> > neighbors; // per point, per layer
+    int entry, topLayer;
+    u32 seed;
+    NeighborQuery buildQuery;
+    std::vector< std::pair<float,int> > pruned;
+
+    float Distance(const float *a, const float *b) const;
+    int RandomLayer();
+    int Greedy(const float *query, int start, int layer) const;
+    void SearchLayer(const float *query, int start, int breadth, int layer, NeighborQuery &scratch) const;
+    void SelectNeighbors(std::vector< std::pair<float,int> > &candidates, int maxCount) const;
+    void Link(int from, int to, int layer);
+};
+
+#endif // _NEIGHBOR_GRAPH_H_
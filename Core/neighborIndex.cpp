@@ -0,0 +1,290 @@
+/*********************************************************************
+MLDemos: A User-Friendly visualization toolkit for machine learning
+Copyright (C) 2010  Basilio Noris
+Contact: mldemos@b4silio.com
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public License,
+version 3 as published by the Free Software Foundation.
+
+This library is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free
+Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*********************************************************************/
+#include "neighborIndex.h"
+#include <algorithm>
+#include <queue>
+#include <cfloat>
+#include <cmath>
+
+using namespace std;
+
+NeighborQuery &NeighborQuery::Local()
+{
+    static thread_local NeighborQuery query;
+    return query;
+}
+
+NeighborIndex::NeighborIndex(int leafSize)
+    : data(0), count(0), dim(0), leafSize(max(1,leafSize)), metric(METRIC_L2), power(2.f)
+{
+}
+
+void NeighborIndex::SetMetric(Metric metric, float power)
+{
+    this->metric = metric;
+    this->power = power;
+    if(metric == METRIC_LP && power == 1) this->metric = METRIC_L1;
+    if(metric == METRIC_LP && power == 2) this->metric = METRIC_L2;
+}
+
+// the contribution of a single coordinate difference to the distance,
+// which bounds from below the distance to anything on the other side of a split
+inline float NeighborIndex::AxisDistance(float diff) const
+{
+    switch(metric)
+    {
+    case METRIC_L2: return diff*diff;
+    case METRIC_LP: return powf(fabs(diff), power);
+    default: return fabs(diff);
+    }
+}
+
+float NeighborIndex::Distance(Metric metric, float power, const float *a, const float *b, int dim, float bound)
+{
+    float dist = 0;
+    switch(metric)
+    {
+    case METRIC_L2:
+        for(int d=0; d<dim && dist <= bound; d++) dist += (a[d]-b[d])*(a[d]-b[d]);
+        break;
+    case METRIC_L1:
+        for(int d=0; d<dim && dist <= bound; d++) dist += fabs(a[d]-b[d]);
+        break;
+    case METRIC_LP:
+        for(int d=0; d<dim && dist <= bound; d++) dist += powf(fabs(a[d]-b[d]), power);
+        break;
+    case METRIC_INF:
+        for(int d=0; d<dim && dist <= bound; d++) dist = max(dist, (float)fabs(a[d]-b[d]));
+        break;
+    }
+    return dist;
+}
+
+// the distance between a and b, the computation stops as soon as it exceeds bound
+inline float NeighborIndex::Distance(const float *a, const float *b, float bound) const
+{
+    return Distance(metric, power, a, b, dim, bound);
+}
+
+float NeighborIndex::Distance(const float *a, const float *b) const
+{
+    return Distance(a, b, FLT_MAX);
+}
+
+void NeighborIndex::Clear()
+{
+    data = 0;
+    count = dim = 0;
+    order.clear();
+    nodes.clear();
+}
+
+void NeighborIndex::Build(const float *data, int count, int dim)
+{
+    Clear();
+    if(!data || count <= 0 || dim <= 0) return;
+    this->data = data;
+    this->count = count;
+    this->dim = dim;
+    order.resize(count);
+    FOR(i, count) order[i] = i;
+    nodes.reserve(2*count/leafSize + 1);
+    BuildNode(0, count);
+}
+
+struct AxisCompare
+{
+    const float *data;
+    int dim, axis;
+    AxisCompare(const float *data, int dim, int axis) : data(data), dim(dim), axis(axis){}
+    bool operator()(int a, int b) const {return data[(size_t)a*dim + axis] < data[(size_t)b*dim + axis];}
+};
+
+int NeighborIndex::BuildNode(int start, int stop)
+{
+    int index = nodes.size();
+    Node node;
+    node.start = start;
+    node.stop = stop;
+    node.axis = 0;
+    node.split = 0;
+    node.left = node.right = -1;
+    nodes.push_back(node);
+    if(stop - start <= leafSize) return index;
+
+    // we split the dimension with the largest spread at its median
+    int axis = 0;
+    float spread = -1;
+    FOR(d, dim)
+    {
+        float minVal = FLT_MAX, maxVal = -FLT_MAX;
+        for(int i=start; i<stop; i++)
+        {
+            float v = data[(size_t)order[i]*dim + d];
+            minVal = min(minVal, v);
+            maxVal = max(maxVal, v);
+        }
+        if(maxVal - minVal > spread)
+        {
+            spread = maxVal - minVal;
+            axis = d;
+        }
+    }
+    if(spread <= 0) return index; // all the points are the same, no need to go further
+    int middle = (start + stop) / 2;
+    nth_element(order.begin() + start, order.begin() + middle, order.begin() + stop, AxisCompare(data, dim, axis));
+    float split = data[(size_t)order[middle]*dim + axis];
+    int left = BuildNode(start, middle);
+    int right = BuildNode(middle, stop);
+    nodes[index].axis = axis;
+    nodes[index].split = split;
+    nodes[index].left = left;
+    nodes[index].right = right;
+    return index;
+}
+
+void NeighborIndex::BoxQuery(const float *query, float radius, ivec &result) const
+{
+    result.clear();
+    if(!nodes.size()) return;
+    ivec stack(1, 0);
+    while(stack.size())
+    {
+        const Node &node = nodes[stack.back()];
+        stack.pop_back();
+        if(node.left == -1)
+        {
+            for(int i=node.start; i<node.stop; i++)
+            {
+                const float *point = row(order[i]);
+                int d = 0;
+                for(; d<dim; d++) if(fabs(point[d] - query[d]) > radius) break;
+                if(d == dim) result.push_back(order[i]);
+            }
+            continue;
+        }
+        // the left child holds the values below the split, the right one those above
+        if(query[node.axis] - radius <= node.split) stack.push_back(node.left);
+        if(query[node.axis] + radius >= node.split) stack.push_back(node.right);
+    }
+}
+
+void NeighborIndex::RadiusQuery(const float *query, float radius, ivec &result, fvec *distances) const
+{
+    result.clear();
+    if(distances) distances->clear();
+    if(!nodes.size()) return;
+    ivec stack(1, 0);
+    while(stack.size())
+    {
+        const Node &node = nodes[stack.back()];
+        stack.pop_back();
+        if(node.left == -1)
+        {
+            for(int i=node.start; i<node.stop; i++)
+            {
+                float dist = Distance(row(order[i]), query, radius);
+                if(dist > radius) continue;
+                result.push_back(order[i]);
+                if(distances) distances->push_back(dist);
+            }
+            continue;
+        }
+        float diff = query[node.axis] - node.split;
+        bool bFar = AxisDistance(diff) <= radius;
+        if(diff <= 0 || bFar) stack.push_back(node.left);
+        if(diff >= 0 || bFar) stack.push_back(node.right);
+    }
+}
+
+void NeighborIndex::KNearest(const float *query, int k, ivec &result, fvec *distances, int exclude) const
+{
+    NeighborQuery scratch;
+    KNearest(query, k, scratch, exclude);
+    result.swap(scratch.indices);
+    if(distances) distances->swap(scratch.distances);
+}
+
+void NeighborIndex::KNearest(const float *query, int k, NeighborQuery &scratch, int exclude) const
+{
+    scratch.indices.clear();
+    scratch.distances.clear();
+    if(!nodes.size() || k <= 0) return;
+    // max-heap of the best candidates so far, the worst one on top
+    vector< pair<float,int> > &best = scratch.heap;
+    vector< pair<int,float> > &stack = scratch.stack; // node and lower bound of its distance
+    best.clear();
+    stack.clear();
+    stack.push_back(make_pair(0, 0.f));
+    while(stack.size())
+    {
+        int n = stack.back().first;
+        float bound = stack.back().second;
+        stack.pop_back();
+        if((int)best.size() == k && bound > best.front().first) continue;
+        const Node &node = nodes[n];
+        if(node.left == -1)
+        {
+            for(int i=node.start; i<node.stop; i++)
+            {
+                if(order[i] == exclude) continue;
+                float worst = (int)best.size() == k ? best.front().first : FLT_MAX;
+                float dist = Distance(row(order[i]), query, worst);
+                if(dist >= worst) continue;
+                if((int)best.size() == k)
+                {
+                    pop_heap(best.begin(), best.end());
+                    best.pop_back();
+                }
+                best.push_back(make_pair(dist, order[i]));
+                push_heap(best.begin(), best.end());
+            }
+            continue;
+        }
+        // we visit the closest child first, the far one only if it can still hold a better point
+        float diff = query[node.axis] - node.split;
+        int nearChild = diff <= 0 ? node.left : node.right;
+        int farChild = diff <= 0 ? node.right : node.left;
+        stack.push_back(make_pair(farChild, max(bound, AxisDistance(diff))));
+        stack.push_back(make_pair(nearChild, bound));
+    }
+    sort_heap(best.begin(), best.end());
+    scratch.indices.resize(best.size());
+    scratch.distances.resize(best.size());
+    FOR(i, best.size())
+    {
+        scratch.indices[i] = best[i].second;
+        scratch.distances[i] = best[i].first;
+    }
+}
+
+void NeighborIndex::KNearestBatch(const float *queries, int count, int k, int *indices, float *distances) const
+{
+    NeighborQuery scratch;
+    FOR(i, count)
+    {
+        KNearest(queries + (size_t)i*dim, k, scratch);
+        FOR(j, k)
+        {
+            bool bFound = (int)j < (int)scratch.indices.size();
+            indices[i*k + j] = bFound ? scratch.indices[j] : -1;
+            if(distances) distances[i*k + j] = bFound ? scratch.distances[j] : FLT_MAX;
+        }
+    }
+}
@@ -0,0 +1,101 @@
+/*********************************************************************
+MLDemos: A User-Friendly visualization toolkit for machine learning
+Copyright (C) 2010  Basilio Noris
+Contact: mldemos@b4silio.com
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public License,
+version 3 as published by the Free Software Foundation.
+
+This library is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free
+Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*********************************************************************/
+#ifndef _NEIGHBOR_INDEX_H_
+#define _NEIGHBOR_INDEX_H_
+
+#include <vector>
+#include <cfloat>
+#include "types.h"
+
+// reusable buffers of the k-nearest queries, one per thread
+struct NeighborQuery
+{
+    std::vector< std::pair<float,int> > heap;
+    std::vector< std::pair<int,float> > stack;
+    ivec indices;
+    fvec distances;
+    fvec point; // room for the caller to prepare the query point
+    std::vector< std::pair<float,int> > candidates; // graph search frontier
+    std::vector<u32> visited; // graph nodes already seen, marked with visitMark
+    u32 visitMark;
+
+    NeighborQuery() : visitMark(0){}
+
+    // the buffers of the calling thread, for the queries that come one at a time
+    static NeighborQuery &Local();
+};
+
+/*!
+ * kd-tree over a contiguous, row-major sample matrix, for the neighborhood queries of
+ * the density and neighbor-based algorithms. The index does not copy the samples, they
+ * must outlive it. Queries do not modify the index and can be run concurrently.
+ * Distances follow the conventions of ANN: the euclidean distance is squared, the p-norm
+ * is raised to the power p and the infinite norm is the largest coordinate difference.
+ */
+class NeighborIndex
+{
+public:
+    enum Metric {METRIC_INF, METRIC_L1, METRIC_L2, METRIC_LP};
+
+    NeighborIndex(int leafSize=16);
+
+    void Build(const float *data, int count, int dim);
+    void Clear();
+    void SetMetric(Metric metric, float power=2.f);
+    int size() const {return count;}
+    int dimension() const {return dim;}
+    const float *row(int i) const {return data + (size_t)i*dim;}
+    float Distance(const float *a, const float *b) const;
+    // the distance between two points of dim coordinates, the computation stops as soon as it exceeds bound
+    static float Distance(Metric metric, float power, const float *a, const float *b, int dim, float bound=FLT_MAX);
+
+    // the points whose coordinates are all within radius of the query (a box around it)
+    void BoxQuery(const float *query, float radius, ivec &result) const;
+    // the points within distance radius of the query, with their distances
+    void RadiusQuery(const float *query, float radius, ivec &result, fvec *distances=0) const;
+    // the k nearest points, sorted by increasing distance, the point exclude (e.g. the query itself) is skipped
+    void KNearest(const float *query, int k, ivec &result, fvec *distances=0, int exclude=-1) const;
+    // same as above, with the results in query.indices and query.distances and no allocation once the buffers have grown
+    void KNearest(const float *query, int k, NeighborQuery &scratch, int exclude=-1) const;
+    // the k nearest points of count row-major queries, in indices and distances (count*k, -1 when there are less than k points)
+    void KNearestBatch(const float *queries, int count, int k, int *indices, float *distances=0) const;
+
+private:
+    struct Node
+    {
+        int start, stop; // range of the node in order
+        int axis;
+        float split;
+        int left, right; // children, -1 for the leaves
+    };
+    const float *data;
+    int count;
+    int dim;
+    int leafSize;
+    Metric metric;
+    float power;
+    ivec order;
+    std::vector<Node> nodes;
+
+    int BuildNode(int start, int stop);
+    float AxisDistance(float diff) const;
+    float Distance(const float *a, const float *b, float bound) const;
+};
+
+#endif // _NEIGHBOR_INDEX_H_
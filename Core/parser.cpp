@@ -17,6 +17,13 @@ License along with this library; if not, write to the Free
 Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
 *********************************************************************/
 #include <QDebug>
+#include <QFile>
+#include <QThread>
+#include <QThreadPool>
+#include <QRunnable>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
 #include <basicMath.h>
 #include "parser.h"
 
@@ -166,121 +173,392 @@ bool CSVIterator::operator==(CSVIterator const& rhs)
     return ((this == &rhs) || ((this->m_str == NULL) && (rhs.m_str == NULL)));
 }
 
+/* CSVStringTable stuff */
+
+static unsigned int hashString(const char *s, size_t length)
+{
+    unsigned int hash = 2166136261u; // FNV-1a
+    for(size_t i=0; i<length; i++) hash = (hash ^ (unsigned char)s[i]) * 16777619u;
+    return hash;
+}
+
+int CSVStringTable::insert(const char *s, size_t length)
+{
+    if(2*(count+1) > (int)slots.size()) grow();
+    unsigned int hash = hashString(s, length);
+    unsigned int mask = slots.size()-1;
+    for(unsigned int slot = hash & mask;; slot = (slot+1) & mask)
+    {
+        int id = slots[slot];
+        if(id == -1)
+        {
+            slots[slot] = strings.size();
+            strings.push_back(string(s, length));
+            hashes.push_back(hash);
+            count++;
+            return strings.size()-1;
+        }
+        if(hashes[id] == hash && strings[id].size() == length &&
+                !memcmp(strings[id].data(), s, length)) return id;
+    }
+}
+
+void CSVStringTable::grow()
+{
+    slots.assign(max((size_t)16, slots.size()*2), -1);
+    unsigned int mask = slots.size()-1;
+    FOR(i, strings.size())
+    {
+        unsigned int slot = hashes[i] & mask;
+        while(slots[slot] != -1) slot = (slot+1) & mask;
+        slots[slot] = i;
+    }
+}
+
+void CSVStringTable::clear()
+{
+    strings.clear();
+    hashes.clear();
+    slots.clear();
+    count = 0;
+}
+
 /* CSVParser stuff */
+
+struct CSVCell
+{
+    const char *begin, *end;
+    bool bQuoted;
+};
+
+// end of the line starting at s, without the line feed and carriage return
+static const char *lineEnd(const char *s, const char *stop, const char **next)
+{
+    const char *e = (const char *)memchr(s, '\n', stop-s);
+    if(!e) e = stop;
+    *next = e < stop ? e+1 : stop;
+    while(e > s && e[-1] == '\r') e--;
+    return e;
+}
+
+// cells of the line, separators between quotes are not splitting the cell and,
+// as with getline, a trailing separator does not add an empty cell
+static int splitLine(const char *s, const char *e, char separator, vector<CSVCell> &cells)
+{
+    cells.clear();
+    while(s < e)
+    {
+        CSVCell cell;
+        cell.begin = s;
+        bool bInside = false;
+        for(; s < e && (bInside || *s != separator); s++)
+        {
+            if(*s == '"') bInside = !bInside;
+        }
+        cell.end = s++;
+        cell.bQuoted = memchr(cell.begin, '"', cell.end-cell.begin) != 0;
+        cells.push_back(cell);
+    }
+    return cells.size();
+}
+
+// text of the cell as the line-based parser used to return it
+static string cellText(const CSVCell &cell, char separator)
+{
+    if(cell.begin == cell.end) return MISSING_VALUE;
+    string text(cell.begin, cell.end);
+    if(cell.bQuoted) std::replace(text.begin(), text.end(), separator, '_');
+    return text;
+}
+
+static const double powersOfTen[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+                                     1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+bool CSVParser::parseFloat(const char *s, const char *e, float &value)
+{
+    while(s < e && (*s == ' ' || *s == '\t')) s++;
+    while(e > s && (e[-1] == ' ' || e[-1] == '\t')) e--;
+    if(s == e) return false;
+    bool bNegative = false;
+    if(*s == '-' || *s == '+') bNegative = *s++ == '-';
+    unsigned long long mantissa = 0;
+    int digits = 0, exponent = 0;
+    bool bDigits = false;
+    for(; s < e && *s >= '0' && *s <= '9'; s++)
+    {
+        bDigits = true;
+        if(digits < 19)
+        {
+            mantissa = mantissa*10 + (*s-'0');
+            if(mantissa) digits++;
+        }
+        else exponent++;
+    }
+    if(s < e && *s == '.')
+    {
+        for(s++; s < e && *s >= '0' && *s <= '9'; s++)
+        {
+            bDigits = true;
+            if(digits >= 19) continue;
+            mantissa = mantissa*10 + (*s-'0');
+            if(mantissa) digits++;
+            exponent--;
+        }
+    }
+    if(!bDigits) return false;
+    if(s < e && (*s == 'e' || *s == 'E'))
+    {
+        s++;
+        bool bNegativeExp = false;
+        if(s < e && (*s == '-' || *s == '+')) bNegativeExp = *s++ == '-';
+        if(s == e || *s < '0' || *s > '9') return false;
+        int exp = 0;
+        for(; s < e && *s >= '0' && *s <= '9'; s++) if(exp < 10000) exp = exp*10 + (*s-'0');
+        exponent += bNegativeExp ? -exp : exp;
+    }
+    if(s != e) return false;
+    double v = (double)mantissa;
+    if(exponent)
+    {
+        int p = abs(exponent);
+        double scale = p < 23 ? powersOfTen[p] : pow(10., p);
+        v = exponent < 0 ? v / scale : v * scale;
+    }
+    value = (float)(bNegative ? -v : v);
+    return true;
+}
+
+static void countRows(CSVChunk &chunk)
+{
+    int rows = 0;
+    const char *next;
+    for(const char *line = chunk.start; line < chunk.stop; line = next)
+    {
+        if(lineEnd(line, chunk.stop, &next) != line) rows++;
+    }
+    chunk.rows = rows;
+}
+
+static void tokenizeChunk(CSVChunk &chunk, char separator, int dim)
+{
+    chunk.columns.assign(dim, fvec(chunk.rows, 0.f));
+    chunk.strings.assign(dim, CSVStringTable());
+    chunk.cells.assign(dim, vector<ipair>());
+    vector<CSVCell> cells;
+    const char *next;
+    int row = 0;
+    for(const char *line = chunk.start; line < chunk.stop && row < chunk.rows; line = next)
+    {
+        const char *end = lineEnd(line, chunk.stop, &next);
+        if(end == line) continue;
+        int count = splitLine(line, end, separator, cells);
+        if(count < dim && chunk.badRow == -1) chunk.badRow = row;
+        FOR(c, min(count, dim))
+        {
+            const CSVCell &cell = cells[c];
+            float value;
+            if(!cell.bQuoted && CSVParser::parseFloat(cell.begin, cell.end, value))
+            {
+                chunk.columns[c][row] = value;
+                continue;
+            }
+            int id;
+            if(cell.begin == cell.end) id = chunk.strings[c].insert(MISSING_VALUE, 1);
+            else if(cell.bQuoted) id = chunk.strings[c].insert(cellText(cell, separator));
+            else id = chunk.strings[c].insert(cell.begin, cell.end-cell.begin);
+            chunk.cells[c].push_back(ipair(row, id));
+        }
+        row++;
+    }
+    chunk.bParsed = true;
+}
+
+class CSVChunkWorker : public QRunnable
+{
+    CSVParser *parser;
+public:
+    CSVChunkWorker(CSVParser *parser) : parser(parser) {}
+    void run() { parser->processChunks(); }
+};
+
+void CSVParser::processChunks()
+{
+    int c;
+    while((c = nextChunk.fetchAndAddOrdered(1)) < chunkStop)
+    {
+        if(bCountOnly) countRows(chunks[c]);
+        else if(!chunks[c].bParsed) tokenizeChunk(chunks[c], separator, firstRow.size());
+    }
+}
+
+void CSVParser::runChunks(int stop, bool bCount)
+{
+    nextChunk = 0;
+    chunkStop = stop;
+    bCountOnly = bCount;
+    int threadCount = min(QThread::idealThreadCount(), stop);
+    if(threadCount <= 1)
+    {
+        processChunks();
+        return;
+    }
+    QThreadPool pool;
+    pool.setMaxThreadCount(threadCount);
+    FOR(i, threadCount) pool.start(new CSVChunkWorker(this));
+    pool.waitForDone();
+}
+
+int CSVParser::chunksForRows(int rows)
+{
+    if(rows <= 0) return 0;
+    int c = 0;
+    while(c < (int)chunks.size() && chunkRows[c] < rows) c++;
+    return min(c+1, (int)chunks.size());
+}
+
 CSVParser::CSVParser()
+    : file(0), buffer(0), bufferEnd(0), bodyStart(0), separator(','), rowCount(0),
+      chunkStop(0), bCountOnly(false)
 {
     bFirstRowAsHeader = false;
     outputLabelColumn = 2;
 }
 
+CSVParser::~CSVParser()
+{
+    clear();
+}
+
 void CSVParser::clear()
 {
     outputLabelColumn = 0;
     classLabels.clear();
-    data.clear();
     dataTypes.clear();
+    chunks.clear();
+    chunkRows.clear();
+    firstRow.clear();
+    columns.clear();
+    unpacked.clear();
+    rowCount = 0;
+    buffer = bufferEnd = bodyStart = 0;
+    DEL(file); // closing the file releases the mapping
 }
 
 void CSVParser::parse(const char* fileName, int separatorType)
 {
     // init
     uint8_t offset = getBOMsize(fileName);
-    file.open(fileName,std::ios_base::binary);
-    if(!file.is_open()) return;
+    int labelColumn = outputLabelColumn;
+    clear();
+    outputLabelColumn = labelColumn;
+    file = new QFile(QString(fileName));
+    if(!file->open(QIODevice::ReadOnly) || file->size() <= offset)
+    {
+        DEL(file);
+        return;
+    }
+    qint64 size = file->size();
+    const char *mapped = (const char *)file->map(0, size);
+    if(!mapped)
+    {
+        unpacked = file->readAll().toStdString();
+        mapped = unpacked.data();
+    }
+    buffer = mapped + offset;
+    bufferEnd = mapped + size;
+
+    // remove null character noise when coming from UTF-X
+    // we assume that the data has only ASCII characters
+    if(offset && memchr(buffer, '\0', min((qint64)4096, (qint64)(bufferEnd-buffer))))
+    {
+        string text;
+        text.reserve(bufferEnd-buffer);
+        for(const char *c=buffer; c<bufferEnd; c++) if(*c) text.push_back(*c);
+        unpacked.swap(text);
+        buffer = unpacked.data();
+        bufferEnd = buffer + unpacked.size();
+    }
+
+    // the first non-empty line gives the number of columns
+    const char *line = buffer, *next = buffer, *end = buffer;
+    for(; line < bufferEnd; line = next)
+    {
+        end = lineEnd(line, bufferEnd, &next);
+        if(end != line) break;
+    }
+    bodyStart = next;
 
-    std::string separators[] = {",", ";", "\t", " "};
+    char separators[] = {',', ';', '\t', ' '};
     int separatorCount = 4;
     int bestSeparator = 0;
-    int dim=0;
-
+    vector<CSVCell> cells;
     if(!separatorType)
     {
-        // we test the separators to find which one is best
+        // we test the separators on the second line, as the first might be a header line
+        const char *secondNext;
+        const char *secondEnd = lineEnd(bodyStart, bufferEnd, &secondNext);
+        size_t dim = 0;
         for(int i=0; i<separatorCount; i++)
         {
-            file.seekg(offset,ios::beg);
-            // Parse CSV input file
-            CSVIterator parser(file, separators[i]);
-            ++parser; // we skip the first line as it might be a header line
-            if(parser.eof() || !parser->size()) continue;
-            vector<string> parsed = parser->getParsedLine();
-            //qDebug() << "separator: " << separators[i].c_str() << ":" << parsed.size();
-            if(parsed.size() > dim)
+            size_t count = splitLine(bodyStart, secondEnd, separators[i], cells);
+            if(count > dim)
             {
-                dim = parsed.size();
+                dim = count;
                 bestSeparator = i;
             }
         }
     }
     else bestSeparator = separatorType-1;
+    separator = separators[bestSeparator];
 
-    file.seekg(offset,ios::beg);
-
-    data.clear();
-    for(CSVIterator parser(file, separators[bestSeparator]);!parser.eof(); ++parser)
-    {
-        if(!parser->size()) continue;
-        vector<string> parsed = parser->getParsedLine();
-        if(!parsed.size()) continue;
-
-        // check for remaining line carrys, *nix only
-        string::size_type pos = 0;
-#if !(defined WIN32 || defined _WIN32)
-        while ( ( pos = parsed.back().find ("\r",pos) ) != string::npos )
-            parsed.back().erase ( pos, 1 );
-#endif
-        // remove null character noise when coming from UTF-X
-        // we assume that the data has only ASCII characters
-        if (offset)
-            for(size_t i = 0; i < parsed.size(); i++)
-            {
-                pos = 0;
-                while ( ( pos = parsed.at(i).find ('\0',pos) ) != string::npos )
-                    parsed.at(i).erase ( pos, 1 );
+    splitLine(line, end, separator, cells);
+    FOR(i, cells.size()) firstRow.push_back(cellText(cells[i], separator));
+    FOR(i, firstRow.size()) columns.push_back(i);
 
-            }
-
-        // Fill dataset
-        data.push_back(parsed);
+    // split the rest of the file on line boundaries, and count the rows of each chunk
+    for(const char *start = bodyStart; start < bufferEnd;)
+    {
+        const char *stop = start + min((qint64)chunkSize, (qint64)(bufferEnd-start));
+        if(stop < bufferEnd)
+        {
+            stop = (const char *)memchr(stop, '\n', bufferEnd-stop);
+            stop = stop ? stop+1 : bufferEnd;
+        }
+        CSVChunk chunk;
+        chunk.start = start;
+        chunk.stop = stop;
+        chunk.rows = 0;
+        chunk.badRow = -1;
+        chunk.bParsed = false;
+        chunks.push_back(chunk);
+        start = stop;
     }
-
-    cout << "Parsing done, read " << data.size() << " entries" << endl;
-    cout << "Found " << data.at(0).size() << " input labels / columns" << endl;
-
-    // look for data types
-    for(size_t i = 0; i < data.at(1).size(); i++)
+    runChunks(chunks.size(), true);
+    rowCount = 0;
+    FOR(i, chunks.size())
     {
-        // Look for a non-empty cell
-        // start with 2nd row as first might be input labels
-        size_t testRow = 1;
-        while(data.at(testRow++).at(i) == "?" && testRow != data.size());
+        rowCount += chunks[i].rows;
+        chunkRows.push_back(rowCount);
+    }
 
+    cout << "Parsing done, read " << rowCount+1 << " entries" << endl;
+    cout << "Found " << firstRow.size() << " input labels / columns" << endl;
 
-        if (testRow == data.size())
+    // look for data types on the first rows
+    vector<string> types(firstRow.size());
+    int typeRows = 0;
+    for(line = bodyStart; line < bufferEnd && typeRows < CSV_PREVIEW_ROWS; line = next)
+    {
+        end = lineEnd(line, bufferEnd, &next);
+        if(end == line) continue;
+        splitLine(line, end, separator, cells);
+        FOR(i, min(cells.size(), types.size()))
         {
-            // if the whole column is missing data... delete it
-            cout << "Warning: Found empty column, deleting..." << endl;
-            for (size_t j = 0; j < data.size(); j++)
-                data.at(j).erase(data.at(j).begin()+i);
-
-        } else // save input type
-            dataTypes.push_back(getType(data.at(testRow).at(i)));
+            if(types[i].empty() && cells[i].begin != cells[i].end) types[i] = cellText(cells[i], separator);
+        }
+        typeRows++;
     }
-
-    cout << data.at(0).size() << " input labels / columns remaining after cleanup" << endl;
-
-//    cout << "Contents: " << endl;
-//    for (size_t j=0; j<data.size(); j++)
-//    {
-//        cout << "|";
-//        for (size_t i=0; i<data.at(1).size(); i++)
-//            cout << data.at(j).at(i) << "|";
-//        cout << endl;
-//    }
-
-    // Read output (class) labels
-    getOutputLabelTypes(true);
-    file.close();
+    FOR(i, types.size()) dataTypes.push_back(types[i].empty() ? UNKNOWN_TYPE : getType(types[i]));
 }
 
 void CSVParser::setOutputColumn(int column)
@@ -289,260 +567,345 @@ void CSVParser::setOutputColumn(int column)
    //getOutputLabelTypes(true); // need to update output label types
 }
 
-map<string,unsigned int> CSVParser::getOutputLabelTypes(bool reparse)
+// fills values with the count first rows of the column, the non-numeric cells (or all of them
+// if bInternAll) get the index of their string in table, in order of first appearance.
+// returns false if at least one cell was not numeric
+bool CSVParser::fetchColumn(int column, int count, bool bInternAll, fvec &values, CSVStringTable &table)
 {
-    if (!reparse) return classLabels;
-    unsigned int id = 0;
-    pair<map<string,unsigned int>::iterator,bool> ret;
-    // Use by default the last column as output class
-    if ((data.size() && outputLabelColumn == -1) || outputLabelColumn >= data.size()) outputLabelColumn = data.at(0).size()-1;
-    for(vector<vector<string> >::iterator it = data.begin(); it<data.end(); it++)
+    values.resize(count);
+    table.clear();
+    bool bNumeric = true;
+    int row = 0;
+    char text[32];
+    if(!bFirstRowAsHeader && count)
     {
-        ret = classLabels.insert( pair<string,unsigned int>(it->at(outputLabelColumn),id) );
-        if (ret.second == true) id++; // new class found
+        float value;
+        bool bParsed = parseFloat(firstRow[column].data(), firstRow[column].data()+firstRow[column].size(), value);
+        if(!bInternAll && bParsed) values[row] = value;
+        else if(bParsed)
+        {
+            // numbers are interned in the same format as in the other rows
+            int length = snprintf(text, sizeof(text), "%.9g", value);
+            values[row] = table.insert(text, length);
+        }
+        else
+        {
+            values[row] = table.insert(firstRow[column]);
+            bNumeric = false;
+        }
+        row++;
+    }
+    ivec remap;
+    for(size_t c=0; c<chunks.size() && row < count; c++)
+    {
+        const CSVChunk &chunk = chunks[c];
+        int rows = min(chunk.rows, count-row);
+        if(!rows) continue;
+        const fvec &source = chunk.columns[column];
+        const vector<ipair> &cells = chunk.cells[column];
+        const CSVStringTable &strings = chunk.strings[column];
+        remap.assign(strings.size(), -1);
+        if(!bInternAll)
+        {
+            memcpy(&values[row], &source[0], rows*sizeof(float));
+            for(size_t i=0; i<cells.size() && cells[i].first < rows; i++)
+            {
+                int &id = remap[cells[i].second];
+                if(id == -1) id = table.insert(strings[cells[i].second]);
+                values[row + cells[i].first] = id;
+                bNumeric = false;
+            }
+        }
+        else
+        {
+            size_t cell = 0;
+            FOR(i, rows)
+            {
+                if(cell < cells.size() && cells[cell].first == (int)i)
+                {
+                    int &id = remap[cells[cell].second];
+                    if(id == -1) id = table.insert(strings[cells[cell].second]);
+                    values[row + i] = id;
+                    cell++;
+                    bNumeric = false;
+                }
+                else
+                {
+                    // 9 significant digits tell apart any two floats
+                    int length = snprintf(text, sizeof(text), "%.9g", source[i]);
+                    values[row + i] = table.insert(text, length);
+                }
+            }
+        }
+        row += rows;
     }
+    return bNumeric;
+}
+
+map<string,unsigned int> CSVParser::getOutputLabelTypes(bool reparse, int maxSamples)
+{
+    if (!reparse || !buffer) return classLabels;
+    // Use by default the last column as output class
+    if (outputLabelColumn == -1 || outputLabelColumn >= (int)columns.size()) outputLabelColumn = columns.size()-1;
+    if (outputLabelColumn < 0) return classLabels;
+    // like getData, we only read as far as the requested samples go
+    int count = rowCount+1;
+    if(bFirstRowAsHeader) count--;
+    if(maxSamples != -1 && maxSamples < count) count = maxSamples;
+    int bodyRows = bFirstRowAsHeader ? count : count-1;
+    runChunks(chunksForRows(bodyRows), false);
+    bool bHeader = bFirstRowAsHeader;
+    bFirstRowAsHeader = false;
+    fvec values;
+    CSVStringTable table;
+    fetchColumn(columns[outputLabelColumn], bodyRows+1, true, values, table);
+    bFirstRowAsHeader = bHeader;
+    FOR(i, table.size()) classLabels.insert(pair<string,unsigned int>(table[i], i));
     return classLabels;
 }
 
 vector<size_t> CSVParser::getMissingValIndex()
 {
     vector<size_t> missingValIndex;
-    size_t nbCols = data.at(0).size();
-    for (size_t i = 0; i < data.size(); i++)
-        for (size_t j = 0; j < nbCols; j++)
-            if (data[i][j] == "?") missingValIndex.push_back(i);
+    if(!buffer) return missingValIndex;
+    runChunks(chunks.size(), false);
+    FOR(j, columns.size())
+    {
+        if(firstRow[columns[j]] == MISSING_VALUE) missingValIndex.push_back(0);
+    }
+    FOR(c, chunks.size())
+    {
+        int rowStart = (c ? chunkRows[c-1] : 0) + 1;
+        FOR(j, columns.size())
+        {
+            const vector<ipair> &cells = chunks[c].cells[columns[j]];
+            const CSVStringTable &strings = chunks[c].strings[columns[j]];
+            FOR(i, cells.size())
+            {
+                if(strings[cells[i].second] == MISSING_VALUE) missingValIndex.push_back(rowStart + cells[i].first);
+            }
+        }
+    }
+    sort(missingValIndex.begin(), missingValIndex.end());
     return missingValIndex;
 }
 
 bool CSVParser::hasData()
 {
-    return data.size();
+    return buffer && columns.size();
 }
 
 void CSVParser::cleanData(unsigned int acceptedTypes)
 {
-    vector<string>::iterator it_str;
-    vector<unsigned int>::iterator it_uint = dataTypes.begin();
-    for(size_t i = 0; i < dataTypes.size(); i++)
+    for(int i = 0; i < (int)dataTypes.size(); i++)
         if (!(dataTypes[i]&acceptedTypes) &&  // data type does not correspond to a requested one
            (i != outputLabelColumn))       // output labels are stored separately, ignore
         {
-            cout << "Removing colum " << i << " of type " << dataTypes[i] <<  " ... ";
-            for(size_t j = 0; j < data.size(); j++)
-            {
-                /* @note it seems that if we have --i instead of (i-1), the compiler produces bad code (SIGSEGV) */
-                it_str = data.at(j).begin() + (i-1);
-                data.at(j).erase(it_str); // delete the column
-            }
-            cout << "and matching type reference ...  " ;
-            it_uint = dataTypes.begin() + (i-1);
-            dataTypes.erase(it_uint); // delete the input to stay consistant
-            i--; if (i < outputLabelColumn) outputLabelColumn--;
+            cout << "Removing colum " << i << " of type " << dataTypes[i] << endl;
+            columns.erase(columns.begin() + i); // the cells stay in the chunks, we just stop reading them
+            dataTypes.erase(dataTypes.begin() + i);
+            if (i < outputLabelColumn) outputLabelColumn--;
+            i--;
         }
 }
 
-pair<vector<fvec>,ivec> CSVParser::getData(ivec excludeIndex, int maxSamples)
+vector< vector<string> > CSVParser::getRawData(int maxRows)
 {
-    int count = data.size();
-    if(bFirstRowAsHeader) count--;
-    int headerSkip = bFirstRowAsHeader?1:0;
-    if(count <= 0) return pair<vector<fvec>,ivec>();
-    vector<fvec> samples(count);
-    ivec labels(count);
-    int dim = data[0].size();
-    if(outputLabelColumn != -1) outputLabelColumn = min(dim-1, outputLabelColumn);
-    classNames.clear();
-    categorical.clear();
-    vector< map<string,int> > labelMaps(dim);
-    ivec labelCounters(dim,0);
-    pair<map<string,int>::iterator,bool> ret;
-    FOR(i, data.size())
-    {
-        if(!i && bFirstRowAsHeader) continue;
-        // check if it's always a number
-        fvec& sample = samples[i-headerSkip];
-        sample.resize((outputLabelColumn==-1) ? dim : dim-1);
-        FOR(j, dim)
+    vector< vector<string> > rawData;
+    if(!buffer || !columns.size()) return rawData;
+    bool bAllColumns = columns.size() == firstRow.size();
+    vector<string> row;
+    FOR(j, columns.size()) row.push_back(firstRow[columns[j]]);
+    rawData.push_back(row);
+    vector<CSVCell> cells;
+    const char *next;
+    for(const char *line = bodyStart; line < bufferEnd; line = next)
+    {
+        if(maxRows != -1 && (int)rawData.size() >= maxRows) break;
+        const char *end = lineEnd(line, bufferEnd, &next);
+        if(end == line) continue;
+        splitLine(line, end, separator, cells);
+        row.clear();
+        if(bAllColumns)
         {
-            if(data[i].size() < dim) {
-                qDebug() << "Something is wrong with the data, exiting!";
-                vector<fvec> newSamples;
-                ivec newLabels;
-                return pair<vector<fvec>,ivec>(newSamples,newLabels);
-            }
-            QString s(data[i][j].c_str());
-            bool ok;
-            float val = s.toFloat(&ok);
-            if(j==outputLabelColumn || !ok)
-            {
-                if(labelMaps[j].count(data[i][j]) > 0) val = labelMaps[j][data[i][j]];
-                else
-                {
-                    val = (float)labelCounters[j];
-                    ret = labelMaps[j].insert(pair<string,int>(data[i][j], val));
-                    if(ret.second) labelCounters[j]++;
-                }
-            }
-            if(j!=outputLabelColumn)
-            {
-                if(outputLabelColumn==-1) sample[j] = val;
-                else
-                {
-                    int index = j < outputLabelColumn ? j : j-1;
-                    sample[index] = val;
-                }
-            }
+            FOR(j, cells.size()) row.push_back(cellText(cells[j], separator));
         }
-    }
-    FOR(j, dim)
-    {
-        if(j == outputLabelColumn) continue;
-        bool bNumerical = true;
-        FORIT(labelMaps[j], string, int)
+        else
         {
-            bool ok;
-            QString(it->first.c_str()).toFloat(&ok);
-            if(!ok && it->first != "?")
+            FOR(j, columns.size())
             {
-                bNumerical = false;
-                break;
+                row.push_back(columns[j] < (int)cells.size() ? cellText(cells[columns[j]], separator) : MISSING_VALUE);
             }
         }
-        if(bNumerical) continue;
-        int itemCount = 0;
-        FORIT(labelMaps[j], string, int)
-        {
-            itemCount = max(itemCount, it->second);
-        }
-        itemCount++;
-        vector<string> cat(itemCount);
-        FORIT(labelMaps[j], string, int)
-        {
-            int index = it->second;
-            cat[index] = it->first;
-        }
-        categorical[ j>outputLabelColumn ? j-1 : j ] = cat;
+        rawData.push_back(row);
     }
+    return rawData;
+}
 
-    if(labelMaps[outputLabelColumn].size() && outputLabelColumn != -1)
+pair<vector<fvec>,ivec> CSVParser::getData(ivec excludeIndex, int maxSamples)
+{
+    int count = getCount();
+    if(bFirstRowAsHeader) count--;
+    if(maxSamples != -1 && maxSamples < count) count = maxSamples;
+    if(count <= 0 || !columns.size()) return pair<vector<fvec>,ivec>();
+
+    // we only read as far in the file as the requested samples go
+    int bodyRows = bFirstRowAsHeader ? count : count-1;
+    int chunkCount = chunksForRows(bodyRows);
+    runChunks(chunkCount, false);
+    FOR(c, chunkCount)
     {
-        bool bNumerical = true;
-        FORIT(labelMaps[outputLabelColumn], string, int)
+        int rowStart = c ? chunkRows[c-1] : 0;
+        if(chunks[c].badRow != -1 && rowStart + chunks[c].badRow < bodyRows)
         {
-            bool ok;
-            QString(it->first.c_str()).toFloat(&ok);
-            if(!ok && it->first != "?")
-            {
-                bNumerical = false;
-                break;
-            }
+            qDebug() << "Something is wrong with the data, exiting!";
+            return pair<vector<fvec>,ivec>();
         }
-        if(!bNumerical)
-        {
-            FORIT(labelMaps[outputLabelColumn], string, int)
-            {
-                classNames[it->second] = QString(it->first.c_str());
-                //else classNames[it->second] = QString("Class %1").arg(QString(it->first.c_str()).toFloat());
-            }
-        }
-        else classNames.clear();
     }
-    if(outputLabelColumn == -1)
+
+    int dim = columns.size();
+    if(outputLabelColumn != -1) outputLabelColumn = min(dim-1, outputLabelColumn);
+    classNames.clear();
+    categorical.clear();
+    vector<bool> bExclude(dim, false);
+    FOR(i, excludeIndex.size())
+    {
+        if(excludeIndex[i] >= 0 && excludeIndex[i] < dim) bExclude[excludeIndex[i]] = true;
+    }
+    int newDim = 0;
+    FOR(d, dim) if(!bExclude[d] && d != outputLabelColumn) newDim++;
+
+    vector<fvec> samples(count, fvec(newDim));
+    ivec labels(count, 0);
+    fvec values;
+    CSVStringTable table;
+    int nD = 0;
+    FOR(d, dim)
     {
-        FOR(i, data.size())
+        if(d == outputLabelColumn) continue;
+        if(!fetchColumn(columns[d], count, false, values, table))
         {
-            if(!i && bFirstRowAsHeader) continue;
-            labels[i-headerSkip] = 0;
+            bool bCategorical = false;
+            FOR(i, table.size()) bCategorical |= table[i] != MISSING_VALUE;
+            if(bCategorical) categorical[outputLabelColumn == -1 || d < outputLabelColumn ? d : d-1] = table.getStrings();
         }
+        if(bExclude[d]) continue;
+        FOR(i, count) samples[i][nD] = values[i];
+        nD++;
     }
-    else
+
+    if(outputLabelColumn != -1)
     {
-        bool numerical = true;
-        FOR(i, data.size())
+        int column = columns[outputLabelColumn];
+        if(fetchColumn(column, count, false, values, table))
         {
-            if(!i && bFirstRowAsHeader) continue;
-            bool ok;
-            QString(data[i][outputLabelColumn].c_str()).toFloat(&ok);
-            if(!ok)
-            {
-                numerical = false;
-                break;
-            }
+            FOR(i, count) labels[i] = values[i];
         }
-        FOR(i, data.size())
+        else
         {
-            if(!i && bFirstRowAsHeader) continue;
-            bool ok;
-            float val = QString(data[i][outputLabelColumn].c_str()).toFloat(&ok);
-            if(numerical)
+            fetchColumn(column, count, true, values, table);
+            FOR(i, count) labels[i] = values[i];
+            bool bNumerical = true;
+            FOR(i, table.size())
             {
-                labels[i-headerSkip] = val;
+                float value;
+                if(table[i] != MISSING_VALUE && !parseFloat(table[i].data(), table[i].data()+table[i].size(), value))
+                {
+                    bNumerical = false;
+                    break;
+                }
             }
-            else
+            if(!bNumerical)
             {
-                int label = labelMaps[outputLabelColumn][data[i][outputLabelColumn]];
-                labels[i-headerSkip] = label;
+                FOR(i, table.size()) classNames[i] = QString(table[i].c_str());
             }
         }
     }
-    if(maxSamples != -1 && maxSamples < samples.size())
+    qDebug() << "Imported samples: " << samples.size() << " labels: " << labels.size();
+    return pair<vector<fvec>,ivec>(samples,labels);
+}
+
+// the samples of a single chunk (the first one also gets the first row unless it is a header).
+// the chunk is only tokenized for the call, so that reading the whole file this way never holds
+// more than one chunk of values. Non-numeric cells are read as 0, and non-numeric labels are
+// looked up in the types found by getOutputLabelTypes, as the strings of other chunks are not known
+pair<vector<fvec>,ivec> CSVParser::getChunkData(int chunk, ivec excludeIndex)
+{
+    if(chunk < 0 || chunk >= (int)chunks.size() || !columns.size()) return pair<vector<fvec>,ivec>();
+    CSVChunk &source = chunks[chunk];
+    bool bParsed = source.bParsed;
+    if(!bParsed)
     {
-        vector<fvec> newSamples(maxSamples);
-        ivec newLabels(maxSamples);
-        u32 *perm = randPerm(samples.size());
-        FOR(i, maxSamples)
-        {
-            newSamples[i] = samples[perm[i]];
-            newLabels[i] = labels[perm[i]];
-        }
-        samples = newSamples;
-        labels = newLabels;
-        count = samples.size();
-        delete [] perm;
-    }
-    if(!excludeIndex.size()) return pair<vector<fvec>,ivec>(samples,labels);
-    vector<fvec> newSamples(count);
-    int newDim = dim - excludeIndex.size();
-    if(outputLabelColumn != -1) newDim--;
-    //qDebug() << "Indices to be excluded: " << excludeIndex.size() << "(newDim: " << newDim << ")";
+        source.badRow = -1;
+        tokenizeChunk(source, separator, firstRow.size());
+    }
+    int dim = columns.size();
+    if(outputLabelColumn != -1) outputLabelColumn = min(dim-1, outputLabelColumn);
+    vector<bool> bExclude(dim, false);
     FOR(i, excludeIndex.size())
     {
-        //qDebug() << i << ":" << excludeIndex[i];
-        // if it's the output we can ignore it but we need to reincrement the number of dimensions
-        if(excludeIndex[i] == outputLabelColumn)
+        if(excludeIndex[i] >= 0 && excludeIndex[i] < dim) bExclude[excludeIndex[i]] = true;
+    }
+    ivec inputs;
+    FOR(d, dim) if(!bExclude[d] && d != outputLabelColumn) inputs.push_back(columns[d]);
+
+    bool bFirstRow = !chunk && !bFirstRowAsHeader;
+    int rows = source.rows;
+    if(source.badRow != -1) rows = source.badRow; // we stop at the first incomplete row
+    vector<fvec> samples(rows + bFirstRow, fvec(inputs.size(), 0.f));
+    ivec labels(samples.size(), 0);
+    if(bFirstRow)
+    {
+        float value;
+        FOR(d, inputs.size())
         {
-            newDim++;
-            break;
+            const string &cell = firstRow[inputs[d]];
+            if(parseFloat(cell.data(), cell.data()+cell.size(), value)) samples[0][d] = value;
         }
     }
-    vector<bool> bExclude(dim, false);
-    FOR(i, excludeIndex.size())
+    FOR(d, inputs.size())
     {
-        bExclude[excludeIndex[i]] = true;
+        const fvec &values = source.columns[inputs[d]];
+        FOR(i, rows) samples[bFirstRow + i][d] = values[i];
     }
-    FOR(i, samples.size())
+    if(outputLabelColumn != -1)
     {
-        newSamples[i].resize(newDim);
-        int nD = 0;
-        FOR(d, dim)
+        int column = columns[outputLabelColumn];
+        const fvec &values = source.columns[column];
+        FOR(i, rows) labels[bFirstRow + i] = values[i];
+        const vector<ipair> &cells = source.cells[column];
+        FOR(i, cells.size())
+        {
+            if(cells[i].first >= rows) break;
+            map<string,unsigned int>::iterator it = classLabels.find(source.strings[column][cells[i].second]);
+            labels[bFirstRow + cells[i].first] = it != classLabels.end() ? it->second : 0;
+        }
+        if(bFirstRow)
         {
-            if(bExclude[d] || d == outputLabelColumn) continue;
-            if(outputLabelColumn == -1) newSamples[i][nD] = samples[i][d];
-            else if (d < outputLabelColumn) newSamples[i][nD] = samples[i][d];
-            else if(d > outputLabelColumn) newSamples[i][nD] = samples[i][d-1];
-            nD++;
+            float value;
+            const string &cell = firstRow[column];
+            if(parseFloat(cell.data(), cell.data()+cell.size(), value)) labels[0] = value;
+            else if(classLabels.count(cell)) labels[0] = classLabels[cell];
         }
     }
-    qDebug() << "Imported samples: " << newSamples.size() << " labels: " << labels.size();
-    return pair<vector<fvec>,ivec>(newSamples,labels);
+    if(!bParsed)
+    {
+        vector<fvec>().swap(source.columns);
+        vector<CSVStringTable>().swap(source.strings);
+        vector< vector<ipair> >().swap(source.cells);
+        source.bParsed = false;
+    }
+    return pair<vector<fvec>,ivec>(samples, labels);
 }
 
 
 uint8_t CSVParser::getBOMsize(const char* fileName)
 {
     FILE *f = fopen(fileName,"rb");
-    unsigned char bom[16];
+    if(!f) return 0;
+    unsigned char bom[16] = {0};
     fread(bom,1,16,f);
+    fclose(f);
 
     if        (bom[0] == 0x00  && bom[1]  == 0x00 &&
                bom[2] == 0xFE  && bom[3]  == 0xFF) {
@@ -31,6 +31,7 @@ Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
 #define NUMERIC_TYPES       (UNSIGNED_INT_TYPE | INT_TYPE | FLOAT_TYPE | DOUBLE_TYPE)
 
 #define MISSING_VALUE        "?"
+#define CSV_PREVIEW_ROWS     1000
 
 #include <map>
 #include <iterator>
@@ -41,8 +42,11 @@ Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
 #include <string>
 #include <types.h>
 #include <QString>
+#include <QAtomicInt>
 #include <stdint.h>
 
+class QFile;
+
 using namespace std;
 
 template<typename T>
@@ -102,36 +106,90 @@ private:
     CSVRow              m_row;
 };
 
+// open addressing table interning the categorical cells, the strings
+// are only allocated the first time they are seen
+class CSVStringTable
+{
+public:
+    CSVStringTable() : count(0) {}
+    int insert(const char *s, size_t length);
+    int insert(const string &s){return insert(s.data(), s.size());}
+    int size() const {return strings.size();}
+    const string &operator[](int id) const {return strings[id];}
+    const vector<string> &getStrings() const {return strings;}
+    void clear();
+
+private:
+    vector<string> strings;
+    vector<unsigned int> hashes;
+    ivec slots; // -1 if empty, index in strings otherwise
+    int count;
+    void grow();
+};
+
+// newline-aligned slice of the file, tokenized on demand
+struct CSVChunk
+{
+    const char *start, *stop;
+    int rows; // non-empty lines
+    int badRow; // first row with missing cells, -1 if none
+    bool bParsed;
+    vector<fvec> columns; // contiguous values, one column per cell of the row
+    vector<CSVStringTable> strings; // chunk-local strings for each column
+    vector< vector<ipair> > cells; // (row, string id) of the non-numeric cells
+};
+
 class CSVParser
 {
+    friend class CSVChunkWorker;
 public:
     CSVParser();
+    ~CSVParser();
     void clear();
     void parse(const char* fileName, int separatorType=0);
     vector<size_t> getMissingValIndex();
     void cleanData(unsigned int acceptedTypes);
     pair<vector<fvec>,ivec> getData(ivec excludeIndex = ivec(), int maxSamples=-1);
-    map<string,unsigned int> getOutputLabelTypes(bool reparse);
+    // the file one chunk at a time, for the algorithms that learn from a stream
+    int getChunkCount(){return chunks.size();}
+    pair<vector<fvec>,ivec> getChunkData(int chunk, ivec excludeIndex = ivec());
+    map<string,unsigned int> getOutputLabelTypes(bool reparse, int maxSamples=-1);
     void setOutputColumn(int column);
     void setFirstRowAsHeader(bool value){bFirstRowAsHeader = value;}
     bool hasData();
     vector<unsigned int> getDataType(){return dataTypes;}
-    int getCount(){return data.size();}
-    vector< vector<string> > getRawData(){return data;}
+    int getCount(){return buffer ? rowCount+1 : 0;}
+    vector< vector<string> > getRawData(int maxRows=-1);
     static pair<vector<fvec>, ivec> numericFromRawData(vector< vector<string> > rawData);
     map<int,QString> getClassNames(){return classNames;}
     map<int, vector<string> > getCategorical(){return categorical;}
+    static bool parseFloat(const char *s, const char *e, float &value);
+    static const int chunkSize = 4<<20;
 
 private:
     bool bFirstRowAsHeader;
     int outputLabelColumn;
-    ifstream file;
+    QFile *file;
+    string unpacked; // file contents without the UTF-16/32 padding
+    const char *buffer, *bufferEnd, *bodyStart;
+    char separator;
+    int rowCount; // rows after the first one
+    vector<string> firstRow;
+    ivec columns; // source columns still in use (see cleanData)
+    vector<CSVChunk> chunks;
+    ivec chunkRows; // rows before each chunk
+    QAtomicInt nextChunk;
+    int chunkStop;
+    bool bCountOnly;
     map<string,unsigned int> classLabels;
     map<int, QString> classNames;
-    vector<vector<string> > data;
     vector<unsigned int> dataTypes;
     map<int, vector<string> > categorical;
     uint8_t getBOMsize(const char* fileName);
+    void runChunks(int stop, bool bCount);
+    void processChunks();
+    int chunksForRows(int rows);
+    bool fetchColumn(int column, int count, bool bInternAll, fvec &values, CSVStringTable &table);
 };
 
 #endif // PARSER_H
@@ -59,6 +59,7 @@ public:
     virtual const char *GetInfoString(){return NULL;}
     virtual void SaveModel(std::string filename){}
     virtual bool LoadModel(std::string filename){return false;}
+    virtual bool IsStreaming() const {return false;} // Train continues the current model instead of refitting it
 };
 
 #endif // _REGRESSOR_H_
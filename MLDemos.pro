@@ -18,6 +18,10 @@ MLDemos.file = MLDemos/MLDemos.pro
 MLDemos.depends = Core
 MLScripting.file = MLScripting/MLScripting.pro
 MLScripting.depends = Core
+# the tests, run with make check
+SUBDIRS += Tests
+Tests.file = Tests/Tests.pro
+Tests.depends = Core
 
 # algorithm plugins
 ALGOPATH = _AlgorithmsPlugins
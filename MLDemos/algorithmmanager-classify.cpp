@@ -162,16 +162,79 @@ void AlgorithmManager::DrawClassifiedSamples(Canvas *canvas, Classifier *classif
     }
 }
 
+// evaluates the classifier (or its one-vs-all companions) on a whole set of samples in a single batch
+// and returns the number of responses per sample stored in results
+static int TestClassifierBatch(Classifier *classifier, std::vector<Classifier *> &classifierMulti, bool bMulticlass, const std::vector<fvec> &samples, fvec &results)
+{
+    results.clear();
+    if(!samples.size()) return 0;
+    int dim = samples[0].size();
+    fvec sampleMatrix = flatten(samples, dim);
+    if(classifier->IsMultiClass()) return classifier->TestMultiBatch(&sampleMatrix[0], samples.size(), dim, results);
+    if(bMulticlass)
+    {
+        int resDim = classifierMulti.size();
+        fvec responses(samples.size());
+        results.resize(samples.size()*resDim);
+        FOR(c, resDim)
+        {
+            classifierMulti[c]->TestBatch(&sampleMatrix[0], samples.size(), dim, &responses[0]);
+            FOR(i, samples.size()) results[i*resDim + c] = responses[i];
+        }
+        return resDim;
+    }
+    results.resize(samples.size());
+    classifier->TestBatch(&sampleMatrix[0], samples.size(), dim, &results[0]);
+    return 1;
+}
+
 bool AlgorithmManager::Train(Classifier *classifier, float trainRatio, bvec trainList, int positiveIndex, std::vector<fvec> samples, ivec labels)
 {
     if(!classifier) return false;
     if(!labels.size()) labels = canvas->data->GetLabels();
     ivec inputDims = GetInputDimensions();
-    if(!samples.size()) samples = canvas->data->GetSampleDims(inputDims);
-    else samples = canvas->data->GetSampleDims(samples, inputDims);
+    // we read the selected dimensions straight from the contiguous samples, the only copies are the train and test sets
+    fvec sampleMatrix;
+    SampleView view;
+    if(!samples.size()) view = canvas->data->GetSampleView(inputDims);
+    else
+    {
+        sampleMatrix = flatten(samples);
+        view = SampleView(&sampleMatrix[0], samples.size(), samples[0].size(), inputDims);
+    }
     sourceDims = inputDims;
     canvas->sourceDims = inputDims;
 
+    // if we are going multiclass on a single-class classifier, we need N one-vs-all models
+    int oneVsAllCount = OneVsAllCount(classifier, labels, positiveIndex);
+    if(oneVsAllCount)
+    {
+        classifierMulti.push_back(classifier);
+        for(int c=1; c<oneVsAllCount; c++) classifierMulti.push_back(classifiers[tabUsedForTraining]->GetClassifier());
+    }
+    if(!TrainClassifier(classifier, classifierMulti, view, labels, trainRatio, trainList, positiveIndex, 0, &lastTrainingInfo)) return false;
+
+    emit Trained();
+    //bIsRocNew = true;
+    //bIsCrossNew = true;
+    //SetROCInfo();
+    return true;
+}
+
+int AlgorithmManager::OneVsAllCount(const Classifier *classifier, const ivec &labels, int positiveIndex)
+{
+    if(classifier->IsMultiClass() || positiveIndex != -1) return 0;
+    int classCount = DatasetManager::GetClassCount(labels);
+    return classCount > 2 ? classCount : 0;
+}
+
+// trains the classifier on its split of the data and stores the training and testing roc data in it.
+// Only touches its arguments, so that separate models can be trained concurrently (see Compare)
+bool AlgorithmManager::TrainClassifier(Classifier *classifier, std::vector<Classifier *> &classifierMulti, const SampleView &view,
+                                       const ivec &labels, float trainRatio, const bvec &trainList, int positiveIndex,
+                                       const u32 *fixedPerm, QString *info)
+{
+    QString trainingInfo;
     ivec newLabels;
     std::map<int,int> binaryClassMap, binaryInverseMap;
     int classCount = DatasetManager::GetClassCount(labels);
@@ -226,12 +289,12 @@ bool AlgorithmManager::Train(Classifier *classifier, float trainRatio, bvec trai
         {
             if(trainList[i])
             {
-                trainSamples.push_back(samples[i]);
+                trainSamples.push_back(view.Sample(i));
                 trainLabels.push_back(newLabels[i]);
             }
             else
             {
-                testSamples.push_back(samples[i]);
+                testSamples.push_back(view.Sample(i));
                 testLabels.push_back(newLabels[i]);
             }
         }
@@ -246,22 +309,27 @@ bool AlgorithmManager::Train(Classifier *classifier, float trainRatio, bvec trai
             classCnt[newLabels[i]]++;
         }
 
-        trainCnt = (int)(samples.size()*trainRatio);
-        testCnt = samples.size() - trainCnt;
+        trainCnt = (int)(view.size()*trainRatio);
+        testCnt = view.size() - trainCnt;
         trainSamples.resize(trainCnt);
         trainLabels.resize(trainCnt);
         testSamples.resize(testCnt);
         testLabels.resize(testCnt);
-        perm = randPerm(samples.size());
+        if(fixedPerm)
+        {
+            perm = new u32[view.size()];
+            FOR(i, view.size()) perm[i] = fixedPerm[i];
+        }
+        else perm = randPerm(view.size());
         FOR(i, trainCnt)
         {
-            trainSamples[i] = samples[perm[i]];
+            trainSamples[i] = view.Sample(perm[i]);
             trainLabels[i] = newLabels[perm[i]];
             trainClassCnt[trainLabels[i]]++;
         }
-        for(int i=trainCnt; i<samples.size(); i++)
+        for(int i=trainCnt; i<view.size(); i++)
         {
-            testSamples[i-trainCnt] = samples[perm[i]];
+            testSamples[i-trainCnt] = view.Sample(perm[i]);
             testLabels[i-trainCnt] = newLabels[perm[i]];
             testClassCnt[testLabels[i-trainCnt]]++;
         }
@@ -311,6 +379,7 @@ bool AlgorithmManager::Train(Classifier *classifier, float trainRatio, bvec trai
     {
         qDebug() << "we're going one-vs-all multiclass! (" << classCount << ")";
         // if we are going multiclass on a single-class classifier, we need to train N one-vs-all models
+        if((int)classifierMulti.size() != classCount) return false;
         FOR(c, classCount)
         {
             int realClass = binaryInverseMap[c];
@@ -320,16 +389,13 @@ bool AlgorithmManager::Train(Classifier *classifier, float trainRatio, bvec trai
                 if(trainLabels[i] == realClass) trainLabelsBinary[i] = +1;
                 else trainLabelsBinary[i] = -1;
             }
-            if(c==0) classifierMulti.push_back(classifier);
-            else classifierMulti.push_back(classifiers[tabUsedForTraining]->GetClassifier());
-            classifierMulti.back()->Train(trainSamples, trainLabelsBinary);
+            classifierMulti[c]->Train(trainSamples, trainLabelsBinary);
         }
         classifier->classMap = binaryClassMap;
         classifier->inverseMap = binaryInverseMap;
     }
 
     // compute test results
-    lastTrainingInfo = "";
     map<int, int> truePerClass;
     map<int, int> falsePerClass;
     map<int, int> countPerClass;
@@ -338,13 +404,15 @@ bool AlgorithmManager::Train(Classifier *classifier, float trainRatio, bvec trai
     // we generate the roc curve for this guy
     bool bTrueMulti = bMulticlass;
     vector<f32pair> rocData;
+    fvec batchResults;
+    int resDim = TestClassifierBatch(classifier, classifierMulti, bMulticlass, trainSamples, batchResults);
     FOR(i, trainSamples.size())
     {
         int label = trainLabels[i];
         if(bMulticlass && binaryClassMap.size()) label = binaryClassMap[label];
         if(classifier->IsMultiClass())
         {
-            fvec res = classifier->TestMulti(trainSamples[i]);
+            fvec res(batchResults.begin() + i*resDim, batchResults.begin() + (i+1)*resDim);
             if(res.size() == 1)
             {
                 rocData.push_back(f32pair(res[0], label));
@@ -379,7 +447,7 @@ bool AlgorithmManager::Train(Classifier *classifier, float trainRatio, bvec trai
                 float maxResp = -FLT_MAX;
                 FOR(c, classifierMulti.size())
                 {
-                    float res = classifierMulti[c]->Test(trainSamples[i]);
+                    float res = batchResults[i*resDim + c];
                     if(res > maxResp)
                     {
                         maxResp = res;
@@ -394,7 +462,7 @@ bool AlgorithmManager::Train(Classifier *classifier, float trainRatio, bvec trai
             }
             else
             {
-                float resp = classifier->Test(trainSamples[i]);
+                float resp = batchResults[i];
                 rocData.push_back(f32pair(resp, label));
                 if(resp > 0 && label == 1) truePerClass[1]++;
                 else if(resp > 0 && label != 1) falsePerClass[0]++;
@@ -408,7 +476,7 @@ bool AlgorithmManager::Train(Classifier *classifier, float trainRatio, bvec trai
     if(!bTrueMulti) rocData = FixRocData(rocData);
     classifier->rocdata.push_back(rocData);
     classifier->roclabels.push_back("training");
-    lastTrainingInfo += QString("\nTraining Set (%1 samples):\n").arg(trainSamples.size());
+    trainingInfo += QString("\nTraining Set (%1 samples):\n").arg(trainSamples.size());
     int posClass = 1;
     if(bTrueMulti)
     {
@@ -429,13 +497,13 @@ bool AlgorithmManager::Train(Classifier *classifier, float trainRatio, bvec trai
             float recall = tp / float(count);
             macroFMeasure += 2*precision*recall/(precision+recall);
             float ratio = it->second != 0 ? tp / (float)it->second : 0;
-            lastTrainingInfo += QString("Class %1 (%5 samples): %2 correct (%4%)\n%3 incorrect\n").arg(c).arg(tp).arg(fp).arg((int)(ratio*100)).arg(it->second);
+            trainingInfo += QString("Class %1 (%5 samples): %2 correct (%4%)\n%3 incorrect\n").arg(c).arg(tp).arg(fp).arg((int)(ratio*100)).arg(it->second);
         }
         macroFMeasure /= countPerClass.size();
         microPrecision = microTP / float(microTP + microFP);
         microRecall = microTP / float(microCount);
         microFMeasure = 2*microPrecision*microRecall/(microPrecision + microRecall);
-        lastTrainingInfo += QString("F-Measure: %1 (micro) \t %2 (macro)\n").arg(microFMeasure, 0, 'f', 3).arg(macroFMeasure, 0, 'f', 3);
+        trainingInfo += QString("F-Measure: %1 (micro) \t %2 (macro)\n").arg(microFMeasure, 0, 'f', 3).arg(macroFMeasure, 0, 'f', 3);
     }
     else
     {
@@ -447,25 +515,26 @@ bool AlgorithmManager::Train(Classifier *classifier, float trainRatio, bvec trai
         int fp = posClass ? falsePerClass[1] : truePerClass[1];
         int count = countPerClass[1];
         float ratio = count != 0 ? tp/(float)count : 1;
-        lastTrainingInfo += QString("Positive (%4 samples): %1 correct (%3%)\n%2 incorrect\n").arg(tp).arg(fp).arg((int)(ratio*100)).arg(count);
+        trainingInfo += QString("Positive (%4 samples): %1 correct (%3%)\n%2 incorrect\n").arg(tp).arg(fp).arg((int)(ratio*100)).arg(count);
         tp = posClass ? truePerClass[0] : falsePerClass[0];
         fp = posClass ? falsePerClass[0] : truePerClass[0];
         count = countPerClass[0];
         ratio = count != 0 ? tp/(float)count : 1;
-        lastTrainingInfo += QString("Negative (%4 samples): %1 correct (%3%)\n%2 incorrect\n").arg(tp).arg(fp).arg((int)(ratio*100)).arg(count);
+        trainingInfo += QString("Negative (%4 samples): %1 correct (%3%)\n%2 incorrect\n").arg(tp).arg(fp).arg((int)(ratio*100)).arg(count);
     }
 
     truePerClass.clear();
     falsePerClass.clear();
     countPerClass.clear();
     rocData.clear();
+    resDim = TestClassifierBatch(classifier, classifierMulti, bMulticlass, testSamples, batchResults);
     FOR(i, testSamples.size())
     {
         int label = testLabels[i];
         if(bMulticlass && binaryClassMap.size()) label = binaryClassMap[label];
         if(classifier->IsMultiClass())
         {
-            fvec res = classifier->TestMulti(testSamples[i]);
+            fvec res(batchResults.begin() + i*resDim, batchResults.begin() + (i+1)*resDim);
             if(res.size() == 1)
             {
                 rocData.push_back(f32pair(res[0], label));
@@ -496,7 +565,7 @@ bool AlgorithmManager::Train(Classifier *classifier, float trainRatio, bvec trai
                 float maxResp = -FLT_MAX;
                 FOR(c, classifierMulti.size())
                 {
-                    float res = classifierMulti[c]->Test(testSamples[i]);
+                    float res = batchResults[i*resDim + c];
                     if(res > maxResp)
                     {
                         maxResp = res;
@@ -510,7 +579,7 @@ bool AlgorithmManager::Train(Classifier *classifier, float trainRatio, bvec trai
                 else truePerClass[c]++;
             }            else
             {
-                float resp = classifier->Test(testSamples[i]);
+                float resp = batchResults[i];
                 rocData.push_back(f32pair(resp, label));
                 if(resp > 0 && label == 1) truePerClass[1]++;
                 else if(resp > 0 && label != 1) falsePerClass[0]++;
@@ -526,7 +595,7 @@ bool AlgorithmManager::Train(Classifier *classifier, float trainRatio, bvec trai
     classifier->roclabels.push_back("test");
     classifier->confusionMatrix[0] = confusionMatrix[0];
     classifier->confusionMatrix[1] = confusionMatrix[1];
-    lastTrainingInfo += QString("\nTesting Set (%1 samples):\n").arg(testSamples.size());
+    trainingInfo += QString("\nTesting Set (%1 samples):\n").arg(testSamples.size());
     if(bTrueMulti)
     {
         float macroFMeasure = 0.f, microFMeasure = 0.f;
@@ -546,13 +615,13 @@ bool AlgorithmManager::Train(Classifier *classifier, float trainRatio, bvec trai
             float recall = tp / float(count);
             macroFMeasure += 2*precision*recall/(precision+recall);
             float ratio = it->second != 0 ? tp / (float)it->second : 0;
-            lastTrainingInfo += QString("Class %1 (%5 samples): %2 correct (%4%)\n%3 incorrect\n").arg(c).arg(tp).arg(fp).arg((int)(ratio*100)).arg(it->second);
+            trainingInfo += QString("Class %1 (%5 samples): %2 correct (%4%)\n%3 incorrect\n").arg(c).arg(tp).arg(fp).arg((int)(ratio*100)).arg(it->second);
         }
         macroFMeasure /= countPerClass.size();
         microPrecision = microTP / float(microTP + microFP);
         microRecall = microTP / float(microCount);
         microFMeasure = 2*microPrecision*microRecall/(microPrecision + microRecall);
-        lastTrainingInfo += QString("F-Measure: %1 (micro) \t %2 (macro)\n").arg(microFMeasure, 0, 'f', 3).arg(macroFMeasure, 0, 'f', 3);
+        trainingInfo += QString("F-Measure: %1 (micro) \t %2 (macro)\n").arg(microFMeasure, 0, 'f', 3).arg(macroFMeasure, 0, 'f', 3);
     }
     else
     {
@@ -560,18 +629,14 @@ bool AlgorithmManager::Train(Classifier *classifier, float trainRatio, bvec trai
         int fp = posClass ? falsePerClass[1] : truePerClass[1];
         int count = countPerClass[1];
         float ratio = count != 0 ? tp/(float)count : 1;
-        lastTrainingInfo += QString("Positive (%4 samples): %1 correct (%3%)\n%2 incorrect\n").arg(tp).arg(fp).arg((int)(ratio*100)).arg(count);
+        trainingInfo += QString("Positive (%4 samples): %1 correct (%3%)\n%2 incorrect\n").arg(tp).arg(fp).arg((int)(ratio*100)).arg(count);
         tp = posClass ? truePerClass[0] : falsePerClass[0];
         fp = posClass ? falsePerClass[0] : truePerClass[0];
         count = countPerClass[0];
         ratio = count != 0 ? tp/(float)count : 1;
-        lastTrainingInfo += QString("Negative (%4 samples): %1 correct (%3%)\n%2 incorrect\n").arg(tp).arg(fp).arg((int)(ratio*100)).arg(count);
+        trainingInfo += QString("Negative (%4 samples): %1 correct (%3%)\n%2 incorrect\n").arg(tp).arg(fp).arg((int)(ratio*100)).arg(count);
     }
     KILL(perm);
-
-    emit Trained();
-    //bIsRocNew = true;
-    //bIsCrossNew = true;
-    //SetROCInfo();
+    if(info) *info = trainingInfo;
     return true;
 }
@@ -133,16 +133,18 @@ void AlgorithmManager::Cluster()
     int f1ratioIndex = optionsCluster->trainRatioCombo->currentIndex();
     float f1ratios[] = {0.01f, 0.05f, 0.1f, 0.2f, 1.f/3.f, 0.5f, 0.75f, 1.f};
     float f1ratio = f1ratios[f1ratioIndex];
+    vector<fvec> sampleResults = clusterer->TestAll(samples);
     vector<fvec> clusterScores(samples.size());
     FOR(i, samples.size())
     {
-        fvec result = clusterer->Test(samples[i]);
+        fvec &result = sampleResults[i];
         if(clusterer->NbClusters()==1) clusterScores[i] = result;
         else if(result.size()>1) clusterScores[i] = result;
         else if(result.size())
         {
             fvec res(clusterer->NbClusters(),0);
             res[result[0]] = 1.f;
+            clusterScores[i] = res;
         }
     }
     float F1 = ClusterFMeasure(samples, labels, clusterScores, f1ratio);
@@ -173,7 +175,7 @@ void AlgorithmManager::Cluster()
         canvas->sampleColors.resize(samples.size());
         FOR(i, samples.size())
         {
-            fvec res = clusterer->Test(samples[i]);
+            fvec &res = sampleResults[i];
             float r=0,g=0,b=0;
             if(res.size() > 1)
             {
@@ -265,9 +267,10 @@ void AlgorithmManager::ClusterTest()
 
     // we fill in the canvas sampleColors for the alternative display types
     canvas->sampleColors.resize(samples.size());
+    vector<fvec> sampleResults = clusterer->TestAll(samples);
     FOR(i, samples.size())
     {
-        fvec res = clusterer->Test(samples[i]);
+        fvec &res = sampleResults[i];
         float r=0,g=0,b=0;
         if(res.size() > 1)
         {
@@ -369,16 +372,18 @@ void AlgorithmManager::ClusterOptimize()
             float AIC = -2*logL + 2*k;
             float AICc = AIC + 2*(k*k + k)/(n-k-1);
 
+            vector<fvec> sampleResults = clusterer->TestAll(samples);
             vector<fvec> clusterScores(samples.size());
             FOR(i, samples.size())
             {
-                fvec result = clusterer->Test(samples[i]);
+                fvec &result = sampleResults[i];
                 if(clusterer->NbClusters()==1) clusterScores[i] = result;
                 else if(result.size()>1) clusterScores[i] = result;
                 else if(result.size())
                 {
                     fvec res(clusterer->NbClusters(),0);
                     res[result[0]] = 1.f;
+                    clusterScores[i] = res;
                 }
             }
             float f1 = ClusterFMeasure(samples, labels, clusterScores, ratio);
@@ -523,9 +528,10 @@ void AlgorithmManager::ClusterIterate()
     ivec inputDims = GetInputDimensions();
     vector<fvec> samples = canvas->data->GetSampleDims(inputDims);
     canvas->sampleColors.resize(samples.size());
+    vector<fvec> sampleResults = clusterer->TestAll(samples);
     FOR(i, samples.size())
     {
-        fvec res = clusterer->Test(samples[i]);
+        fvec &res = sampleResults[i];
         float r=0,g=0,b=0;
         if(res.size() > 1)
         {
@@ -555,8 +561,15 @@ void AlgorithmManager::Train(Clusterer *clusterer, float trainRatio, bvec trainL
     if(!clusterer) return;
     if(!labels.size()) labels = canvas->data->GetLabels();
     ivec inputDims = GetInputDimensions();
-    if(!samples.size()) samples = canvas->data->GetSampleDims(inputDims);
-    else samples = canvas->data->GetSampleDims(samples, inputDims);
+    // the training subsets are read straight from the contiguous samples
+    fvec sampleMatrix;
+    SampleView view;
+    if(!samples.size()) view = canvas->data->GetSampleView(inputDims);
+    else
+    {
+        sampleMatrix = flatten(samples);
+        view = SampleView(&sampleMatrix[0], samples.size(), samples[0].size(), inputDims);
+    }
     sourceDims = inputDims;
     canvas->sourceDims = inputDims;
 
@@ -567,24 +580,24 @@ void AlgorithmManager::Train(Clusterer *clusterer, float trainRatio, bvec trainL
         {
             if(trainList[i])
             {
-                trainSamples.push_back(samples[i]);
+                trainSamples.push_back(view.Sample(i));
             }
         }
         clusterer->Train(trainSamples);
     }
     else if(trainRatio < 1)
     {
-        int trainCnt = samples.size()*trainRatio;
+        int trainCnt = view.size()*trainRatio;
         vector<fvec> trainSamples(trainCnt);
-        u32 *perm = randPerm(samples.size());
+        u32 *perm = randPerm(view.size());
         FOR(i, trainCnt)
         {
-            trainSamples[i] = samples[perm[i]];
+            trainSamples[i] = view.Sample(perm[i]);
         }
         clusterer->Train(trainSamples);
         delete [] perm;
     }
-    else clusterer->Train(samples);
+    else clusterer->Train(view.ToSamples());
     // we test the clusters to see how well they classify the samples
 
     if(!testFMeasures) return;
@@ -598,10 +611,12 @@ void AlgorithmManager::Train(Clusterer *clusterer, float trainRatio, bvec trainL
     fvec clusterScores(nbClusters);
     map<int,float> labelScores;
 
-    vector<fvec> scores(samples.size());
-    FOR(i, canvas->data->GetCount())
+    fvec sampleResults = clusterer->TestMany(view.ToMatrix(), view.dim(), view.size());
+    int resDim = view.size() ? sampleResults.size() / view.size() : 0;
+    vector<fvec> scores(view.size());
+    FOR(i, view.size())
     {
-        fvec result = clusterer->Test(samples[i]);
+        fvec result(sampleResults.begin() + i*resDim, sampleResults.begin() + (i+1)*resDim);
         if(clusterer->NbClusters()==1) scores[i] = result;
         else if(result.size()>1) scores[i] = result;
         else scores[i] = fvec(nbClusters,0);
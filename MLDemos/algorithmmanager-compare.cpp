@@ -19,8 +19,70 @@ Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
 *********************************************************************/
 #include "algorithmmanager.h"
 #include "mldemos.h"
+#include <QThread>
+#include <QThreadPool>
+#include <QRunnable>
+#include <QAtomicInt>
 
 using namespace std;
+
+// one fold of one classifier in the comparison, with its own models and its own split
+struct CompareTask
+{
+    int option; // index in the compare options
+    Classifier *classifier;
+    std::vector<Classifier *> classifierMulti; // one-vs-all models (the first one is classifier)
+    u32 *perm;
+    bool bDone;
+};
+
+// the classification folds, trained concurrently on a thread pool
+struct CompareJobs
+{
+    std::vector<CompareTask> tasks;
+    ivec parallelTasks;
+    fvec sampleMatrix;
+    SampleView view;
+    ivec labels;
+    float trainRatio;
+    bvec trainList;
+    QAtomicInt nextTask, doneCount, bCanceled;
+
+    ~CompareJobs()
+    {
+        FOR(t, tasks.size())
+        {
+            if(!tasks[t].classifierMulti.size()) DEL(tasks[t].classifier);
+            FOR(c, tasks[t].classifierMulti.size()) DEL(tasks[t].classifierMulti[c]);
+            KILL(tasks[t].perm);
+        }
+    }
+
+    void Run(int t)
+    {
+        CompareTask &task = tasks[t];
+        AlgorithmManager::TrainClassifier(task.classifier, task.classifierMulti, view, labels,
+                                          trainRatio, trainList, -1, task.perm);
+        task.bDone = true;
+        doneCount.fetchAndAddOrdered(1);
+    }
+};
+
+class CompareWorker : public QRunnable
+{
+    CompareJobs *jobs;
+public:
+    CompareWorker(CompareJobs *jobs) : jobs(jobs) {}
+    void run()
+    {
+        int t;
+        while(!jobs->bCanceled.load() && (t = jobs->nextTask.fetchAndAddOrdered(1)) < (int)jobs->parallelTasks.size())
+        {
+            jobs->Run(jobs->parallelTasks[t]);
+        }
+    }
+};
+
 void AlgorithmManager::Compare()
 {
     if(!canvas) return;
@@ -94,6 +156,97 @@ void AlgorithmManager::Compare()
 
     QProgressDialog progress("Comparing Algorithms", "cancel", 0, folds*compare->compareOptions.size());
     progress.show();
+
+    // the classifier models are all created here, as the plugins read their parameters from
+    // the gui, then each (algorithm, fold) is trained on its own split on the thread pool
+    CompareJobs jobs;
+    FOR(i, compare->compareOptions.size())
+    {
+        QString string = compare->compareOptions[i];
+        QTextStream stream(&string);
+        QString line = stream.readLine();
+        QString paramString = stream.readAll();
+        if(!line.startsWith("Classification")) continue;
+        QStringList s = line.split(":");
+        int tab = s[1].toInt();
+        if(tab >= classifiers.size() || !classifiers[tab]) continue;
+        QTextStream paramStream(&paramString);
+        QString paramName;
+        float paramValue;
+        while(!paramStream.atEnd())
+        {
+            paramStream >> paramName;
+            paramStream >> paramValue;
+            classifiers[tab]->LoadParams(paramName, paramValue);
+        }
+        if(!jobs.tasks.size())
+        {
+            ivec inputDims = GetInputDimensions();
+            if(!samples.size())
+            {
+                jobs.sampleMatrix = canvas->data->GetSampleView(inputDims).ToMatrix();
+                jobs.labels = canvas->data->GetLabels();
+            }
+            else
+            {
+                jobs.sampleMatrix = SampleView(&flatten(samples)[0], samples.size(), samples[0].size(), inputDims).ToMatrix();
+                jobs.labels = labels;
+            }
+            int dim = inputDims.size() ? inputDims.size() : (samples.size() ? samples[0].size() : canvas->data->GetDimCount());
+            jobs.view = SampleView(jobs.sampleMatrix.size() ? &jobs.sampleMatrix[0] : 0, jobs.labels.size(), dim);
+            jobs.trainRatio = trainRatio;
+            jobs.trainList = trainList;
+            if (!samples.size() && optionsClassify->manualTrainButton->isChecked()) {
+                jobs.trainList = GetManualSelection();
+            }
+        }
+        FOR(f, folds)
+        {
+            CompareTask task;
+            task.option = i;
+            task.classifier = classifiers[tab]->GetClassifier();
+            if(!task.classifier) continue;
+            int oneVsAllCount = OneVsAllCount(task.classifier, jobs.labels, -1);
+            if(oneVsAllCount) task.classifierMulti.push_back(task.classifier);
+            for(int c=1; c<oneVsAllCount; c++) task.classifierMulti.push_back(classifiers[tab]->GetClassifier());
+            task.perm = randPerm(jobs.view.size());
+            task.bDone = false;
+            jobs.tasks.push_back(task);
+        }
+    }
+    ivec serialTasks;
+    FOR(t, jobs.tasks.size())
+    {
+        if(jobs.tasks[t].classifier->CanTrainConcurrently()) jobs.parallelTasks.push_back(t);
+        else serialTasks.push_back(t); // models that share state while training stay on this thread
+    }
+    // the cores are split between the models trained at once, so that the models that train
+    // on several threads themselves do not ask for more threads than there are cores
+    int idealCount = QThread::idealThreadCount();
+    int threadCount = min(idealCount, (int)jobs.parallelTasks.size());
+    FOR(t, jobs.parallelTasks.size())
+    {
+        CompareTask &task = jobs.tasks[jobs.parallelTasks[t]];
+        task.classifier->SetThreadCount(max(1, idealCount / threadCount));
+        FOR(c, task.classifierMulti.size()) task.classifierMulti[c]->SetThreadCount(max(1, idealCount / threadCount));
+    }
+    QThreadPool pool;
+    FOR(t, threadCount) pool.start(new CompareWorker(&jobs));
+    while(!pool.waitForDone(40))
+    {
+        progress.setValue(jobs.doneCount.load());
+        qApp->processEvents(QEventLoop::ExcludeUserInputEvents);
+        if(progress.wasCanceled()) jobs.bCanceled.store(1);
+    }
+    // the other models are trained one at a time once the pool is done, each with all the cores
+    FOR(t, serialTasks.size())
+    {
+        if(jobs.bCanceled.load()) break;
+        jobs.Run(serialTasks[t]);
+        progress.setValue(jobs.doneCount.load());
+        qApp->processEvents(QEventLoop::ExcludeUserInputEvents);
+        if(progress.wasCanceled()) jobs.bCanceled.store(1);
+    }
     FOR(i, compare->compareOptions.size())
     {
         QString string = compare->compareOptions[i];
@@ -148,30 +301,17 @@ void AlgorithmManager::Compare()
             QStringList s = line.split(":");
             int tab = s[1].toInt();
             if(tab >= classifiers.size() || !classifiers[tab]) continue;
-            QTextStream paramStream(&paramString);
-            QString paramName;
-            float paramValue;
-            while(!paramStream.atEnd())
-            {
-                paramStream >> paramName;
-                paramStream >> paramValue;
-                classifiers[tab]->LoadParams(paramName, paramValue);
-            }
             QString algoName = classifiers[tab]->GetAlgoString();
             fvec fmeasureTrain, fmeasureTest, errorTrain, errorTest, precisionTrain, precisionTest, recallTrain, recallTest;
 
             map<int,int> classes;
             FOR(j, canvas->data->GetLabels().size()) classes[canvas->data->GetLabels()[j]]++;
 
-            if (!samples.size() && optionsClassify->manualTrainButton->isChecked()) {
-                trainList = GetManualSelection();
-            }
-
-            FOR(f, folds)
+            // the results are merged in the order of the folds, whichever finished first
+            FOR(t, jobs.tasks.size())
             {
-                classifier = classifiers[tab]->GetClassifier();
-                if(!classifier) continue;
-                Train(classifier, trainRatio, trainList, -1, samples, labels);
+                if(jobs.tasks[t].option != i || !jobs.tasks[t].bDone) continue;
+                classifier = jobs.tasks[t].classifier;
                 bool bMulti = classifier->IsMultiClass() && DatasetManager::GetClassCount(canvas->data->GetLabels()) > 2;
                 if(classifier->rocdata.size()>0)
                 {
@@ -250,27 +390,7 @@ void AlgorithmManager::Compare()
                         }
                     }
                 }
-                if(!classifierMulti.size()) DEL(classifier);
-                classifier = 0;
-                sourceDims.clear();
-                FOR(c,classifierMulti.size()) DEL(classifierMulti[c]); classifierMulti.clear();
-
-                progress.setValue(f + i*folds);
-                qApp->processEvents(QEventLoop::ExcludeUserInputEvents);
-                if(progress.wasCanceled())
-                {
-                    compare->AddResults(fmeasureTest,   "F-Measure (Test)", algoName);
-                    compare->AddResults(errorTest,      "Error (Test)", algoName);
-                    compare->AddResults(precisionTest,  "Precision (Test)", algoName);
-                    compare->AddResults(recallTest,     "Recall (Test)", algoName);
-                    compare->AddResults(fmeasureTrain,  "F-Measure (Training)", algoName);
-                    compare->AddResults(errorTrain,     "Error (Training)", algoName);
-                    compare->AddResults(precisionTrain, "Precision (Training)", algoName);
-                    compare->AddResults(recallTrain,    "Recall (Training)", algoName);
-                    //compare->SetActiveResult(1);
-                    compare->Show();
-                    return;
-                }
+                classifier = 0; // the models are released with the jobs
             }
             compare->AddResults(fmeasureTest,   "F-Measure (Test)", algoName);
             compare->AddResults(errorTest,      "Error (Test)", algoName);
@@ -281,6 +401,11 @@ void AlgorithmManager::Compare()
             compare->AddResults(precisionTrain, "Precision (Training)", algoName);
             compare->AddResults(recallTrain,    "Recall (Training)", algoName);
             //compare->SetActiveResult(1);
+            if(jobs.bCanceled.load())
+            {
+                compare->Show();
+                return;
+            }
         }
         if(line.startsWith("Regression"))
         {
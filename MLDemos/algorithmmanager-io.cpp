@@ -32,6 +32,8 @@ void AlgorithmManager::LoadClassifier()
     bool ok = classifier->LoadModel(filename.toStdString());
     if(ok)
     {
+        // the draw timer must be done with the old model before we delete it
+        if(drawTimer->isRunning()) drawTimer->Stop();
         if(!classifierMulti.size()) DEL(this->classifier);
         this->classifier = 0;
         FOR(i,classifierMulti.size()) DEL(classifierMulti[i]); classifierMulti.clear();
@@ -39,7 +41,6 @@ void AlgorithmManager::LoadClassifier()
         tabUsedForTraining = tab;
         classifiers[tab]->Draw(canvas, classifier);
         DrawClassifiedSamples(canvas, classifier, classifierMulti);
-        if(drawTimer->isRunning()) drawTimer->Stop();
         drawTimer->Clear();
         drawTimer->inputDims = GetInputDimensions();
         drawTimer->start(QThread::NormalPriority);
@@ -66,11 +67,11 @@ void AlgorithmManager::LoadRegressor()
     bool ok = regressor->LoadModel(filename.toStdString());
     if(ok)
     {
+        if(drawTimer->isRunning()) drawTimer->Stop();
         DEL(this->regressor);
         this->regressor = regressor;
         tabUsedForTraining = tab;
         regressors[tab]->Draw(canvas, regressor);
-        if(drawTimer->isRunning()) drawTimer->Stop();
         drawTimer->Clear();
         drawTimer->inputDims = GetInputDimensions();
         drawTimer->start(QThread::NormalPriority);
@@ -97,13 +98,13 @@ void AlgorithmManager::LoadDynamical()
     bool ok = dynamical->LoadModel(filename.toStdString());
     if(ok)
     {
+        if(drawTimer->isRunning()) drawTimer->Stop();
         DEL(this->dynamical);
         this->dynamical = dynamical;
         tabUsedForTraining = tab;
         dynamicals[tab]->Draw(canvas, dynamical);
         if(dynamicals[tab]->UsesDrawTimer())
         {
-            if(drawTimer->isRunning()) drawTimer->Stop();
             drawTimer->Clear();
             drawTimer->bColorMap = optionsDynamic->colorCheck->isChecked();
             drawTimer->start(QThread::NormalPriority);
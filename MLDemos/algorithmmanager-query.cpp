@@ -74,10 +74,7 @@ void AlgorithmManager::QueryClusterer(std::vector<fvec> samples)
     std::vector<fvec> results;
     QMutexLocker lock(mutex);
     if (clusterer && samples.size()) {
-        results.resize(samples.size());
-        FOR (i, samples.size()) {
-            results[i] = clusterer->Test(samples[i]);
-        }
+        results = clusterer->TestAll(samples);
     }
     emit SendResults(results);
 }
@@ -162,18 +162,25 @@ void AlgorithmManager::Train(Regressor *regressor, int outputDim, float trainRat
     outputIndexInList = inputDims.size()-1;
     sourceDims = inputDims;
 
-    if(!samples.size()) samples = canvas->data->GetSampleDims(inputDims, outputIndexInList == -1 ? outputDim : -1);
-    else samples = canvas->data->GetSampleDims(samples, inputDims, outputIndexInList == -1 ? outputDim : -1);
+    // the output is always among the input dimensions at this point, so we can read them straight from the contiguous samples
+    fvec sampleMatrix;
+    SampleView view;
+    if(!samples.size()) view = canvas->data->GetSampleView(inputDims);
+    else {
+        sampleMatrix = flatten(samples);
+        view = SampleView(&sampleMatrix[0], samples.size(), samples[0].size(), inputDims);
+    }
     if(!labels.size()) labels = canvas->data->GetLabels();
 
-    if(!samples.size()) return;
-    int dim = samples[0].size();
+    if(!view.size()) return;
+    int dim = view.dim();
     if(dim < 2) return;
 
     regressor->SetOutputDim(outputDim);
 
     fvec trainErrors, testErrors;
     if(trainRatio == 1.f && !trainList.size()) {
+        samples = view.ToSamples();
         regressor->Train(samples, labels);
         trainErrors.clear();
         FOR(i, samples.size())
@@ -186,18 +193,18 @@ void AlgorithmManager::Train(Regressor *regressor, int outputDim, float trainRat
         regressor->trainErrors = trainErrors;
         regressor->testErrors.clear();
     } else {
-        int trainCnt = (int)(samples.size()*trainRatio);
-        int testCnt = samples.size() - trainCnt;
-        u32 *perm = randPerm(samples.size());
+        int trainCnt = (int)(view.size()*trainRatio);
+        int testCnt = view.size() - trainCnt;
+        u32 *perm = randPerm(view.size());
         vector<fvec> trainSamples, testSamples;
         ivec trainLabels, testLabels;
         if(trainList.size()) {
             FOR(i, trainList.size()) {
                 if(trainList[i]) {
-                    trainSamples.push_back(samples[i]);
+                    trainSamples.push_back(view.Sample(i));
                     trainLabels.push_back(labels[i]);
                 } else {
-                    testSamples.push_back(samples[i]);
+                    testSamples.push_back(view.Sample(i));
                     testLabels.push_back(labels[i]);
                 }
             }
@@ -209,11 +216,11 @@ void AlgorithmManager::Train(Regressor *regressor, int outputDim, float trainRat
             testSamples.resize(testCnt);
             testLabels.resize(testCnt);
             FOR(i, trainCnt) {
-                trainSamples[i] = samples[perm[i]];
+                trainSamples[i] = view.Sample(perm[i]);
                 trainLabels[i] = labels[perm[i]];
             }
             FOR(i, testCnt) {
-                testSamples[i] = samples[perm[i+trainCnt]];
+                testSamples[i] = view.Sample(perm[i+trainCnt]);
                 testLabels[i] = labels[perm[i+trainCnt]];
             }
         }
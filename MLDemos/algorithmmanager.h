@@ -114,6 +114,10 @@ public:
                       QList<InputOutputInterface *> inputoutputs);
 
     bool Train(Classifier *classifier, float trainRatio=1, bvec trainList = bvec(), int positiveIndex=-1, std::vector<fvec> samples=std::vector<fvec>(), ivec labels=ivec());
+    static bool TrainClassifier(Classifier *classifier, std::vector<Classifier *> &classifierMulti, const SampleView &view,
+                                const ivec &labels, float trainRatio, const bvec &trainList, int positiveIndex,
+                                const u32 *fixedPerm=0, QString *info=0);
+    static int OneVsAllCount(const Classifier *classifier, const ivec &labels, int positiveIndex);
     void Train(Regressor *regressor, int outputDim=-1, float trainRatio=1, bvec trainList = bvec(), std::vector<fvec> samples=std::vector<fvec>(), ivec labels=ivec());
     fvec Train(Dynamical *dynamical);
     void Train(Clusterer *clusterer, float trainRatio=1, bvec trainList = bvec(), float *testFMeasures=0, std::vector<fvec> samples=std::vector<fvec>(), ivec labels=ivec());
@@ -1,6 +1,10 @@
 #include "gridsearch.h"
 #include <QPixmap>
 #include <QClipboard>
+#include <QThread>
+#include <QThreadPool>
+#include <QRunnable>
+#include <QAtomicInt>
 #include <basicMath.h>
 #include "ui_gridsearch.h"
 
@@ -351,6 +355,307 @@ fPair GridSearch::GetParamsRange()
     return ranges;
 }
 
+// the train and test sets of one cross-validation fold, shared by all the cells of the grid
+struct GridFold
+{
+    vector<fvec> trainSamples, testSamples;
+    ivec trainLabels, trainBinLabels, testLabels, testBinLabels;
+};
+
+// one cell of the grid evaluated on one fold, with its own model instance
+struct GridTask
+{
+    int cell;
+    int fold;
+    int trainCount; // how much of the training set is used (successive halving)
+    Classifier *classifier;
+    Regressor *regressor;
+    float measure1, measure2;
+};
+
+struct GridJobs
+{
+    vector<GridFold> folds;
+    vector<GridTask> tasks;
+    ivec parallelTasks;
+    QAtomicInt nextTask, doneCount;
+
+    ~GridJobs()
+    {
+        FOR(t, tasks.size())
+        {
+            DEL(tasks[t].classifier);
+            DEL(tasks[t].regressor);
+        }
+    }
+
+    void Run(int t);
+};
+
+class GridWorker : public QRunnable
+{
+    GridJobs *jobs;
+public:
+    GridWorker(GridJobs *jobs) : jobs(jobs) {}
+    void run()
+    {
+        int t;
+        while((t = jobs->nextTask.fetchAndAddOrdered(1)) < (int)jobs->parallelTasks.size())
+        {
+            jobs->Run(jobs->parallelTasks[t]);
+        }
+    }
+};
+
+// computes the classification error and f-measure of c on the test set of the fold
+static void EvaluateClassifier(Classifier *c, const GridFold &fold, int trainCount, float &error, float &fmeasure)
+{
+    vector<fvec> trainSamples(fold.trainSamples.begin(), fold.trainSamples.begin() + trainCount);
+    if(c->IsMultiClass()) c->Train(trainSamples, ivec(fold.trainLabels.begin(), fold.trainLabels.begin() + trainCount));
+    else c->Train(trainSamples, ivec(fold.trainBinLabels.begin(), fold.trainBinLabels.begin() + trainCount));
+    const vector<fvec> &testSamples = fold.testSamples;
+    const ivec &testLabels = fold.testLabels;
+    const ivec &testBinLabels = fold.testBinLabels;
+    float invError=0;
+    error = 0;
+    bool bBinary = false;
+    rocData rocdata;
+    // the whole test set is evaluated in a single batch
+    int testDim = testSamples.size() ? testSamples[0].size() : 0;
+    fvec testMatrix = flatten(testSamples, testDim);
+    fvec testResults;
+    int resDim = 1;
+    if(!testSamples.size());
+    else if(c->IsMultiClass()) resDim = c->TestMultiBatch(&testMatrix[0], testSamples.size(), testDim, testResults);
+    else
+    {
+        testResults.resize(testSamples.size());
+        c->TestBatch(&testMatrix[0], testSamples.size(), testDim, &testResults[0]);
+    }
+    FOR(i, testSamples.size())
+    {
+        if(c->IsMultiClass())
+        {
+            if(!resDim) continue;
+            const float *res = &testResults[i*resDim];
+            if(resDim == 1)
+            {
+                bBinary = true;
+                // we use invError because we don't know in which order the classifier
+                // has learned the classes, and which has become the de facto positive class
+                if(res[0] * testBinLabels[i] < 0) error += 1.f;
+                else invError += 1.f;
+                rocdata.push_back(f32pair(res[0], (testBinLabels[i]+1)/2));
+            }
+            else
+            {
+
+                int winner = 0;
+                float score = res[0];
+                FOR(j, resDim)
+                {
+                    if(res[j] > score)
+                    {
+                        score = res[j];
+                        winner = j;
+                    }
+                }
+                if(winner != testLabels[i]) error += 1.f;
+                rocdata.push_back(f32pair(winner, testLabels[i]));
+            }
+        }
+        else
+        {
+            bBinary = true;
+            float res = testResults[i];
+            if(res * testBinLabels[i] < 0) error += 1.f;
+            else invError += 1.f;
+            rocdata.push_back(f32pair(res, (testBinLabels[i]+1)/2));
+        }
+    }
+    rocdata = FixRocData(rocdata);
+    if(bBinary) error = min(error, invError);
+    error /= testSamples.size();
+    // we use micro f-measure for multi-class
+    fmeasure = bBinary ? GetRocValueAt(rocdata, 0) : GetMicroMacroFMeasure(rocdata).first;
+}
+
+// computes the mean absolute error of r on the test set of the fold
+static float EvaluateRegressor(Regressor *r, const GridFold &fold, int trainCount)
+{
+    vector<fvec> trainSamples(fold.trainSamples.begin(), fold.trainSamples.begin() + trainCount);
+    r->Train(trainSamples, ivec(fold.trainLabels.begin(), fold.trainLabels.begin() + trainCount));
+    const vector<fvec> &testSamples = fold.testSamples;
+    int outputDim = testSamples.size() ? testSamples[0].size()-1 : 0;
+    float error = 0;
+    FOR(i, testSamples.size())
+    {
+        fvec res = r->Test(testSamples[i]);
+        error += fabs(res[0] - testSamples[i][outputDim]);
+    }
+    return testSamples.size() ? error / testSamples.size() : 0;
+}
+
+void GridJobs::Run(int t)
+{
+    GridTask &task = tasks[t];
+    const GridFold &fold = folds[task.fold];
+    task.measure2 = 0;
+    if(task.classifier) EvaluateClassifier(task.classifier, fold, task.trainCount, task.measure1, task.measure2);
+    else if(task.regressor) task.measure1 = EvaluateRegressor(task.regressor, fold, task.trainCount);
+    // the trained models are not needed anymore, we don't keep a whole grid of them around
+    DEL(task.classifier);
+    DEL(task.regressor);
+    doneCount.fetchAndAddOrdered(1);
+}
+
+// evaluates every parameter set of cellParams by cross-validation, with the cells and folds trained in parallel.
+// With successive halving, all the cells first get a single fold and a fraction of the training data,
+// and only the best third of them moves on to the next round, until the survivors get all the data and all the folds.
+// The cells that are dropped early keep the score they had in their last round.
+void GridSearch::RunGrid(const vector<fvec> &cellParams, const vector<fvec> &samples, const ivec &labels,
+                         float trainRatio, int folds, bool bHalving, fvec &measure1Map, fvec &measure2Map)
+{
+    const int halvingRate = 3;
+    const int halvingMinSamples = 20;
+    int cellCount = cellParams.size();
+    int trainCount = (int)(trainRatio * samples.size());
+    ivec binLabels = toBinary(labels);
+
+    // the folds are the same for all the cells
+    GridJobs jobs;
+    jobs.folds.resize(folds);
+    u32 *perm = randPerm(samples.size());
+    FOR(f, folds)
+    {
+        GridFold &fold = jobs.folds[f];
+        int foldOffset = (f*samples.size()/folds);
+        FOR(i, samples.size())
+        {
+            int index = perm[(foldOffset + i) % samples.size()];
+            if((int)i < trainCount)
+            {
+                fold.trainSamples.push_back(samples[index]);
+                fold.trainLabels.push_back(labels[index]);
+                fold.trainBinLabels.push_back(binLabels[index]);
+            }
+            else
+            {
+                fold.testSamples.push_back(samples[index]);
+                fold.testLabels.push_back(labels[index]);
+                fold.testBinLabels.push_back(binLabels[index]);
+            }
+        }
+    }
+    KILL(perm);
+
+    int rounds = 0;
+    if(bHalving)
+    {
+        int budget = halvingRate;
+        while(budget <= cellCount && trainCount / budget >= halvingMinSamples)
+        {
+            rounds++;
+            budget *= halvingRate;
+        }
+    }
+    int taskCount = 0;
+    for(int r=0, alive=cellCount; r<=rounds; r++, alive = (alive + halvingRate - 1) / halvingRate)
+    {
+        taskCount += alive * (r == rounds ? folds : 1);
+    }
+    ui->progressBar->setMaximum(taskCount);
+    int progressOffset = 0;
+
+    ivec aliveCells(cellCount);
+    FOR(i, cellCount) aliveCells[i] = i;
+    FOR(r, rounds+1)
+    {
+        bool bLast = (int)r == rounds;
+        int roundFolds = bLast ? folds : 1;
+        int roundTrainCount = trainCount;
+        FOR(i, rounds-r) roundTrainCount /= halvingRate;
+
+        // the models are created here as the interfaces read their parameters from the gui
+        jobs.tasks.clear();
+        jobs.parallelTasks.clear();
+        jobs.nextTask.store(0);
+        jobs.doneCount.store(0);
+        ivec serialTasks;
+        FOR(i, aliveCells.size())
+        {
+            FOR(f, roundFolds)
+            {
+                GridTask task;
+                task.cell = aliveCells[i];
+                task.fold = f;
+                task.trainCount = roundTrainCount;
+                task.classifier = 0;
+                task.regressor = 0;
+                task.measure1 = task.measure2 = 0;
+                bool bConcurrent = false;
+                if(classifier)
+                {
+                    task.classifier = classifier->GetClassifier();
+                    classifier->SetParams(task.classifier, cellParams[task.cell]);
+                    bConcurrent = task.classifier->CanTrainConcurrently();
+                }
+                else if(regressor)
+                {
+                    task.regressor = regressor->GetRegressor();
+                    regressor->SetParams(task.regressor, cellParams[task.cell]);
+                    task.regressor->SetOutputDim(samples[0].size()-1);
+                }
+                if(bConcurrent) jobs.parallelTasks.push_back(jobs.tasks.size());
+                else serialTasks.push_back(jobs.tasks.size());
+                jobs.tasks.push_back(task);
+            }
+        }
+
+        // as in Compare, the cores are split between the cells trained at once, and the
+        // models that cannot be trained concurrently wait for the pool to be done
+        int idealCount = QThread::idealThreadCount();
+        int threadCount = min(idealCount, (int)jobs.parallelTasks.size());
+        FOR(t, jobs.parallelTasks.size()) jobs.tasks[jobs.parallelTasks[t]].classifier->SetThreadCount(max(1, idealCount / threadCount));
+        QThreadPool pool;
+        FOR(t, threadCount) pool.start(new GridWorker(&jobs));
+        while(!pool.waitForDone(40))
+        {
+            ui->progressBar->setValue(progressOffset + jobs.doneCount.load());
+            qApp->processEvents(QEventLoop::ExcludeUserInputEvents);
+        }
+        FOR(t, serialTasks.size())
+        {
+            jobs.Run(serialTasks[t]);
+            ui->progressBar->setValue(progressOffset + jobs.doneCount.load());
+            qApp->processEvents(QEventLoop::ExcludeUserInputEvents);
+        }
+        progressOffset += jobs.tasks.size();
+
+        // now we fill the error maps with the mean over the folds
+        FOR(i, aliveCells.size())
+        {
+            float measure1Mean = 0, measure2Mean = 0;
+            FOR(f, roundFolds)
+            {
+                measure1Mean += jobs.tasks[i*roundFolds + f].measure1;
+                measure2Mean += jobs.tasks[i*roundFolds + f].measure2;
+            }
+            measure1Map[aliveCells[i]] = measure1Mean / roundFolds;
+            measure2Map[aliveCells[i]] = measure2Mean / roundFolds;
+        }
+        if(bLast) break;
+
+        // and we keep the cells with the lowest error for the next round
+        vector< pair<float,int> > ranking(aliveCells.size());
+        FOR(i, aliveCells.size()) ranking[i] = make_pair(measure1Map[aliveCells[i]], aliveCells[i]);
+        sort(ranking.begin(), ranking.end());
+        aliveCells.resize((aliveCells.size() + halvingRate - 1) / halvingRate);
+        FOR(i, aliveCells.size()) aliveCells[i] = ranking[i].second;
+        sort(aliveCells.begin(), aliveCells.end());
+    }
+}
+
 void GridSearch::Run()
 {
     mapList.clear();
@@ -404,7 +709,6 @@ void GridSearch::Run()
     float trainRatio = 0.66;
     vector<fvec> samples = canvas->data->GetSamples();
     ivec labels = canvas->data->GetLabels();
-    ivec binLabels = toBinary(labels);
     ui->progressBar->setValue(0);
     ui->progressBar->setMaximum(xSteps*ySteps);
     int w = 0;
@@ -439,127 +743,35 @@ void GridSearch::Run()
         canvas->data->GetReward()->SetReward(rewardData, size, low, high);
     }
 
-    u32 *perm = randPerm(samples.size());
     fvec measure1Map(xSteps*ySteps);
     fvec measure2Map(xSteps*ySteps);
     fvec measure3Map(xSteps*ySteps);
-    FOR(y, ySteps)
+    if(classifier || regressor)
     {
-        FOR(x, xSteps)
+        if(!samples.size()) return;
+        vector<fvec> cellParams(xSteps*ySteps, params);
+        FOR(y, ySteps)
         {
-            if(!bNone1) params[xIndex] = x / (float) (xSteps-1) * (xMax - xMin) + xMin;
-            if(!bNone2) params[yIndex] = y / (float) (ySteps-1) * (yMax - yMin) + yMin;
-            int trainCount = (int)(trainRatio * samples.size());
-            vector<fvec> trainSamples(trainCount);
-            ivec trainLabels(trainCount);
-            ivec trainBinLabels(trainCount);
-            vector<fvec> testSamples(samples.size()-trainCount);
-            ivec testLabels(samples.size()-trainCount);
-            ivec testBinLabels(samples.size()-trainCount);
-            fvec measure1(folds, 0);
-            fvec measure2(folds, 0);
-            fvec measure3(folds, 0);
-            FOR(f, folds)
+            FOR(x, xSteps)
             {
-                int foldOffset = (f*samples.size()/folds);
-                FOR(i, samples.size())
-                {
-                    if(i < trainCount)
-                    {
-                        trainSamples[i] = samples[perm[(foldOffset + i) % samples.size()]];
-                        trainLabels[i] = labels[perm[(foldOffset + i) % labels.size()]];
-                        trainBinLabels[i] = binLabels[perm[(foldOffset + i) % labels.size()]];
-                    }
-                    else
-                    {
-                        testSamples[i-trainCount] = samples[perm[(foldOffset + i) % samples.size()]];
-                        testLabels[i-trainCount] = labels[perm[(foldOffset + i) % labels.size()]];
-                        testBinLabels[i-trainCount] = binLabels[perm[(foldOffset + i) % labels.size()]];
-                    }
-                }
-
-                if(classifier)
-                {
-                    if(!samples.size()) return;
-                    Classifier *c = classifier->GetClassifier();
-                    classifier->SetParams(c, params);
-                    if(c->IsMultiClass()) c->Train(trainSamples, trainLabels);
-                    else c->Train(trainSamples, trainBinLabels);
-                    float error=0, invError=0;
-                    bool bBinary = false;
-                    rocData rocdata;
-                    FOR(i, testSamples.size())
-                    {
-                        if(c->IsMultiClass())
-                        {
-                            fvec res = c->TestMulti(testSamples[i]);
-                            if(res.size() == 1)
-                            {
-                                bBinary = true;
-                                // we use invError because we don't know in which order the classifier
-                                // has learned the classes, and which has become the de facto positive class
-                                if(res[0] * testBinLabels[i] < 0) error += 1.f;
-                                else invError += 1.f;
-                                rocdata.push_back(f32pair(res[0], (testBinLabels[i]+1)/2));
-                            }
-                            else
-                            {
-
-                                int winner = 0;
-                                float score = res[0];
-                                FOR(j, res.size())
-                                {
-                                    if(res[j] > score)
-                                    {
-                                        score = res[j];
-                                        winner = j;
-                                    }
-                                }
-                                if(winner != testLabels[i]) error += 1.f;
-                                rocdata.push_back(f32pair(winner, testLabels[i]));
-                            }
-                        }
-                        else
-                        {
-                            bBinary = true;
-                            float res = c->Test(testSamples[i]);
-                            if(res * testBinLabels[i] < 0) error += 1.f;
-                            else invError += 1.f;
-                            rocdata.push_back(f32pair(res, (testBinLabels[i]+1)/2));
-                        }
-                    }
-                    rocdata = FixRocData(rocdata);
-                    if(bBinary) error = min(error, invError);
-                    error /= testSamples.size();
-                    measure1[f] = error;
-                    // we use micro f-measure for multi-class
-                    float eff = bBinary ? GetRocValueAt(rocdata, 0) : GetMicroMacroFMeasure(rocdata).first;
-                    measure2[f] = eff;
-                    DEL(c);
-                }
-                else if(clusterer);
-                else if(regressor)
-                {
-                    if(!samples.size()) return;
-                    Regressor *r = regressor->GetRegressor();
-                    regressor->SetParams(r, params);
-                    int outputDim = samples[0].size()-1;
-                    r->SetOutputDim(outputDim);
-                    r->Train(trainSamples, trainLabels);
-                    float error = 0;
-                    FOR(i, testSamples.size())
-                    {
-                        fvec res = r->Test(testSamples[i]);
-                        // we compute the mse
-                        error += sqrtf((res[0] - trainSamples[i][outputDim])*(res[0] - trainSamples[i][outputDim]));
-                    }
-                    error /= testSamples.size();
-                    measure1[f] = error;
-                    delete r;
-                }
-                else if(dynamical);
-                else if(avoider);
-                else if(maximizer)
+                if(!bNone1) cellParams[x+y*xSteps][xIndex] = x / (float) (xSteps-1) * (xMax - xMin) + xMin;
+                if(!bNone2) cellParams[x+y*xSteps][yIndex] = y / (float) (ySteps-1) * (yMax - yMin) + yMin;
+            }
+        }
+        RunGrid(cellParams, samples, labels, trainRatio, folds, ui->halvingCheck->isChecked(), measure1Map, measure2Map);
+    }
+    else if(maximizer)
+    {
+        FOR(y, ySteps)
+        {
+            FOR(x, xSteps)
+            {
+                if(!bNone1) params[xIndex] = x / (float) (xSteps-1) * (xMax - xMin) + xMin;
+                if(!bNone2) params[yIndex] = y / (float) (ySteps-1) * (yMax - yMin) + yMin;
+                fvec measure1(folds, 0);
+                fvec measure2(folds, 0);
+                fvec measure3(folds, 0);
+                FOR(f, folds)
                 {
                     fvec startingPoint(2);
                     if(canvas->targets.size())
@@ -596,32 +808,26 @@ void GridSearch::Run()
                     measure3[f] = evals;
                     delete m;
                 }
-                else if(reinforcement)
-                    ;
-                else if(projector)
-                    ;
-            }
-            // now we fill the error map
-            float measure1Mean = 0, measure2Mean = 0, measure3Mean = 0;
-            FOR(f, folds)
-            {
-                measure1Mean += measure1[f];
-                measure2Mean += measure2[f];
-                measure3Mean += measure3[f];
+                // now we fill the error map
+                float measure1Mean = 0, measure2Mean = 0, measure3Mean = 0;
+                FOR(f, folds)
+                {
+                    measure1Mean += measure1[f];
+                    measure2Mean += measure2[f];
+                    measure3Mean += measure3[f];
+                }
+                measure1Mean /= folds;
+                measure2Mean /= folds;
+                measure3Mean /= folds;
+                measure1Map[x+y*xSteps] = measure1Mean;
+                measure2Map[x+y*xSteps] = measure2Mean;
+                measure3Map[x+y*xSteps] = measure3Mean;
+                ui->progressBar->setValue(x+y*xSteps);
+                ui->progressBar->repaint();
+                qApp->processEvents(QEventLoop::ExcludeUserInputEvents);
             }
-            measure1Mean /= folds;
-            measure2Mean /= folds;
-            measure3Mean /= folds;
-            //qDebug() << "mean" << mean << "fmeasure" << effMean;
-            measure1Map[x+y*xSteps] = measure1Mean;
-            measure2Map[x+y*xSteps] = measure2Mean;
-            measure3Map[x+y*xSteps] = measure3Mean;
-            ui->progressBar->setValue(x+y*xSteps);
-            ui->progressBar->repaint();
-            qApp->processEvents(QEventLoop::ExcludeUserInputEvents);
         }
     }
-    KILL(perm);
     KILL(rewardData);
 
     if(classifier)
@@ -60,6 +60,8 @@ protected:
 private:
     fPair GetParamsRange();
     void DisplayResults();
+    void RunGrid(const std::vector<fvec> &cellParams, const std::vector<fvec> &samples, const ivec &labels,
+                 float trainRatio, int folds, bool bHalving, fvec &measure1Map, fvec &measure2Map);
 
 signals:
     void Hiding();
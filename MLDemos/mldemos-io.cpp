@@ -23,21 +23,21 @@ Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
 void MLDemos::SaveData()
 {
     if (!canvas) return;
-    QString filename = QFileDialog::getSaveFileName(this, tr("Save Data"), "", tr("ML Files (*.ml)"));
+    QString filename = QFileDialog::getSaveFileName(this, tr("Save Data"), "", tr("ML Files (*.ml);;ML Binary Files (*.mlb)"));
     if (filename.isEmpty()) return;
-    if (!filename.endsWith(".ml")) filename += ".ml";
+    if (!filename.endsWith(".ml") && !filename.endsWith(".mlb")) filename += ".ml";
     Save(filename);
 }
 void MLDemos::Save(QString filename)
 {
-    QFile file(filename);
-    if (!file.open(QIODevice::WriteOnly)) {
+    if (!canvas->maps.reward.isNull()) RewardFromMap(canvas->maps.reward.toImage());
+    // the dataset opens the file itself, it may be the one it is reading its samples from
+    bool bSaved = filename.endsWith(".mlb") ? canvas->data->SaveBinary(filename.toLatin1())
+                                            : canvas->data->Save(filename.toLatin1());
+    if (!bSaved) {
         ui.statusBar->showMessage("WARNING: Unable to save file");
         return;
     }
-    file.close();
-    if (!canvas->maps.reward.isNull()) RewardFromMap(canvas->maps.reward.toImage());
-    canvas->data->Save(filename.toLatin1());
     SaveParams(filename);
     ui.statusBar->showMessage("Data saved successfully");
 }
@@ -45,9 +45,9 @@ void MLDemos::Save(QString filename)
 void MLDemos::LoadData()
 {
     if (!canvas) return;
-    QString filename = QFileDialog::getOpenFileName(this, tr("Load Data"), "", tr("ML Files (*.ml)"));
+    QString filename = QFileDialog::getOpenFileName(this, tr("Load Data"), "", tr("ML Files (*.ml *.mlb)"));
     if (filename.isEmpty()) return;
-    if (!filename.endsWith(".ml")) filename += ".ml";
+    if (!filename.endsWith(".ml") && !filename.endsWith(".mlb")) filename += ".ml";
     Load(filename);
 }
 
@@ -60,7 +60,9 @@ void MLDemos::Load(QString filename)
     }
     file.close();
     ClearData();
-    canvas->data->Load(filename.toLatin1());
+    // binary datasets are recognized by their magic bytes, whatever their extension
+    if (DatasetManager::IsBinary(filename.toLatin1())) canvas->data->LoadBinary(filename.toLatin1());
+    else canvas->data->Load(filename.toLatin1());
     MapFromReward();
     LoadParams(filename);
     //    QImage reward(filename + "-reward.png");
@@ -104,7 +106,7 @@ void MLDemos::dragEnterEvent(QDragEnterEvent *event)
     if (event->mimeData()->hasUrls()) {
         QList<QUrl> urls = event->mimeData()->urls();
         QStringList dataType;
-        dataType << ".ml" << ".csv" << ".data";
+        dataType << ".ml" << ".mlb" << ".csv" << ".data";
         for (int i=0; i<urls.size(); i++) {
             QString filename = urls[i].path();
             for (int j=0; j < dataType.size(); j++) {
@@ -127,16 +129,9 @@ void MLDemos::dropEvent(QDropEvent *event)
     {
         QString filename = event->mimeData()->urls()[i].toLocalFile();
         qDebug() << "accepted drop file:" << filename;
-        if (filename.toLower().endsWith(".ml"))
+        if (filename.toLower().endsWith(".ml") || filename.toLower().endsWith(".mlb"))
         {
-            ClearData();
-            canvas->data->Load(filename.toLatin1());
-            MapFromReward();
-            LoadParams(filename);
-            ui.statusBar->showMessage("Data loaded successfully");
-            ResetPositiveClass();
-            UpdateInfo();
-            canvas->repaint();
+            Load(filename);
         }
         else if (filename.toLower().endsWith(".csv") || filename.toLower().endsWith(".data"))
         {
@@ -465,7 +465,9 @@ void MLDemos::SaveParams( QString filename )
     QTextStream out(&file);
     if(!file.isOpen()) return;
 
-    if(!canvas->data->GetCount()) out << "0 2\n";
+    // binary datasets get the parameters appended as text, without samples
+    bool bBinary = DatasetManager::IsBinary(filename.toLatin1());
+    if(!canvas->data->GetCount() || bBinary) out << "0 2\n";
     char groupName[255];
 
     if(canvas->dimNames.size())
@@ -631,8 +633,10 @@ void MLDemos::LoadParams( QString filename )
 {
     QFile file(filename);
     file.open(QFile::ReadOnly);
-    QTextStream in(&file);
     if(!file.isOpen()) return;
+    // the parameters of binary datasets follow the binary data
+    if(DatasetManager::IsBinary(filename.toLatin1())) file.seek(DatasetManager::GetBinarySize(filename.toLatin1()));
+    QTextStream in(&file);
 
     int sampleCnt, size;
     in >> sampleCnt;
@@ -31,7 +31,10 @@ HEADERS += basicMath.h \
     maximize.h \
     reinforcement.h \
     dynamical.h \
-    clusterer.h
+    clusterer.h \
+    projector.h
 
 SOURCES += \
     main.cpp
+
+win32:LIBS += -lpsapi
@@ -18,127 +18,812 @@ License along with this library; if not, write to the Free
 Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
 *********************************************************************/
 #include <public.h>
+#include <basicMath.h>
 #include <interfaces.h>
 #include <classifier.h>
 #include <regressor.h>
+#include <clusterer.h>
+#include <projector.h>
 #include <datasetManager.h>
+#include <parser.h>
 
-#include <QtGui/QApplication>
+#include <QApplication>
 #include <QtPlugin>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QTextStream>
+#include <QElapsedTimer>
+#include <QPluginLoader>
+#include <QThread>
+#include <QThreadPool>
+#include <QRunnable>
+#include <QAtomicInt>
+#include <algorithm>
+
+#if defined(Q_OS_WIN)
+#include <windows.h>
+#include <psapi.h>
+#elif defined(Q_OS_MAC)
+#include <mach/mach.h>
+#else
+#include <unistd.h>
+#include <stdio.h>
+#endif
 
 using namespace std;
 
 map<QString,ClassifierInterface*> classifierInterfaces;
+map<QString,RegressorInterface*> regressorInterfaces;
+map<QString,ClustererInterface*> clustererInterfaces;
+map<QString,ProjectorInterface*> projectorInterfaces;
 vector<QPluginLoader*> pluginLoaders;
 void LoadPlugins();
 
-int main(int argc, char *argv[])
+enum BenchmarkType {BENCH_CLASSIFIER, BENCH_REGRESSOR, BENCH_CLUSTERER, BENCH_PROJECTOR};
+const char *benchmarkTypeNames[] = {"classifier", "regressor", "clusterer", "projector"};
+
+struct BenchmarkAlgorithm
 {
-	QApplication a(argc, argv);
+    BenchmarkType type;
+    QString name;
+    fvec parameters; // empty: the defaults of the plugin widget are used
+};
 
-    // we start by loading all plugins
-    LoadPlugins();
+struct BenchmarkResult
+{
+    BenchmarkType type;
+    QString name, dataset;
+    int fold, threads;
+    int trainCount, testCount;
+    double trainTime; // ms
+    double latency50, latency90, latency99; // us per sample
+    double throughput; // samples per second
+    long long baseMemory, peakMemory; // kB, resident size of the process before the run and its peak during the run
+    QString metric;
+    double score;
+};
+
+// current resident set size of the process, in kB
+long long CurrentMemory()
+{
+#if defined(Q_OS_WIN)
+    PROCESS_MEMORY_COUNTERS counters;
+    if(!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) return 0;
+    return counters.WorkingSetSize / 1024;
+#elif defined(Q_OS_MAC)
+    mach_task_basic_info info;
+    mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+    if(task_info(mach_task_self(), MACH_TASK_BASIC_INFO, (task_info_t)&info, &count) != KERN_SUCCESS) return 0;
+    return info.resident_size / 1024;
+#else
+    FILE *file = fopen("/proc/self/statm", "r");
+    if(!file) return 0;
+    long long pages = 0, resident = 0;
+    if(fscanf(file, "%lld %lld", &pages, &resident) != 2) resident = 0;
+    fclose(file);
+    return resident * (sysconf(_SC_PAGESIZE) / 1024);
+#endif
+}
+
+#if defined(Q_OS_LINUX)
+// writing 5 to clear_refs resets the peak resident size of the process (VmHWM) to its current size
+bool ResetPeakMemory()
+{
+    FILE *file = fopen("/proc/self/clear_refs", "w");
+    if(!file) return false;
+    bool bReset = fputs("5", file) >= 0;
+    if(fclose(file)) bReset = false;
+    return bReset;
+}
 
-    if(argc == 1) // we just list the algorithms
+// peak resident size of the process since the last reset, in kB
+long long PeakMemory()
+{
+    FILE *file = fopen("/proc/self/status", "r");
+    if(!file) return 0;
+    char line[256];
+    long long peak = 0;
+    while(fgets(line, sizeof(line), file))
     {
-        printf("Usage: .... \n");
+        if(sscanf(line, "VmHWM: %lld", &peak) == 1) break;
+    }
+    fclose(file);
+    return peak;
+}
+#endif
 
-        printf("Algorithms \n");
-        printf("---------- \n");
-        printf("name \t:\t[param1] [param2] ... \n");
-        printf("\n");
-        for (map<QString,ClassifierInterface*>::iterator it = classifierInterfaces.begin(); it != classifierInterfaces.end(); it++)
+// the peak resident size of the process during one run. On linux the kernel keeps it (VmHWM) and
+// it is reset at the start of the run; elsewhere, or if it cannot be reset, the resident size is
+// polled every millisecond from a separate thread
+class MemorySampler : public QThread
+{
+    QAtomicInt bSampling;
+    long long peak;
+    bool bHighWaterMark;
+public:
+    MemorySampler() : bSampling(0), peak(0), bHighWaterMark(false) {}
+    void Begin()
+    {
+        peak = CurrentMemory();
+#if defined(Q_OS_LINUX)
+        bHighWaterMark = ResetPeakMemory();
+        if(bHighWaterMark) return;
+#endif
+        bSampling.store(1);
+        start();
+    }
+    long long End()
+    {
+#if defined(Q_OS_LINUX)
+        if(bHighWaterMark) return max(peak, PeakMemory());
+#endif
+        bSampling.store(0);
+        wait();
+        return max(peak, CurrentMemory());
+    }
+protected:
+    void run()
+    {
+        while(bSampling.load())
         {
-            printf("%s\t:\t", it->first.toLatin1().data());
-            std::vector<QString> pNames;
-            std::vector<QString> pTypes;
-            std::vector< std::vector<QString> > pValues;
-            it->second->GetParameterList(pNames, pTypes, pValues);
-            FOR(i, pNames.size()) printf("[%s] ", pNames[i].toLatin1().data());
-            printf("\n");
+            peak = max(peak, CurrentMemory());
+            msleep(1);
         }
-        fflush(stdout);
-        //return -1;
     }
+};
 
-    // we get the datasets filenames
-    QString filename1, filename2;
+double Percentile(const vector<double> &sorted, double p)
+{
+    if(!sorted.size()) return 0;
+    int index = min((int)sorted.size()-1, (int)(p*sorted.size()));
+    return sorted[index];
+}
 
+void SetLatencies(BenchmarkResult &result, vector<double> &latencies)
+{
+    sort(latencies.begin(), latencies.end());
+    result.latency50 = Percentile(latencies, 0.5);
+    result.latency90 = Percentile(latencies, 0.9);
+    result.latency99 = Percentile(latencies, 0.99);
+}
 
-    // we get the data (training and testing)
-    DatasetManager dataset1, dataset2;
-    dataset1.Load(filename1.toLatin1().data());
-    dataset2.Load(filename2.toLatin1().data());
-    vector<fvec> trainSamples = dataset1.GetSamples();
-    ivec trainLabels = dataset1.GetLabels();
-    vector<fvec> testSamples = dataset2.GetSamples();
-    ivec testLabels = dataset2.GetLabels();
+fvec Flatten(const vector<fvec> &samples)
+{
+    if(!samples.size()) return fvec();
+    int dim = samples[0].size();
+    fvec matrix(samples.size()*dim);
+    FOR(i, samples.size()) FOR(d, dim) matrix[i*dim + d] = samples[i][d];
+    return matrix;
+}
 
-    if(!trainSamples.size() && !testSamples.size())
+// slice of a batched classifier test, run on its own thread
+class BatchWorker : public QRunnable
+{
+    const Classifier *classifier;
+    const float *matrix;
+    int start, count, dim;
+    float *out;
+    fvec *multiOut;
+public:
+    BatchWorker(const Classifier *classifier, const float *matrix, int start, int count, int dim, float *out, fvec *multiOut)
+        : classifier(classifier), matrix(matrix), start(start), count(count), dim(dim), out(out), multiOut(multiOut) {}
+    void run()
     {
-        qDebug() << "no samples to train or test!";
-        return -1;
+        if(multiOut) classifier->TestMultiBatch(matrix + start*dim, count, dim, *multiOut);
+        else classifier->TestBatch(matrix + start*dim, count, dim, out + start);
     }
+};
 
-    // toy example!
-    QString name = "GMM";
-    int param1 = 4; // 4 gaussiennes
+bool IsError(float response, int label)
+{
+    return response > 0 ? label < 1 : label > 0;
+}
+
+void RunClassifier(ClassifierInterface *interface, const BenchmarkAlgorithm &algorithm, int threads,
+                   const vector<fvec> &trainSamples, const ivec &trainLabels,
+                   const vector<fvec> &testSamples, const ivec &testLabels, BenchmarkResult &result)
+{
+    Classifier *classifier = interface->GetClassifier();
+    if(algorithm.parameters.size()) interface->SetParams(classifier, algorithm.parameters);
+    else interface->SetParams(classifier);
+
+    QElapsedTimer timer;
+    timer.start();
+    classifier->Train(trainSamples, trainLabels);
+    result.trainTime = timer.nsecsElapsed()*1e-6;
 
-    // we get the algorithm and the parameters
-    if(!classifierInterfaces.count(name))
+    int count = testSamples.size();
+    int dim = count ? testSamples[0].size() : 0;
+    bool bMulti = classifier->IsMultiClass();
+    vector<double> latencies(count);
+    FOR(i, count)
     {
-        qDebug() << "cannot find algorithm, sorry.";
-        return -1;
+        timer.restart();
+        if(bMulti) classifier->TestMulti(testSamples[i]);
+        else classifier->Test(testSamples[i]);
+        latencies[i] = timer.nsecsElapsed()*1e-3;
     }
-    ClassifierInterface *interface = classifierInterfaces[name];
-    Classifier *classifier = interface->GetClassifier();
+    SetLatencies(result, latencies);
+
+    // throughput goes through the batched path, split across threads when the model allows it
+    if(!classifier->IsThreadSafe()) threads = 1;
+    threads = max(1, min(threads, count));
+    result.threads = threads;
+    fvec matrix = Flatten(testSamples);
+    fvec responses(count);
+    vector<fvec> multiResponses(threads);
+    timer.restart();
+    if(count)
+    {
+        QThreadPool pool;
+        pool.setMaxThreadCount(threads);
+        int slice = (count + threads - 1) / threads;
+        FOR(t, threads)
+        {
+            int start = t*slice;
+            int length = min(slice, count - start);
+            if(length <= 0) break;
+            BatchWorker *worker = new BatchWorker(classifier, &matrix[0], start, length, dim,
+                                                  &responses[0], bMulti ? &multiResponses[t] : 0);
+            if(threads == 1)
+            {
+                worker->run();
+                delete worker;
+            }
+            else pool.start(worker);
+        }
+        pool.waitForDone();
+    }
+    double elapsed = timer.nsecsElapsed()*1e-9;
+    result.throughput = elapsed > 0 ? count / elapsed : 0;
 
-    fvec parameters;
-    parameters.push_back(param1);
-    interface->SetParams(classifier, parameters);
+    int errors = 0;
+    if(bMulti && count)
+    {
+        // each thread filled a (slice x resDim) block
+        int slice = (count + threads - 1) / threads;
+        int resDim = multiResponses[0].size() / min(slice, count);
+        FOR(i, count)
+        {
+            if(!resDim) break;
+            const float *res = &multiResponses[i / slice][(i % slice)*resDim];
+            if(resDim == 1)
+            {
+                if(IsError(res[0], testLabels[i])) errors++;
+                continue;
+            }
+            int maxClass = 0;
+            FOR(j, resDim) if(res[maxClass] < res[j]) maxClass = j;
+            if(classifier->inverseMap.count(maxClass)) maxClass = classifier->inverseMap[maxClass];
+            if(maxClass != testLabels[i]) errors++;
+        }
+    }
+    else
+    {
+        FOR(i, count) if(IsError(responses[i], testLabels[i])) errors++;
+    }
+    result.metric = "accuracy";
+    result.score = count ? 1. - errors / (double)count : 0;
+    delete classifier;
+}
 
-    // we do the training
-    classifier->Train(trainSamples, trainLabels);
+// the samples of a CSV file one chunk at a time, to models that learn from a stream (e.g. GMM
+// with a stream chunk size) and continue from one chunk to the next
+int StreamChunks(CSVParser *stream, Regressor *regressor, Clusterer *clusterer)
+{
+    int count = 0;
+    FOR(c, stream->getChunkCount())
+    {
+        pair<vector<fvec>,ivec> chunk = stream->getChunkData(c);
+        if(!chunk.first.size()) continue;
+        if(regressor)
+        {
+            regressor->SetOutputDim(chunk.first[0].size()-1);
+            regressor->Train(chunk.first, chunk.second);
+        }
+        if(clusterer) clusterer->Train(chunk.first);
+        count += chunk.first.size();
+    }
+    return count;
+}
+
+bool RunRegressor(RegressorInterface *interface, const BenchmarkAlgorithm &algorithm,
+                  const vector<fvec> &trainSamples, const ivec &trainLabels,
+                  const vector<fvec> &testSamples, BenchmarkResult &result, CSVParser *stream=0)
+{
+    Regressor *regressor = interface->GetRegressor();
+    if(algorithm.parameters.size()) interface->SetParams(regressor, algorithm.parameters);
+    else interface->SetParams(regressor);
+    if(stream && !regressor->IsStreaming())
+    {
+        // it would be refitted on each chunk and end up trained on the last one only
+        qDebug() << algorithm.name << "does not learn from a stream with these parameters, skipping";
+        delete regressor;
+        return false;
+    }
+    // the output is the last dimension of the dataset
+    if(trainSamples.size()) regressor->SetOutputDim(trainSamples[0].size()-1);
+
+    QElapsedTimer timer;
+    timer.start();
+    if(stream) result.trainCount = StreamChunks(stream, regressor, 0);
+    else regressor->Train(trainSamples, trainLabels);
+    result.trainTime = timer.nsecsElapsed()*1e-6;
+
+    int count = testSamples.size();
+    vector<double> latencies(count);
+    double error = 0;
+    QElapsedTimer total;
+    total.start();
+    FOR(i, count)
+    {
+        timer.restart();
+        fvec res = regressor->Test(testSamples[i]);
+        latencies[i] = timer.nsecsElapsed()*1e-3;
+        if(res.size())
+        {
+            float diff = res[0] - testSamples[i].back();
+            error += diff*diff;
+        }
+    }
+    double elapsed = total.nsecsElapsed()*1e-9;
+    SetLatencies(result, latencies);
+    result.threads = 1;
+    result.throughput = elapsed > 0 ? count / elapsed : 0;
+    result.metric = "rmse";
+    result.score = count ? sqrt(error / count) : 0;
+    delete regressor;
+    return true;
+}
+
+bool RunClusterer(ClustererInterface *interface, const BenchmarkAlgorithm &algorithm,
+                  const vector<fvec> &trainSamples, const vector<fvec> &testSamples, BenchmarkResult &result,
+                  CSVParser *stream=0)
+{
+    Clusterer *clusterer = interface->GetClusterer();
+    if(algorithm.parameters.size()) interface->SetParams(clusterer, algorithm.parameters);
+    else interface->SetParams(clusterer);
+    if(stream && !clusterer->IsStreaming())
+    {
+        qDebug() << algorithm.name << "does not learn from a stream with these parameters, skipping";
+        delete clusterer;
+        return false;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    if(stream)
+    {
+        clusterer->SetIterative(true);
+        result.trainCount = StreamChunks(stream, 0, clusterer);
+    }
+    else clusterer->Train(trainSamples);
+    result.trainTime = timer.nsecsElapsed()*1e-6;
+
+    int count = testSamples.size();
+    vector<double> latencies(count);
+    FOR(i, count)
+    {
+        timer.restart();
+        clusterer->Test(testSamples[i]);
+        latencies[i] = timer.nsecsElapsed()*1e-3;
+    }
+    SetLatencies(result, latencies);
+
+    fvec matrix = Flatten(testSamples);
+    timer.restart();
+    if(count) clusterer->TestMany(matrix, testSamples[0].size(), count);
+    double elapsed = timer.nsecsElapsed()*1e-9;
+    result.threads = 1;
+    result.throughput = elapsed > 0 ? count / elapsed : 0;
+    result.metric = "loglikelihood";
+    result.score = count ? clusterer->GetLogLikelihood(testSamples) : 0;
+    delete clusterer;
+    return true;
+}
 
-    int errors=0;
-    FOR(i, testSamples.size())
+void RunProjector(ProjectorInterface *interface, const BenchmarkAlgorithm &algorithm,
+                  const vector<fvec> &trainSamples, const ivec &trainLabels,
+                  const vector<fvec> &testSamples, BenchmarkResult &result)
+{
+    Projector *projector = interface->GetProjector();
+    if(algorithm.parameters.size()) interface->SetParams(projector, algorithm.parameters);
+    else interface->SetParams(projector);
+
+    QElapsedTimer timer;
+    timer.start();
+    projector->Train(trainSamples, trainLabels);
+    result.trainTime = timer.nsecsElapsed()*1e-6;
+
+    int count = testSamples.size();
+    vector<double> latencies(count);
+    QElapsedTimer total;
+    total.start();
+    FOR(i, count)
+    {
+        timer.restart();
+        projector->Project(testSamples[i]);
+        latencies[i] = timer.nsecsElapsed()*1e-3;
+    }
+    double elapsed = total.nsecsElapsed()*1e-9;
+    SetLatencies(result, latencies);
+    result.threads = 1;
+    result.throughput = elapsed > 0 ? count / elapsed : 0;
+    result.metric = "";
+    result.score = 0;
+    delete projector;
+}
+
+bool LoadDataset(DatasetManager &dataset, QString filename)
+{
+    QByteArray name = filename.toLocal8Bit();
+    if(DatasetManager::IsBinary(name.data())) return dataset.LoadBinary(name.data());
+    return dataset.Load(name.data());
+}
+
+// trains and tests the algorithm on each fold of the dataset (or on the separate test set)
+void RunBenchmark(const BenchmarkAlgorithm &algorithm, QString datasetName, DatasetManager &dataset,
+                  DatasetManager *testset, int folds, int threads, vector<BenchmarkResult> &results)
+{
+    vector<fvec> samples = dataset.GetSamples();
+    ivec labels = dataset.GetLabels();
+    int count = samples.size();
+    if(!count) return;
+    if(testset) folds = 1;
+    u32 *perm = randPerm(count);
+    FOR(f, folds)
     {
-        int label = testLabels[i];
-        if(classifier->IsMultiClass())
+        vector<fvec> trainSamples, testSamples;
+        ivec trainLabels, testLabels;
+        if(testset)
+        {
+            trainSamples = samples;
+            trainLabels = labels;
+            testSamples = testset->GetSamples();
+            testLabels = testset->GetLabels();
+        }
+        else if(folds == 1)
+        {
+            trainSamples = testSamples = samples;
+            trainLabels = testLabels = labels;
+        }
+        else
         {
-            fvec res = classifier->TestMulti(testSamples[i]);
-            if(res.size() == 1) // it's actually a binary classification
+            FOR(i, count)
             {
-                if (res[0] > 0)
+                int index = perm[i];
+                if((int)(i % folds) == f)
                 {
-                    if (label < 1) errors++;
+                    testSamples.push_back(samples[index]);
+                    testLabels.push_back(labels[index]);
                 }
                 else
                 {
-                    if (label > 0) errors++;
+                    trainSamples.push_back(samples[index]);
+                    trainLabels.push_back(labels[index]);
                 }
             }
-            else
-            {
-                int maxClass = 0;
-                FOR(j, res.size()) if (res[maxClass] < res[j]) maxClass = j;
-                if (maxClass != label) errors++;
-            }
-        } else {
-            float res = classifier->Test(testSamples[i]);
-            if (res > 0)
+        }
+
+        BenchmarkResult result;
+        result.type = algorithm.type;
+        result.name = algorithm.name;
+        result.dataset = datasetName;
+        result.fold = f;
+        result.threads = 1;
+        result.trainCount = trainSamples.size();
+        result.testCount = testSamples.size();
+        result.baseMemory = CurrentMemory();
+        MemorySampler memory;
+        memory.Begin();
+        switch(algorithm.type)
+        {
+        case BENCH_CLASSIFIER:
+            RunClassifier(classifierInterfaces[algorithm.name], algorithm, threads,
+                          trainSamples, trainLabels, testSamples, testLabels, result);
+            break;
+        case BENCH_REGRESSOR:
+            RunRegressor(regressorInterfaces[algorithm.name], algorithm, trainSamples, trainLabels, testSamples, result);
+            break;
+        case BENCH_CLUSTERER:
+            RunClusterer(clustererInterfaces[algorithm.name], algorithm, trainSamples, testSamples, result);
+            break;
+        case BENCH_PROJECTOR:
+            RunProjector(projectorInterfaces[algorithm.name], algorithm, trainSamples, trainLabels, testSamples, result);
+            break;
+        }
+        result.peakMemory = memory.End();
+        results.push_back(result);
+        fprintf(stderr, "%s %s on %s (fold %d): trained in %.1f ms\n", benchmarkTypeNames[algorithm.type],
+                algorithm.name.toLatin1().data(), datasetName.toLatin1().data(), f, result.trainTime);
+    }
+    delete [] perm;
+}
+
+// trains the regressors and clusterers on a CSV file read one chunk at a time, so that only one chunk
+// of the file is in memory at once. They are tested on the separate test set, or on the first chunk
+void RunStream(const BenchmarkAlgorithm &algorithm, QString fileName, DatasetManager *testset,
+               vector<BenchmarkResult> &results)
+{
+    if(algorithm.type != BENCH_REGRESSOR && algorithm.type != BENCH_CLUSTERER)
+    {
+        qDebug() << "only regressors and clusterers can be trained on a stream, skipping" << algorithm.name;
+        return;
+    }
+    CSVParser stream;
+    stream.setOutputColumn(-1); // the output of the regressors is the last column
+    stream.parse(fileName.toLocal8Bit().data());
+    if(!stream.hasData()) return;
+    vector< vector<string> > firstRow = stream.getRawData(1);
+    bool bHeader = false;
+    float value;
+    FOR(i, firstRow[0].size())
+    {
+        const string &cell = firstRow[0][i];
+        bHeader |= !CSVParser::parseFloat(cell.data(), cell.data()+cell.size(), value);
+    }
+    stream.setFirstRowAsHeader(bHeader);
+    vector<fvec> testSamples = testset ? testset->GetSamples() : stream.getChunkData(0).first;
+
+    BenchmarkResult result;
+    result.type = algorithm.type;
+    result.name = algorithm.name;
+    result.dataset = QFileInfo(fileName).fileName();
+    result.fold = 0;
+    result.threads = 1;
+    result.trainCount = 0;
+    result.testCount = testSamples.size();
+    result.baseMemory = CurrentMemory();
+    MemorySampler memory;
+    memory.Begin();
+    bool bStreamed;
+    if(algorithm.type == BENCH_REGRESSOR)
+    {
+        bStreamed = RunRegressor(regressorInterfaces[algorithm.name], algorithm, vector<fvec>(), ivec(), testSamples, result, &stream);
+    }
+    else bStreamed = RunClusterer(clustererInterfaces[algorithm.name], algorithm, vector<fvec>(), testSamples, result, &stream);
+    result.peakMemory = memory.End();
+    if(!bStreamed) return;
+    results.push_back(result);
+    fprintf(stderr, "%s %s streamed from %s: trained on %d samples in %.1f ms\n", benchmarkTypeNames[algorithm.type],
+            algorithm.name.toLatin1().data(), result.dataset.toLatin1().data(), result.trainCount, result.trainTime);
+}
+
+QString JsonString(QString s)
+{
+    s.replace("\\", "\\\\");
+    s.replace("\"", "\\\"");
+    return "\"" + s + "\"";
+}
+
+void WriteResults(QTextStream &out, const vector<BenchmarkResult> &results, bool bCsv)
+{
+    if(bCsv)
+    {
+        out << "type,algorithm,dataset,fold,threads,train_count,test_count,train_ms,"
+               "latency_p50_us,latency_p90_us,latency_p99_us,throughput,base_rss_kb,peak_rss_kb,metric,score\n";
+        FOR(i, results.size())
+        {
+            const BenchmarkResult &r = results[i];
+            out << benchmarkTypeNames[r.type] << "," << r.name << "," << r.dataset << "," << r.fold << ","
+                << r.threads << "," << r.trainCount << "," << r.testCount << "," << r.trainTime << ","
+                << r.latency50 << "," << r.latency90 << "," << r.latency99 << "," << r.throughput << ","
+                << r.baseMemory << "," << r.peakMemory << "," << r.metric << "," << r.score << "\n";
+        }
+        return;
+    }
+    out << "[\n";
+    FOR(i, results.size())
+    {
+        const BenchmarkResult &r = results[i];
+        out << "  {\"type\": " << JsonString(benchmarkTypeNames[r.type])
+            << ", \"algorithm\": " << JsonString(r.name)
+            << ", \"dataset\": " << JsonString(r.dataset)
+            << ", \"fold\": " << r.fold
+            << ", \"threads\": " << r.threads
+            << ", \"train_count\": " << r.trainCount
+            << ", \"test_count\": " << r.testCount
+            << ", \"train_ms\": " << r.trainTime
+            << ", \"latency_p50_us\": " << r.latency50
+            << ", \"latency_p90_us\": " << r.latency90
+            << ", \"latency_p99_us\": " << r.latency99
+            << ", \"throughput\": " << r.throughput
+            << ", \"base_rss_kb\": " << r.baseMemory
+            << ", \"peak_rss_kb\": " << r.peakMemory
+            << ", \"metric\": " << JsonString(r.metric)
+            << ", \"score\": " << r.score << "}" << (i+1 < results.size() ? ",\n" : "\n");
+    }
+    out << "]\n";
+}
+
+template <typename T>
+void PrintAlgorithms(const char *type, map<QString,T*> &interfaces)
+{
+    for (typename map<QString,T*>::iterator it = interfaces.begin(); it != interfaces.end(); it++)
+    {
+        printf("%s\t%s\t:\t", type, it->first.toLatin1().data());
+        std::vector<QString> pNames;
+        std::vector<QString> pTypes;
+        std::vector< std::vector<QString> > pValues;
+        it->second->GetParameterList(pNames, pTypes, pValues);
+        FOR(i, pNames.size()) printf("[%s] ", pNames[i].toLatin1().data());
+        printf("\n");
+    }
+}
+
+void PrintUsage()
+{
+    printf("Usage: mlscript [options]\n");
+    printf("  -c, --classifier NAME[:p1,p2,...]  benchmark a classifier (parameters as in SetParams)\n");
+    printf("  -r, --regressor NAME[:p1,p2,...]   benchmark a regressor (output is the last dimension)\n");
+    printf("  -k, --clusterer NAME[:p1,p2,...]   benchmark a clusterer\n");
+    printf("  -p, --projector NAME[:p1,p2,...]   benchmark a projector\n");
+    printf("  -d, --data FILE                    dataset (.ml or .mlb), can be repeated\n");
+    printf("  -s, --stream FILE                  CSV file fed one chunk at a time to the streaming regressors and clusterers\n");
+    printf("  -t, --test FILE                    separate test set, disables the folds\n");
+    printf("  -f, --folds N                      cross-validation folds (1: test on the training set)\n");
+    printf("  -j, --threads N                    threads used for batched testing\n");
+    printf("  -o, --output FILE                  write the results to FILE instead of stdout\n");
+    printf("      --csv                          CSV output instead of JSON\n");
+    printf("  -l, --list                         list the available algorithms\n");
+    printf("\n");
+    printf("Algorithms \n");
+    printf("---------- \n");
+    printf("type\tname\t:\t[param1] [param2] ... \n");
+    printf("\n");
+    PrintAlgorithms("classifier", classifierInterfaces);
+    PrintAlgorithms("regressor", regressorInterfaces);
+    PrintAlgorithms("clusterer", clustererInterfaces);
+    PrintAlgorithms("projector", projectorInterfaces);
+    fflush(stdout);
+}
+
+bool ParseAlgorithm(BenchmarkType type, QString argument, vector<BenchmarkAlgorithm> &algorithms)
+{
+    BenchmarkAlgorithm algorithm;
+    algorithm.type = type;
+    algorithm.name = argument.section(':', 0, 0);
+    QString parameters = argument.section(':', 1);
+    if(!parameters.isEmpty())
+    {
+        QStringList values = parameters.split(',');
+        FOR(i, values.size())
+        {
+            bool ok;
+            float value = values[i].toFloat(&ok);
+            if(!ok)
             {
-                if (label < 1) errors++;
+                qDebug() << "invalid parameter" << values[i] << "for" << algorithm.name;
+                return false;
             }
+            algorithm.parameters.push_back(value);
+        }
+    }
+    bool bFound = false;
+    switch(type)
+    {
+    case BENCH_CLASSIFIER: bFound = classifierInterfaces.count(algorithm.name); break;
+    case BENCH_REGRESSOR: bFound = regressorInterfaces.count(algorithm.name); break;
+    case BENCH_CLUSTERER: bFound = clustererInterfaces.count(algorithm.name); break;
+    case BENCH_PROJECTOR: bFound = projectorInterfaces.count(algorithm.name); break;
+    }
+    if(!bFound)
+    {
+        qDebug() << "cannot find" << benchmarkTypeNames[type] << algorithm.name;
+        return false;
+    }
+    algorithms.push_back(algorithm);
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+	QApplication a(argc, argv);
+
+    // we start by loading all plugins
+    LoadPlugins();
+
+    vector<BenchmarkAlgorithm> algorithms;
+    QStringList datasets, streams;
+    QString testFile, outputFile;
+    int folds = 1, threads = QThread::idealThreadCount();
+    bool bCsv = false;
+
+    QStringList arguments = a.arguments();
+    for(int i=1; i<arguments.size(); i++)
+    {
+        QString option = arguments[i];
+        bool bHasValue = i+1 < arguments.size();
+        QString value = bHasValue ? arguments[i+1] : QString();
+        if(option == "-l" || option == "--list")
+        {
+            PrintUsage();
+            return 0;
+        }
+        else if(option == "--csv") bCsv = true;
+        else if(!bHasValue)
+        {
+            qDebug() << "missing value for" << option;
+            return -1;
+        }
+        else
+        {
+            i++;
+            bool bOk = true;
+            if(option == "-c" || option == "--classifier") bOk = ParseAlgorithm(BENCH_CLASSIFIER, value, algorithms);
+            else if(option == "-r" || option == "--regressor") bOk = ParseAlgorithm(BENCH_REGRESSOR, value, algorithms);
+            else if(option == "-k" || option == "--clusterer") bOk = ParseAlgorithm(BENCH_CLUSTERER, value, algorithms);
+            else if(option == "-p" || option == "--projector") bOk = ParseAlgorithm(BENCH_PROJECTOR, value, algorithms);
+            else if(option == "-d" || option == "--data") datasets << value;
+            else if(option == "-s" || option == "--stream") streams << value;
+            else if(option == "-t" || option == "--test") testFile = value;
+            else if(option == "-f" || option == "--folds") folds = max(1, value.toInt());
+            else if(option == "-j" || option == "--threads") threads = max(1, value.toInt());
+            else if(option == "-o" || option == "--output") outputFile = value;
             else
             {
-                if (label > 0) errors++;
+                qDebug() << "unknown option" << option;
+                bOk = false;
             }
+            if(!bOk) return -1;
+        }
+    }
+
+    if(!algorithms.size() || (!datasets.size() && !streams.size()))
+    {
+        PrintUsage();
+        return algorithms.size() || datasets.size() || streams.size() ? -1 : 0;
+    }
+
+    DatasetManager testset;
+    if(!testFile.isEmpty() && !LoadDataset(testset, testFile))
+    {
+        qDebug() << "unable to load" << testFile;
+        return -1;
+    }
+
+    vector<BenchmarkResult> results;
+    FOR(d, datasets.size())
+    {
+        DatasetManager dataset;
+        if(!LoadDataset(dataset, datasets[d]) || !dataset.GetCount())
+        {
+            qDebug() << "no samples to train or test in" << datasets[d];
+            continue;
+        }
+        QString datasetName = QFileInfo(datasets[d]).fileName();
+        FOR(i, algorithms.size())
+        {
+            RunBenchmark(algorithms[i], datasetName, dataset, testFile.isEmpty() ? 0 : &testset,
+                         folds, threads, results);
+        }
+    }
+    FOR(s, streams.size())
+    {
+        FOR(i, algorithms.size())
+        {
+            RunStream(algorithms[i], streams[s], testFile.isEmpty() ? 0 : &testset, results);
         }
     }
-    printf("error: %.2f%", errors / (float)testSamples.size()*100);
-    fflush(stdout);
 
+    if(outputFile.isEmpty())
+    {
+        QTextStream out(stdout);
+        WriteResults(out, results, bCsv);
+    }
+    else
+    {
+        QFile file(outputFile);
+        if(!file.open(QIODevice::WriteOnly | QIODevice::Text))
+        {
+            qDebug() << "unable to write" << outputFile;
+            return -1;
+        }
+        QTextStream out(&file);
+        WriteResults(out, results, bCsv);
+    }
+    return 0;
 }
 
 void LoadPlugins()
@@ -190,6 +875,27 @@ void LoadPlugins()
                     name = name.split(" ").at(0);
                     classifierInterfaces[name] = classifierList[i];
                 }
+                std::vector<RegressorInterface*> regressorList = iCollection->GetRegressors();
+                FOR (i, regressorList.size())
+                {
+                    QString name = regressorList[i]->GetAlgoString();
+                    name = name.split(" ").at(0);
+                    regressorInterfaces[name] = regressorList[i];
+                }
+                std::vector<ClustererInterface*> clustererList = iCollection->GetClusterers();
+                FOR (i, clustererList.size())
+                {
+                    QString name = clustererList[i]->GetAlgoString();
+                    name = name.split(" ").at(0);
+                    clustererInterfaces[name] = clustererList[i];
+                }
+                std::vector<ProjectorInterface*> projectorList = iCollection->GetProjectors();
+                FOR (i, projectorList.size())
+                {
+                    QString name = projectorList[i]->GetAlgoString();
+                    name = name.split(" ").at(0);
+                    projectorInterfaces[name] = projectorList[i];
+                }
                 continue;
             }
             ClassifierInterface *iClassifier = qobject_cast<ClassifierInterface *>(plugin);
@@ -199,6 +905,27 @@ void LoadPlugins()
                 classifierInterfaces[name] = iClassifier;
                 continue;
             }
+            RegressorInterface *iRegressor = qobject_cast<RegressorInterface *>(plugin);
+            if (iRegressor) {
+                QString name = iRegressor->GetAlgoString();
+                name = name.split(" ").at(0);
+                regressorInterfaces[name] = iRegressor;
+                continue;
+            }
+            ClustererInterface *iClusterer = qobject_cast<ClustererInterface *>(plugin);
+            if (iClusterer) {
+                QString name = iClusterer->GetAlgoString();
+                name = name.split(" ").at(0);
+                clustererInterfaces[name] = iClusterer;
+                continue;
+            }
+            ProjectorInterface *iProjector = qobject_cast<ProjectorInterface *>(plugin);
+            if (iProjector) {
+                QString name = iProjector->GetAlgoString();
+                name = name.split(" ").at(0);
+                projectorInterfaces[name] = iProjector;
+                continue;
+            }
         } else {
             qDebug() << pluginLoader->errorString();
             delete pluginLoader;
@@ -0,0 +1,25 @@
+# ##########################
+# Configuration      #
+# ##########################
+TEMPLATE = app
+
+TARGET = datasetManager_test
+NAME = datasetManager_test
+MLPATH =..
+
+# make check builds and runs the test
+CONFIG += mainApp console testcase
+CONFIG -= app_bundle
+include($$MLPATH/MLDemos_variables.pri)
+
+
+# ##########################
+# Source Files       #
+# ##########################
+
+HEADERS += datasetManager.h \
+    public.h \
+    types.h
+
+SOURCES += \
+    datasetManager_test.cpp
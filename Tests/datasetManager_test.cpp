@@ -0,0 +1,56 @@
+// saves a binary dataset over the file it was loaded (and mapped) from, then checks that it reads back the same
+#include <stdio.h>
+#include "datasetManager.h"
+
+using namespace std;
+
+int main(int argc, char **argv)
+{
+    const char *filename = argc > 1 ? argv[1] : "roundtrip_test.mlb";
+    const int count = 1000, dim = 3;
+
+    DatasetManager original(dim);
+    for(int i=0; i<count; i++) {
+        fvec sample(dim);
+        for(int d=0; d<dim; d++) sample[d] = i*dim + d + 0.5f;
+        original.AddSample(sample, i%4);
+    }
+    if(!original.SaveBinary(filename)) {
+        printf("unable to write %s\n", filename);
+        return 1;
+    }
+
+    // the loaded samples are read from the mapped file until the dataset is modified
+    DatasetManager loaded;
+    if(!loaded.LoadBinary(filename)) {
+        printf("unable to load %s\n", filename);
+        return 1;
+    }
+    if(!loaded.SaveBinary(filename)) {
+        printf("unable to save %s over itself\n", filename);
+        return 1;
+    }
+
+    DatasetManager reloaded;
+    if(!reloaded.LoadBinary(filename) || reloaded.GetCount() != count || reloaded.GetDimCount() != dim) {
+        printf("the saved dataset does not load back\n");
+        return 1;
+    }
+    const float *samples = reloaded.GetSampleBuffer(), *expected = original.GetSampleBuffer();
+    for(int i=0; i<count; i++) {
+        for(int d=0; d<dim; d++) {
+            if(samples[i*dim + d] != expected[i*dim + d] || reloaded.GetLabel(i) != original.GetLabel(i)) {
+                printf("sample %d differs after the round trip\n", i);
+                return 1;
+            }
+        }
+    }
+    // the first dataset must still be readable after its file was replaced
+    if(loaded.GetSampleBuffer()[count*dim-1] != expected[count*dim-1]) {
+        printf("the loaded dataset was corrupted by the save\n");
+        return 1;
+    }
+    remove(filename);
+    printf("round trip of %d samples: ok\n", count);
+    return 0;
+}
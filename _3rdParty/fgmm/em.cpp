@@ -26,134 +26,375 @@
 #include <float.h>
 #include <stdio.h>
 #include <assert.h>
+#include <atomic>
+#include <thread>
+#include <vector>
 
 #define max_iter 100
 
+/* points processed together : they are stored dimension-major in the
+   scratch buffers so that the inner loops run over the points */
+#define EM_BLOCK 128
+
+/* points handed to a thread at a time. each chunk keeps its own sums,
+   added up in order afterwards, so that the results do not depend on
+   the number of threads */
+#define EM_CHUNK 4096
+
 /**
- * for all data compute p(x|i) prob that state i generated data point x
- * correspond to the E step of EM.
- *
- * @param *pix is an alloc'd float table of dimension nstates*data_len
- * returns total log_likelihood
+ * one pass over the data : E step (or k-means assignment) followed by the
+ * accumulation of the sufficient statistics of each state. For each chunk
+ * and state, stats holds (with w the responsibility and mu the current mean)
+ *    sum w , sum w (x - mu) , sum w (x - mu)(x - mu)^T (packed as an smat)
+ * only the diagonal of the last one is accumulated if full is 0.
  */
-_fgmm_real fgmm_e_step(struct gmm * GMM,
-                       const _fgmm_real * data,
-                       int data_len,
-                       _fgmm_real * pix)
+struct em_pass {
+    struct gmm * GMM;
+    const _fgmm_real * data;
+    int data_len;
+    const _fgmm_real * weights;
+    int kmeans; /* hard assignment to the closest mean instead of responsibilities */
+    int full;
+    int stat_size;
+    int nchunks;
+    double * stats;
+    double * scores; /* log-likelihood (or k-means distance) of each chunk */
+    _fgmm_real * log_norm; /* log(prior * nfactor) of each state */
+    std::atomic<int> next_chunk;
+};
+
+/* scratch buffers of one thread */
+struct em_scratch {
+    _fgmm_real * points; /* dim x EM_BLOCK */
+    _fgmm_real * centered; /* dim x EM_BLOCK */
+    _fgmm_real * resp; /* nstates x EM_BLOCK */
+    _fgmm_real * dist; /* EM_BLOCK */
+};
+
+/* sum over a block of w * a * b, with separate partial sums so that it vectorizes */
+_minline _fgmm_real em_block_dot(const _fgmm_real * w, const _fgmm_real * a, const _fgmm_real * b)
 {
-    /* E step */
-    _fgmm_real log_lik=0;
-    _fgmm_real like;
-    _fgmm_real * pxi;
-    int data_i=0;
-    int state_i;
+    _fgmm_real acc[8] = {0,0,0,0,0,0,0,0};
+    int p, k;
+    for(p=0;p<EM_BLOCK;p+=8)
+        for(k=0;k<8;k++)
+            acc[k] += w[p+k]*a[p+k]*b[p+k];
+    return ((acc[0]+acc[1])+(acc[2]+acc[3]))+((acc[4]+acc[5])+(acc[6]+acc[7]));
+}
 
-    pxi = (_fgmm_real *) malloc(sizeof(_fgmm_real) * GMM->nstates);
-    for(;data_i<data_len;data_i++)
+static void em_block(struct em_pass * pass, struct em_scratch * s, int first, int count, double * stats, double * score)
+{
+    struct gmm * GMM = pass->GMM;
+    int dim = GMM->dim;
+    int nstates = GMM->nstates;
+    int state_i, i, j, p;
+    _fgmm_real * points = s->points;
+    _fgmm_real * centered = s->centered;
+    _fgmm_real * dist = s->dist;
+    const _fgmm_real * pdata = pass->data + first*dim;
+
+    /* the loops below always run over a full block, a shorter one is padded
+       with zeros that get no responsibility */
+    for(p=0;p<count;p++)
+        for(i=0;i<dim;i++)
+            points[i*EM_BLOCK + p] = pdata[p*dim + i];
+    for(i=0;i<dim;i++)
+        for(p=count;p<EM_BLOCK;p++)
+            points[i*EM_BLOCK + p] = 0.;
+    for(state_i=0;state_i<nstates;state_i++)
+        for(p=count;p<EM_BLOCK;p++)
+            s->resp[state_i*EM_BLOCK + p] = 0.;
+
+    /* log density of each point in each state, or its square distance to the mean */
+    for(state_i=0;state_i<nstates;state_i++)
     {
-        like=0;
-        for(state_i=0;state_i<GMM->nstates;state_i++)
+        struct gaussian * g = &GMM->gauss[state_i];
+        _fgmm_real * resp = s->resp + state_i*EM_BLOCK;
+        for(p=0;p<EM_BLOCK;p++)
+            dist[p] = 0.;
+        if(pass->kmeans)
+        {
+            for(i=0;i<dim;i++)
+            {
+                const _fgmm_real * pi = points + i*EM_BLOCK;
+                _fgmm_real mean = g->mean[i];
+                for(p=0;p<EM_BLOCK;p++)
+                    dist[p] += (pi[p] - mean)*(pi[p] - mean);
+            }
+            for(p=0;p<count;p++)
+                resp[p] = dist[p];
+            continue;
+        }
+        /* whiten the block with the cholesky factor, as smat_sesq does for one point */
+        const _fgmm_real * pichol = g->icovar_cholesky->_;
+        for(i=0;i<dim;i++)
         {
-            pxi[state_i] = gaussian_pdf(&GMM->gauss[state_i], data + data_i*GMM->dim) ;
-
-            //printf("state %d -> lik : %f\n",state_i,pxi[state_i]);
-            like += pxi[state_i]* GMM->gauss[state_i].prior;
-            /*
-            pdata++;
-            ppxi++;
-            */
+            _fgmm_real * ci = centered + i*EM_BLOCK;
+            const _fgmm_real * pi = points + i*EM_BLOCK;
+            _fgmm_real mean = g->mean[i];
+            for(p=0;p<EM_BLOCK;p++)
+                ci[p] = pi[p] - mean;
         }
-        if(like<= FLT_MIN)
+        for(i=0;i<dim;i++)
+        {
+            _fgmm_real * ci = centered + i*EM_BLOCK;
+            _fgmm_real inv = *pichol++;
+            for(p=0;p<EM_BLOCK;p++)
+            {
+                ci[p] *= inv;
+                dist[p] += ci[p]*ci[p];
+            }
+            for(j=i+1;j<dim;j++)
+            {
+                _fgmm_real * cj = centered + j*EM_BLOCK;
+                _fgmm_real coef = *pichol++;
+                for(p=0;p<EM_BLOCK;p++)
+                    cj[p] -= coef*ci[p];
+            }
+        }
+        for(p=0;p<count;p++)
+            resp[p] = pass->log_norm[state_i] - .5f*dist[p];
+    }
+
+    /* normalize into responsibilities */
+    for(p=0;p<count;p++)
+    {
+        _fgmm_real weight = pass->weights ? pass->weights[first + p] : 1.f;
+        if(pass->kmeans)
+        {
+            int cstate = 0;
+            _fgmm_real min_distance = FLT_MAX;
+            for(state_i=0;state_i<nstates;state_i++)
+            {
+                if(s->resp[state_i*EM_BLOCK + p] < min_distance)
+                {
+                    cstate = state_i;
+                    min_distance = s->resp[state_i*EM_BLOCK + p];
+                }
+            }
+            *score += min_distance;
+            for(state_i=0;state_i<nstates;state_i++)
+                s->resp[state_i*EM_BLOCK + p] = state_i == cstate ? weight : 0.f;
+            continue;
+        }
+        /* log-sum-exp, so that points far from every state still get their share */
+        _fgmm_real max_log = -FLT_MAX;
+        for(state_i=0;state_i<nstates;state_i++)
+            if(s->resp[state_i*EM_BLOCK + p] > max_log)
+                max_log = s->resp[state_i*EM_BLOCK + p];
+        _fgmm_real sum = 0.;
+        for(state_i=0;state_i<nstates;state_i++)
+        {
+            _fgmm_real delta = s->resp[state_i*EM_BLOCK + p] - max_log;
+            s->resp[state_i*EM_BLOCK + p] = delta > -80.f ? expf(delta) : 0.f;
+            sum += s->resp[state_i*EM_BLOCK + p];
+        }
+        if(max_log > -FLT_MAX) *score += max_log + logf(sum);
+        for(state_i=0;state_i<nstates;state_i++)
+        {
+            /* negligible responsibilities are dropped rather than kept as denormals,
+               a state left without any point is then reseeded by the M step */
+            _fgmm_real r = max_log > -FLT_MAX ? s->resp[state_i*EM_BLOCK + p] / sum : 0.f;
+            s->resp[state_i*EM_BLOCK + p] = r >= FLT_MIN ? r*weight : 0.f;
+        }
+    }
+
+    /* sufficient statistics, centered on the current means */
+    for(p=0;p<EM_BLOCK;p++)
+        dist[p] = 1.;
+    for(state_i=0;state_i<nstates;state_i++)
+    {
+        struct gaussian * g = &GMM->gauss[state_i];
+        const _fgmm_real * w = s->resp + state_i*EM_BLOCK;
+        double * st = stats + state_i*pass->stat_size;
+        _fgmm_real sum = 0.;
+        for(p=0;p<EM_BLOCK;p++)
+            sum += w[p];
+        if(sum == 0.) continue;
+        st[0] += em_block_dot(w,dist,dist);
+        for(i=0;i<dim;i++)
         {
-            //printf("too far from current distrib %d\n",data_i);
-            // exit(0);
+            _fgmm_real * ci = centered + i*EM_BLOCK;
+            const _fgmm_real * pi = points + i*EM_BLOCK;
+            _fgmm_real mean = g->mean[i];
+            for(p=0;p<EM_BLOCK;p++)
+                ci[p] = pi[p] - mean;
+            st[1+i] += em_block_dot(w,ci,dist);
         }
-        else log_lik += log(like);
-        /*
-        if(isnan(log_lik) || isinf(log_lik))
-        exit(0);
-        */
-        for(state_i=0;state_i<GMM->nstates;state_i++)
+        double * scatter = st + 1 + dim;
+        for(i=0;i<dim;i++)
         {
-            pix[data_i + state_i*data_len] = pxi[state_i] * GMM->gauss[state_i].prior / like;
-            if(pix[data_i + state_i*data_len] <= FLT_MIN)
-                pix[data_i + state_i*data_len] = FLT_MIN;
+            const _fgmm_real * ci = centered + i*EM_BLOCK;
+            for(j=i;j<(pass->full ? dim : i+1);j++)
+                *scatter++ += em_block_dot(w,ci,centered + j*EM_BLOCK);
+        }
+    }
+}
 
+static void em_worker(struct em_pass * pass)
+{
+    int dim = pass->GMM->dim;
+    int chunk, first, last;
+    struct em_scratch s;
+    s.points = (_fgmm_real *) malloc(sizeof(_fgmm_real) * dim * EM_BLOCK);
+    s.centered = (_fgmm_real *) malloc(sizeof(_fgmm_real) * dim * EM_BLOCK);
+    s.resp = (_fgmm_real *) malloc(sizeof(_fgmm_real) * pass->GMM->nstates * EM_BLOCK);
+    s.dist = (_fgmm_real *) malloc(sizeof(_fgmm_real) * EM_BLOCK);
+    while((chunk = pass->next_chunk++) < pass->nchunks)
+    {
+        double * stats = pass->stats + chunk * pass->GMM->nstates * pass->stat_size;
+        last = (chunk+1)*EM_CHUNK < pass->data_len ? (chunk+1)*EM_CHUNK : pass->data_len;
+        pass->scores[chunk] = 0.;
+        for(first=chunk*EM_CHUNK;first<last;first+=EM_BLOCK)
+        {
+            int count = last - first < EM_BLOCK ? last - first : EM_BLOCK;
+            double score = 0.;
+            em_block(pass,&s,first,count,stats,&score);
+            pass->scores[chunk] += score;
         }
+    }
+    free(s.points);
+    free(s.centered);
+    free(s.resp);
+    free(s.dist);
+}
 
+static void em_pass_init(struct em_pass * pass, struct gmm * GMM,
+                         const _fgmm_real * data, int data_len,
+                         const _fgmm_real * weights, int kmeans)
+{
+    pass->GMM = GMM;
+    pass->data = data;
+    pass->data_len = data_len;
+    pass->weights = weights;
+    pass->kmeans = kmeans;
+    pass->full = 1;
+    pass->stat_size = 1 + GMM->dim + GMM->dim*(GMM->dim+1)/2;
+    pass->nchunks = (data_len + EM_CHUNK - 1) / EM_CHUNK;
+    pass->stats = (double *) malloc(sizeof(double) * pass->nchunks * GMM->nstates * pass->stat_size);
+    pass->scores = (double *) malloc(sizeof(double) * pass->nchunks);
+    pass->log_norm = (_fgmm_real *) malloc(sizeof(_fgmm_real) * GMM->nstates);
+}
+
+static void em_pass_free(struct em_pass * pass)
+{
+    free(pass->stats);
+    free(pass->scores);
+    free(pass->log_norm);
+}
+
+/**
+ * for all data compute p(i|x), the probability that state i generated
+ * data point x (or the closest mean for k-means) and accumulate the
+ * statistics of the M step, in parallel over chunks of points.
+ * correspond to the E step of EM.
+ *
+ * returns total log_likelihood (total distance to the means for k-means)
+ */
+static double fgmm_e_step(struct em_pass * pass)
+{
+    struct gmm * GMM = pass->GMM;
+    int state_i, chunk, t;
+    double total = 0.;
+    for(state_i=0;state_i<GMM->nstates;state_i++)
+        pass->log_norm[state_i] = logf(GMM->gauss[state_i].prior) + logf(GMM->gauss[state_i].nfactor);
+    for(t=0;t<pass->nchunks * GMM->nstates * pass->stat_size;t++)
+        pass->stats[t] = 0.;
+
+    pass->next_chunk = 0;
+    int nthreads = (int)std::thread::hardware_concurrency();
+    if(nthreads > pass->nchunks) nthreads = pass->nchunks;
+    if(nthreads <= 1)
+        em_worker(pass);
+    else
+    {
+        std::vector<std::thread> threads;
+        for(t=0;t<nthreads;t++)
+            threads.push_back(std::thread(em_worker,pass));
+        for(t=0;t<nthreads;t++)
+            threads[t].join();
     }
-    free(pxi);
-    return log_lik;
+
+    for(chunk=0;chunk<pass->nchunks;chunk++)
+        total += pass->scores[chunk];
+    return total;
 }
 
-/** updates the mean and covariances of the model, 
-    given the data and the probabilty of each point to
-    be generated from each state (pix)
+/** updates the mean and covariances of the model from the
+    statistics accumulated by the E step
 
     reestimate_flag is set to one if we need to do another round
                     (mainly when a cluster was empty)
     covar_t         sets the covariance type (diag, sphere of full )
 */
 
-void fgmm_m_step(struct gmm * GMM,
-                 const _fgmm_real * data,
-                 int data_len,
-                 _fgmm_real * pix,
-                 int * reestimate_flag,
-                 enum COVARIANCE_TYPE covar_t)
+static void fgmm_m_step(struct em_pass * pass,
+                        int * reestimate_flag,
+                        enum COVARIANCE_TYPE covar_t)
 {
-    int state_i,k;
+    struct gmm * GMM = pass->GMM;
+    int dim = GMM->dim;
+    int state_i, chunk, i, j, k;
     int random_point = 0;
+    double * st = (double *) malloc(sizeof(double) * pass->stat_size);
     for(state_i=0;state_i<GMM->nstates;state_i++)
     {
-        GMM->gauss[state_i].prior = 0;
-        for(k=0;k<GMM->dim;k++)
-            GMM->gauss[state_i].mean[k] = 0;
-
-        switch(covar_t)
+        struct gaussian * g = &GMM->gauss[state_i];
+        for(k=0;k<pass->stat_size;k++)
+            st[k] = 0.;
+        for(chunk=0;chunk<pass->nchunks;chunk++)
         {
-        case COVARIANCE_DIAG :
-            GMM->gauss[state_i].prior = smat_covariance_diag(GMM->gauss[state_i].covar,
-                                                             data_len,
-                                                             &pix[state_i*data_len],
-                                                             data,
-                                                             GMM->gauss[state_i].mean);
-            break;
-
-        case COVARIANCE_SPHERE :
-            GMM->gauss[state_i].prior = smat_covariance_single(GMM->gauss[state_i].covar,
-                                                               data_len,
-                                                               &pix[state_i*data_len],
-                                                               data,
-                                                               GMM->gauss[state_i].mean);
-            break;
-
-        default :
-            GMM->gauss[state_i].prior = smat_covariance(GMM->gauss[state_i].covar,
-                                                        data_len,
-                                                        &pix[state_i*data_len],
-                                                        data,
-                                                        GMM->gauss[state_i].mean);
-            break;
+            const double * cst = pass->stats + (chunk*GMM->nstates + state_i)*pass->stat_size;
+            for(k=0;k<pass->stat_size;k++)
+                st[k] += cst[k];
         }
-
+        double norm = st[0];
 
         // If no point belong to us, reassign to a random one ..
-        if(GMM->gauss[state_i].prior == 0)
+        if(norm == 0.)
         {
-            random_point = rand()%data_len;
-            for(k=0;k<GMM->dim;k++)
-                GMM->gauss[state_i].mean[k] = data[random_point*GMM->dim + k];
+            g->prior = 0;
+            random_point = rand()%pass->data_len;
+            for(k=0;k<dim;k++)
+                g->mean[k] = pass->data[random_point*dim + k];
             *reestimate_flag = 1; // then we shall restimate mean/covar of this cluster
+            continue;
         }
-        else
+
+        /* the statistics are centered on the previous mean */
+        const double * shift = st + 1;
+        const double * scatter = st + 1 + dim;
+        _fgmm_real * pcov = g->covar->_;
+        double variance = 0.;
+        for(i=0;i<dim;i++)
         {
-            GMM->gauss[state_i].prior /= data_len;
-            invert_covar(&GMM->gauss[state_i]);
+            for(j=i;j<dim;j++)
+            {
+                double value = 0.;
+                if(pass->full)
+                    value = *scatter++ / norm - shift[i]*shift[j]/(norm*norm);
+                else if(j==i)
+                    value = *scatter++ / norm - shift[i]*shift[i]/(norm*norm);
+                if(j != i && covar_t != COVARIANCE_FULL)
+                    value = 0.;
+                if(j == i)
+                    variance += value;
+                *pcov++ = value;
+            }
+        }
+        if(covar_t == COVARIANCE_SPHERE)
+        {
+            pcov = g->covar->_;
+            for(i=0;i<dim;i++)
+                for(j=i;j<dim;j++)
+                    *pcov++ = j==i ? variance / dim : 0.;
         }
+        for(i=0;i<dim;i++)
+            g->mean[i] += shift[i] / norm;
+        g->prior = norm / pass->data_len;
+        invert_covar(g);
     }
-
-
+    free(st);
 }
 
 /** perform em on the giver data
@@ -170,16 +411,16 @@ int fgmm_em( struct gmm * GMM,
              enum COVARIANCE_TYPE covar_t,
              const _fgmm_real * weights) // if not NULL, weighted version ..
 {
-    _fgmm_real * pix;
+    struct em_pass pass;
     _fgmm_real log_lik;
     int niter=0;
     _fgmm_real oldlik=0;
     _fgmm_real deltalik=0;
     int state_i;
-    int d=0;
     int reestimate_flag=0; // shall we do one more iteration ??
 
-    pix = (_fgmm_real *) malloc( sizeof(_fgmm_real) * data_length * GMM->nstates);
+    em_pass_init(&pass,GMM,data,data_length,weights,0);
+    pass.full = covar_t == COVARIANCE_FULL;
 
     for(state_i=0;state_i<GMM->nstates;state_i++)
     {
@@ -190,7 +431,7 @@ int fgmm_em( struct gmm * GMM,
     for(niter=0;niter<max_iter;niter++)
     {
         reestimate_flag = 0;
-        log_lik = fgmm_e_step(GMM,data,data_length,pix);
+        log_lik = fgmm_e_step(&pass);
         log_lik/=data_length;
 #ifndef NDEBUG
         //printf("Log lik :: %f \n",log_lik);
@@ -202,92 +443,19 @@ int fgmm_em( struct gmm * GMM,
         if(fabs(deltalik) < likelihood_epsilon && !reestimate_flag)
             break;
 
-        if(weights != NULL)
-        {
-            for(d=0;d<data_length;d++)
-            {
-                for(state_i=0;state_i< GMM->nstates; state_i++)
-                    pix[d*GMM->nstates + state_i] *= weights[d];
-
-            }
-        }
-
-        fgmm_m_step(GMM,data,data_length,pix,&reestimate_flag,covar_t);
-        //      pdata = data;
+        fgmm_m_step(&pass,&reestimate_flag,covar_t);
     }
     if(end_loglikelihood != NULL)
         *end_loglikelihood = log_lik;
 
-    free(pix);
+    em_pass_free(&pass);
     return niter;
 }
 
-
-/**
- * this is the k-means estimation steps :
+/* do kmeans , reusing lots of code .. 
  *
- * works the same way than normal e_step, just that
- * pix are computed as 0 and 1, given if the current
- * data points belong or not to the cluster...
- *
- * returns total distance to all clusters.
- */
-
-_fgmm_real fgmm_kmeans_e_step(struct gmm * GMM,
-                              const _fgmm_real * data,
-                              int data_len,
-                              _fgmm_real * pix)
-{
-    /* E step */
-    _fgmm_real total_distance=0;
-    _fgmm_real distance;
-    _fgmm_real max_distance;
-    int cstate = 0;
-    int data_i=0;
-    int state_i;
-    int _;
-    const _fgmm_real * pdata = data;
-
-    for(;data_i<data_len;data_i++)
-    {
-        max_distance = FLT_MAX;
-        cstate = -1;
-        for(state_i=0;state_i<GMM->nstates;state_i++)
-        {
-            distance = 0;
-            for(_ = 0; _ < GMM->dim ; _++)
-            {
-                distance += (*pdata - GMM->gauss[state_i].mean[_]) * (*pdata - GMM->gauss[state_i].mean[_]);
-                pdata++;
-            }
-            // printf("%d %f \n", state_i, distance);
-            pdata -= GMM->dim;
-            if( distance < max_distance)
-            {
-                cstate = state_i;
-                max_distance = distance;
-            }
-        }
-        pdata += GMM->dim;
-        if(cstate == -1) cstate = 0;
-        assert(cstate != -1);
-        // fucking unreadable but this sets pix[.. , state_i] to
-        // 0 unless state_i is cstate
-        //      printf(" cstate : %d \n",cstate);
-        for(state_i=0;state_i<GMM->nstates;state_i++)
-        {
-            pix[data_i + state_i*data_len] = 0;
-            if(state_i == cstate)
-                pix[data_i + state_i*data_len] = 1.;
-        }
-
-
-        total_distance += max_distance;
-    }
-    return total_distance;
-}
-
-/* do kmeans , reusing lots of code .. */ 
+ * the E step assigns each point to its closest mean (with a
+ * responsibility of 1) and returns the total distance to the means. */ 
 
 int fgmm_kmeans( struct gmm * GMM,
                  const _fgmm_real * data,
@@ -295,16 +463,15 @@ int fgmm_kmeans( struct gmm * GMM,
                  _fgmm_real likelihood_epsilon,
                  const _fgmm_real * weights) // if not NULL, weighted version ..
 {
-    _fgmm_real * pix;
+    struct em_pass pass;
     _fgmm_real total_distance;
     int niter=0;
     _fgmm_real oldlik=0;
     _fgmm_real deltalik=0;
     int state_i;
-    int d=0;
     int reestimate_flag = 0;
 
-    pix = (_fgmm_real *) malloc( sizeof(_fgmm_real) * data_length * GMM->nstates);
+    em_pass_init(&pass,GMM,data,data_length,weights,1);
 
     for(state_i=0;state_i<GMM->nstates;state_i++)
     {
@@ -315,7 +482,7 @@ int fgmm_kmeans( struct gmm * GMM,
     for(niter=0;niter<max_iter;niter++)
     {
         reestimate_flag = 0;
-        total_distance = fgmm_kmeans_e_step(GMM,data,data_length,pix);
+        total_distance = fgmm_e_step(&pass);
         total_distance/=data_length;
 #ifndef NDEBUG
         //printf("Kmeans distance :: %f \n",total_distance);
@@ -327,21 +494,99 @@ int fgmm_kmeans( struct gmm * GMM,
         if(fabs(deltalik) < likelihood_epsilon && !reestimate_flag)
             break;
 
-        if(weights != NULL)
-        {
-            for(d=0;d<data_length;d++)
-            {
-                for(state_i=0;state_i< GMM->nstates; state_i++)
-                    pix[d + state_i*data_length] *= weights[d];
-
-            }
-        }
         // the song remains the same ..
-        fgmm_m_step(GMM,data,data_length,pix,&reestimate_flag,COVARIANCE_FULL);
+        fgmm_m_step(&pass,&reestimate_flag,COVARIANCE_FULL);
     }
 
-    free(pix);
+    em_pass_free(&pass);
     return niter;
 
 }
 
+/* one step of stochastic EM on a chunk of data : the statistics of
+ * the chunk (normalized by its length) are blended with the ones the
+ * current model expects, with a weight of step for the chunk, and the
+ * parameters are reestimated from the result. with a step of 1 this is
+ * a plain M step on the chunk, steps decaying like t^-k with 0.5 < k <= 1
+ * converge over a stream of chunks (Cappe and Moulines).
+ *
+ * returns the average log-likelihood of the chunk under the model before
+ * the update.
+ */
+
+_fgmm_real fgmm_update_chunk( struct gmm * GMM,
+                              const _fgmm_real * data,
+                              int data_length,
+                              _fgmm_real step,
+                              enum COVARIANCE_TYPE covar_t)
+{
+    struct em_pass pass;
+    int dim = GMM->dim;
+    int state_i, chunk, i, j, k;
+    double log_lik;
+    if(data_length <= 0)
+        return 0.;
+    if(step > 1.)
+        step = 1.;
+
+    em_pass_init(&pass,GMM,data,data_length,NULL,0);
+    pass.full = covar_t == COVARIANCE_FULL;
+    for(state_i=0;state_i<GMM->nstates;state_i++)
+        invert_covar(&GMM->gauss[state_i]);
+    log_lik = fgmm_e_step(&pass);
+
+    double * st = (double *) malloc(sizeof(double) * pass.stat_size);
+    for(state_i=0;state_i<GMM->nstates;state_i++)
+    {
+        struct gaussian * g = &GMM->gauss[state_i];
+        for(k=0;k<pass.stat_size;k++)
+            st[k] = 0.;
+        for(chunk=0;chunk<pass.nchunks;chunk++)
+        {
+            const double * cst = pass.stats + (chunk*GMM->nstates + state_i)*pass.stat_size;
+            for(k=0;k<pass.stat_size;k++)
+                st[k] += cst[k];
+        }
+
+        /* the model expects prior, 0 and prior*covar for the statistics
+           of one point, centered on its mean */
+        double norm = (1. - step) * g->prior + step * st[0] / data_length;
+        if(norm <= 0.)
+            continue;
+        double * shift = st + 1;
+        for(i=0;i<dim;i++)
+            shift[i] = step * shift[i] / data_length / norm;
+        const double * scatter = st + 1 + dim;
+        _fgmm_real * pcov = g->covar->_;
+        double variance = 0.;
+        for(i=0;i<dim;i++)
+        {
+            for(j=i;j<dim;j++)
+            {
+                double value = (1. - step) * g->prior * (*pcov);
+                if(pass.full || j==i)
+                    value += step * *scatter++ / data_length;
+                value = value / norm - shift[i]*shift[j];
+                if(j != i && covar_t != COVARIANCE_FULL)
+                    value = 0.;
+                if(j == i)
+                    variance += value;
+                *pcov++ = value;
+            }
+        }
+        if(covar_t == COVARIANCE_SPHERE)
+        {
+            pcov = g->covar->_;
+            for(i=0;i<dim;i++)
+                for(j=i;j<dim;j++)
+                    *pcov++ = j==i ? variance / dim : 0.;
+        }
+        for(i=0;i<dim;i++)
+            g->mean[i] += shift[i];
+        g->prior = norm;
+        invert_covar(g);
+    }
+    free(st);
+    em_pass_free(&pass);
+    return log_lik / data_length;
+}
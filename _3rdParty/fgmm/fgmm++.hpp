@@ -176,6 +176,22 @@ public :
 		return fgmm_get_pdf(c_gmm,obs,weights);
 	};
 
+	/**
+   * likelihood of count points (row order), stored in out
+   */
+	void pdfBatch(const _fgmm_real * obs, int count, _fgmm_real * out)
+	{
+		fgmm_get_pdf_batch(c_gmm,obs,count,out);
+	};
+
+	/**
+   * density of each state for count points, stored in out (count*nstates)
+   */
+	void statePdfBatch(const _fgmm_real * obs, int count, _fgmm_real * out)
+	{
+		fgmm_get_state_pdf_batch(c_gmm,obs,count,out);
+	};
+
 	_fgmm_real pdf(const _fgmm_real * obs, int state)
 	{
 		if(state >= c_gmm->nstates) return 0;
@@ -322,6 +338,18 @@ public :
 			fgmm_update(c_gmm,point);
 	};
 
+	/**
+   * stochastic EM step on a chunk of data
+   *
+   * @param data : dim*len array, datapoints (row order)
+   * @param step : weight of the chunk against the current model, in ]0,1]
+   * @return the average loglikelihood of the chunk before the update
+   */
+	float updateChunk(const _fgmm_real * data, int len, float step, COVARIANCE_TYPE covar_t=COVARIANCE_FULL)
+	{
+		return fgmm_update_chunk(c_gmm,data,len,step,covar_t);
+	};
+
 	/** returns state index with the highest likelihood
    */
 	int getLikelyState(const _fgmm_real * point)
@@ -295,6 +295,21 @@ int fgmm_kmeans( struct gmm * GMM,
 		 _fgmm_real epsilon,
 		 const _fgmm_real * weights);
 
+/**
+ * stochastic EM step, for data streams that do not fit in memory
+ *
+ * @param data : a chunk of data_length points (row order)
+ * @param step : weight of the chunk against the current model, in ]0,1]
+ *               (1 : the parameters are reestimated from the chunk alone)
+ *
+ * @return : the average loglikelihood of the chunk before the update
+ */
+_fgmm_real fgmm_update_chunk( struct gmm * GMM,
+			      const _fgmm_real * data,
+			      int data_length,
+			      _fgmm_real step,
+			      enum COVARIANCE_TYPE covar_t);
+
 /**
  * return likelihood of point
  * if weights != NULL , return normalized weights of each gaussian
@@ -303,6 +318,24 @@ _fgmm_real fgmm_get_pdf( struct gmm * gmm,
 		    _fgmm_real * point,
 		    _fgmm_real * weights);
 
+/**
+ * likelihood of count points stored row-wise in points (count*dim),
+ * written in out (must be alloc'd of size count)
+ */
+void fgmm_get_pdf_batch( struct gmm * gmm,
+			 const _fgmm_real * points,
+			 int count,
+			 _fgmm_real * out);
+
+/**
+ * density of each state (without priors) for count points stored
+ * row-wise in points, written in out (count*nstates, row-wise)
+ */
+void fgmm_get_state_pdf_batch( struct gmm * gmm,
+			       const _fgmm_real * points,
+			       int count,
+			       _fgmm_real * out);
+
 
 /**
  * Structure holding stuffs for the regression 
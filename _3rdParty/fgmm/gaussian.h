@@ -55,6 +55,17 @@ _minline _fgmm_real gaussian_pdf(struct gaussian* g, const _fgmm_real* x)
   return dist2;
 }
 
+/* same as gaussian_pdf, using a scratch buffer of size g->dim */
+_minline _fgmm_real gaussian_pdf_buf(const struct gaussian* g, const _fgmm_real* x, _fgmm_real* scratch)
+{
+  _fgmm_real dist2;
+  _fgmm_real dist = smat_sesq_buf(g->icovar_cholesky,g->mean,x,scratch);
+  dist *= .5;
+  dist2 =  expf(-dist)*g->nfactor;
+  if(dist2 == 0) dist2 = FLT_MIN;
+  return dist2;
+}
+
 /** alloc memory for the gaussian 
     and init it to zero with identity covariance matrix
 */
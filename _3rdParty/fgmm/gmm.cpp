@@ -313,6 +313,40 @@ _fgmm_real fgmm_get_pdf( struct gmm * gmm,
   return like;
 }
 
+void fgmm_get_pdf_batch( struct gmm * gmm,
+			 const _fgmm_real * points,
+			 int count,
+			 _fgmm_real * out)
+{
+  int i, state_i;
+  _fgmm_real * scratch = (_fgmm_real *) malloc(sizeof(_fgmm_real) * gmm->dim);
+  for(i=0;i<count;i++)
+    {
+      const _fgmm_real * point = points + i*gmm->dim;
+      _fgmm_real like = 0;
+      for(state_i=0;state_i<gmm->nstates;state_i++)
+	like += gmm->gauss[state_i].prior * gaussian_pdf_buf(&(gmm->gauss[state_i]),point,scratch);
+      out[i] = like;
+    }
+  free(scratch);
+}
+
+void fgmm_get_state_pdf_batch( struct gmm * gmm,
+			       const _fgmm_real * points,
+			       int count,
+			       _fgmm_real * out)
+{
+  int i, state_i;
+  _fgmm_real * scratch = (_fgmm_real *) malloc(sizeof(_fgmm_real) * gmm->dim);
+  for(i=0;i<count;i++)
+    {
+      const _fgmm_real * point = points + i*gmm->dim;
+      for(state_i=0;state_i<gmm->nstates;state_i++)
+	out[i*gmm->nstates + state_i] = gaussian_pdf_buf(&(gmm->gauss[state_i]),point,scratch);
+    }
+  free(scratch);
+}
+
 int fgmm_most_likely_state(struct gmm * gmm,
 			   const _fgmm_real * obs)
 {
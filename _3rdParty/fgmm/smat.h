@@ -191,6 +191,30 @@ void smat_ttmult(const struct smat* tri, struct smat* out);
 void smat_tforward(struct smat * lower, _fgmm_real * b, _fgmm_real * y) ;
 void smat_tbackward(const struct smat * upper, _fgmm_real * b, _fgmm_real * y);
 
+/**
+ * same as smat_sesq, but uses a caller-provided scratch buffer of size dim
+ * instead of allocating one on each call (used for batched evaluations)
+ */
+_minline _fgmm_real smat_sesq_buf(const struct smat * ichol,const _fgmm_real * bias,const _fgmm_real * x, _fgmm_real * cdata)
+{
+  _fgmm_real out = 0.;
+  int i,j;
+  const _fgmm_real * pichol = ichol->_;
+  for(i=0;i<ichol->dim;i++)
+    cdata[i] = 0.;
+  for(i=0;i<ichol->dim;i++)
+    {
+      cdata[i] += x[i] - bias[i];
+      cdata[i] *= *pichol++;
+      for(j=i+1;j<ichol->dim;j++)
+	{
+	  cdata[j] -= (*pichol++)*cdata[i];
+	}
+      out += cdata[i]*cdata[i];
+    }
+  return out;
+};
+
 /**
  * computes sesquilinear form :
  *   (x - bias)^T Sigma^-1 (x-bias) 
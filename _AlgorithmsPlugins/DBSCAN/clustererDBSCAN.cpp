@@ -20,60 +20,60 @@ Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
 #include "public.h"
 #include "clustererDBSCAN.h"
 #include <boost/foreach.hpp>
+#include <algorithm>
 
 using namespace std;
 
-class MetricEuclidean
+// the distance between two samples for the selected metric,
+// the euclidean distance is squared, as are the thresholds it is compared with
+double ClustererDBSCAN::distance(const float *a, const float *b) const
 {
-public:
-    double distance(Point a, Point b) {
-        double dist = 0;
-        FOR(i, a.size()) {
+    double dist = 0;
+    switch(_metric)
+    {
+    case 0: // Euclidean
+        FOR(i, dim) {
             double d = (a[i]-b[i]);
             dist += d*d;
         }
         return dist;
-    }
-};
-
-class MetricManhattan
-{
-public:
-    double distance(Point a, Point b) {
-        double dist = 0;
-        FOR(i, a.size()) {
-            float d = fabs(a[i]-b[i]);
-            dist += d;
-        }
+    case 1: // Manhattan
+        FOR(i, dim) dist += fabs(a[i]-b[i]);
         return dist;
-    }
-};
-
-class MetricChebyshev
-{
-public:
-    double distance(Point a, Point b) {
-        double dist = 0;
-        FOR(i, a.size()) {
+    case 2: // Chebyshev
+        FOR(i, dim) {
             double d = fabs(a[i]-b[i]);
             if(d > dist) dist = d;
         }
         return dist;
+    case 3: // Astroid
+        FOR(i, dim) dist += pow(fabs(a[i]-b[i]),2./3.f);
+        return pow(dist,3.f/2.f);
+    default: // Cosine
+    {
+        float dot = 0, normA = 0, normB = 0;
+        FOR(i, dim) {
+            dot += a[i]*b[i];
+            normA += a[i]*a[i];
+            normB += b[i]*b[i];
+        }
+        return 1.0 - dot / (sqrtf(normA)*sqrtf(normB));
     }
-};
+    }
+}
 
-class MetricAstroid
+// half-width of the box that contains all the points closer than threshold:
+// no single coordinate can differ by more than the distance itself for the Manhattan,
+// Chebyshev and Astroid distances, and the cosine distance on normalized samples is half
+// their squared euclidean distance
+float ClustererDBSCAN::boxRadius(double threshold) const
 {
-public:
-    double distance(Point a, Point b) {
-        double dist = 0;
-        FOR(i, a.size()) {
-            double d = fabs(a[i]-b[i]);
-            dist += pow(d,2./3.f);
-        }
-        return pow(dist,3.f/2.f);
-    }
-};
+    if(threshold <= 0) return 0;
+    double radius = threshold;
+    if(_metric == 0) radius = sqrt(threshold);
+    else if(_metric > 3) radius = sqrt(2*threshold);
+    return radius*(1 + 1e-5) + 1e-6; // we leave some room for the rounding, the exact distances are checked anyway
+}
 
 void ClustererDBSCAN::Train(std::vector< fvec > samples)
 {
@@ -90,32 +90,35 @@ void ClustererDBSCAN::Train(std::vector< fvec > samples)
     pts.reserve(samples.size());
 
     // convert from fvec to Point
+    data.resize(samples.size()*dim);
     for (int j = 0; j < samples.size(); ++j) {
         Point v (samples[j].size());
         for (int i = 0; i < dim; ++i) {
             v(i)=samples[j][i];
+            data[j*dim + i] = samples[j][i];
         }
         pts.push_back(v);
     }
 
-    // build the similarity matrix according to the selected metric
-    if(_metric == 0) {
-        MetricEuclidean d;
-        computeSimilarity(d,pts);
-    } else if (_metric == 1) {
-        MetricManhattan d;
-        computeSimilarity(d,pts);
-    } else if (_metric == 2) {
-        MetricChebyshev d;
-        computeSimilarity(d,pts);
-    } else if (_metric == 3) {
-        MetricAstroid d;
-        computeSimilarity(d,pts);
-    } else if (_metric == 4) { // dot_product
-        Metrics::Distance<Metrics::Cosine<Point> > d;
-        computeSimilarity(d,pts);
+    // index the samples for the neighborhood queries, the cosine distance works on the directions only
+    if(_metric > 3) {
+        normalized = data;
+        FOR(j, samples.size()) {
+            float norm = 0;
+            FOR(i, dim) norm += normalized[j*dim + i]*normalized[j*dim + i];
+            norm = sqrtf(norm);
+            if(norm > 0) FOR(i, dim) normalized[j*dim + i] /= norm;
+        }
+        index.Build(&normalized[0], samples.size(), dim);
+    } else {
+        normalized.clear();
+        index.Build(&data[0], samples.size(), dim);
     }
 
+    // the dense similarity matrix is only worth it on tiny datasets
+    if(bDenseMatrix && samples.size() <= DBSCAN_DENSE_MAX) computeSimilarity();
+    else _sim.resize(0, 0, false);
+
     // run clustering
 
     if (_type>0) { //OPTICS
@@ -135,11 +138,7 @@ fvec ClustererDBSCAN::Test( const fvec &sample)
 {
     fvec res(nbClusters+1,0);
 
-    //convert input to Point
-    Point v (sample.size());
-    for (int i = 0; i < sample.size(); ++i) {
-        v(i)=sample[i];
-    }
+    if(!index.size() || (int)sample.size() < dim) return res;
 
     // find the nearest point in our samples
     int nearest = -1;
@@ -152,25 +151,22 @@ fvec ClustererDBSCAN::Test( const fvec &sample)
     {
         _depth=realEps;
     }
-    for (int j = 0; j < pts.size(); ++j)
+
+    // only the samples in the box around the sample can be closer than eps
+    fvec query(sample.begin(), sample.begin() + dim);
+    if(_metric > 3) {
+        float norm = 0;
+        FOR(i, dim) norm += query[i]*query[i];
+        norm = sqrtf(norm);
+        if(norm > 0) FOR(i, dim) query[i] /= norm;
+    }
+    ivec candidates;
+    index.BoxQuery(&query[0], boxRadius(realEps), candidates);
+    sort(candidates.begin(), candidates.end());
+    FOR(c, candidates.size())
     {
-        // according to the selected metric
-        if(_metric == 0) {
-            MetricEuclidean d;
-            temp_d = d.distance(v, pts[j]);
-        } else if (_metric == 1){
-            MetricManhattan d;
-            temp_d = d.distance(v, pts[j]);
-        } else if (_metric == 2){
-            MetricChebyshev d;
-            temp_d = d.distance(v, pts[j]);
-        } else if (_metric == 3){
-            MetricAstroid d;
-            temp_d = d.distance(v, pts[j]);
-        } else {
-            Metrics::Distance<Metrics::Cosine<Point> > d;
-            temp_d = d.distance(v, pts[j]);
-        }
+        int j = candidates[c];
+        temp_d = distance(&sample[0], &data[j*dim]);
         if (temp_d < dist && temp_d < realEps && _pointId_to_clusterId[j] > 0 && _core[j]) {
             dist = temp_d;
             nearest = j;
@@ -244,13 +240,14 @@ bool ClustererDBSCAN::SetClusterTestValue(int count, int max)
     return false;
 }
 
-void ClustererDBSCAN::SetParams(float minpts, float eps, int metric, float depth, int type)
+void ClustererDBSCAN::SetParams(float minpts, float eps, int metric, float depth, int type, bool bDenseMatrix)
 {
     _eps = eps;
     _metric = metric;
     _minPts = minpts;
     _depth = depth;
     _type = type;
+    this->bDenseMatrix = bDenseMatrix;
 }
 
 void ClustererDBSCAN::run_cluster(Points samples)
@@ -332,6 +329,8 @@ void ClustererDBSCAN::run_cluster(Points samples)
 
 void ClustererDBSCAN::run_optics(Points samples)
 {
+    _queued = 0;
+    _queueOrder.resize(samples.size(), 0);
     // foreach pid
     for (PointId pid = 0; pid < samples.size(); pid++)
     {
@@ -341,13 +340,14 @@ void ClustererDBSCAN::run_optics(Points samples)
             _visited[pid] = true;
 
             // get the neighbors
-            Neighbors ne = findNeighbors(pid, _eps);
+            std::vector<double> distances;
+            Neighbors ne = findNeighbors(pid, _eps, &distances);
             // add it to the ordered list
             _optics_list.push_back(pid);
-            // use the multiMap as priority queue
-            QMultiMap<double,PointId> queue;
+            // use the set as priority queue
+            OpticsQueue queue;
 
-            double d = this->core_distance(pid,_eps);
+            double d = this->core_distance(distances);
             // not enough support -> mark as noise
             if (d < 0)
             {
@@ -357,13 +357,13 @@ void ClustererDBSCAN::run_optics(Points samples)
             {
                 //else it is a core point
                 _core[pid] = true;
-                this->update_reachability(ne,pid,d,queue);
+                this->update_reachability(ne,distances,d,queue);
 
                 // go to neighbors in the good order
-                while(queue.size()>0)
+                while(!queue.empty())
                 {
                     //take element with lowest distance from the queue
-                    PointId nPid = queue.begin().value();
+                    PointId nPid = queue.begin()->pid;
                     queue.erase(queue.begin());
 
                     // not already visited
@@ -372,16 +372,17 @@ void ClustererDBSCAN::run_optics(Points samples)
                         _visited[nPid] = true;
 
                         // go to neighbors
-                        Neighbors ne1 = findNeighbors(nPid, _eps);
+                        std::vector<double> distances1;
+                        Neighbors ne1 = findNeighbors(nPid, _eps, &distances1);
 
                         _optics_list.push_back(nPid);
 
-                        double dd = this->core_distance(nPid,_eps);
+                        double dd = this->core_distance(distances1);
                         // enough support
                         if (dd >= 0)
                         {
                             _core[nPid] = true;
-                            this->update_reachability(ne1,nPid,dd,queue);
+                            this->update_reachability(ne1,distances1,dd,queue);
 
                         }
                     }
@@ -393,26 +394,20 @@ void ClustererDBSCAN::run_optics(Points samples)
 
 }
 
-void ClustererDBSCAN::update_reachability(Neighbors ne,PointId pid,double core_dist,QMultiMap<double,PointId> &queue)
+void ClustererDBSCAN::update_reachability(const Neighbors &ne, const std::vector<double> &distances, double core_dist, OpticsQueue &queue)
 {
-    BOOST_FOREACH(Neighbors::value_type n, ne)
+    FOR(i, ne.size())
     {
+        PointId n = ne[i];
         if(!_visited[n])
         {
-            double ndist = max(core_dist,_sim(pid,n));
-            if(_reachability[n]< 0)
+            double ndist = max(core_dist,distances[i]);
+            if(_reachability[n]< 0 || _reachability[n]>ndist)
             {
+                if(_reachability[n] >= 0) queue.erase(OpticsEntry(_reachability[n],_queueOrder[n],n));
                 _reachability[n] = ndist;
-                queue.insert(ndist,n);
-            }
-            else{
-                if(_reachability[n]>ndist)
-                {
-                    queue.remove(_reachability[n],n);
-                    _reachability[n] = ndist;
-                    queue.insert(ndist,n);
-                }
-
+                _queueOrder[n] = _queued++;
+                queue.insert(OpticsEntry(ndist,_queueOrder[n],n));
             }
         }
     }
@@ -589,54 +584,63 @@ void ClustererDBSCAN::find_clusters_WF()
 }
 
 
-// compute the core-distance
-double ClustererDBSCAN::core_distance(PointId pid,double threshold)
+// compute the core-distance, the distance to the minPts-th neighbor
+double ClustererDBSCAN::core_distance(std::vector<double> distances)
 {
-    QMultiMap<double,int> p;
-    for (unsigned int j=0; j < _sim.size1(); j++)
-    {
-        if 	((pid != j ) && (_sim(pid, j)) < threshold)
-        {
-            p.insert(_sim(pid, j),j);
-        }
-    }
-    QList<double> k = p.keys();
-    if (k.size()<_minPts)
+    if (_minPts <= 0) return 0;
+    if ((int)distances.size()<_minPts)
     {
         return -1;
     }
-    else
-    {
-        return k[_minPts-1];
-    }
-
+    nth_element(distances.begin(), distances.begin() + _minPts-1, distances.end());
+    return distances[_minPts-1];
 }
 
 
-Neighbors ClustererDBSCAN::findNeighbors(PointId pid, double threshold)
+Neighbors ClustererDBSCAN::findNeighbors(PointId pid, double threshold, std::vector<double> *distances)
 {
     Neighbors ne;
+    if(distances) distances->clear();
 
-    for (unsigned int j=0; j < _sim.size1(); j++) {
-        if 	((pid != j ) && (_sim(pid, j)) < threshold) {
+    if(_sim.size1()) {
+        for (unsigned int j=0; j < _sim.size1(); j++) {
+            if 	((pid != j ) && (_sim(pid, j)) < threshold) {
+                ne.push_back(j);
+                if(distances) distances->push_back(_sim(pid, j));
+            }
+        }
+        return ne;
+    }
+
+    // we only compute the distances to the samples in the box around the point,
+    // in index order to visit them in the same order as a full scan
+    ivec candidates;
+    const float *point = _metric > 3 ? &normalized[pid*dim] : &data[pid*dim];
+    index.BoxQuery(point, boxRadius(threshold), candidates);
+    sort(candidates.begin(), candidates.end());
+    FOR(i, candidates.size()) {
+        PointId j = candidates[i];
+        if (pid == j) continue;
+        double d = distance(&data[pid*dim], &data[j*dim]);
+        if (d < threshold) {
             ne.push_back(j);
+            if(distances) distances->push_back(d);
         }
     }
     return ne;
 }
 
-template <typename Distance_type>
-void ClustererDBSCAN::computeSimilarity(Distance_type & d,Points samples)
+void ClustererDBSCAN::computeSimilarity()
 {
-    unsigned int size = samples.size();
+    unsigned int size = pts.size();
     _sim.resize(size, size, false);
     for (unsigned int i=0; i < size; i++)
     {
+        _sim(i, i) = 0;
         for (unsigned int j=i+1; j < size; j++)
         {
-            _sim(j, i) = _sim(i, j) = d.distance(samples[i], samples[j]);
+            _sim(j, i) = _sim(i, j) = distance(&data[i*dim], &data[j*dim]);
 
         }
     }
 }
-
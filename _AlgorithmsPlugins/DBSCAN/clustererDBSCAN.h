@@ -26,7 +26,11 @@ Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
 #include <boost/numeric/ublas/matrix.hpp>
 #include <boost/foreach.hpp>
 #include <boost/numeric/ublas/vector.hpp>
-#include <QMultiMap>
+#include <set>
+#include "neighborIndex.h"
+
+// above this many samples the dense distance matrix is never used, even when asked for
+#define DBSCAN_DENSE_MAX 4096
 
 
 // a single point is made up of vector of float
@@ -41,6 +45,20 @@ typedef std::vector<PointId> CCluster;
 // a set of Neighbors is a vector of pointid
 typedef std::vector<PointId> Neighbors;
 
+// OPTICS priority queue entry, the closest first and, for the same reachability, the last queued first
+struct OpticsEntry
+{
+    double reachability;
+    int order;
+    PointId pid;
+    OpticsEntry(double reachability, int order, PointId pid) : reachability(reachability), order(order), pid(pid){}
+    bool operator<(const OpticsEntry &o) const
+    {
+        return reachability != o.reachability ? reachability < o.reachability : order > o.order;
+    }
+};
+typedef std::set<OpticsEntry> OpticsQueue;
+
 
 /**
   Clusterer DBSCAN implementing all the necessary functions from the interface
@@ -52,7 +70,7 @@ public:
     /**
       Constructor, instanciating everything that will be used
       */
-    ClustererDBSCAN(): testCount(1), testMax(1), _eps(0.1), _minPts(1) {}
+    ClustererDBSCAN(): testCount(1), testMax(1), _eps(0.1), _minPts(1), bDenseMatrix(false) {}
     /**
       Deconstructor, deinstanciating everything that has been instanciated
       */
@@ -78,20 +96,20 @@ public:
     bool SetClusterTestValue(int count, int max);
 
     /**
-      Function to set the algorithm hyper-parameters, called prior to the training itself
+      Function to set the algorithm hyper-parameters, called prior to the training itself.
+      bDenseMatrix caches all the pairwise distances instead of using the spatial index (tiny datasets only)
       */
-    void SetParams(float minpts, float eps, int metric, float depth,int type);
+    void SetParams(float minpts, float eps, int metric, float depth,int type, bool bDenseMatrix=false);
 
     /**
       Function to compute the similarity matrix used as cache for the distances between points
       */
-    template <typename Distance_type>
-    void computeSimilarity(Distance_type & d,Points samples);
+    void computeSimilarity();
 
     /**
-      Function to get all the points within a distance given by the threshold
+      Function to get all the points within a distance given by the threshold, and optionally their distances
       */
-    Neighbors findNeighbors(PointId pid, double threshold);
+    Neighbors findNeighbors(PointId pid, double threshold, std::vector<double> *distances=0);
 
     /**
       Run DBSCAN
@@ -101,12 +119,12 @@ public:
     /**
       Function to update the reachability of a given point according to its core-distance
       */
-    void update_reachability(Neighbors ne,PointId pid,double core_dist,QMultiMap<double,PointId> &queue);
+    void update_reachability(const Neighbors &ne, const std::vector<double> &distances, double core_dist, OpticsQueue &queue);
 
     /**
-      Function to compute the core-distance of a points
+      Function to compute the core-distance of a point from the distances to its neighbors
       */
-    double core_distance(PointId pid,double threshold);
+    double core_distance(std::vector<double> distances);
 
     /**
       Run OPTICS
@@ -148,8 +166,18 @@ private:
     // the collection of clusters
     std::vector<CCluster> _clusters;
 
-    // simarity_matrix
+    // simarity_matrix, only when bDenseMatrix is set
     boost::numeric::ublas::matrix<double> _sim;
+    bool bDenseMatrix;
+
+    // the samples as a contiguous matrix, and the spatial index over them
+    // (over the normalized samples for the cosine distance)
+    fvec data;
+    fvec normalized;
+    NeighborIndex index;
+
+    double distance(const float *a, const float *b) const;
+    float boxRadius(double threshold) const;
 
     // eps radiuus
     // Two points are neighbors if the distance
@@ -161,6 +189,10 @@ private:
 
     std::vector<bool> _visited;
 
+    // number of entries pushed in the OPTICS queue, and when each point was last queued
+    int _queued;
+    std::vector<int> _queueOrder;
+
     // depth of the pits to identify on the plot
     float _depth;
     // metric to be used for compèuting the distances (0:Cosine,1:Euclidean)
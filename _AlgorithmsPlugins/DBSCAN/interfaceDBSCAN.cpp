@@ -101,14 +101,16 @@ fvec ClustDBSCAN::GetParams()
     int metric = params->metricCombo->currentIndex();
     int type = params->typeCombo->currentIndex();
     double depth = params->depthSpin->value();
+    bool bDenseMatrix = params->denseCheck->isChecked();
 
     int i=0;
-    fvec par(5);
+    fvec par(6);
     par[i++] = minNeighbours;
     par[i++] = eps;
     par[i++] = metric;
     par[i++] = type;
     par[i++] = depth;
+    par[i++] = bDenseMatrix;
     return par;
 }
 
@@ -124,8 +126,9 @@ void ClustDBSCAN::SetParams(Clusterer *clusterer, fvec parameters)
     int metric = (int)parameters.size() > i ? parameters[i] : 0; i++;
     int type = (int)parameters.size() > i ? parameters[i] : 0; i++;
     float depth = (int)parameters.size() > i ? parameters[i] : 0; i++;
+    bool bDenseMatrix = (int)parameters.size() > i ? parameters[i] : 0; i++;
 
-    dbscan->SetParams(minpts, eps, metric,depth,type);
+    dbscan->SetParams(minpts, eps, metric,depth,type, bDenseMatrix);
 }
 
 void ClustDBSCAN::GetParameterList(std::vector<QString> &parameterNames,
@@ -140,11 +143,13 @@ void ClustDBSCAN::GetParameterList(std::vector<QString> &parameterNames,
     parameterNames.push_back("Metric Type");
     parameterNames.push_back("Algorithm");
     parameterNames.push_back("Depth.");
+    parameterNames.push_back("Dense Matrix");
     parameterTypes.push_back("Integer");
     parameterTypes.push_back("Real");
     parameterTypes.push_back("List");
     parameterTypes.push_back("List");
     parameterTypes.push_back("Real");
+    parameterTypes.push_back("List");
     parameterValues.push_back(vector<QString>());
     parameterValues.back().push_back("1");
     parameterValues.back().push_back("99999");
@@ -161,6 +166,9 @@ void ClustDBSCAN::GetParameterList(std::vector<QString> &parameterNames,
     parameterValues.push_back(vector<QString>());
     parameterValues.back().push_back("0.00000000001f");
     parameterValues.back().push_back("99999999.f");
+    parameterValues.push_back(vector<QString>());
+    parameterValues.back().push_back("False");
+    parameterValues.back().push_back("True");
 }
 
 Clusterer *ClustDBSCAN::GetClusterer()
@@ -448,6 +456,7 @@ void ClustDBSCAN::SaveOptions(QSettings &settings)
     settings.setValue("Metric", params->metricCombo->currentIndex());
     settings.setValue("Type", params->typeCombo->currentIndex());
     settings.setValue("Depth", params->depthSpin->value());
+    settings.setValue("DenseMatrix", params->denseCheck->isChecked());
  }
 
 bool ClustDBSCAN::LoadOptions(QSettings &settings)
@@ -458,6 +467,7 @@ bool ClustDBSCAN::LoadOptions(QSettings &settings)
     if(settings.contains("Metric")) params->metricCombo->setCurrentIndex(settings.value("Metric").toInt());
     if(settings.contains("Type")) params->typeCombo->setCurrentIndex(settings.value("Type").toInt());
     if(settings.contains("Depth")) params->depthSpin->setValue(settings.value("Depth").toFloat());
+    if(settings.contains("DenseMatrix")) params->denseCheck->setChecked(settings.value("DenseMatrix").toBool());
     if(params->typeCombo->currentIndex()==0) // prepare also the interface by hidding unnecessary stuff
     {
         params->depthSpin->setVisible(false);
@@ -476,6 +486,7 @@ void ClustDBSCAN::SaveParams(QTextStream &file)
     file << "clusterOptions" << ":" << "Metric" << " " << params->metricCombo->currentIndex() << "\n";
     file << "clusterOptions" << ":" << "Depth" << " " << params->depthSpin->value() << "\n";
     file << "clusterOptions" << ":" << "Type" << " " << params->typeCombo->currentIndex() << "\n";
+    file << "clusterOptions" << ":" << "DenseMatrix" << " " << params->denseCheck->isChecked() << "\n";
 }
 
 bool ClustDBSCAN::LoadParams(QString name, float value)
@@ -486,6 +497,7 @@ bool ClustDBSCAN::LoadParams(QString name, float value)
     if(name.endsWith("Metric")) params->metricCombo->setCurrentIndex((int)value);
     if(name.endsWith("Depth")) params->depthSpin->setValue(value);
     if(name.endsWith("Type")) params->typeCombo->setCurrentIndex((int)value);
+    if(name.endsWith("DenseMatrix")) params->denseCheck->setChecked((int)value);
     if(params->typeCombo->currentIndex()==0) // prepare also the interface by hidding unnecessary stuff
     {
         params->depthSpin->setVisible(false);
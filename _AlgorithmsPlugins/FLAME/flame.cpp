@@ -27,10 +27,61 @@ Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
 #include <string.h>
 #include <math.h>
 #include <stdio.h>
+#include <algorithm>
+#include <functional>
+#include <vector>
+#include <QThread>
+#include <QThreadPool>
+#include <QRunnable>
+#include <QAtomicInt>
 
 using namespace std;
 
 #include "flame.h"
+#include "neighborIndex.h"
+
+/* Objects handled at once by a thread in the parallel loops. */
+#define FLAME_BLOCK 64
+
+typedef std::function<void(int,int)> FlameJob;
+
+/* Takes the next block of objects until all have been processed. */
+class FlameWorker : public QRunnable
+{
+public:
+        FlameWorker( const FlameJob &job, QAtomicInt &next, int n )
+                : job( job ), next( next ), n( n ) {}
+        void run() {
+                int first;
+                while( (first = next.fetchAndAddOrdered( FLAME_BLOCK )) < n )
+                        job( first, min( first + FLAME_BLOCK, n ) );
+        }
+private:
+        const FlameJob &job;
+        QAtomicInt &next;
+        int n;
+};
+
+/* Calls job( first, last ) on the blocks of FLAME_BLOCK objects of [0,n),
+ * starting at multiples of FLAME_BLOCK, spread over the available cores. */
+void Flame_Parallel( int n, const FlameJob &job ) {
+        int first;
+        int blocks = (n + FLAME_BLOCK - 1) / FLAME_BLOCK;
+        int threadCount = min( QThread::idealThreadCount(), blocks );
+        if( threadCount <= 1 ){
+                for(first=0; first<n; first+=FLAME_BLOCK) job( first, min( first + FLAME_BLOCK, n ) );
+                return;
+        }
+        QAtomicInt next( 0 );
+        QThreadPool pool;
+        pool.setMaxThreadCount( threadCount );
+        for(int i=0; i<threadCount; i++) pool.start( new FlameWorker( job, next, n ) );
+        pool.waitForDone();
+}
+
+bool IndexFloat_Less( const IndexFloat &a, const IndexFloat &b ) {
+        return a.value < b.value || ( a.value == b.value && a.index < b.index );
+}
 
  /*
  Quick Sort.
@@ -223,12 +274,6 @@ int Int_New() {
 
 void Flame_Clear( Flame *self ) {
         int i;
-        for(i=0; i<self->N; i++){
-                free( self->graph[i] );
-                free( self->dists[i] );
-                free( self->weights[i] );
-                free( self->fuzzyships[i] );
-        }
         if( self->clusters ){
                 for(i=0; i<=self->cso_count; i++){
                         if( self->clusters[i].array ) free( self->clusters[i].array );
@@ -251,49 +296,78 @@ void Flame_Clear( Flame *self ) {
         self->N = self->K = self->KMAX = self->cso_count = 0;
 }
 
+/* The MAX nearest neighbors of each object (itself excluded) from a kd-tree,
+ * for the distances it supports: the euclidean and manhattan ones. */
+void Flame_SetIndexedNeighbors( Flame *self, float *data[], int n, int m, int MAX ) {
+        int i;
+        bool bEuclidean = self->distfunc == Flame_Euclidean;
+        fvec points( (size_t)n*m );
+        NeighborIndex index;
+        for(i=0; i<n; i++) memcpy( &points[(size_t)i*m], data[i], m*sizeof(float) );
+        index.SetMetric( bEuclidean ? NeighborIndex::METRIC_L2 : NeighborIndex::METRIC_L1 );
+        index.Build( &points[0], n, m );
+        Flame_Parallel( n, [&]( int first, int last ){
+                NeighborQuery &query = NeighborQuery::Local();
+                for(int i=first; i<last; i++){
+                        int *ids = self->graph + (size_t)i*MAX;
+                        float *dists = self->dists + (size_t)i*MAX;
+                        index.KNearest( index.row( i ), MAX, query, i );
+                        for(int j=0; j<MAX; j++){
+                                ids[j] = query.indices[j];
+                                /* the tree works on squared euclidean distances */
+                                dists[j] = bEuclidean ? sqrt( query.distances[j] ) : query.distances[j];
+                        }
+                }
+        });
+}
+
+/* The MAX nearest neighbors of each object (itself excluded) by computing
+ * its distance to all the others. If m==0, data is distance matrix. */
+void Flame_SetScannedNeighbors( Flame *self, float *data[], int n, int m, int MAX ) {
+        Flame_Parallel( n, [&]( int first, int last ){
+                vector<IndexFloat> vals( n-1 );
+                for(int i=first; i<last; i++){
+                        int *ids = self->graph + (size_t)i*MAX;
+                        float *dists = self->dists + (size_t)i*MAX;
+                        int count = 0;
+                        for(int j=0; j<n; j++){
+                                if( j == i ) continue;
+                                vals[count].index = j;
+                                vals[count].value = m ? self->distfunc( data[i], data[j], m ) : data[i][j];
+                                count ++;
+                        }
+                        /* Only the MAX nearest neighbors need to be sorted. */
+                        nth_element( vals.begin(), vals.begin() + MAX-1, vals.end(), IndexFloat_Less );
+                        sort( vals.begin(), vals.begin() + MAX, IndexFloat_Less );
+                        for(int j=0; j<MAX; j++){
+                                ids[j] = vals[j].index;
+                                dists[j] = vals[j].value;
+                        }
+                }
+        });
+}
+
 /* If m==0, data is distance matrix. */
 void Flame_SetMatrix( Flame *self, float *data[], int n, int m ) {
-        int i, j, k;
         int MAX = sqrt( n ) + 10;
-        IndexFloat *vals = (IndexFloat*) calloc( n, sizeof(IndexFloat) );
         if( MAX >= n ) MAX = n - 1;
 
         Flame_Clear( self );
         self->N = n;
         self->KMAX = MAX;
 
-        self->graph = (int**) calloc( n, sizeof(int*) );
-        self->dists = (float**) calloc( n, sizeof(float*) );
-        self->weights = (float**) calloc( n, sizeof(float*) );
+        self->graph = (int*) calloc( (size_t)n*MAX, sizeof(int) );
+        self->dists = (float*) calloc( (size_t)n*MAX, sizeof(float) );
+        self->weights = (float*) calloc( (size_t)n*MAX, sizeof(float) );
         self->nncounts = (int*) calloc( n, sizeof(int) );
         self->obtypes = (char*) calloc( n, sizeof(char) );
-        self->fuzzyships = (float**) calloc( n, sizeof(float*) );
+        if( MAX <= 0 ) return;
 
-        for(i=0; i<n; i++){
-                self->graph[i] = (int*) calloc( MAX, sizeof(int) );
-                self->dists[i] = (float*) calloc( MAX, sizeof(float) );
-                self->weights[i] = (float*) calloc( MAX, sizeof(float) );
-                if( m ==0 ){
-                        /* data is distance matrix. */
-                        for(j=0; j<n; j++){
-                                vals[j].index = j;
-                                vals[j].value = data[i][j];
-                        }
-                }else{
-                        /* data is raw data matrix. */
-                        for(j=0; j<n; j++){
-                                vals[j].index = j;
-                                vals[j].value = self->distfunc( data[i], data[j], m );
-                        }
-                }
-                PartialQuickSort( vals, 0, n-1, MAX+1 );
-                /* Store MAX number of nearest neighbors. */
-                for(j=0; j<MAX; j++){
-                        self->graph[i][j] = vals[j+1].index;
-                        self->dists[i][j] = vals[j+1].value;
-                }
-        }
-        free( vals );
+        /* Store MAX number of nearest neighbors. */
+        if( m > 0 && ( self->distfunc == Flame_Euclidean || self->distfunc == Flame_Manhattan ) )
+                Flame_SetIndexedNeighbors( self, data, n, m, MAX );
+        else
+                Flame_SetScannedNeighbors( self, data, n, m, MAX );
 }
 
 void Flame_SetDataMatrix( Flame *self, float *data[], int n, int m, int dt ) {
@@ -311,7 +385,6 @@ void Flame_DefineSupports( Flame *self, int knn, float thd ) {
         int i, j, k;
         int n = self->N;
         int kmax = self->KMAX;
-        float **dists = self->dists;
         float *density = (float*) calloc( n, sizeof(float) );
         float d, sum, sum2, fmin, fmax = 0.0;
 
@@ -320,9 +393,11 @@ void Flame_DefineSupports( Flame *self, int knn, float thd ) {
         for(i=0; i<n; i++) {
                 /* To include all the neighbors that have distances equal to the
                  * distance of the most distant one of the K-Nearest Neighbors */
+                float *dists = self->dists + (size_t)i*kmax;
+                float *weights = self->weights + (size_t)i*kmax;
                 k = knn;
-                d = dists[i][knn-1];
-                for(j=knn; j<kmax; j++) if( dists[i][j] == d ) k ++; else break;
+                d = dists[knn-1];
+                for(j=knn; j<kmax; j++) if( dists[j] == d ) k ++; else break;
                 self->nncounts[i] = k;
 
                 /* The definition of weights in this implementation is
@@ -333,10 +408,10 @@ void Flame_DefineSupports( Flame *self, int knn, float thd ) {
                  * the ranking of distances of the neighbors, so it is more
                  * robust against distance transformations. */
                 sum = 0.5*k*(k+1.0);
-                for(j=0; j<k; j++) self->weights[i][j] = (k-j) / sum;
+                for(j=0; j<k; j++) weights[j] = (k-j) / sum;
 
                 sum = 0.0;
-                for(j=0; j<k; j++) sum += dists[i][j];
+                for(j=0; j<k; j++) sum += dists[j];
                 density[i] = 1.0 / (sum + EPSILON);
         }
         sum = 0.0;
@@ -352,16 +427,17 @@ void Flame_DefineSupports( Flame *self, int knn, float thd ) {
         memset( self->obtypes, 0, n*sizeof(char) );
         self->cso_count = 0;
         for(i=0; i<n; i++) {
+                int *ids = self->graph + (size_t)i*kmax;
                 k = self->nncounts[i];
                 fmax = 0.0;
-                fmin = density[i] / density[ self->graph[i][0] ];
+                fmin = density[i] / density[ ids[0] ];
                 for(j=1; j<k; j++){
-                        d = density[i] / density[ self->graph[i][j] ];
+                        d = density[i] / density[ ids[j] ];
                         if( d > fmax ) fmax = d;
                         if( d < fmin ) fmin = d;
                         /* To avoid defining neighboring objects or objects close
                          * to an outlier as CSOs.  */
-                        if( self->obtypes[ self->graph[i][j] ] ) fmin = 0.0;
+                        if( self->obtypes[ ids[j] ] ) fmin = 0.0;
                 }
                 if( fmin >= 1.0 ){
                         self->cso_count ++;
@@ -373,78 +449,88 @@ void Flame_DefineSupports( Flame *self, int knn, float thd ) {
         free( density );
 }
 
+/* Update membership of object i in fuzzy by a linear combination of the
+ * memberships of its nearest neighbors in fuzzy2, and return the squared
+ * difference with its previous memberships. Only fuzzy[i] is written, so that
+ * the objects can be updated concurrently. */
+double Flame_Propagate( Flame *self, int i, float *fuzzy, const float *fuzzy2, bool bNormalize ) {
+        int j, k, C = self->cso_count+1;
+        int knn = self->nncounts[i];
+        const int *ids = self->graph + (size_t)i*self->KMAX;
+        const float *wt = self->weights + (size_t)i*self->KMAX;
+        const float *previous = fuzzy2 + (size_t)i*C;
+        double dev = 0.0, sum = 0.0;
+        fuzzy += (size_t)i*C;
+        for(j=0; j<C; j++) fuzzy[j] = 0.0;
+        /* Neighbor by neighbor, so that their memberships are read contiguously. */
+        for(k=0; k<knn; k++){
+                const float *neighbor = fuzzy2 + (size_t)ids[k]*C;
+                for(j=0; j<C; j++) fuzzy[j] += wt[k] * neighbor[j];
+        }
+        for(j=0; j<C; j++){
+                dev += (fuzzy[j] - previous[j]) * (fuzzy[j] - previous[j]);
+                sum += fuzzy[j];
+        }
+        if( bNormalize ) for(j=0; j<C; j++) fuzzy[j] = fuzzy[j] / sum;
+        return dev;
+}
+
 void Flame_LocalApproximation( Flame *self, int steps, float epsilon) {
-        int i, j, k, t, n = self->N, m = self->cso_count;
-        float **fuzzyships = self->fuzzyships;
-        float **fuzzyships2 = (float**)calloc( n, sizeof(float*) );
+        int i, j, k, t, n = self->N, m = self->cso_count, C = m+1;
+        float *fuzzyships, *fuzzyships2;
         char *obtypes = self->obtypes;
         char even = 0;
         double dev = 0;
-
+        /* Deviation of each block, summed in order so that the result
+         * does not depend on the number of threads. */
+        vector<double> devs( (n + FLAME_BLOCK - 1) / FLAME_BLOCK );
+
+        self->fuzzyships = (float*) realloc( self->fuzzyships, (size_t)n*C*sizeof(float) );
+        fuzzyships = self->fuzzyships;
+        fuzzyships2 = (float*) calloc( (size_t)n*C, sizeof(float) );
+        memset( fuzzyships, 0, (size_t)n*C*sizeof(float) );
         k = 0;
         for(i=0; i<n; i++){
-                fuzzyships[i] = (float*) realloc( fuzzyships[i], (m+1)*sizeof(float) );
-                fuzzyships2[i] = (float*) calloc( m+1, sizeof(float) );
-                memset( fuzzyships[i], 0, (m+1)*sizeof(float) );
+                float *fuzzy = fuzzyships + (size_t)i*C;
+                float *fuzzy2 = fuzzyships2 + (size_t)i*C;
                 if( obtypes[i] == OBT_SUPPORT ){
                         /* Full membership to the cluster represented by itself. */
-                        fuzzyships[i][k] = 1.0;
-                        fuzzyships2[i][k] = 1.0;
+                        fuzzy[k] = 1.0;
+                        fuzzy2[k] = 1.0;
                         k ++;
                 }else if( obtypes[i] == OBT_OUTLIER ){
                         /* Full membership to the outlier group. */
-                        fuzzyships[i][m] = 1.0;
-                        fuzzyships2[i][m] = 1.0;
+                        fuzzy[m] = 1.0;
+                        fuzzy2[m] = 1.0;
                 }else{
                         /* Equal memberships to all clusters and the outlier group.
                          * Random initialization does not change the results. */
                         for(j=0; j<=m; j++)
-                                fuzzyships[i][j] = fuzzyships2[i][j] = 1.0/(m+1);
+                                fuzzy[j] = fuzzy2[j] = 1.0/(m+1);
                 }
         }
         for(t=0; t<steps; t++){
-                dev = 0;
-                for(i=0; i<n; i++){
-                        int knn = self->nncounts[i];
-                        int *ids = self->graph[i];
-                        float *wt = self->weights[i];
-                        float *fuzzy = fuzzyships[i];
-                        float **fuzzy2 = fuzzyships2;
-                        double sum = 0.0;
-                        if( self->obtypes[i] != OBT_NORMAL ) continue;
-                        if( even ){
-                                fuzzy = fuzzyships2[i];
-                                fuzzy2 = fuzzyships;
+                float *fuzzy = even ? fuzzyships2 : fuzzyships;
+                const float *fuzzy2 = even ? fuzzyships : fuzzyships2;
+                Flame_Parallel( n, [&]( int first, int last ){
+                        double blockDev = 0.0;
+                        for(int i=first; i<last; i++){
+                                if( obtypes[i] != OBT_NORMAL ) continue;
+                                blockDev += Flame_Propagate( self, i, fuzzy, fuzzy2, true );
                         }
-                        /* Update membership of an object by a linear combination of
-                         * the memberships of its nearest neighbors. */
-                        for(j=0; j<=m; j++){
-                                fuzzy[j] = 0.0;
-                                for(k=0; k<knn; k++) fuzzy[j] += wt[k] * fuzzy2[ ids[k] ][j];
-                                dev += (fuzzy[j] - fuzzy2[i][j]) * (fuzzy[j] - fuzzy2[i][j]);
-                                sum += fuzzy[j];
-                        }
-                        for(j=0; j<=m; j++) fuzzy[j] = fuzzy[j] / sum;
-                }
+                        devs[first / FLAME_BLOCK] = blockDev;
+                });
+                dev = 0;
+                for(i=0; i<(int)devs.size(); i++) dev += devs[i];
                 even = ! even;
                 if( dev < epsilon ) break;
         }
         self->steps = t;
         /* update the membership of all objects to remove clusters
          * that contains only the CSO. */
-        for (i=0; i<n; i++){
-                int knn = self->nncounts[i];
-                int *ids = self->graph[i];
-                float *wt = self->weights[i];
-                float *fuzzy = fuzzyships[i];
-                float **fuzzy2 = fuzzyships2;
-                for(j=0; j<=m; j++){
-                        fuzzy[j] = 0.0;
-                        for(k=0; k<knn; k++) fuzzy[j] += wt[k] * fuzzy2[ ids[k] ][j];
-                        dev += (fuzzy[j] - fuzzy2[i][j]) * (fuzzy[j] - fuzzy2[i][j]);
-                }
-        }
-        for (i=0; i<n; i++) free( fuzzyships2[i] );
+        Flame_Parallel( n, [&]( int first, int last ){
+                for(int i=first; i<last; i++) Flame_Propagate( self, i, fuzzyships, fuzzyships2, false );
+        });
         free( fuzzyships2 );
 }
 
@@ -462,7 +548,7 @@ void Flame_MakeClusters( Flame *self, float thd ) {
         int N = self->N;
         int C = self->cso_count+1;
         float fmax;
-        float **fuzzyships = self->fuzzyships;
+        float *fuzzyships = self->fuzzyships;
         IntArray *clust;
         IndexFloat *vals = (IndexFloat*) calloc( N, sizeof(IndexFloat) );
 
@@ -471,7 +557,7 @@ void Flame_MakeClusters( Flame *self, float thd ) {
                 vals[i].index = i;
                 vals[i].value = 0.0;
                 for(j=0; j<C; j++){
-                        float fs = fuzzyships[i][j];
+                        float fs = fuzzyships[(size_t)i*C+j];
                         if( fs > EPSILON ) vals[i].value -= fs * log( fs );
                 }
         }
@@ -491,9 +577,9 @@ void Flame_MakeClusters( Flame *self, float thd ) {
                         fmax = 0;
                         imax = -1;
                         for(j=0; j<C; j++){
-                                if( fuzzyships[id][j] > fmax ){
+                                if( fuzzyships[(size_t)id*C+j] > fmax ){
                                         imax = j;
-                                        fmax = fuzzyships[id][j];
+                                        fmax = fuzzyships[(size_t)id*C+j];
                                 }
                         }
                         IntArray_Push( self->clusters + imax, id );
@@ -506,7 +592,7 @@ void Flame_MakeClusters( Flame *self, float thd ) {
                         int id = vals[i].index;
                         imax = -1;
                         for(j=0; j<C; j++){
-                                if( fuzzyships[id][j] > thd || ( j == C-1 && imax <0 ) ){
+                                if( fuzzyships[(size_t)id*C+j] > thd || ( j == C-1 && imax <0 ) ){
                                         imax = j;
                                         IntArray_Push( self->clusters + j, id );
                                 }
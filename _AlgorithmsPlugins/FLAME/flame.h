@@ -111,22 +111,26 @@ struct Flame
 	/* Stores the KMAX nearest neighbors instead of K nearest neighbors
 	 * for each objects, so that when K is changed, weights and CSOs can be
 	 * re-computed without referring to the original data.
+	 * The neighbors of object i are graph[i*KMAX] to graph[i*KMAX+KMAX-1],
+	 * sorted by increasing distance; dists and weights use the same layout.
 	 */
-	int   **graph;
+	int   *graph;
 	/* Distances to the KMAX nearest neighbors. */
-	float **dists;
+	float *dists;
 
 	/* Nearest neighbor count.
 	 * it can be different from K if an object has nearest neighbors with
 	 * equal distance. */
 	int    *nncounts;
-	float **weights;
+	float *weights;
 
 	/* Number of identified Cluster Supporting Objects */
 	int cso_count;
 	char *obtypes;
 
-	float **fuzzyships;
+	/* Memberships of object i in fuzzyships[i*(cso_count+1)] and the following
+	 * cso_count entries, the last one being the outlier group. */
+	float *fuzzyships;
 	
 	/* Number of clusters including the outlier group */
 	int count;
@@ -148,7 +152,10 @@ void Flame_Clear( Flame *self );
  * 
  * If T==DST_USER or T>=DST_NULL, and Flame::distfunc member is set,
  * then Flame::distfunc is used to compute the distances;
- * Otherwise, Flame_Euclidean() is used. */
+ * Otherwise, Flame_Euclidean() is used.
+ * The nearest neighbors are found with a kd-tree for the euclidean and
+ * manhattan distances, and by scanning all the objects otherwise; in both
+ * cases the objects are processed in parallel. */
 void Flame_SetDataMatrix( Flame *self, float *data[], int N, int M, int T );
 
 /* Set a pre-computed NxN distance matrix. */
@@ -170,7 +177,8 @@ void Flame_DefineSupports( Flame *self, int knn, float thd );
 /* Local Approximation of fuzzy memberships.
  * Stopped after the maximum steps of iterations;
  * Or stopped when the overall membership difference between
- * two iterations become less than epsilon. */
+ * two iterations become less than epsilon.
+ * Each iteration updates all the objects in parallel. */
 void Flame_LocalApproximation( Flame *self, int steps, float epsilon );
 
 /* Construct clusters.
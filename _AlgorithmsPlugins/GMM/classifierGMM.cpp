@@ -26,14 +26,12 @@ Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
 
 using namespace std;
 
-fvec pdfMulti;
-fvec pdfSingle(1);
-
 ClassifierGMM::ClassifierGMM()
 	: nbClusters(2), covarianceType(2), initType(1)
 {
 	bSingleClass = false;
 	bMultiClass = true;
+	bThreadSafe = true;
     bUseClassPriors = false;
 }
 
@@ -106,11 +104,12 @@ void ClassifierGMM::Train(std::vector< fvec > samples, ivec labels)
 		gmms[i]->init(data[i], s.size(), initType);
         gmms[i]->em(data[i], s.size(), 1e-4, (COVARIANCE_TYPE)covarianceType);
 	}
-    pdfMulti.resize(gmms.size());
 }
 
 fvec ClassifierGMM::TestMulti(const fvec &sample) const
 {
+    // the responses are kept local so that the model can be tested from several threads
+    fvec pdfMulti(gmms.size());
     FOR(i, gmms.size()) pdfMulti[i] = gmms[i]->pdf((float*)&sample[0]);
 	if(gmms.size()==2)
 	{
@@ -121,8 +120,7 @@ fvec ClassifierGMM::TestMulti(const fvec &sample) const
         }
         float p1 = logf(pdfMulti[1]*prior1);
         float p0 = logf(pdfMulti[0]*prior0);
-        pdfSingle[0] = (p1 - p0);
-        return pdfSingle;
+        return fvec(1, p1 - p0);
 	}
 
     float xmin=-1000.f, xmax=1000.f; // we clamp the value between these two
@@ -136,6 +134,40 @@ fvec ClassifierGMM::TestMulti(const fvec &sample) const
     return pdfMulti;
 }
 
+int ClassifierGMM::TestMultiBatch(const float *rowMajor, int count, int dim, fvec &out) const
+{
+    out.clear();
+    if(!gmms.size()) return 0;
+    // we compute the likelihoods of the whole batch for each class model
+    fvec pdfs(gmms.size()*count);
+    FOR(i, gmms.size()) gmms[i]->pdfBatch(rowMajor, count, &pdfs[i*count]);
+    if(gmms.size()==2)
+    {
+        float prior1 = 1.f, prior0 = 1.f;
+        if(bUseClassPriors) {
+            prior1 = priors[1];
+            prior0 = priors[0];
+        }
+        out.resize(count);
+        FOR(i, count) out[i] = logf(pdfs[count+i]*prior1) - logf(pdfs[i]*prior0);
+        return 1;
+    }
+
+    int resDim = gmms.size();
+    float xmin=-1000.f, xmax=1000.f; // we clamp the value between these two
+    out.resize(count*resDim);
+    FOR(c, resDim)
+    {
+        float prior = bUseClassPriors ? priors[c] : 1.f;
+        FOR(i, count)
+        {
+            float value = logf(pdfs[c*count + i]*prior);
+            out[i*resDim + c] = (min(xmax,max(xmin, value)) - xmin) / (xmax);
+        }
+    }
+    return resDim;
+}
+
 float ClassifierGMM::Test( const fvec &sample) const
 {
 	fvec pdf = TestMulti(sample);
@@ -42,6 +42,7 @@ public:
     float Test(const fvec &sample) const ;
     float Test(const fVec &sample) const ;
     fvec TestMulti(const fvec &sample) const ;
+    int TestMultiBatch(const float *rowMajor, int count, int dim, fvec &out) const ;
     const char *GetInfoString() const ;
     void SaveModel(const std::string filename) const ;
     bool LoadModel(const std::string filename);
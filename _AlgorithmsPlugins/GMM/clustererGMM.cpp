@@ -30,6 +30,12 @@ ClustererGMM::~ClustererGMM()
 void ClustererGMM::Train(std::vector< fvec > samples)
 {
 	if(!samples.size()) return;
+    if(streamChunk)
+    {
+        // the samples are the next part of the stream: the current model is updated rather than refitted
+        Update(samples);
+        return;
+    }
     dim = samples[0].size();
 	DEL(gmm);
 	gmm = new Gmm(nbClusters, dim);
@@ -44,6 +50,37 @@ void ClustererGMM::Train(std::vector< fvec > samples)
 //	FOR(i, nbClusters) gmm->SetPrior(i, 1.f/nbClusters);
 }
 
+// stochastic EM: the first chunk initializes the model, each of the following ones moves it
+// towards the statistics of the chunk. Only one chunk is copied at a time, so that the memory
+// used does not depend on the length of the stream
+void ClustererGMM::Update(const std::vector< fvec > &samples)
+{
+    if(!samples.size()) return;
+    if(gmm && (samples[0].size() != dim || gmm->nstates != nbClusters)) DEL(gmm);
+    if(!gmm) streamSteps = 0;
+    dim = samples[0].size();
+    KILL(data);
+    u32 chunk = streamChunk ? streamChunk : samples.size();
+    fvec buffer(min((size_t)chunk, samples.size())*dim);
+    for(u32 start=0; start<samples.size(); start+=chunk)
+    {
+        u32 count = min((size_t)chunk, samples.size()-start);
+        FOR(i, count)
+        {
+            FOR(d, dim) buffer[i*dim + d] = samples[start+i][d];
+        }
+        if(!gmm)
+        {
+            if(count < nbClusters) continue;
+            gmm = new Gmm(nbClusters, dim);
+            gmm->init(&buffer[0], count, initType);
+            gmm->em(&buffer[0], count, -1e4, (COVARIANCE_TYPE)covarianceType);
+        }
+        else gmm->updateChunk(&buffer[0], count, powf(streamSteps+1, -streamDecay), (COVARIANCE_TYPE)covarianceType);
+        streamSteps++;
+    }
+}
+
 fvec ClustererGMM::Test( const fvec &sample)
 {
 	fvec res;
@@ -72,8 +109,26 @@ fvec ClustererGMM::Test( const fVec &sample)
 	return res;
 }
 
+fvec ClustererGMM::TestMany(const fvec &sampleMatrix, const int sampleDim, const int count)
+{
+    fvec results(count*nbClusters, 0);
+    if(!gmm || !count || sampleDim != dim || sampleMatrix.size() != sampleDim*count) return results;
+    if(gmm->nstates != nbClusters) return Clusterer::TestMany(sampleMatrix, sampleDim, count);
+    // the state densities of all the samples in one go, normalized into responsibilities
+    gmm->statePdfBatch(&sampleMatrix[0], count, &results[0]);
+    FOR(n, count)
+    {
+        float *res = &results[n*nbClusters];
+        float sum = 0;
+        FOR(i, nbClusters) sum += res[i];
+        if(sum > FLT_MIN*3) FOR(i, nbClusters) res[i] /= sum;
+    }
+    return results;
+}
+
 float ClustererGMM::GetLogLikelihood(std::vector<fvec> samples)
 {
+    if(!gmm) return 0;
     float *weights = new float[nbClusters];
     float logLik = 0;
     FOR(i, samples.size())
@@ -103,11 +158,13 @@ float ClustererGMM::GetParameterCount()
     return nbClusters;
 }
 
-void ClustererGMM::SetParams(u32 nbClusters, u32 covarianceType, u32 initType)
+void ClustererGMM::SetParams(u32 nbClusters, u32 covarianceType, u32 initType, u32 streamChunk, float streamDecay)
 {
 	this->nbClusters = nbClusters;
 	this->covarianceType = covarianceType;
 	this->initType = initType;
+    this->streamChunk = streamChunk;
+    this->streamDecay = streamDecay;
 }
 
 const char *ClustererGMM::GetInfoString()
@@ -141,5 +198,6 @@ const char *ClustererGMM::GetInfoString()
 		sprintf(text, "%sK-Means\n", text);
 		break;
 	}
+    if(streamChunk) sprintf(text, "%sStreaming: %d chunks of %d samples (decay %.2f)\n", text, streamSteps, streamChunk, streamDecay);
 	return text;
 }
@@ -31,24 +31,33 @@ private:
 	u32 covarianceType;
 	u32 initType;
 	float *data;
+    u32 streamChunk; // 0: batch EM, otherwise stochastic EM over chunks of streamChunk samples
+    float streamDecay; // the step of the t-th chunk is (t+1)^-streamDecay
+    u32 streamSteps;
 public:
-    ClustererGMM() : gmm(0), data(0), covarianceType(2), initType(1){}
+    ClustererGMM() : gmm(0), data(0), covarianceType(2), initType(1), streamChunk(0), streamDecay(0.6f), streamSteps(0){}
     ~ClustererGMM();
     ClustererGMM(const ClustererGMM& other) : Clusterer(other)
     {
-        gmm = new Gmm(*(other.gmm));
+        gmm = other.gmm ? new Gmm(*(other.gmm)) : 0;
         covarianceType = other.covarianceType;
         initType = other.initType;
+        streamChunk = other.streamChunk;
+        streamDecay = other.streamDecay;
+        streamSteps = other.streamSteps;
         data=0;
     }
     virtual ClustererGMM* clone() const { return new ClustererGMM(*this);}
 	void Train(std::vector< fvec > samples);
+    void Update(const std::vector< fvec > &samples);
 	fvec Test( const fvec &sample);
 	fvec Test( const fVec &sample);
+    fvec TestMany(const fvec &sampleMatrix, const int sampleDim, const int count);
     const char *GetInfoString();
     float GetLogLikelihood(std::vector<fvec> samples);
     float GetParameterCount();
-	void SetParams(u32 nbClusters, u32 covarianceType, u32 initType);
+    bool IsStreaming() const {return streamChunk != 0;}
+	void SetParams(u32 nbClusters, u32 covarianceType, u32 initType, u32 streamChunk=0, float streamDecay=0.6f);
 };
 
 #endif // _CLUSTERER_GMM_H_
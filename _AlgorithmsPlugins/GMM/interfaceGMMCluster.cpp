@@ -48,10 +48,12 @@ void ClustGMM::SetParams(Clusterer *clusterer)
 
 fvec ClustGMM::GetParams()
 {
-    fvec par(3);
+    fvec par(5);
     par[0] = params->gmmCount->value();
     par[1] = params->gmmCovarianceCombo->currentIndex();
     par[2] = params->gmmInitCombo->currentIndex();
+    par[3] = params->gmmStreamSpin->value();
+    par[4] = params->gmmDecaySpin->value();
     return par;
 }
 
@@ -61,7 +63,9 @@ void ClustGMM::SetParams(Clusterer *clusterer, fvec parameters)
     int clusters = parameters.size() > 0 ? parameters[0] : 1;
     int covType = parameters.size() > 1 ? parameters[1] : 0;
     int initType = parameters.size() > 2 ? parameters[2] : 0;
-    ((ClustererGMM *)clusterer)->SetParams(clusters, covType, initType);
+    int streamChunk = parameters.size() > 3 ? parameters[3] : 0;
+    float streamDecay = parameters.size() > 4 ? parameters[4] : 0.6f;
+    ((ClustererGMM *)clusterer)->SetParams(clusters, covType, initType, streamChunk, streamDecay);
 }
 
 void ClustGMM::GetParameterList(std::vector<QString> &parameterNames,
@@ -74,9 +78,13 @@ void ClustGMM::GetParameterList(std::vector<QString> &parameterNames,
     parameterNames.push_back("Components Count");
     parameterNames.push_back("Covariance Type");
     parameterNames.push_back("Initialization Type");
+    parameterNames.push_back("Stream Chunk Size");
+    parameterNames.push_back("Stream Step Decay");
     parameterTypes.push_back("Integer");
     parameterTypes.push_back("List");
     parameterTypes.push_back("List");
+    parameterTypes.push_back("Integer");
+    parameterTypes.push_back("Real");
     parameterValues.push_back(vector<QString>());
     parameterValues.back().push_back("1");
     parameterValues.back().push_back("999");
@@ -88,6 +96,12 @@ void ClustGMM::GetParameterList(std::vector<QString> &parameterNames,
     parameterValues.back().push_back("Random");
     parameterValues.back().push_back("Uniform");
     parameterValues.back().push_back("K-Means");
+    parameterValues.push_back(vector<QString>());
+    parameterValues.back().push_back("0");
+    parameterValues.back().push_back("1000000");
+    parameterValues.push_back(vector<QString>());
+    parameterValues.back().push_back("0.5");
+    parameterValues.back().push_back("1");
 }
 
 void ClustGMM::ShowMarginals()
@@ -111,6 +125,7 @@ void ClustGMM::DrawInfo(Canvas *canvas, QPainter &painter, Clusterer *clusterer)
 
 	ClustererGMM * _gmm = (ClustererGMM*)clusterer;
 	Gmm *gmm = _gmm->gmm;
+	if(!gmm) return; // a stream too short to initialize the model
 	int dim = gmm->dim;
 	float mean[2];
 	float sigma[3];
@@ -242,6 +257,7 @@ void ClustGMM::DrawGL(Canvas *canvas, GLWidget *glw, Clusterer *clusterer)
 
     if(!dynamic_cast<ClustererGMM*>(clusterer)) return;
     Gmm* gmm = dynamic_cast<ClustererGMM*>(clusterer)->gmm;
+    if(!gmm) return;
 
     fvec mean(3);
     float eigVal[3], rot[4*4];
@@ -351,6 +367,8 @@ void ClustGMM::SaveOptions(QSettings &settings)
 	settings.setValue("gmmCount", params->gmmCount->value());
 	settings.setValue("gmmCovariance", params->gmmCovarianceCombo->currentIndex());
 	settings.setValue("gmmInit", params->gmmInitCombo->currentIndex());
+	settings.setValue("gmmStream", params->gmmStreamSpin->value());
+	settings.setValue("gmmDecay", params->gmmDecaySpin->value());
 }
 
 bool ClustGMM::LoadOptions(QSettings &settings)
@@ -358,6 +376,8 @@ bool ClustGMM::LoadOptions(QSettings &settings)
 	if(settings.contains("gmmCount")) params->gmmCount->setValue(settings.value("gmmCount").toFloat());
 	if(settings.contains("gmmCovariance")) params->gmmCovarianceCombo->setCurrentIndex(settings.value("gmmCovariance").toInt());
 	if(settings.contains("gmmInit")) params->gmmInitCombo->setCurrentIndex(settings.value("gmmInit").toInt());
+	if(settings.contains("gmmStream")) params->gmmStreamSpin->setValue(settings.value("gmmStream").toInt());
+	if(settings.contains("gmmDecay")) params->gmmDecaySpin->setValue(settings.value("gmmDecay").toFloat());
 	return true;
 }
 
@@ -366,6 +386,8 @@ void ClustGMM::SaveParams(QTextStream &file)
 	file << "clusterOptions" << ":" << "gmmCount" << " " << params->gmmCount->value() << "\n";
 	file << "clusterOptions" << ":" << "gmmCovariance" << " " << params->gmmCovarianceCombo->currentIndex() << "\n";
 	file << "clusterOptions" << ":" << "gmmInit" << " " << params->gmmInitCombo->currentIndex() << "\n";
+	file << "clusterOptions" << ":" << "gmmStream" << " " << params->gmmStreamSpin->value() << "\n";
+	file << "clusterOptions" << ":" << "gmmDecay" << " " << params->gmmDecaySpin->value() << "\n";
 }
 
 bool ClustGMM::LoadParams(QString name, float value)
@@ -373,5 +395,7 @@ bool ClustGMM::LoadParams(QString name, float value)
 	if(name.endsWith("gmmCount")) params->gmmCount->setValue((int)value);
 	if(name.endsWith("gmmCovariance")) params->gmmCovarianceCombo->setCurrentIndex((int)value);
 	if(name.endsWith("gmmInit")) params->gmmInitCombo->setCurrentIndex((int)value);
+	if(name.endsWith("gmmStream")) params->gmmStreamSpin->setValue((int)value);
+	if(name.endsWith("gmmDecay")) params->gmmDecaySpin->setValue(value);
 	return true;
 }
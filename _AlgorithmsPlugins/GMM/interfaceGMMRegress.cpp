@@ -48,10 +48,12 @@ void RegrGMM::SetParams(Regressor *regressor)
 
 fvec RegrGMM::GetParams()
 {
-    fvec par(3);
+    fvec par(5);
     par[0] = params->gmmCount->value();
     par[1] = params->gmmCovarianceCombo->currentIndex();
     par[2] = params->gmmInitCombo->currentIndex();
+    par[3] = params->gmmStreamSpin->value();
+    par[4] = params->gmmDecaySpin->value();
     return par;
 }
 
@@ -61,7 +63,9 @@ void RegrGMM::SetParams(Regressor *regressor, fvec parameters)
     int clusters = parameters.size() > 0 ? parameters[0] : 1;
     int covType = parameters.size() > 1 ? parameters[1] : 0;
     int initType = parameters.size() > 2 ? parameters[2] : 0;
-    ((RegressorGMR *)regressor)->SetParams(clusters, covType, initType);
+    int streamChunk = parameters.size() > 3 ? parameters[3] : 0;
+    float streamDecay = parameters.size() > 4 ? parameters[4] : 0.6f;
+    ((RegressorGMR *)regressor)->SetParams(clusters, covType, initType, streamChunk, streamDecay);
 }
 
 void RegrGMM::GetParameterList(std::vector<QString> &parameterNames,
@@ -74,9 +78,13 @@ void RegrGMM::GetParameterList(std::vector<QString> &parameterNames,
     parameterNames.push_back("Components Count");
     parameterNames.push_back("Covariance Type");
     parameterNames.push_back("Initialization Type");
+    parameterNames.push_back("Stream Chunk Size");
+    parameterNames.push_back("Stream Step Decay");
     parameterTypes.push_back("Integer");
     parameterTypes.push_back("List");
     parameterTypes.push_back("List");
+    parameterTypes.push_back("Integer");
+    parameterTypes.push_back("Real");
     parameterValues.push_back(vector<QString>());
     parameterValues.back().push_back("1");
     parameterValues.back().push_back("999");
@@ -88,6 +96,12 @@ void RegrGMM::GetParameterList(std::vector<QString> &parameterNames,
     parameterValues.back().push_back("Random");
     parameterValues.back().push_back("Uniform");
     parameterValues.back().push_back("K-Means");
+    parameterValues.push_back(vector<QString>());
+    parameterValues.back().push_back("0");
+    parameterValues.back().push_back("1000000");
+    parameterValues.push_back(vector<QString>());
+    parameterValues.back().push_back("0.5");
+    parameterValues.back().push_back("1");
 }
 
 void RegrGMM::ShowMarginals()
@@ -125,6 +139,7 @@ QString RegrGMM::GetAlgoString()
 		algo += " K-M";
 		break;
 	}
+	if(params->gmmStreamSpin->value()) algo += QString(" Str%1").arg(params->gmmStreamSpin->value());
 	return algo;
 }
 
@@ -343,6 +358,7 @@ void RegrGMM::DrawGL(Canvas *canvas, GLWidget *glw, Regressor *regressor)
 
     if(!dynamic_cast<RegressorGMR*>(regressor)) return;
     Gmm* gmr = dynamic_cast<RegressorGMR*>(regressor)->gmm;
+    if(!gmr) return;
 
     fvec mean(3);
     float eigVal[3], rot[4*4];
@@ -455,6 +471,8 @@ void RegrGMM::SaveOptions(QSettings &settings)
 	settings.setValue("gmmCount", params->gmmCount->value());
 	settings.setValue("gmmCovariance", params->gmmCovarianceCombo->currentIndex());
 	settings.setValue("gmmInit", params->gmmInitCombo->currentIndex());
+	settings.setValue("gmmStream", params->gmmStreamSpin->value());
+	settings.setValue("gmmDecay", params->gmmDecaySpin->value());
 }
 
 bool RegrGMM::LoadOptions(QSettings &settings)
@@ -462,6 +480,8 @@ bool RegrGMM::LoadOptions(QSettings &settings)
 	if(settings.contains("gmmCount")) params->gmmCount->setValue(settings.value("gmmCount").toFloat());
 	if(settings.contains("gmmCovariance")) params->gmmCovarianceCombo->setCurrentIndex(settings.value("gmmCovariance").toInt());
 	if(settings.contains("gmmInit")) params->gmmInitCombo->setCurrentIndex(settings.value("gmmInit").toInt());
+	if(settings.contains("gmmStream")) params->gmmStreamSpin->setValue(settings.value("gmmStream").toInt());
+	if(settings.contains("gmmDecay")) params->gmmDecaySpin->setValue(settings.value("gmmDecay").toFloat());
 	return true;
 }
 
@@ -470,6 +490,8 @@ void RegrGMM::SaveParams(QTextStream &file)
 	file << "regressionOptions" << ":" << "gmmCount" << " " << params->gmmCount->value() << "\n";
 	file << "regressionOptions" << ":" << "gmmCovariance" << " " << params->gmmCovarianceCombo->currentIndex() << "\n";
 	file << "regressionOptions" << ":" << "gmmInit" << " " << params->gmmInitCombo->currentIndex() << "\n";
+	file << "regressionOptions" << ":" << "gmmStream" << " " << params->gmmStreamSpin->value() << "\n";
+	file << "regressionOptions" << ":" << "gmmDecay" << " " << params->gmmDecaySpin->value() << "\n";
 }
 
 bool RegrGMM::LoadParams(QString name, float value)
@@ -477,5 +499,7 @@ bool RegrGMM::LoadParams(QString name, float value)
 	if(name.endsWith("gmmCount")) params->gmmCount->setValue((int)value);
 	if(name.endsWith("gmmCovariance")) params->gmmCovarianceCombo->setCurrentIndex((int)value);
 	if(name.endsWith("gmmInit")) params->gmmInitCombo->setCurrentIndex((int)value);
+	if(name.endsWith("gmmStream")) params->gmmStreamSpin->setValue((int)value);
+	if(name.endsWith("gmmDecay")) params->gmmDecaySpin->setValue(value);
 	return true;
 }
@@ -27,6 +27,12 @@ using namespace std;
 void RegressorGMR::Train(std::vector< fvec > samples, ivec labels)
 {
 	if(!samples.size()) return;
+    if(streamChunk)
+    {
+        // the samples are the next part of the stream: the current model is updated rather than refitted
+        Update(samples);
+        return;
+    }
     dim = samples[0].size();
 
     if(outputDim != -1 && outputDim < dim-1)
@@ -57,6 +63,41 @@ void RegressorGMR::Train(std::vector< fvec > samples, ivec labels)
 	gmm->initRegression(dim-1);
 }
 
+// stochastic EM over chunks of the samples, continuing from the current model if there is one
+void RegressorGMR::Update(const std::vector< fvec > &samples)
+{
+    if(!samples.size()) return;
+    if(gmm && (samples[0].size() != dim || gmm->nstates != nbClusters)) DEL(gmm);
+    if(!gmm) streamSteps = 0;
+    dim = samples[0].size();
+    KILL(data);
+    int swapDim = outputDim != -1 && outputDim < dim-1 ? outputDim : dim-1; // the output goes last
+    u32 chunk = streamChunk ? streamChunk : samples.size();
+    fvec buffer(min((size_t)chunk, samples.size())*dim);
+    for(u32 start=0; start<samples.size(); start+=chunk)
+    {
+        u32 count = min((size_t)chunk, samples.size()-start);
+        FOR(i, count)
+        {
+            float *point = &buffer[i*dim];
+            FOR(d, dim) point[d] = samples[start+i][d];
+            swap(point[dim-1], point[swapDim]);
+        }
+        if(!gmm)
+        {
+            if(count < nbClusters) continue;
+            gmm = new Gmm(nbClusters, dim);
+            gmm->init(&buffer[0], count, initType);
+            gmm->em(&buffer[0], count, 1e-4, (COVARIANCE_TYPE)covarianceType);
+        }
+        else gmm->updateChunk(&buffer[0], count, powf(streamSteps+1, -streamDecay), (COVARIANCE_TYPE)covarianceType);
+        streamSteps++;
+    }
+    if(!gmm) return;
+    bFixedThreshold = false;
+    gmm->initRegression(dim-1);
+}
+
 fvec RegressorGMR::Test( const fvec &sample)
 {
     fvec res;
@@ -95,11 +136,13 @@ fVec RegressorGMR::Test( const fVec &sample)
 	return res;
 }
 
-void RegressorGMR::SetParams(u32 nbClusters, u32 covarianceType, u32 initType)
+void RegressorGMR::SetParams(u32 nbClusters, u32 covarianceType, u32 initType, u32 streamChunk, float streamDecay)
 {
 	this->nbClusters = nbClusters;
 	this->covarianceType = covarianceType;
 	this->initType = initType;
+    this->streamChunk = streamChunk;
+    this->streamDecay = streamDecay;
 }
 
 const char *RegressorGMR::GetInfoString()
@@ -133,6 +176,7 @@ const char *RegressorGMR::GetInfoString()
 		sprintf(text, "%sK-Means\n", text);
 		break;
 	}
+    if(streamChunk) sprintf(text, "%sStreaming: %d chunks of %d samples (decay %.2f)\n", text, streamSteps, streamChunk, streamDecay);
 	return text;
 }
 
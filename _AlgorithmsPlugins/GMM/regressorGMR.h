@@ -32,16 +32,21 @@ private:
 	u32 covarianceType;
 	u32 initType;
 	float *data;
+    u32 streamChunk; // 0: batch EM, otherwise stochastic EM over chunks of streamChunk samples
+    float streamDecay; // the step of the t-th chunk is (t+1)^-streamDecay
+    u32 streamSteps;
 public:
-    RegressorGMR() : gmm(0), data(0), nbClusters(2), covarianceType(2), initType(1){type = REGR_GMR;}
+    RegressorGMR() : gmm(0), data(0), nbClusters(2), covarianceType(2), initType(1), streamChunk(0), streamDecay(0.6f), streamSteps(0){type = REGR_GMR;}
 	void Train(std::vector< fvec > samples, ivec labels);
+    void Update(const std::vector< fvec > &samples);
 	fvec Test( const fvec &sample);
 	fVec Test( const fVec &sample);
     const char *GetInfoString();
     void SaveModel(std::string filename);
     bool LoadModel(std::string filename);
+    bool IsStreaming() const {return streamChunk != 0;}
 
-	void SetParams(u32 nbClusters, u32 covarianceType, u32 initType);
+	void SetParams(u32 nbClusters, u32 covarianceType, u32 initType, u32 streamChunk=0, float streamDecay=0.6f);
 };
 
 #endif // _REGRESSOR_GMM_H_
@@ -1,5 +1,6 @@
 #include "SOGP.h"
 #include <string.h>
+#include <algorithm>
 #include <QDebug>
 
 
@@ -13,28 +14,37 @@ void SOGP::addM(const Matrix& in,const Matrix& out){
 
 //Add this input and output to the GP
 void SOGP::add(const ColumnVector& in,const ColumnVector& out){
-    double kstar =m_params.m_kernel->kstar(in);
+    Eigen::MatrixXd x(in.Nrows(),1);
+    for(int i=0;i<in.Nrows();i++) x(i,0)=in(i+1);
+    Eigen::RowVectorXd y(out.Nrows());
+    for(int i=0;i<out.Nrows();i++) y(i)=out(i+1);
+    Eigen::VectorXd kstars;
+    m_params.m_kernel->kstarBatch(x,kstars);
+    double kstar = kstars(0);
 
     if(current_size==0)
     {//First point is easy
-        C.ReSize(1,1);
-        Q.ReSize(1,1);
+        reserve(1);
         //Equations 2.46 with q, r, and s collapsed
-        alpha=out.t()/(kstar+m_params.s20);
-        C(1,1)=-1/(kstar+m_params.s20);
-        Q(1,1)=1/kstar;
+        alpha=y/(kstar+m_params.s20);
+        C(0,0)=-1/(kstar+m_params.s20);
+        Q(0,0)=1/kstar;
 
         current_size=1;
-        BV = in;
+        BV = x;
         return;
     }
 
     //We already have data
     //perform the kernel
-    ColumnVector k=m_params.m_kernel->kernelM(in,BV);
+    int n = current_size;
+    Eigen::MatrixXd K;
+    m_params.m_kernel->kernelBatch(x,BV,K);
+    Eigen::VectorXd k = K.transpose();
 
-    RowVector m=k.t()*alpha;
-    double s2 = kstar+(k.t()*C*k).AsScalar();
+    Eigen::RowVectorXd m = k.transpose()*alpha;
+    Eigen::VectorXd Ck = C.topLeftCorner(n,n)*k;
+    double s2 = kstar+k.dot(Ck);
 
     if(s2<1e-12){//For numerical stability..from Csato's Matlab code?
         //printf("SOGP::Small s2 %lf\n",s2);
@@ -45,12 +55,12 @@ void SOGP::add(const ColumnVector& in,const ColumnVector& out){
     //page 33 - Assumes Gaussian noise
     double r = -1/(m_params.s20+s2);
     //printf("out %d m %d r %f\n",out.Nrows(),m.Ncols(),r);
-    RowVector q = -r*(out.t()-m);
+    Eigen::RowVectorXd q = -r*(y-m);
 
     //projection onto current BV
-    ColumnVector ehat = Q*k;//Appendix G, section c
+    Eigen::VectorXd ehat = Q.topLeftCorner(n,n)*k;//Appendix G, section c
     //residual length
-    double gamma = kstar-(k.t()*ehat).AsScalar();//Ibid
+    double gamma = kstar-k.dot(ehat);//Ibid
     if(gamma<1e-12){//Numerical instability?
         //printf("SOGP::Gamma (%lf) < 0\n",gamma);
         gamma=0;
@@ -59,60 +69,45 @@ void SOGP::add(const ColumnVector& in,const ColumnVector& out){
     if(gamma<1e-6 && m_params.capacity!= -1){//Nearly singular, do a sparse update (e_tol)
         //printf("SOGP::Sparse! %lf \n",gamma);
         double eta = 1/(1+gamma*r);//Ibid
-        ColumnVector shat = C*k+ehat;//Appendix G section e
-        alpha=alpha+shat*(q*eta);//Appendix G section f
-        C=C+r*eta*shat*shat.t();//Ibid
+        Eigen::VectorXd shat = Ck+ehat;//Appendix G section e
+        alpha.noalias() += shat*(q*eta);//Appendix G section f
+        C.topLeftCorner(n,n).noalias() += (r*eta)*shat*shat.transpose();//Ibid
     }
     else{//Full update
         //printf("SOGP::Full!\n");
-        //Expansions are messy
-        RowVector expander(1);
+        //The new row and column go in the space left in C and Q, without reallocating
+        reserve(n+1);
 
         //s is of length N+1
-        expander(1)=1;
-        ColumnVector s = C*k & expander;//Apendix G section e
+        Eigen::VectorXd s(n+1);
+        s.head(n) = Ck;//Apendix G section e
+        s(n) = 1;
 
         //Add a row to alpha
-        expander.ReSize(alpha.Ncols());
-        for(int i=0;i<alpha.Ncols();i++)
-            expander(i+1)=0;
-        alpha = alpha & expander;
+        alpha.conservativeResize(n+1,Eigen::NoChange);
+        alpha.row(n).setZero();
         //Update alpha
-        alpha=alpha+s*q;//Equations 2.46
-
-        //Add Row to C
-        expander.ReSize(C.Ncols());
-        for(int i=0;i<C.Ncols();i++)
-            expander(i+1)=0;
-        C = C&expander;
-        //Add a Column to C
-        expander.ReSize(C.Nrows());
-        for(int i=0;i<C.Nrows();i++)
-            expander(i+1)=0;
-        C = C | expander.t();
+        alpha.noalias() += s*q;//Equations 2.46
+
+        //Add a row and a column to C
+        C.row(n).head(n+1).setZero();
+        C.col(n).head(n+1).setZero();
         //Update C
-        C = C + r*s*s.t();//Ibid
+        C.topLeftCorner(n+1,n+1).noalias() += r*s*s.transpose();//Ibid
 
         //Save the data, N++
-        BV = BV | in;
+        BV.conservativeResize(Eigen::NoChange,n+1);
+        BV.col(n) = x.col(0);
         current_size++;
 
-        //Add row to Gram Matrix
-        expander.ReSize(Q.Ncols());
-        for(int i=0;i<Q.Ncols();i++)
-            expander(i+1)=0;
-        Q = Q&expander;
-        //Add column
-        expander.ReSize(Q.Nrows());
-        for(int i=0;i<Q.Nrows();i++)
-            expander(i+1)=0;
-        Q = Q | expander.t();
+        //Add a row and a column to the Gram Matrix
+        Q.row(n).head(n+1).setZero();
+        Q.col(n).head(n+1).setZero();
         //Add one more to ehat
-        expander.ReSize(1);
-        expander(1)=-1;
-        ehat = ehat & expander;
+        ehat.conservativeResize(n+1);
+        ehat(n) = -1;
         //Update gram matrix
-        Q = Q + (1/gamma)*ehat*ehat.t();//Equation 3.5
+        Q.topLeftCorner(n+1,n+1).noalias() += (1/gamma)*ehat*ehat.transpose();//Equation 3.5
     }
 
     //Delete BVs if necessay...maybe only 2 per iteration?
@@ -120,9 +115,9 @@ void SOGP::add(const ColumnVector& in,const ColumnVector& out){
         double minscore=0,score;
         int minloc=-1;
         //Find the minimum score
-        for(int i=1;i<=current_size;i++){
-            score = alpha.Row(i).SumSquare()/(Q(i,i)+C(i,i));
-            if(i==1 || score<minscore){
+        for(int i=0;i<current_size;i++){
+            score = alpha.row(i).squaredNorm()/(Q(i,i)+C(i,i));
+            if(i==0 || score<minscore){
                 minscore=score;
                 minloc=i;
             }
@@ -136,9 +131,9 @@ void SOGP::add(const ColumnVector& in,const ColumnVector& out){
         //Delete for geometric reasons - Loop?
         double minscore=0,score;
         int minloc=-1;
-        for(int i=1;i<=current_size;i++){
+        for(int i=0;i<current_size;i++){
             score = 1/Q(i,i);
-            if(i==1 || score<minscore){
+            if(i==0 || score<minscore){
                 minscore=score;
                 minloc=i;
             }
@@ -149,74 +144,133 @@ void SOGP::add(const ColumnVector& in,const ColumnVector& out){
     }
 }
 
-//Delete a BV.  Very messy
+//Grow C and Q geometrically (up to the capacity) so that adding a BV does not copy them
+void SOGP::reserve(int n){
+    if(C.rows()>=n) return;
+    int size = std::max(n,std::max(16,2*(int)C.rows()));
+    if(m_params.capacity>0) size = std::min(size,std::max(n,m_params.capacity+1));
+    Eigen::MatrixXd newC(size,size), newQ(size,size);
+    newC.topLeftCorner(current_size,current_size) = C.topLeftCorner(current_size,current_size);
+    newQ.topLeftCorner(current_size,current_size) = Q.topLeftCorner(current_size,current_size);
+    C.swap(newC);
+    Q.swap(newQ);
+}
+
+//Delete a BV (0-based).  Very messy
 void SOGP::delete_bv(int loc){
+    int last = current_size-1;
     //First swap loc to the last spot
-    RowVector alphastar = alpha.Row(loc);
-    alpha.Row(loc)=alpha.Row(alpha.Nrows());
+    Eigen::RowVectorXd alphastar = alpha.row(loc);
+    alpha.row(loc)=alpha.row(last);
     //Now C
     double cstar = C(loc,loc);
-    ColumnVector Cstar = C.Column(loc);
-    Cstar(loc)=Cstar(Cstar.Nrows());
-    Cstar=Cstar.Rows(1,Cstar.Nrows()-1);
-    ColumnVector Crep=C.Column(C.Ncols());
-    Crep(loc)=Crep(Crep.Nrows());
-    C.Row(loc)=Crep.t();;
-    C.Column(loc)=Crep;
+    Eigen::VectorXd Cstar = C.col(loc).head(current_size);
+    Cstar(loc)=Cstar(last);
+    Cstar.conservativeResize(last);
+    Eigen::VectorXd Crep = C.col(last).head(current_size);
+    Crep(loc)=Crep(last);
+    C.row(loc).head(current_size)=Crep.transpose();
+    C.col(loc).head(current_size)=Crep;
     //and Q
     double qstar = Q(loc,loc);
-    ColumnVector Qstar = Q.Column(loc);
-    Qstar(loc)=Qstar(Qstar.Nrows());
-    Qstar=Qstar.Rows(1,Qstar.Nrows()-1);
-    ColumnVector Qrep=Q.Column(Q.Ncols());
-    Qrep(loc)=Qrep(Qrep.Nrows());
-    Q.Row(loc)=Qrep.t();
-    Q.Column(loc)=Qrep;
+    Eigen::VectorXd Qstar = Q.col(loc).head(current_size);
+    Qstar(loc)=Qstar(last);
+    Qstar.conservativeResize(last);
+    Eigen::VectorXd Qrep = Q.col(last).head(current_size);
+    Qrep(loc)=Qrep(last);
+    Q.row(loc).head(current_size)=Qrep.transpose();
+    Q.col(loc).head(current_size)=Qrep;
 
     //Ok, now do the actual removal  Appendix G section g
-    alpha= alpha.Rows(1,alpha.Nrows()-1);
-    ColumnVector qc = (Qstar+Cstar)/(qstar+cstar);
-    for(int i=1;i<=alpha.Ncols();i++)
-        alpha.Column(i)-=alphastar(i)*qc;
-    C = C.SymSubMatrix(1,C.Ncols()-1) + (Qstar*Qstar.t())/qstar - ((Qstar+Cstar)*(Qstar+Cstar).t())/(qstar+cstar);
-    Q = Q.SymSubMatrix(1,Q.Ncols()-1) - (Qstar*Qstar.t())/qstar;
+    alpha.conservativeResize(last,Eigen::NoChange);
+    Eigen::VectorXd qc = (Qstar+Cstar)/(qstar+cstar);
+    alpha.noalias() -= qc*alphastar;
+    C.topLeftCorner(last,last).noalias() += (1/qstar)*Qstar*Qstar.transpose();
+    C.topLeftCorner(last,last).noalias() -= (qstar+cstar)*qc*qc.transpose();
+    Q.topLeftCorner(last,last).noalias() -= (1/qstar)*Qstar*Qstar.transpose();
 
     //And the BV
-    BV.Column(loc)=BV.Column(BV.Ncols());
-    BV=BV.Columns(1,BV.Ncols()-1);
+    BV.col(loc)=BV.col(last);
+    BV.conservativeResize(Eigen::NoChange,last);
 
     current_size--;
 }
 
+#define SOGP_BLOCK 256 //points predicted together
 
 //Predict on a chunk of data.
 ReturnMatrix SOGP::predictM(const Matrix& in, ColumnVector &sigconf,bool conf){
     //printf("SOGP::Predicting on %d points\n",in.Ncols());
-    Matrix out(alpha.Ncols(),in.Ncols());
+    Eigen::MatrixXd x(in.Nrows(),in.Ncols()), y;
+    for(int i=0;i<in.Nrows();i++)
+        for(int c=0;c<in.Ncols();c++)
+            x(i,c)=in(i+1,c+1);
+    Eigen::VectorXd sigmas;
+    predictM(x,y,sigmas,conf);
+    Matrix out(y.rows(),y.cols());
     sigconf.ReSize(in.Ncols());
-    for(int c=1;c<=in.Ncols();c++)
-        out.Column(c) = predict(in.Column(c),sigconf(c),conf);
+    for(int c=0;c<y.cols();c++)
+    {
+        for(int i=0;i<y.rows();i++) out(i+1,c+1)=y(i,c);
+        sigconf(c+1)=sigmas(c);
+    }
     out.Release();
     return out;
 }
 
+void SOGP::predictM(const Eigen::MatrixXd& in, Eigen::MatrixXd& out, Eigen::VectorXd& sigconf, bool conf){
+    int count = in.cols();
+    out.resize(current_size ? alpha.cols() : 0,count);
+    sigconf.resize(count);
+    Eigen::MatrixXd block, blockOut;
+    Eigen::VectorXd sigma, kstars;
+    for(int b=0;b<count;b+=SOGP_BLOCK)
+    {
+        int blockSize = std::min(SOGP_BLOCK,count-b);
+        block = in.middleCols(b,blockSize);
+        predictBlock(block,blockOut,sigma,kstars);
+        out.middleCols(b,blockSize) = blockOut;
+        for(int i=0;i<blockSize;i++)
+            sigconf(b+i)=confidence(sigma(i),kstars(i),conf);
+    }
+}
+
 //Predict the output and uncertainty for this input.
 ReturnMatrix SOGP::predict(const ColumnVector& in, double &sigma,bool conf){
-    double kstar = m_params.m_kernel->kstar(in);
-    ColumnVector k=m_params.m_kernel->kernelM(in,BV);
+    Eigen::MatrixXd x(in.Nrows(),1), y;
+    for(int i=0;i<in.Nrows();i++) x(i,0)=in(i+1);
+    Eigen::VectorXd sigmas, kstars;
+    predictBlock(x,y,sigmas,kstars);
+
+    //We don't know the output dimensionality before the first point
+    //So return nothing.
+    ColumnVector out(y.rows());
+    for(int i=0;i<y.rows();i++) out(i+1)=y(i,0);
+    sigma=confidence(sigmas(0),kstars(0),conf);
+    out.Release();
+    return out;
+}
 
-    ColumnVector out;
+//The means (DoutxM) and variances of the columns of in, from a single kernel matrix
+void SOGP::predictBlock(const Eigen::MatrixXd& in, Eigen::MatrixXd& out, Eigen::VectorXd& sigma, Eigen::VectorXd& kstars){
+    m_params.m_kernel->kstarBatch(in,kstars);
     if(current_size==0){
-        sigma = kstar+m_params.s20;
-        //We don't actually know the correct output dimensionality
-        //So return nothing.
-        out.ReSize(0);
-    }
-    else{
-        out=(k.t()*alpha).t();//Page 33
-        sigma=m_params.s20 + kstar + (k.t()*C*k).AsScalar();//Ibid..needs s2 from page 19
+        sigma = (kstars.array()+m_params.s20).matrix();
+        out.resize(0,in.cols());
+        return;
     }
+    int n = current_size;
+    Eigen::MatrixXd K;
+    m_params.m_kernel->kernelBatch(in,BV,K);
+    out.noalias() = alpha.transpose()*K.transpose();//Page 33
+    //k'Ck for every point: one product with C, then the row-wise dot products
+    Eigen::MatrixXd KC;
+    KC.noalias() = K*C.topLeftCorner(n,n);
+    sigma = KC.cwiseProduct(K).rowwise().sum();
+    sigma.array() += kstars.array()+m_params.s20;//Ibid..needs s2 from page 19
+}
 
+double SOGP::confidence(double sigma, double kstar, bool conf){
     if(sigma<0){//Numerical instability?
         printf("SOGP:: sigma (%lf) < 0!\n",sigma);
         sigma=0;
@@ -234,10 +288,7 @@ ReturnMatrix SOGP::predict(const ColumnVector& in, double &sigma,bool conf){
     }
     else
         sigma=sqrt(sigma);
-    
-    out.Release();
-    return out;
-
+    return sigma;
 }
 
 //Log probability of this data
@@ -257,6 +308,23 @@ double SOGP::log_prob(const ColumnVector& in, const ColumnVector& out){
     return(-ls2pi -log(sigma) -.5*out2/(sigma*sigma));
 }
 
+//Conversions for the newmat printers
+static Matrix toNewmat(const Eigen::MatrixXd &m){
+    Matrix res(m.rows(),m.cols());
+    for(int i=0;i<m.rows();i++)
+        for(int j=0;j<m.cols();j++)
+            res(i+1,j+1)=m(i,j);
+    return res;
+}
+
+static Eigen::MatrixXd fromNewmat(const Matrix &m){
+    Eigen::MatrixXd res(m.Nrows(),m.Ncols());
+    for(int i=0;i<res.rows();i++)
+        for(int j=0;j<res.cols();j++)
+            res(i,j)=m(i+1,j+1);
+    return res;
+}
+
 #define VER 16
 
 bool SOGP::printTo(FILE *fp,bool ascii){
@@ -269,10 +337,10 @@ bool SOGP::printTo(FILE *fp,bool ascii){
     fprintf(fp,"current_size: %d\n",current_size);
 
     m_params.printTo(fp,ascii);
-    printMatrix(alpha,fp,"alpha",ascii);
-    printMatrix(C,fp,"C",ascii);
-    printMatrix(Q,fp,"Q",ascii);
-    printMatrix(BV,fp,"BV",ascii);
+    printMatrix(toNewmat(alpha),fp,"alpha",ascii);
+    printMatrix(toNewmat(C.topLeftCorner(current_size,current_size)),fp,"C",ascii);
+    printMatrix(toNewmat(Q.topLeftCorner(current_size,current_size)),fp,"Q",ascii);
+    printMatrix(toNewmat(BV),fp,"BV",ascii);
     return true;
 }
 
@@ -291,10 +359,11 @@ bool SOGP::readFrom(FILE *fp,bool ascii){
     fscanf(fp,"current_size: %d\n",&current_size);
 
     m_params.readFrom(fp,ascii);
-    readMatrix(alpha,fp,"alpha",ascii);
-    readMatrix(C,fp,"C",ascii);
-    readMatrix(Q,fp,"Q",ascii);
-    readMatrix(BV,fp,"BV",ascii);
+    Matrix m;
+    readMatrix(m,fp,"alpha",ascii); alpha=fromNewmat(m);
+    readMatrix(m,fp,"C",ascii); C=fromNewmat(m);
+    readMatrix(m,fp,"Q",ascii); Q=fromNewmat(m);
+    readMatrix(m,fp,"BV",ascii); BV=fromNewmat(m);
     return true;
 }
 
@@ -46,13 +46,16 @@ class SOGP{
     return predict(in,foo);
   }
 
-  //These two just wrap the single-data versions
+  //addM wraps the single-data version
   void addM(const Matrix& in, const Matrix& out);
+  //predictM evaluates the kernel against the BVs for all the columns at once
   ReturnMatrix predictM(const Matrix& in, ColumnVector &sigconf,bool conf=false);
   ReturnMatrix predictM(const Matrix& in){
     ColumnVector foo;
     return predictM(in,foo);
   }
+  //Same on Eigen matrices: in is DinxM, out is DoutxM
+  void predictM(const Eigen::MatrixXd& in, Eigen::MatrixXd& out, Eigen::VectorXd& sigconf, bool conf=false);
 
   //Return the log probability of this pair under the GP
   double log_prob(const ColumnVector& in, const ColumnVector& out);
@@ -78,14 +81,14 @@ class SOGP{
     return current_size;
   }
   double BVloc(int ind,int dim){
-    if(ind<BV.Ncols() && dim < BV.Nrows())
-      return BV(dim+1,ind+1);
+    if(ind<BV.cols() && dim < BV.rows())
+      return BV(dim,ind);
     else
       return 0;//Not quite correct
   }
   double alpha_acc(int ind,int dim){
-    if(ind<alpha.Nrows() && dim < alpha.Ncols())
-      return alpha(ind+1,dim+1);
+    if(ind<alpha.rows() && dim < alpha.cols())
+      return alpha(ind,dim);
     else
       return 0;
   }
@@ -93,23 +96,29 @@ class SOGP{
     m_params.capacity=cap;
   }
 
-  int dim(){return BV.Nrows();}
+  int dim(){return BV.rows();}
 
   SOGPParams &getParams(){return m_params;}
 
  private: 
   int current_size;  //how many points do I have
-  Matrix alpha;      //Alpha and C are the parameters of the GP
-                     //Alpha is NxDout
-  Matrix C;            
-  Matrix Q;          //Inverse Gram Matrix.  C and Q are NxN
-  Matrix BV;         //The Basis Vectors
-                     //BV is DinxN
+  Eigen::MatrixXd alpha;  //Alpha and C are the parameters of the GP
+                          //Alpha is NxDout
+  Eigen::MatrixXd C;
+  Eigen::MatrixXd Q;      //Inverse Gram Matrix.  C and Q are NxN
+                          //Both are allocated ahead, only the top left NxN block is used
+  Eigen::MatrixXd BV;     //The Basis Vectors
+                          //BV is DinxN
   //parameters
   SOGPParams m_params;
   
   //Removal function
   void delete_bv(int loc);
+  //Makes room in C and Q for n BVs
+  void reserve(int n);
+  //Means and variances of the columns of in
+  void predictBlock(const Eigen::MatrixXd& in, Eigen::MatrixXd& out, Eigen::VectorXd& sigma, Eigen::VectorXd& kstars);
+  double confidence(double sigma, double kstar, bool conf);
 
 public:
   //Set the parameters.  Maybe public for reset?
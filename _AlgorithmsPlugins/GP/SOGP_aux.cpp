@@ -1,5 +1,6 @@
 #include "SOGP_aux.h"
 #include <string.h>
+#include <algorithm>
 
 //Basic cascades - Not efficient
 ReturnMatrix SOGPKernel::kernelM(const ColumnVector& in, const Matrix &BV){
@@ -20,9 +21,31 @@ double SOGPKernel::kstar(){
 	foo(1)=0;
 	return kernel(foo,foo);
 }
+//Batched cascades - only for kernels without a matrix form
+void SOGPKernel::kernelBatch(const Eigen::MatrixXd &X, const Eigen::MatrixXd &BV, Eigen::MatrixXd &K){
+	K.resize(X.cols(),BV.cols());
+	ColumnVector a(X.rows()), b(BV.rows());
+	for(int i=0;i<X.cols();i++)
+	{
+		for(int d=0;d<X.rows();d++) a(d+1)=X(d,i);
+		for(int j=0;j<BV.cols();j++)
+		{
+			for(int d=0;d<BV.rows();d++) b(d+1)=BV(d,j);
+			K(i,j)=kernel(a,b);
+		}
+	}
+}
+void SOGPKernel::kstarBatch(const Eigen::MatrixXd &X, Eigen::VectorXd &kstars){
+	kstars.resize(X.cols());
+	ColumnVector a(X.rows());
+	for(int i=0;i<X.cols();i++)
+	{
+		for(int d=0;d<X.rows();d++) a(d+1)=X(d,i);
+		kstars(i)=kstar(a);
+	}
+}
 //RBF
-double RBFKernel::kernel(const ColumnVector &a, const ColumnVector &b){ 
-	double d = a.Nrows();
+void RBFKernel::expand(int d){
 	if(d!=widths.Ncols())
 	{//Expand if necessary
 		//printf("RBFKernel:  Resizing width to %d\n",(int)d);
@@ -32,11 +55,39 @@ double RBFKernel::kernel(const ColumnVector &a, const ColumnVector &b){
         for(int i=widths.Ncols();i<=d;i++) newWidths(i) = wtmp;
         widths = newWidths;
     }
+}
+double RBFKernel::kernel(const ColumnVector &a, const ColumnVector &b){ 
+	double d = a.Nrows();
+	expand(a.Nrows());
 	//I think this bumps up against numerical stability issues.
 	Matrix c = a-b;
 	Real ss = SumSquare(SP(c,widths.t()));
 	return A*exp(-(1/(2*d)) * ss);
 }
+void RBFKernel::kernelBatch(const Eigen::MatrixXd &X, const Eigen::MatrixXd &BV, Eigen::MatrixXd &K){
+	int d = X.rows();
+	expand(d);
+	Eigen::VectorXd w(d);
+	for(int i=0;i<d;i++) w(i)=widths(i+1);
+	Eigen::MatrixXd x = w.asDiagonal()*X;
+	Eigen::MatrixXd b = w.asDiagonal()*BV;
+	//squared distances as |x|^2 + |b|^2 - 2 x.b, with all the cross terms in a single product
+	K.noalias() = x.transpose()*b;
+	Eigen::VectorXd xx = x.colwise().squaredNorm().transpose();
+	Eigen::RowVectorXd bb = b.colwise().squaredNorm();
+	for(int j=0;j<K.cols();j++)
+	{
+		for(int i=0;i<K.rows();i++)
+		{
+			double ss = std::max(0., xx(i) + bb(j) - 2*K(i,j));
+			K(i,j) = A*exp(-(1/(2.*d)) * ss);
+		}
+	}
+}
+void RBFKernel::kstarBatch(const Eigen::MatrixXd &X, Eigen::VectorXd &kstars){
+	expand(X.rows());
+	kstars.setConstant(X.cols(),A);
+}
 //POL
 double POLKernel::kernel(const ColumnVector &a, const ColumnVector &b){
     double d = a.Nrows();
@@ -46,6 +97,31 @@ double POLKernel::kernel(const ColumnVector &a, const ColumnVector &b){
         resp += pow((inner/(d*scales(i))),i);
     return resp;
 }
+void POLKernel::kernelBatch(const Eigen::MatrixXd &X, const Eigen::MatrixXd &BV, Eigen::MatrixXd &K){
+    double d = X.rows();
+    K.noalias() = X.transpose()*BV;
+    for(int j=0;j<K.cols();j++)
+    {
+        for(int i=0;i<K.rows();i++)
+        {
+            double inner = K(i,j), resp=1;
+            for(int s=1;s<=scales.Ncols();s++)
+                resp += pow((inner/(d*scales(s))),s);
+            K(i,j) = resp;
+        }
+    }
+}
+void POLKernel::kstarBatch(const Eigen::MatrixXd &X, Eigen::VectorXd &kstars){
+    double d = X.rows();
+    kstars = X.colwise().squaredNorm().transpose();
+    for(int i=0;i<kstars.size();i++)
+    {
+        double inner = kstars(i), resp=1;
+        for(int s=1;s<=scales.Ncols();s++)
+            resp += pow((inner/(d*scales(s))),s);
+        kstars(i) = resp;
+    }
+}
 //POLY
 double POLYKernel::kernel(const ColumnVector &a, const ColumnVector &b){
     double resp=1;
@@ -53,6 +129,17 @@ double POLYKernel::kernel(const ColumnVector &a, const ColumnVector &b){
     resp = pow(inner, degree);
     return resp;
 }
+void POLYKernel::kernelBatch(const Eigen::MatrixXd &X, const Eigen::MatrixXd &BV, Eigen::MatrixXd &K){
+    K.noalias() = X.transpose()*BV;
+    for(int j=0;j<K.cols();j++)
+        for(int i=0;i<K.rows();i++)
+            K(i,j) = pow(K(i,j) + offset, degree);
+}
+void POLYKernel::kstarBatch(const Eigen::MatrixXd &X, Eigen::VectorXd &kstars){
+    kstars = X.colwise().squaredNorm().transpose();
+    for(int i=0;i<kstars.size();i++)
+        kstars(i) = pow(kstars(i) + offset, degree);
+}
 
 //-------------------------------------------------------------
 //Newmat printers
@@ -6,6 +6,7 @@
 //Newmat Library and print extension
 #define WANT_MATH
 #include "newmat11/newmatap.h"
+#include <Eigen/Core>
 #include <stdio.h>
 
 #ifndef M_PI
@@ -40,6 +41,10 @@ public:
     virtual ReturnMatrix kernelM(const ColumnVector& in, const Matrix &BV);
     virtual double kstar(const ColumnVector& in);
     virtual double kstar();
+    //Batched versions: K(i,j) = kernel(X.col(i),BV.col(j)), kstars(i) = kstar(X.col(i))
+    //Defaults cascade to kernel(), known kernels override with matrix products
+    virtual void kernelBatch(const Eigen::MatrixXd& X, const Eigen::MatrixXd& BV, Eigen::MatrixXd& K);
+    virtual void kstarBatch(const Eigen::MatrixXd& X, Eigen::VectorXd& kstars);
     virtual void printTo(FILE *fp,bool ascii=false){
         printf("Kernel Writer %d not written\n",m_type);
     }
@@ -59,6 +64,8 @@ class RBFKernel: public SOGPKernel{
 public:
     virtual ~RBFKernel(){}
     double kernel(const ColumnVector &a, const ColumnVector &b);
+    void kernelBatch(const Eigen::MatrixXd& X, const Eigen::MatrixXd& BV, Eigen::MatrixXd& K);
+    void kstarBatch(const Eigen::MatrixXd& X, Eigen::VectorXd& kstars);
     void printTo(FILE *fp,bool ascii = false){
         fprintf(fp,"A %lf\n",A);printRV(widths,fp,"widths",ascii);
     }
@@ -105,6 +112,7 @@ public:
 private:
     double A;//Should likely never change, but just in case
     RowVector widths;//Stored as 1/w
+    void expand(int d);
     void init(double w){
         RowVector foo(1);foo(1)=w;init(foo);
     }
@@ -119,6 +127,8 @@ class POLKernel: public SOGPKernel{
 public:
     virtual ~POLKernel(){}
     double kernel(const ColumnVector &a, const ColumnVector &b);
+    void kernelBatch(const Eigen::MatrixXd& X, const Eigen::MatrixXd& BV, Eigen::MatrixXd& K);
+    void kstarBatch(const Eigen::MatrixXd& X, Eigen::VectorXd& kstars);
     POLKernel(){
         init(1);
     }
@@ -168,6 +178,8 @@ class POLYKernel: public SOGPKernel{
 public:
     virtual ~POLYKernel(){}
     double kernel(const ColumnVector &a, const ColumnVector &b);
+    void kernelBatch(const Eigen::MatrixXd& X, const Eigen::MatrixXd& BV, Eigen::MatrixXd& K);
+    void kstarBatch(const Eigen::MatrixXd& X, Eigen::VectorXd& kstars);
     POLYKernel(){
         init(1);
     }
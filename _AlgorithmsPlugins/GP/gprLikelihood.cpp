@@ -0,0 +1,310 @@
+/*********************************************************************
+MLDemos: A User-Friendly visualization toolkit for machine learning
+Copyright (C) 2010  Basilio Noris
+Contact: mldemos@b4silio.com
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Library General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free
+Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*********************************************************************/
+#include <types.h>
+#include "gprLikelihood.h"
+#include "SOGP_aux.h"
+#include <Eigen/Cholesky>
+#include <nlopt/nlopt.hpp>
+#include <QThread>
+#include <QThreadPool>
+#include <QRunnable>
+#include <QAtomicInt>
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+#define GPR_BLOCK 32 // columns handed to a worker at a time
+
+enum GPRJob {GPR_KERNEL, GPR_INVERSE, GPR_PRODUCT, GPR_GRADIENT};
+
+// one evaluation of the likelihood; every job fills or reads the lower triangles one block of columns at a time
+struct GPRLikelihoodPass
+{
+    const Eigen::MatrixXd *inputs;
+    Eigen::MatrixXd scaled; // inputs divided by the rbf widths
+    int kernelType, n, dim;
+    double s20, A, scale;
+    Eigen::MatrixXd K; // K + s20 I
+    const Eigen::MatrixXd *L; // Cholesky factor of K + s20 I
+    Eigen::MatrixXd Z; // inverse of L
+    Eigen::MatrixXd inverse; // (K + s20 I)^-1 = Z'Z
+    Eigen::VectorXd alpha; // (K + s20 I)^-1 y
+    vector<dvec> gradients; // sums of each block, added in order for repeatable results
+    QAtomicInt nextBlock;
+
+    double Kernel(int i, int j) const
+    {
+        if(kernelType == kerPOL) return 1 + inputs->col(i).dot(inputs->col(j))/(dim*scale);
+        const double *a = &scaled(0,i), *b = &scaled(0,j);
+        double ss = 0;
+        FOR(d, dim) ss += (a[d]-b[d])*(a[d]-b[d]);
+        return A*exp(-(1/(2.*dim)) * ss);
+    }
+
+    void PullBlocks(GPRJob job)
+    {
+        int j;
+        while((j = nextBlock.fetchAndAddOrdered(GPR_BLOCK)) < n)
+        {
+            int b = min(GPR_BLOCK, n-j);
+            switch(job)
+            {
+            case GPR_KERNEL:
+                for(int c=j; c<j+b; c++)
+                {
+                    for(int i=c; i<n; i++) K(i,c) = Kernel(i,c);
+                    K(c,c) += s20;
+                }
+                break;
+            case GPR_INVERSE:
+                Z.block(j,j,b,b).setIdentity();
+                L->bottomRightCorner(n-j,n-j).triangularView<Eigen::Lower>().solveInPlace(Z.block(j,j,n-j,b));
+                break;
+            case GPR_PRODUCT:
+                // Z is lower triangular: the rows above j do not contribute
+                inverse.block(j,j,n-j,b).noalias() = Z.block(j,j,n-j,n-j).triangularView<Eigen::Lower>().transpose()*Z.block(j,j,n-j,b);
+                break;
+            case GPR_GRADIENT:
+                Gradient(j, b, gradients[j/GPR_BLOCK]);
+                break;
+            }
+        }
+    }
+
+    // sum over the block of (alpha alpha' - inverse) times the derivatives of the kernel
+    void Gradient(int j, int b, dvec &gradient) const
+    {
+        gradient.assign(kernelType == kerPOL ? 1 : dim+1, 0);
+        for(int c=j; c<j+b; c++)
+        {
+            for(int i=c; i<n; i++)
+            {
+                double w = (alpha(i)*alpha(c) - inverse(i,c)) * (i == c ? 1 : 2);
+                double k = i == c ? K(i,c) - s20 : K(i,c);
+                if(kernelType == kerPOL)
+                {
+                    gradient[0] += w*(k-1);
+                    continue;
+                }
+                double m = w*k;
+                const double *a = &(*inputs)(0,i), *bb = &(*inputs)(0,c);
+                FOR(d, dim) gradient[d] += m*(a[d]-bb[d])*(a[d]-bb[d]);
+                gradient[dim] += m;
+            }
+        }
+    }
+};
+
+class GPRLikelihoodWorker : public QRunnable
+{
+    GPRLikelihoodPass *pass;
+    GPRJob job;
+public:
+    GPRLikelihoodWorker(GPRLikelihoodPass *pass, GPRJob job) : pass(pass), job(job){}
+    void run(){pass->PullBlocks(job);}
+};
+
+static void RunJob(GPRLikelihoodPass &pass, GPRJob job, int threadCount)
+{
+    pass.nextBlock = 0;
+    threadCount = min(threadCount, (pass.n + GPR_BLOCK-1)/GPR_BLOCK);
+    if(threadCount <= 1)
+    {
+        pass.PullBlocks(job);
+        return;
+    }
+    QThreadPool pool;
+    pool.setMaxThreadCount(threadCount);
+    FOR(i, threadCount) pool.start(new GPRLikelihoodWorker(&pass, job));
+    pool.waitForDone();
+}
+
+GPRLikelihood::GPRLikelihood(const Eigen::MatrixXd &inputs, const Eigen::VectorXd &outputs, int kernelType, double s20, int maxPoints)
+    : kernelType(kernelType), s20(s20)
+{
+    int n = outputs.size();
+    int step = (maxPoints > 0 && n > maxPoints) ? (n + maxPoints-1)/maxPoints : 1;
+    int count = (n + step-1)/step;
+    this->inputs.resize(inputs.rows(), count);
+    this->outputs.resize(count);
+    FOR(i, count)
+    {
+        this->inputs.col(i) = inputs.col(i*step);
+        this->outputs(i) = outputs(i*step);
+    }
+}
+
+int GPRLikelihood::ParameterCount() const
+{
+    return kernelType == kerPOL ? 1 : inputs.rows()+1;
+}
+
+double GPRLikelihood::Evaluate(const double *x, double *gradient, int threadCount) const
+{
+    GPRLikelihoodPass pass;
+    pass.inputs = &inputs;
+    pass.kernelType = kernelType;
+    pass.n = outputs.size();
+    pass.dim = inputs.rows();
+    pass.s20 = s20;
+    pass.A = pass.scale = 1;
+    int n = pass.n, dim = pass.dim;
+    if(kernelType == kerPOL) pass.scale = x[0];
+    else
+    {
+        pass.A = x[dim];
+        pass.scaled.resize(dim, n);
+        FOR(d, dim) pass.scaled.row(d) = inputs.row(d)/x[d];
+    }
+
+    pass.K.resize(n, n);
+    RunJob(pass, GPR_KERNEL, threadCount);
+    Eigen::LLT<Eigen::MatrixXd> llt(pass.K);
+    if(!n || llt.info() != Eigen::Success)
+    {
+        if(gradient) FOR(i, ParameterCount()) gradient[i] = 0;
+        return -1e100;
+    }
+    const Eigen::MatrixXd &L = llt.matrixLLT();
+    pass.alpha = llt.solve(outputs);
+    double logDet = 0;
+    FOR(i, n) logDet += log(L(i,i));
+    double logLikelihood = -0.5*outputs.dot(pass.alpha) - logDet - 0.5*n*log(2*M_PI);
+    if(!gradient) return logLikelihood;
+
+    // d/dtheta = 1/2 tr((alpha alpha' - (K + s20 I)^-1) dK/dtheta)
+    pass.L = &L;
+    pass.Z.setZero(n, n);
+    RunJob(pass, GPR_INVERSE, threadCount);
+    pass.inverse.resize(n, n);
+    RunJob(pass, GPR_PRODUCT, threadCount);
+    pass.Z.resize(0, 0);
+    pass.gradients.resize((n + GPR_BLOCK-1)/GPR_BLOCK);
+    RunJob(pass, GPR_GRADIENT, threadCount);
+    int count = ParameterCount();
+    FOR(i, count) gradient[i] = 0;
+    FOR(b, pass.gradients.size()) FOR(i, count) gradient[i] += pass.gradients[b][i];
+    if(kernelType == kerPOL) gradient[0] *= -0.5/x[0];
+    else
+    {
+        FOR(d, dim) gradient[d] *= 0.5/(dim*x[d]*x[d]*x[d]);
+        gradient[dim] *= 0.5/x[dim];
+    }
+    return logLikelihood;
+}
+
+// one run of the optimizer, keeping the best parameters it evaluated
+struct GPRRestart
+{
+    const GPRLikelihood *likelihood;
+    vector<double> x;
+    double best;
+    int threadCount;
+};
+
+// nlopt works on the logarithms of the parameters, which keeps them positive and evens out their scales
+static double LogObjective(unsigned n, const double *u, double *gradient, void *data)
+{
+    GPRRestart *restart = (GPRRestart*)data;
+    vector<double> x(n);
+    FOR(i, n) x[i] = exp(u[i]);
+    double value = restart->likelihood->Evaluate(&x[0], gradient, restart->threadCount);
+    if(gradient) FOR(i, n) gradient[i] *= x[i];
+    if(value > restart->best)
+    {
+        restart->best = value;
+        restart->x = x;
+    }
+    return value;
+}
+
+static void RunRestart(GPRRestart &restart, int maxEvaluations)
+{
+    int n = restart.x.size();
+    const double lower = 1e-4, upper = 1e4;
+    nlopt::opt opt(nlopt::LD_LBFGS, n);
+    opt.set_max_objective(LogObjective, (void*)&restart);
+    opt.set_maxeval(maxEvaluations);
+    opt.set_lower_bounds(vector<double>(n, log(lower)));
+    opt.set_upper_bounds(vector<double>(n, log(upper)));
+    opt.set_xtol_rel(1e-4);
+    vector<double> u(n);
+    FOR(i, n) u[i] = log(max(lower, min(upper, restart.x[i])));
+    restart.best = -HUGE_VAL;
+    try
+    {
+        double value;
+        opt.optimize(u, value);
+    }
+    catch(std::exception &e)
+    {
+        // roundoff or too many evaluations: the best point so far is kept
+    }
+}
+
+class GPRRestartWorker : public QRunnable
+{
+    vector<GPRRestart> *restarts;
+    QAtomicInt *next;
+    int maxEvaluations;
+public:
+    GPRRestartWorker(vector<GPRRestart> *restarts, QAtomicInt *next, int maxEvaluations)
+        : restarts(restarts), next(next), maxEvaluations(maxEvaluations){}
+    void run()
+    {
+        int i;
+        while((i = next->fetchAndAddOrdered(1)) < (int)restarts->size()) RunRestart((*restarts)[i], maxEvaluations);
+    }
+};
+
+double GPRLikelihood::Maximize(vector<double> &x, int restartCount, int maxEvaluations) const
+{
+    restartCount = max(1, restartCount);
+    int idealCount = max(1, QThread::idealThreadCount());
+    int threadCount = min(idealCount, restartCount);
+    // the widths (or the scale) of the other starting points are 4 times smaller, 4 times larger, 16 times smaller...
+    int widthCount = kernelType == kerPOL ? 1 : inputs.rows();
+    vector<GPRRestart> restarts(restartCount);
+    FOR(r, restartCount)
+    {
+        restarts[r].likelihood = this;
+        restarts[r].x = x;
+        restarts[r].threadCount = max(1, idealCount/threadCount);
+        if(!r) continue;
+        double factor = pow(4., (r+1)/2);
+        if(r%2) factor = 1/factor;
+        FOR(i, widthCount) restarts[r].x[i] *= factor;
+    }
+    QAtomicInt next(0);
+    if(threadCount <= 1) GPRRestartWorker(&restarts, &next, maxEvaluations).run();
+    else
+    {
+        QThreadPool pool;
+        pool.setMaxThreadCount(threadCount);
+        FOR(i, threadCount) pool.start(new GPRRestartWorker(&restarts, &next, maxEvaluations));
+        pool.waitForDone();
+    }
+    int best = 0;
+    FOR(r, restartCount) if(restarts[r].best > restarts[best].best) best = r;
+    if(restarts[best].best == -HUGE_VAL) return -HUGE_VAL;
+    x = restarts[best].x;
+    return restarts[best].best;
+}
@@ -0,0 +1,54 @@
+/*********************************************************************
+MLDemos: A User-Friendly visualization toolkit for machine learning
+Copyright (C) 2010  Basilio Noris
+Contact: mldemos@b4silio.com
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Library General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free
+Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*********************************************************************/
+#ifndef _GPR_LIKELIHOOD_H_
+#define _GPR_LIKELIHOOD_H_
+
+#include <vector>
+#include <Eigen/Core>
+
+/*!
+ * Log marginal likelihood of a full gaussian process using the kernels of SOGP, and its analytic
+ * gradient, from a single Cholesky factorization of K + s20 I. The parameters are those given to
+ * the kernels by RegressorGPR: the width of each dimension then the amplitude A for the rbf kernel,
+ * the scale for the (first order) pol kernel. The kernel matrix, the inverse and the trace terms of
+ * the gradient are computed in column blocks split over threads.
+ * Maximize runs the L-BFGS of nlopt on the logarithms of the parameters from several starting
+ * points at once, and keeps the best. With maxPoints > 0, the likelihood is that of an evenly
+ * spaced subset of at most maxPoints samples: faster, but a different objective than the full set.
+ */
+class GPRLikelihood
+{
+public:
+    GPRLikelihood(const Eigen::MatrixXd &inputs, const Eigen::VectorXd &outputs, int kernelType, double s20, int maxPoints=0);
+    int ParameterCount() const;
+    int SampleCount() const {return outputs.size();}
+    // the log likelihood at x, and its derivatives with respect to x in gradient if not null
+    double Evaluate(const double *x, double *gradient=0, int threadCount=1) const;
+    // maximizes the likelihood starting from x and restarts-1 rescaled copies of it; x gets the best parameters
+    double Maximize(std::vector<double> &x, int restarts=4, int maxEvaluations=100) const;
+
+private:
+    Eigen::MatrixXd inputs; // Din x N
+    Eigen::VectorXd outputs;
+    int kernelType;
+    double s20;
+};
+
+#endif // _GPR_LIKELIHOOD_H_
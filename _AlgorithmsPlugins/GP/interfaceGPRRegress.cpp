@@ -30,6 +30,7 @@ RegrGPR::RegrGPR()
     connect(params->kernelTypeCombo, SIGNAL(currentIndexChanged(int)), this, SLOT(ChangeOptions()));
     connect(params->sparseCheck, SIGNAL(clicked()), this, SLOT(ChangeOptions()));
     connect(params->optimizeCheck, SIGNAL(clicked()), this, SLOT(ChangeOptions()));
+    connect(params->optimizeCombo, SIGNAL(currentIndexChanged(int)), this, SLOT(ChangeOptions()));
     ChangeOptions();
 }
 
@@ -45,6 +46,9 @@ void RegrGPR::ChangeOptions()
     params->capacitySpin->setVisible(bSparse);
     params->labelCapacity->setVisible(bSparse);
     params->optimizeCombo->setVisible(params->optimizeCheck->isChecked());
+    bool bLikelihood = params->optimizeCheck->isChecked() && params->optimizeCombo->currentIndex() == 0;
+    params->fitSamplesSpin->setVisible(bLikelihood);
+    params->labelFitSamples->setVisible(bLikelihood);
 
     switch(params->kernelTypeCombo->currentIndex())
     {
@@ -83,8 +87,9 @@ void RegrGPR::SetParams(Regressor *regressor)
     double kernelNoise = params->noiseSpin->value();
     bool bOptimize = params->optimizeCheck->isChecked();
     bool bUseLikelihood = params->optimizeCombo->currentIndex() == 0;
+    int fitSamples = params->fitSamplesSpin->value();
 
-    gpr->SetParams(kernelGamma, kernelNoise, capacity, kernelType, kernelDegree, bOptimize, bUseLikelihood);
+    gpr->SetParams(kernelGamma, kernelNoise, capacity, kernelType, kernelDegree, bOptimize, bUseLikelihood, fitSamples);
 }
 
 fvec RegrGPR::GetParams()
@@ -93,18 +98,21 @@ fvec RegrGPR::GetParams()
     float kernelGamma = params->kernelWidthSpin->value();
     float kernelDegree = params->kernelDegSpin->value();
     int capacity = params->capacitySpin->value();
-    //bool bSparse = params->sparseCheck->isChecked();
+    bool bSparse = params->sparseCheck->isChecked();
     double kernelNoise = params->noiseSpin->value();
     bool bOptimize = params->optimizeCheck->isChecked();
     bool bUseLikelihood = params->optimizeCombo->currentIndex() == 0;
-    fvec par(7);
+    int fitSamples = params->fitSamplesSpin->value();
+    fvec par(9);
     par[0] = kernelType;
     par[1] = kernelGamma;
     par[2] = kernelDegree;
     par[3] = capacity;
-    par[4] = kernelNoise;
-    par[5] = bOptimize;
-    par[6] = bUseLikelihood;
+    par[4] = bSparse;
+    par[5] = kernelNoise;
+    par[6] = bOptimize;
+    par[7] = bUseLikelihood;
+    par[8] = fitSamples;
     return par;
 }
 
@@ -123,8 +131,9 @@ void RegrGPR::SetParams(Regressor *regressor, fvec parameters)
     double kernelNoise = parameters.size() > i ? parameters[i] : 0; i++;
     bool bOptimize = parameters.size() > i ? parameters[i] : 0; i++;
     bool bUseLikelihood = parameters.size() > i ? parameters[i] : 0; i++;
-    if(bSparse) capacity = -1;
-    gpr->SetParams(kernelGamma, kernelNoise, capacity, kernelType, kernelDegree, bOptimize, bUseLikelihood);
+    int fitSamples = parameters.size() > i ? parameters[i] : 0; i++;
+    if(!bSparse) capacity = -1;
+    gpr->SetParams(kernelGamma, kernelNoise, capacity, kernelType, kernelDegree, bOptimize, bUseLikelihood, fitSamples);
 }
 
 void RegrGPR::GetParameterList(std::vector<QString> &parameterNames,
@@ -142,6 +151,7 @@ void RegrGPR::GetParameterList(std::vector<QString> &parameterNames,
     parameterNames.push_back("kernelNoise");
     parameterNames.push_back("bOptimize");
     parameterNames.push_back("bUseLikelihood");
+    parameterNames.push_back("fitSamples");
     parameterTypes.push_back("List");
     parameterTypes.push_back("Real");
     parameterTypes.push_back("Integer");
@@ -150,6 +160,7 @@ void RegrGPR::GetParameterList(std::vector<QString> &parameterNames,
     parameterTypes.push_back("Real");
     parameterTypes.push_back("List");
     parameterTypes.push_back("List");
+    parameterTypes.push_back("Integer");
     parameterValues.push_back(vector<QString>());
     parameterValues.back().push_back("Linear");
     parameterValues.back().push_back("Poly");
@@ -175,6 +186,9 @@ void RegrGPR::GetParameterList(std::vector<QString> &parameterNames,
     parameterValues.push_back(vector<QString>());
     parameterValues.back().push_back("False");
     parameterValues.back().push_back("True");
+    parameterValues.push_back(vector<QString>());
+    parameterValues.back().push_back("0");
+    parameterValues.back().push_back("9999999");
 }
 
 QString RegrGPR::GetAlgoString()
@@ -279,20 +293,28 @@ void RegrGPR::DrawConfidence(Canvas *canvas, Regressor *regressor)
         }
         int outputDim = regressor->outputDim;
         int yIndex = canvas->yIndex;
-        Matrix _testout;
-        ColumnVector _testin(dim);
         QImage density(QSize(256,256), QImage::Format_RGB32);
         density.fill(0);
-        // we draw a density map for the probability
+        // the whole row of inputs is predicted at once
+        Matrix _testin(dim, density.width());
         for (int i=0; i < density.width(); i++)
         {
             fvec sampleIn = canvas->toSampleCoords(i*w/density.width(),0);
-            FOR(d, dim) _testin(d+1) = sampleIn[d];
-            if(outputDim != -1 && outputDim < dim) _testin(outputDim+1) = sampleIn[dim];
-            double sigma;
-            _testout = gpr->sogp->predict(_testin, sigma);
-            sigma = sigma*sigma;
-            float testout = _testout(1,1);
+            FOR(d, dim) _testin(d+1, i+1) = sampleIn[d];
+            if(outputDim != -1 && outputDim < dim) _testin(outputDim+1, i+1) = sampleIn[dim];
+        }
+        ColumnVector sigmas;
+        Matrix _testout = gpr->sogp->predictM(_testin, sigmas);
+        if(!_testout.Nrows())
+        {
+            canvas->maps.confidence = QPixmap();
+            return;
+        }
+        // we draw a density map for the probability
+        for (int i=0; i < density.width(); i++)
+        {
+            double sigma = sigmas(i+1)*sigmas(i+1);
+            float testout = _testout(1,i+1);
             for (int j=0; j< density.height(); j++)
             {
                 fvec sampleOut = canvas->toSampleCoords(i*w/density.width(),j*h/density.height());
@@ -323,10 +345,16 @@ void RegrGPR::DrawModel(Canvas *canvas, QPainter &painter, Regressor *regressor)
     QPointF oldPoint(-FLT_MAX,-FLT_MAX);
     QPointF oldPointUp(-FLT_MAX,-FLT_MAX);
     QPointF oldPointDown(-FLT_MAX,-FLT_MAX);
+    std::vector<fvec> samples(steps);
+    FOR(x, steps) samples[x] = canvas->toSampleCoords(x,0);
+    fvec means, variances;
+    gpr->TestBatch(samples, means, variances);
     FOR(x, steps)
     {
-        sample = canvas->toSampleCoords(x,0);
-        fvec res = regressor->Test(sample);
+        sample = samples[x];
+        fvec res(2);
+        res[0] = means[x];
+        res[1] = variances[x];
         if(res[0] != res[0] || res[1] != res[1]) continue;
         QPointF point = canvas->toCanvasCoords(sample[xIndex], res[0]);
         QPointF pointUp = canvas->toCanvasCoords(sample[xIndex],res[0] + res[1]);
@@ -366,6 +394,7 @@ void RegrGPR::SaveOptions(QSettings &settings)
     settings.setValue("sparseCheck", params->sparseCheck->isChecked());
     settings.setValue("optimizeCheck", params->optimizeCheck->isChecked());
     settings.setValue("optimizeCombo", params->optimizeCombo->currentIndex());
+    settings.setValue("fitSamplesSpin", params->fitSamplesSpin->value());
 }
 
 bool RegrGPR::LoadOptions(QSettings &settings)
@@ -378,6 +407,7 @@ bool RegrGPR::LoadOptions(QSettings &settings)
     if(settings.contains("sparseCheck")) params->sparseCheck->setChecked(settings.value("sparseCheck").toBool());
     if(settings.contains("optimizeCheck")) params->optimizeCheck->setChecked(settings.value("optimizeCheck").toBool());
     if(settings.contains("optimizeCombo")) params->optimizeCombo->setCurrentIndex(settings.value("optimizeCombo").toInt());
+    if(settings.contains("fitSamplesSpin")) params->fitSamplesSpin->setValue(settings.value("fitSamplesSpin").toInt());
     return true;
 }
 
@@ -391,6 +421,7 @@ void RegrGPR::SaveParams(QTextStream &file)
     file << "regressionOptions" << ":" << "sparseCheck" << " " << params->sparseCheck->isChecked() << "\n";
     file << "regressionOptions" << ":" << "optimizeCheck" << " " << params->optimizeCheck->isChecked() << "\n";
     file << "regressionOptions" << ":" << "optimizeCombo" << " " << params->optimizeCombo->currentIndex() << "\n";
+    file << "regressionOptions" << ":" << "fitSamplesSpin" << " " << params->fitSamplesSpin->value() << "\n";
 }
 
 bool RegrGPR::LoadParams(QString name, float value)
@@ -403,5 +434,6 @@ bool RegrGPR::LoadParams(QString name, float value)
     if(name.endsWith("sparseCheck")) params->sparseCheck->setChecked((int)value);
     if(name.endsWith("optimizeCheck")) params->optimizeCheck->setChecked((int)value);
     if(name.endsWith("optimizeCombo")) params->optimizeCombo->setCurrentIndex((int)value);
+    if(name.endsWith("fitSamplesSpin")) params->fitSamplesSpin->setValue((int)value);
     return true;
 }
@@ -27,6 +27,7 @@ HEADERS += canvas.h \
     classifierGP.h \
     SOGP_aux.h \
     SOGP.h \
+    gprLikelihood.h \
     regressorGPR.h \
     interfaceGPRRegress.h \
     interfaceGPRDynamic.h \
@@ -37,6 +38,7 @@ SOURCES += pluginGP.cpp \
     classifierGP.cpp \
     SOGP_aux.cpp \
     SOGP.cpp \
+    gprLikelihood.cpp \
     regressorGPR.cpp \
     interfaceGPRRegress.cpp \
     interfaceGPRDynamic.cpp \
@@ -19,6 +19,7 @@ Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
 *********************************************************************/
 #include <public.h>
 #include "regressorGPR.h"
+#include "gprLikelihood.h"
 #include <QDebug>
 #include <nlopt/nlopt.hpp>
 
@@ -70,7 +71,7 @@ void RegressorGPR::Train( std::vector<fvec> input, ivec labels)
     bTrained = true;
 }
 
-double GetLikelihood(const double *x, const Matrix &inputs, const Matrix &outputs, SOGP *sogp, bool bLikelihood)
+double GetTrainingError(const double *x, const Matrix &inputs, const Matrix &outputs, SOGP *sogp)
 {
     int dim = inputs.Nrows();
     SOGPParams &oldParams = sogp->getParams();
@@ -99,64 +100,41 @@ double GetLikelihood(const double *x, const Matrix &inputs, const Matrix &output
     }
     sogp->addM(inputs, outputs);
 
-    if(bLikelihood)
+    double mse = 0;
+    ColumnVector confidence;
+    Matrix out = sogp->predictM(inputs, confidence);
+    if(out.Nrows())
     {
-        double logLikelihood = 0;
-        for(int i=1;i<=inputs.Ncols();i++)
-        {
-            float loglik = sogp->log_prob(inputs.Column(i), outputs.Column(i));
-            logLikelihood += loglik;
-        }
-        QString list;
-        if(kernelType == kerRBF)
+        for(int i=1; i<=inputs.Ncols();i++)
         {
-            FOR(d, dim) list += QString("%1 ").arg(x[d]);
-            list += QString("A: %1").arg(x[dim]);
+            double diff = out(1,i) - outputs(1,i);
+            mse += diff*diff;
         }
-        else list += QString("%1 ").arg(x[0]);
-        qDebug() << "loglik" << logLikelihood << list;
-        if(logLikelihood != logLikelihood) return 0; // better than NAN!
-        return logLikelihood;
     }
-    else
+    else mse = FLT_MAX;
+    mse /= inputs.Ncols();
+    QString list;
+    if(kernelType == kerRBF)
     {
-        double mse = 0;
-        for(int i=1; i<=inputs.Ncols();i++)
-        {
-            double confidence;
-            Matrix out = sogp->predict(inputs.Column(i),confidence);
-            if(out.Ncols())
-            {
-                double diff = out(1,1) - outputs(1,i);
-                mse += diff*diff;
-            }
-            else mse = FLT_MAX;
-        }
-        mse /= inputs.Ncols();
-        QString list;
-        if(kernelType == kerRBF)
-        {
-            FOR(d, dim) list += QString("%1 ").arg(x[d]);
-            list += QString("A: %1").arg(x[dim]);
-        }
-        else list += QString("%1 ").arg(x[0]);
-        qDebug() << "mse" << mse << list;
-        return mse;
+        FOR(d, dim) list += QString("%1 ").arg(x[d]);
+        list += QString("A: %1").arg(x[dim]);
     }
+    else list += QString("%1 ").arg(x[0]);
+    qDebug() << "mse" << mse << list;
+    return mse;
 }
 
 struct OptData
 {
     const Matrix *inputs, *outputs;
     SOGP *sogp;
-    bool bLikelihood;
 };
 
 double objectiveFunction(unsigned n, const double *x, double *gradient /* NULL if not needed */, void *func_data)
 {
     OptData *data = (OptData*)func_data;
 
-    double objective = GetLikelihood(x, *data->inputs, *data->outputs, data->sogp, data->bLikelihood);
+    double objective = GetTrainingError(x, *data->inputs, *data->outputs, data->sogp);
     if(gradient)
     {
         double *dx = new double[n];
@@ -165,7 +143,7 @@ double objectiveFunction(unsigned n, const double *x, double *gradient /* NULL i
         {
             memcpy(dx, x, n*sizeof(double));
             dx[i] += delta;
-            double dError = GetLikelihood(dx, *data->inputs, *data->outputs, data->sogp, data->bLikelihood);
+            double dError = GetTrainingError(dx, *data->inputs, *data->outputs, data->sogp);
             gradient[i] = (dError - objective)/delta;
         }
         delete [] dx;
@@ -178,13 +156,6 @@ void RegressorGPR::Optimize(const Matrix &inputs, const Matrix &outputs)
 {
     int dim = inputs.Nrows();
 
-    OptData *data = new OptData;
-
-    data->inputs = &inputs;
-    data->outputs = &outputs;
-    data->sogp = sogp;
-    data->bLikelihood = bOptimizeLikelihood;
-
     int optDim = dim + 1;
     SOGPParams &oldParams = sogp->getParams();
     switch(oldParams.m_kernel->m_type)
@@ -197,24 +168,6 @@ void RegressorGPR::Optimize(const Matrix &inputs, const Matrix &outputs)
         break;
     }
 
-    //nlopt::opt opt(nlopt::LN_AUGLAG, optDim);
-    //nlopt::opt opt(nlopt::LN_COBYLA, optDim);
-    //nlopt::opt opt(nlopt::LN_NELDERMEAD, optDim);
-    //nlopt::opt opt(nlopt::LN_NEWUOA, optDim);
-    //nlopt::opt opt(nlopt::LN_PRAXIS, optDim);
-    nlopt::opt opt(nlopt::LN_BOBYQA, optDim);
-    //nlopt::opt opt(nlopt::LN_SBPLX, optDim);
-
-    if(bOptimizeLikelihood) opt.set_max_objective(objectiveFunction, (void*)data);
-    else opt.set_min_objective(objectiveFunction, (void*)data);
-    opt.set_maxeval(200);
-    vector<double> lowerBounds(optDim, 0);
-    if(bOptimizeLikelihood) lowerBounds.back() = 1e-4; // s20 noise
-    opt.set_lower_bounds(lowerBounds);
-    vector<double> steps(optDim,0.1);
-    opt.set_initial_step(steps);
-    opt.set_xtol_abs(0.01);
-
     vector<double> x(optDim), xOpt;
 
     switch(oldParams.m_kernel->m_type)
@@ -233,10 +186,51 @@ void RegressorGPR::Optimize(const Matrix &inputs, const Matrix &outputs)
     }
         break;
     }
+    OptData *data = 0;
     try
     {
         // do the actual optimization
-        xOpt = opt.optimize(x);
+        if(bOptimizeLikelihood)
+        {
+            // marginal likelihood of the full GP, maximized with its analytic gradient
+            Eigen::MatrixXd X(dim, inputs.Ncols());
+            Eigen::VectorXd y(inputs.Ncols());
+            FOR(i, inputs.Ncols())
+            {
+                FOR(d, dim) X(d, i) = inputs(d+1, i+1);
+                y(i) = outputs(1, i+1);
+            }
+            GPRLikelihood likelihood(X, y, oldParams.m_kernel->m_type, oldParams.s20, fitSamples);
+            xOpt = x;
+            double logLikelihood = likelihood.Maximize(xOpt);
+            QString list;
+            FOR(i, xOpt.size()) list += QString("%1 ").arg(xOpt[i]);
+            qDebug() << "loglik" << logLikelihood << list;
+        }
+        else
+        {
+            data = new OptData;
+            data->inputs = &inputs;
+            data->outputs = &outputs;
+            data->sogp = sogp;
+
+            //nlopt::opt opt(nlopt::LN_AUGLAG, optDim);
+            //nlopt::opt opt(nlopt::LN_COBYLA, optDim);
+            //nlopt::opt opt(nlopt::LN_NELDERMEAD, optDim);
+            //nlopt::opt opt(nlopt::LN_NEWUOA, optDim);
+            //nlopt::opt opt(nlopt::LN_PRAXIS, optDim);
+            nlopt::opt opt(nlopt::LN_BOBYQA, optDim);
+            //nlopt::opt opt(nlopt::LN_SBPLX, optDim);
+
+            opt.set_min_objective(objectiveFunction, (void*)data);
+            opt.set_maxeval(200);
+            vector<double> lowerBounds(optDim, 0);
+            opt.set_lower_bounds(lowerBounds);
+            vector<double> steps(optDim,0.1);
+            opt.set_initial_step(steps);
+            opt.set_xtol_abs(0.01);
+            xOpt = opt.optimize(x);
+        }
 
         // use the best parameters to retrain
         int dim = inputs.Nrows();
@@ -292,6 +286,29 @@ fvec RegressorGPR::Test( const fvec &sample )
     return res;
 }
 
+void RegressorGPR::TestBatch(const std::vector<fvec> &samples, fvec &means, fvec &variances)
+{
+    int count = samples.size();
+    means.assign(count, 0);
+    variances.assign(count, 0);
+    if(!sogp || !count) return;
+    int dim = sogp->dim();
+    Eigen::MatrixXd inputs(dim, count);
+    FOR(n, count)
+    {
+        FOR(d, dim) inputs(d, n) = samples[n][d];
+        if(outputDim != -1 && outputDim < dim) inputs(outputDim, n) = samples[n][dim];
+    }
+    Eigen::MatrixXd outputs;
+    Eigen::VectorXd confidence;
+    sogp->predictM(inputs, outputs, confidence);
+    FOR(n, count)
+    {
+        if(outputs.rows()) means[n] = outputs(0, n);
+        variances[n] = confidence(n)*confidence(n);
+    }
+}
+
 fVec RegressorGPR::Test( const fVec &sample )
 {
     fVec res;
@@ -37,17 +37,20 @@ private:
 	int capacity;
     bool bOptimize;
     bool bOptimizeLikelihood;
+    int fitSamples; // samples the likelihood is computed on, 0: all of them
 
 public:
 	SOGP *sogp;
 	bool bShowBasis;
-    RegressorGPR() : sogp(0), dim(1), capacity(0), kernelType(kerRBF), bTrained(false), param1(1), param2(0.1), bShowBasis(false), degree(1), bOptimize(false){type = REGR_GPR;}
+    RegressorGPR() : sogp(0), dim(1), capacity(0), kernelType(kerRBF), bTrained(false), param1(1), param2(0.1), bShowBasis(false), degree(1), bOptimize(false), bOptimizeLikelihood(true), fitSamples(0){type = REGR_GPR;}
 	void Train(std::vector<fvec> inputs, ivec labels);
 	fvec Test(const fvec &sample);
 	fVec Test(const fVec &sample);
+	// the results of Test for all the samples, from a single prediction of the model
+	void TestBatch(const std::vector<fvec> &samples, fvec &means, fvec &variances);
     const char *GetInfoString();
 
-    void SetParams(double p1, double p2, int capacity, int kType, int d=1, bool bOptimize=false, bool bOptimizeLikelihood=true){param1=p1; param2=p2; kernelType=kType; degree = d;this->capacity=capacity;this->bOptimize=bOptimize;this->bOptimizeLikelihood=bOptimizeLikelihood;}
+    void SetParams(double p1, double p2, int capacity, int kType, int d=1, bool bOptimize=false, bool bOptimizeLikelihood=true, int fitSamples=0){param1=p1; param2=p2; kernelType=kType; degree = d;this->capacity=capacity;this->bOptimize=bOptimize;this->bOptimizeLikelihood=bOptimizeLikelihood;this->fitSamples=fitSamples;}
     SOGP *GetModel(){return sogp;}
 	void Clear();
 	fvec GetBasisVector(int index);
@@ -21,6 +21,7 @@ Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
 #include "basicMath.h"
 #include "classifierKNN.h"
 #include <map>
+#include <fstream>
 #include <QDebug>
 using namespace std;
 
@@ -28,20 +29,16 @@ void ClassifierKNN::Train( std::vector< fvec > samples, ivec labels )
 {
 	if(!samples.size()) return;
 	int dim = samples[0].size();
-	DEL(kdTree);
-	annClose();
-	ANN::MetricType = (ANN_METRIC)metricType;
-	ANN::MetricPower = metricP;
 	this->samples = samples;
 	this->labels = labels;
 
-	dataPts = annAllocPts(samples.size(), dim);			// allocate data points
-	FOR(i, samples.size())
-	{
-		FOR(j, dim) dataPts[i][j] = samples[i][j];
-	}
-	kdTree = new ANNkd_tree(dataPts, samples.size(), dim);
+	fvec points = flatten(samples, dim);
+	index.Build(&points[0], samples.size(), dim);
+	MapClasses();
+}
 
+void ClassifierKNN::MapClasses()
+{
     int cnt=0;
     bool bClassZero=false, bClassOne=false;
     FOR(i, labels.size()) {
@@ -52,146 +49,125 @@ void ClassifierKNN::Train( std::vector< fvec > samples, ivec labels )
 
     bBinary = (classMap.size() == 2 && bClassZero && bClassOne);
     for(map<int,int>::iterator it=classMap.begin(); it != classMap.end(); it++) inverseMap[it->second] = it->first;
+
+    // we remap the labels and the class ordering once and for all
+    classLabels.resize(labels.size());
+    bvec bPresent(256, false);
+    FOR(i, labels.size())
+    {
+        classLabels[i] = classMap.at(labels[i]);
+        if(classLabels[i] >= 0 && classLabels[i] < 256) bPresent[classLabels[i]] = true;
+    }
+    classIndices.clear();
+    FOR(i, 256) if(bPresent[i]) classIndices.push_back(i);
 }
 
 ClassifierKNN::~ClassifierKNN()
 {
-	annClose();
-	DEL(kdTree);
 }
 
 fvec ClassifierKNN::TestMulti(const fvec &sample) const
 {
-	if(!samples.size()) return fvec();
-
-    ivec newLabels(labels.size());
-    std::map<int,int> counts;
-    FOR(i, newLabels.size()) {
-        newLabels[i] = classMap.at(labels.at(i));
-        counts[newLabels[i]] = 0;
-    }
-
-	double eps = 0; // error bound
-	ANNpoint queryPt; // query point
-	queryPt = annAllocPt(sample.size()); // allocate query point
-	ANNidxArray nnIdx = new ANNidx[k]; // allocate near neigh indices
-	ANNdistArray dists = new ANNdist[k]; // allocate near neighbor dists
-	FOR(i, sample.size()) queryPt[i] = sample[i];
-	kdTree->annkSearch(queryPt, k, nnIdx, dists, eps);
-	FOR(i, k)
-	{
-        if(nnIdx[i] >= (int)newLabels.size()) {
-            continue;
-        }
-        int label = newLabels[nnIdx[i]];
-        counts[label]++;
-	}
-	delete [] nnIdx; // clean things up
-	delete [] dists;
-
     fvec score;
-    if(bBinary) {
-        float res = (counts[1] - counts[0])/(float)(counts[0]+counts[1])*3;
-        score.push_back(classMap.at(0) == 0 ? res : -res);
-        return score;
-    }
-
-    FOR(i, 256) {
-		if(counts.count(i)) score.push_back(counts[i]);
-	}
-
-	float sum = 0;
-    FOR(i, score.size()) {
-		sum += score[i];
-	}
-
-    if(sum > 0) {
-        FOR(i, score.size()) {
-			score[i] /= sum;
-		}
-	}
-	return score;
+    TestMultiBatch(&sample[0], 1, sample.size(), score);
+    return score;
 }
 
 float ClassifierKNN::Test( const fvec &sample ) const
 {
-	if(!samples.size()) return 0;
-	float score = 0;
-	double eps = 0; // error bound
-	ANNpoint queryPt; // query point
-	queryPt = annAllocPt(sample.size()); // allocate query point
-	ANNidxArray nnIdx = new ANNidx[k]; // allocate near neigh indices
-	ANNdistArray dists = new ANNdist[k]; // allocate near neighbor dists
-	FOR(i, sample.size()) queryPt[i] = sample[i];
-	kdTree->annkSearch(queryPt, k, nnIdx, dists, eps);
-	int cnt = 0;
-	//map<int,int> counts;
-	FOR(i, k)
-	{
-		if(nnIdx[i] >= labels.size()) continue;
-        //int label = labels[nnIdx[i]];
-		//if(counts.count(label)) counts[label]++;
-		//else counts[label] = 0;
-		score += labels[nnIdx[i]];
-		cnt++;
-	}
-	score /= cnt;
-
-	delete [] nnIdx; // clean things up
-	delete [] dists;
-
-	return score;
+    float score = 0;
+    TestBatch(&sample[0], 1, sample.size(), &score);
+    return score;
 }
 
 float ClassifierKNN::Test( const fVec &sample ) const
 {
-	if(!samples.size()) return 0;
-	float score = 0;
-
-	double eps = 0; // error bound
-	ANNpoint queryPt; // query point
-	queryPt = annAllocPt(sample.size()); // allocate query point
-	ANNidxArray nnIdx = new ANNidx[k]; // allocate near neigh indices
-	ANNdistArray dists = new ANNdist[k]; // allocate near neighbor dists
-	FOR(i, sample.size()) queryPt[i] = sample._[i];
-	kdTree->annkSearch(queryPt, k, nnIdx, dists, eps);
-	int cnt = 0;
-	FOR(i, k)
-	{
-		if(nnIdx[i] >= labels.size()) continue;
-		score += labels[nnIdx[i]];
-		cnt++;
-	}
-	score /= cnt;
+    float score = 0;
+    TestBatch(sample._, 1, 2, &score);
+    return score*2;
+}
 
-	delete [] nnIdx; // clean things up
-	delete [] dists;
+void ClassifierKNN::TestBatch(const float *rowMajor, int count, int dim, float *out) const
+{
+    if(!samples.size() || dim < index.dimension())
+    {
+        FOR(i, count) out[i] = 0;
+        return;
+    }
+    // the query buffers belong to the calling thread and are reused from one call to the next
+    NeighborQuery &query = NeighborQuery::Local();
+    FOR(i, count)
+    {
+        index.KNearest(rowMajor + i*dim, k, query);
+        float score = 0;
+        int cnt = 0;
+        FOR(j, query.indices.size())
+        {
+            if(query.indices[j] >= (int)labels.size()) continue;
+            score += labels[query.indices[j]];
+            cnt++;
+        }
+        out[i] = cnt ? score / cnt : 0;
+    }
+}
 
-	return score*2;
+int ClassifierKNN::TestMultiBatch(const float *rowMajor, int count, int dim, fvec &out) const
+{
+    out.clear();
+    if(!samples.size() || dim < index.dimension()) return 0;
+
+    int resDim = bBinary ? 1 : classIndices.size();
+    float binarySign = (bBinary && classMap.at(0) != 0) ? -1.f : 1.f;
+    out.resize(count*resDim, 0.f);
+
+    NeighborQuery &query = NeighborQuery::Local();
+    float counts[256];
+    FOR(i, count)
+    {
+        index.KNearest(rowMajor + i*dim, k, query);
+        FOR(c, classIndices.size()) counts[classIndices[c]] = 0;
+        FOR(j, query.indices.size())
+        {
+            if(query.indices[j] >= (int)classLabels.size()) continue;
+            int label = classLabels[query.indices[j]];
+            if(label >= 0 && label < 256) counts[label]++;
+        }
+        float *res = &out[i*resDim];
+        if(bBinary)
+        {
+            res[0] = binarySign*(counts[1] - counts[0])/(counts[0]+counts[1])*3;
+            continue;
+        }
+        float sum = 0;
+        FOR(c, resDim) sum += (res[c] = counts[classIndices[c]]);
+        if(sum > 0) FOR(c, resDim) res[c] /= sum;
+    }
+    return resDim;
 }
 
-void ClassifierKNN::SetParams( u32 k, int metricType, u32 metricP )
+void ClassifierKNN::SetParams( u32 k, int metricType, u32 metricP, int indexType, int buildBreadth, int searchBreadth )
 {
 	this->k = k;
 	switch(metricType)
 	{
 	case 0:
-		this->metricType = ANN_METRIC1;
+		this->metricType = NeighborIndex::METRIC_L1;
 		this->metricP = 1;
 		break;
 	case 1:
-		this->metricType = ANN_METRIC2;
+		this->metricType = NeighborIndex::METRIC_L2;
 		this->metricP = 2;
 		break;
 	case 2:
-		this->metricType = ANN_METRICP;
+		this->metricType = NeighborIndex::METRIC_LP;
 		this->metricP = metricP;
 		break;
 	case 3:
-		this->metricType = ANN_METRIC0;
+		this->metricType = NeighborIndex::METRIC_INF;
 		this->metricP = 0;
 		break;
 	}
+	index.SetParams((NeighborIndex::Metric)this->metricType, this->metricP, indexType, buildBreadth, searchBreadth);
 }
 
 const char *ClassifierKNN::GetInfoString() const
@@ -215,5 +191,62 @@ const char *ClassifierKNN::GetInfoString() const
 		sprintf(text, "%s%d-norm\n", text, metricP);
 		break;
 	}
+	if(index.type() == KNNSearch::INDEX_GRAPH) sprintf(text, "%sIndex: graph (build %d, search %d)\n", text, index.buildBreadth(), index.searchBreadth());
+	else sprintf(text, "%sIndex: kd-tree\n", text);
 	return text;
 }
+
+void ClassifierKNN::SaveModel(const std::string filename) const
+{
+    if(!samples.size())
+    {
+        std::cout << "Error: Nothing to save!" << std::endl;
+        return;
+    }
+    std::ofstream file(filename.c_str());
+    if(!file)
+    {
+        std::cout << "Error: Could not open the file!" << std::endl;
+        return;
+    }
+    int dim = samples[0].size();
+    file.precision(9);
+    file << "KNN " << k << " " << metricType << " " << metricP << "\n";
+    file << samples.size() << " " << dim << "\n";
+    FOR(i, samples.size())
+    {
+        file << labels[i];
+        FOR(d, dim) file << " " << samples[i][d];
+        file << "\n";
+    }
+    index.Save(file);
+}
+
+bool ClassifierKNN::LoadModel(const std::string filename)
+{
+    std::ifstream file(filename.c_str());
+    if(!file.is_open())
+    {
+        std::cout << "Error: Could not open the file!" << std::endl;
+        return false;
+    }
+    string header;
+    int count = 0, dim = 0;
+    file >> header >> k >> metricType >> metricP >> count >> dim;
+    if(!file || header != "KNN" || count <= 0 || dim <= 0) return false;
+    samples.assign(count, fvec(dim));
+    labels.resize(count);
+    FOR(i, count)
+    {
+        file >> labels[i];
+        FOR(d, dim) file >> samples[i][d];
+    }
+    if(!file) return false;
+    fvec points = flatten(samples, dim);
+    if(!index.Load(file, &points[0], count, dim)) return false;
+    this->dim = dim;
+    classMap.clear();
+    inverseMap.clear();
+    MapClasses();
+    return true;
+}
@@ -22,31 +22,33 @@ Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
 #include <vector>
 #include <map>
 #include "classifier.h"
-#include "ANN/ANN.h"
+#include "knnSearch.h"
 
 class ClassifierKNN : public Classifier
 {
 private:
     int k;
-    int					nPts;					// actual number of data points
-	ANNpointArray		dataPts;				// data points
-	ANNidxArray			nnIdx;					// near neighbor indices
-	ANNdistArray		dists;					// near neighbor distances
-	ANNkd_tree*			kdTree;					// search structure
+	KNNSearch			index;					// search structure
 	int metricType;
 	int metricP;
-	std::map<int,int> counts;
     bool bBinary;
+    ivec classLabels;							// labels remapped to the class indices
+    ivec classIndices;							// the classes present, in increasing order
+    void MapClasses();
 
 public:
-    ClassifierKNN(): k(1), nPts(0), dataPts(0), nnIdx(0), dists(0), kdTree(0), metricType(2), metricP(2), bBinary(false) {bMultiClass = true;}
+    ClassifierKNN(): k(1), metricType(2), metricP(2), bBinary(false) {bMultiClass = true; bThreadSafe = bConcurrentTraining = true;}
 	~ClassifierKNN();
     void Train(std::vector< fvec > samples, ivec labels);
     fvec TestMulti(const fvec &sample) const ;
     float Test( const fvec &sample) const ;
     float Test( const fVec &sample) const ;
-	void SetParams(u32 k, int metricType, u32 metricP);
+    void TestBatch(const float *rowMajor, int count, int dim, float *out) const ;
+    int TestMultiBatch(const float *rowMajor, int count, int dim, fvec &out) const ;
+	void SetParams(u32 k, int metricType, u32 metricP, int indexType=KNNSearch::INDEX_KDTREE, int buildBreadth=100, int searchBreadth=50);
     const char *GetInfoString() const ;
+    void SaveModel(const std::string filename) const ;
+    bool LoadModel(const std::string filename);
 };
 
 #endif // _CLASSIFIER_KNN_H_
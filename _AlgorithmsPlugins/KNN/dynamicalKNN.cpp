@@ -20,6 +20,7 @@ Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
 #include "public.h"
 #include "basicMath.h"
 #include "dynamicalKNN.h"
+#include <fstream>
 using namespace std;
 
 void DynamicalKNN::Train(std::vector< std::vector<fvec> > trajectories, ivec labels)
@@ -52,23 +53,12 @@ void DynamicalKNN::Train(std::vector< std::vector<fvec> > trajectories, ivec lab
 		}
 	}
 
-	DEL(kdTree);
-	annClose();
-	ANN::MetricType = (ANN_METRIC)metricType;
-	ANN::MetricPower = metricP;
-
-	dataPts = annAllocPts(sampleCount, dim);			// allocate data points
-	FOR(i, sampleCount)
-	{
-		FOR(d, dim) dataPts[i][d] = points[i][d];
-	}
-	kdTree = new ANNkd_tree(dataPts, sampleCount, dim);
+	fvec data = flatten(points, dim);
+	index.Build(&data[0], sampleCount, dim);
 }
 
 DynamicalKNN::~DynamicalKNN()
 {
-	annClose();
-	DEL(kdTree);
 }
 std::vector<fvec> DynamicalKNN::Test( const fvec &sample, const int count)
 {
@@ -87,65 +77,37 @@ std::vector<fvec> DynamicalKNN::Test( const fvec &sample, const int count)
 	return res;
 }
 
-fvec DynamicalKNN::Test( const fvec &sample )
+// distance-weighted mean of the velocities of the neighbors found by the query
+void DynamicalKNN::Estimate( const NeighborQuery &query, float *mean, int dim ) const
 {
-	fvec res;
-	res.resize(2,0);
-	int dim = sample.size();
-	if(!points.size()) return res;
-	double eps = 0; // error bound
-	ANNpoint queryPt; // query point
-	queryPt = annAllocPt(dim); // allocate query point
-	ANNidxArray nnIdx = new ANNidx[k]; // allocate near neigh indices
-	ANNdistArray dists = new ANNdist[k]; // allocate near neighbor dists
-	FOR(i, dim) queryPt[i] = sample[i];
-	kdTree->annkSearch(queryPt, k, nnIdx, dists, eps);
-
+	const ivec &nnIdx = query.indices;
+	const fvec &dists = query.distances;
 	float dsum = 0;
-    vector<fvec> scores(k);
-	FOR(i, k)
+	FOR(i, nnIdx.size())
 	{
-		if(nnIdx[i] >= points.size()) continue;
-		if(dists[i] == 0) dsum += 0;
-		else dsum += 1./dists[i];
-		scores[i].resize(dim);
-		FOR(d,dim) scores[i][d] = velocities[nnIdx[i]][d];
+		if(dists[i] != 0) dsum += 1./dists[i];
 	}
-	FOR(i, k)
+	FOR(d, dim) mean[d] = 0;
+	FOR(i, nnIdx.size())
 	{
-		if(nnIdx[i] >= points.size()) continue;
 		if(dists[i] == 0) continue;
-		dists[i] = 1./(dists[i])/dsum;
-	}
-
-    fvec mean(dim,0);
-    fvec stdev(dim,0);
-	int cnt = 0;
-	FOR(i, k)
-	{
-		if(nnIdx[i] >= points.size()) continue;
-		//mean += scores[i] / (scores.size());
-		mean += scores[i] * dists[i];
-		cnt++;
-	}
-	FOR(i, k)
-	{
-		if(nnIdx[i] >= points.size()) continue;
-		FOR(d,dim) stdev[d] += (scores[i] - mean)[d]*(scores[i] - mean)[d];
+		float weight = 1./dists[i]/dsum;
+		const fvec &velocity = velocities[nnIdx[i]];
+		FOR(d, dim) mean[d] += velocity[d] * weight;
 	}
-	FOR(d,dim)
-	{
-		if(cnt) stdev[d] /= cnt;
-		else stdev[d] = 0;
-		stdev[d] = sqrtf(stdev[d]);
-	}
-
-	delete [] nnIdx; // clean things up
-	delete [] dists;
-
-	res = mean;
-	//res[1] = stdev;
+}
 
+fvec DynamicalKNN::Test( const fvec &sample )
+{
+	fvec res;
+	res.resize(2,0);
+	int dim = sample.size();
+	if(!points.size() || dim < index.dimension()) return res;
+	// the query buffers belong to the calling thread and are reused from one call to the next
+	NeighborQuery &query = NeighborQuery::Local();
+	index.KNearest(&sample[0], k, query);
+	res.resize(dim);
+	Estimate(query, &res[0], dim);
 	return res;
 }
 
@@ -153,86 +115,36 @@ fvec DynamicalKNN::Test( const fvec &sample )
 fVec DynamicalKNN::Test( const fVec &sample )
 {
 	fVec res;
-	int dim = 2;
-	if(!points.size()) return res;
-	double eps = 0; // error bound
-	ANNpoint queryPt; // query point
-	queryPt = annAllocPt(dim); // allocate query point
-	ANNidxArray nnIdx = new ANNidx[k]; // allocate near neigh indices
-	ANNdistArray dists = new ANNdist[k]; // allocate near neighbor dists
-	FOR(i, dim) queryPt[i] = sample._[i];
-	kdTree->annkSearch(queryPt, k, nnIdx, dists, eps);
-
-	float dsum = 0;
-	vector<fvec> scores;
-	scores.resize(k);
-	FOR(i, k)
-	{
-		if(nnIdx[i] >= points.size()) continue;
-		if(dists[i] == 0) dsum += 0;
-		else dsum += 1./dists[i];
-		scores[i].resize(dim);
-		FOR(d,dim) scores[i][d] = velocities[nnIdx[i]][d];
-	}
-	FOR(i, k)
-	{
-		if(nnIdx[i] >= points.size()) continue;
-		if(dists[i] == 0) continue;
-		dists[i] = 1./(dists[i])/dsum;
-	}
-
-	fVec mean, stdev;
-	int cnt = 0;
-	FOR(i, k)
-	{
-		if(nnIdx[i] >= points.size()) continue;
-		//mean += scores[i] / (scores.size());
-		mean += scores[i] * dists[i];
-		cnt++;
-	}
-	FOR(i, k)
-	{
-		if(nnIdx[i] >= points.size()) continue;
-		FOR(d,dim) stdev[d] += (scores[i] - mean)[d]*(scores[i] - mean)[d];
-	}
-	FOR(d,dim)
-	{
-		if(cnt) stdev[d] /= cnt;
-		else stdev[d] = 0;
-		stdev[d] = sqrtf(stdev[d]);
-	}
-
-	delete [] nnIdx; // clean things up
-	delete [] dists;
-
-	res = mean;
-	//res[1] = stdev;
-
+	if(!points.size() || index.dimension() != 2) return res;
+	NeighborQuery &query = NeighborQuery::Local();
+	index.KNearest(sample._, k, query);
+	Estimate(query, res._, 2);
 	return res;
 }
 
-void DynamicalKNN::SetParams( u32 k, int metricType, u32 metricP )
+void DynamicalKNN::SetParams( u32 k, int metricType, u32 metricP, int indexType, int buildBreadth, int searchBreadth )
 {
 	this->k = k;
 	switch(metricType)
 	{
 	case 0:
-		this->metricType = ANN_METRIC1;
+		this->metricType = NeighborIndex::METRIC_L1;
 		this->metricP = 1;
 		break;
 	case 1:
-		this->metricType = ANN_METRIC2;
+		this->metricType = NeighborIndex::METRIC_L2;
 		this->metricP = 2;
 		break;
 	case 2:
-		this->metricType = ANN_METRICP;
+		this->metricType = NeighborIndex::METRIC_LP;
 		this->metricP = metricP;
 		break;
 	case 3:
-		this->metricType = ANN_METRIC0;
+		this->metricType = NeighborIndex::METRIC_INF;
 		this->metricP = 0;
 		break;
 	}
+	index.SetParams((NeighborIndex::Metric)this->metricType, this->metricP, indexType, buildBreadth, searchBreadth);
 }
 
 const char *DynamicalKNN::GetInfoString()
@@ -256,5 +168,58 @@ const char *DynamicalKNN::GetInfoString()
 		sprintf(text, "%s%d-norm\n", text, metricP);
 		break;
 	}
+	if(index.type() == KNNSearch::INDEX_GRAPH) sprintf(text, "%sIndex: graph (build %d, search %d)\n", text, index.buildBreadth(), index.searchBreadth());
+	else sprintf(text, "%sIndex: kd-tree\n", text);
 	return text;
 }
+
+void DynamicalKNN::SaveModel(std::string filename)
+{
+	if(!points.size())
+	{
+		std::cout << "Error: Nothing to save!" << std::endl;
+		return;
+	}
+	std::ofstream file(filename.c_str());
+	if(!file)
+	{
+		std::cout << "Error: Could not open the file!" << std::endl;
+		return;
+	}
+	int dim = points[0].size();
+	file.precision(9);
+	file << "KNN " << k << " " << metricType << " " << metricP << " " << dT << "\n";
+	file << points.size() << " " << dim << "\n";
+	FOR(i, points.size())
+	{
+		FOR(d, dim) file << points[i][d] << " ";
+		FOR(d, dim) file << velocities[i][d] << " ";
+		file << "\n";
+	}
+	index.Save(file);
+}
+
+bool DynamicalKNN::LoadModel(std::string filename)
+{
+	std::ifstream file(filename.c_str());
+	if(!file.is_open())
+	{
+		std::cout << "Error: Could not open the file!" << std::endl;
+		return false;
+	}
+	string header;
+	int count = 0, dim = 0;
+	file >> header >> k >> metricType >> metricP >> dT >> count >> dim;
+	if(!file || header != "KNN" || count <= 0 || dim <= 0) return false;
+	points.assign(count, fvec(dim));
+	velocities.assign(count, fvec(dim));
+	FOR(i, count)
+	{
+		FOR(d, dim) file >> points[i][d];
+		FOR(d, dim) file >> velocities[i][d];
+	}
+	if(!file) return false;
+	this->dim = dim;
+	fvec data = flatten(points, dim);
+	return index.Load(file, &data[0], count, dim);
+}
@@ -21,23 +21,20 @@ Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
 
 #include <vector>
 #include "dynamical.h"
-#include "ANN/ANN.h"
+#include "knnSearch.h"
 
 class DynamicalKNN : public Dynamical
 {
 private:
-	int					nPts;					// actual number of data points
-	ANNpointArray		dataPts;				// data points
-	ANNidxArray			nnIdx;					// near neighbor indices
-	ANNdistArray		dists;					// near neighbor distances
-	ANNkd_tree*			kdTree;					// search structure
+	KNNSearch			index;					// search structure
 	int metricType;
 	int metricP;
 	int k;
 	std::vector<fvec> points;
 	std::vector<fvec> velocities;
+	void Estimate(const NeighborQuery &query, float *mean, int dim) const;
 public:
-    DynamicalKNN(): k(1), nPts(0), dataPts(0), nnIdx(0), dists(0), kdTree(0), metricType(2), metricP(2){type = DYN_KNN;}
+    DynamicalKNN(): k(1), metricType(2), metricP(2){type = DYN_KNN;}
 	~DynamicalKNN();
 	void Train(std::vector< std::vector<fvec> > trajectories, ivec labels);
 	std::vector<fvec> Test( const fvec &sample, const int count);
@@ -45,7 +42,9 @@ public:
 	fVec Test( const fVec &sample);
     const char *GetInfoString();
 
-	void SetParams(u32 k, int metricType, u32 metricP);
+	void SetParams(u32 k, int metricType, u32 metricP, int indexType=KNNSearch::INDEX_KDTREE, int buildBreadth=100, int searchBreadth=50);
+	void SaveModel(std::string filename);
+	bool LoadModel(std::string filename);
 };
 
 #endif // _DYNAMICAL_KNN_H_
@@ -30,6 +30,7 @@ RegrKNN::RegrKNN()
 	params = new Ui::ParametersKNNRegress();
 	params->setupUi(widget = new QWidget());
     connect(params->knnNormCombo, SIGNAL(currentIndexChanged(int)), this, SLOT(ChangeOptions()));
+    connect(params->knnIndexCombo, SIGNAL(currentIndexChanged(int)), this, SLOT(ChangeOptions()));
     ChangeOptions();
 }
 
@@ -42,24 +43,28 @@ void RegrKNN::ChangeOptions()
 {
     params->knnNormSpin->setVisible(params->knnNormCombo->currentIndex() == 2);
     params->labelPower->setVisible(params->knnNormCombo->currentIndex() == 2);
+    bool bGraph = params->knnIndexCombo->currentIndex() == KNNSearch::INDEX_GRAPH;
+    params->knnBuildSpin->setVisible(bGraph);
+    params->knnSearchSpin->setVisible(bGraph);
+    params->labelBuild->setVisible(bGraph);
+    params->labelSearch->setVisible(bGraph);
 }
 
 void RegrKNN::SetParams(Regressor *regressor)
 {
 	if(!regressor) return;
-	int k = params->knnKspin->value();
-	int metricType = params->knnNormCombo->currentIndex();
-	int metricP = params->knnNormSpin->value();
-
-	((RegressorKNN *)regressor)->SetParams(k, metricType, metricP);
+    SetParams(regressor, GetParams());
 }
 
 fvec RegrKNN::GetParams()
 {
-    fvec par(3);
+    fvec par(6);
     par[0] = params->knnKspin->value();
     par[1] = params->knnNormCombo->currentIndex();
     par[2] = params->knnNormSpin->value();
+    par[3] = params->knnIndexCombo->currentIndex();
+    par[4] = params->knnBuildSpin->value();
+    par[5] = params->knnSearchSpin->value();
     return par;
 }
 
@@ -69,7 +74,10 @@ void RegrKNN::SetParams(Regressor *regressor, fvec parameters)
     int k = parameters.size() > 0 ? parameters[0] : 1;
     int metricType = parameters.size() > 1 ? parameters[1] : 0;
     int metricP = parameters.size() > 2 ? parameters[2] : 0;
-    ((RegressorKNN *)regressor)->SetParams(k, metricType, metricP);
+    int indexType = parameters.size() > 3 ? parameters[3] : KNNSearch::INDEX_KDTREE;
+    int buildBreadth = parameters.size() > 4 ? parameters[4] : 100;
+    int searchBreadth = parameters.size() > 5 ? parameters[5] : 50;
+    ((RegressorKNN *)regressor)->SetParams(k, metricType, metricP, indexType, buildBreadth, searchBreadth);
 }
 
 void RegrKNN::GetParameterList(std::vector<QString> &parameterNames,
@@ -79,9 +87,15 @@ void RegrKNN::GetParameterList(std::vector<QString> &parameterNames,
     parameterNames.push_back("K");
     parameterNames.push_back("Metric Type");
     parameterNames.push_back("Metric Power");
+    parameterNames.push_back("Index Type");
+    parameterNames.push_back("Build Breadth");
+    parameterNames.push_back("Search Breadth");
+    parameterTypes.push_back("Integer");
+    parameterTypes.push_back("List");
     parameterTypes.push_back("Integer");
     parameterTypes.push_back("List");
     parameterTypes.push_back("Integer");
+    parameterTypes.push_back("Integer");
     parameterValues.push_back(vector<QString>());
     parameterValues.back().push_back("1");
     parameterValues.back().push_back("999");
@@ -93,6 +107,15 @@ void RegrKNN::GetParameterList(std::vector<QString> &parameterNames,
     parameterValues.push_back(vector<QString>());
     parameterValues.back().push_back("1");
     parameterValues.back().push_back("150");
+    parameterValues.push_back(vector<QString>());
+    parameterValues.back().push_back("kd-tree");
+    parameterValues.back().push_back("Graph");
+    parameterValues.push_back(vector<QString>());
+    parameterValues.back().push_back("10");
+    parameterValues.back().push_back("1000");
+    parameterValues.push_back(vector<QString>());
+    parameterValues.back().push_back("1");
+    parameterValues.back().push_back("1000");
 }
 
 QString RegrKNN::GetAlgoString()
@@ -101,6 +124,7 @@ QString RegrKNN::GetAlgoString()
 	int metricType = params->knnNormCombo->currentIndex();
 	int metricP = params->knnNormSpin->value();
 	QString algo = QString("KNN %1 %2").arg(k).arg(metricType==3? 0 : metricType == 2 ? metricP : metricType+1);
+	if(params->knnIndexCombo->currentIndex() == KNNSearch::INDEX_GRAPH) algo += QString(" Graph %1 %2").arg(params->knnBuildSpin->value()).arg(params->knnSearchSpin->value());
 	return algo;
 }
 
@@ -158,6 +182,9 @@ void RegrKNN::SaveOptions(QSettings &settings)
 	settings.setValue("knnK", params->knnKspin->value());
 	settings.setValue("knnNorm", params->knnNormCombo->currentIndex());
 	settings.setValue("knnPower", params->knnNormSpin->value());
+	settings.setValue("knnIndex", params->knnIndexCombo->currentIndex());
+	settings.setValue("knnBuild", params->knnBuildSpin->value());
+	settings.setValue("knnSearch", params->knnSearchSpin->value());
 }
 
 bool RegrKNN::LoadOptions(QSettings &settings)
@@ -165,6 +192,9 @@ bool RegrKNN::LoadOptions(QSettings &settings)
 	if(settings.contains("knnK")) params->knnKspin->setValue(settings.value("knnK").toFloat());
 	if(settings.contains("knnNorm")) params->knnNormCombo->setCurrentIndex(settings.value("knnNorm").toInt());
 	if(settings.contains("knnPower")) params->knnNormSpin->setValue(settings.value("knnPower").toFloat());
+	if(settings.contains("knnIndex")) params->knnIndexCombo->setCurrentIndex(settings.value("knnIndex").toInt());
+	if(settings.contains("knnBuild")) params->knnBuildSpin->setValue(settings.value("knnBuild").toInt());
+	if(settings.contains("knnSearch")) params->knnSearchSpin->setValue(settings.value("knnSearch").toInt());
 	return true;
 }
 
@@ -173,6 +203,9 @@ void RegrKNN::SaveParams(QTextStream &file)
 	file << "regressionOptions" << ":" << "knnK" << " " << params->knnKspin->value() << "\n";
 	file << "regressionOptions" << ":" << "knnNorm" << " " << params->knnNormCombo->currentIndex() << "\n";
 	file << "regressionOptions" << ":" << "knnPower" << " " << params->knnNormSpin->value() << "\n";
+	file << "regressionOptions" << ":" << "knnIndex" << " " << params->knnIndexCombo->currentIndex() << "\n";
+	file << "regressionOptions" << ":" << "knnBuild" << " " << params->knnBuildSpin->value() << "\n";
+	file << "regressionOptions" << ":" << "knnSearch" << " " << params->knnSearchSpin->value() << "\n";
 }
 
 bool RegrKNN::LoadParams(QString name, float value)
@@ -180,5 +213,8 @@ bool RegrKNN::LoadParams(QString name, float value)
 	if(name.endsWith("knnK")) params->knnKspin->setValue((int)value);
 	if(name.endsWith("knnNorm")) params->knnNormCombo->setCurrentIndex((int)value);
 	if(name.endsWith("knnPower")) params->knnNormSpin->setValue((int)value);
+	if(name.endsWith("knnIndex")) params->knnIndexCombo->setCurrentIndex((int)value);
+	if(name.endsWith("knnBuild")) params->knnBuildSpin->setValue((int)value);
+	if(name.endsWith("knnSearch")) params->knnSearchSpin->setValue((int)value);
 	return true;
 }
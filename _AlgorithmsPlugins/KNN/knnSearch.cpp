@@ -0,0 +1,189 @@
+/*********************************************************************
+MLDemos: A User-Friendly visualization toolkit for machine learning
+Copyright (C) 2010  Basilio Noris
+Contact: mldemos@b4silio.com
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public License,
+version 3 as published by the Free Software Foundation.
+
+This library is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free
+Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*********************************************************************/
+#include "public.h"
+#include "knnSearch.h"
+#include <QMutex>
+#include <QMutexLocker>
+#include <algorithm>
+#include <cstring>
+#include <string>
+using namespace std;
+
+#define GRAPH_LINKS 16
+
+// the last graph built, so that the next model trained on the same samples plus new ones
+// (a new classifier, with the samples in another order) only inserts the new ones
+struct GraphCacheState
+{
+    QMutex mutex;
+    NeighborGraph graph;
+    NeighborIndex::Metric metric;
+    int power, buildBreadth;
+
+    GraphCacheState() : metric(NeighborIndex::METRIC_L2), power(2), buildBreadth(0) {}
+};
+
+static GraphCacheState &GraphCache()
+{
+    static GraphCacheState state;
+    return state;
+}
+
+// FNV-1a over the bits of one sample
+static unsigned long long SampleHash(const float *sample, int dim)
+{
+    unsigned long long hash = 14695981039346656037ULL;
+    FOR(d, dim)
+    {
+        unsigned int bits;
+        memcpy(&bits, &sample[d], sizeof(bits));
+        hash = (hash ^ bits) * 1099511628211ULL;
+    }
+    return hash;
+}
+
+// finds each point of the graph among the samples (identical coordinates, whatever their order) and
+// fills order with the sample of each point; false if some point is not among the samples
+static bool MatchSamples(const NeighborGraph &graph, const float *data, int count, int dim, ivec &order, bvec &used)
+{
+    order.clear();
+    used.assign(count, false);
+    if(graph.dimension() != dim || graph.size() > count) return false;
+    vector< pair<unsigned long long,int> > hashes(count);
+    FOR(i, count) hashes[i] = make_pair(SampleHash(data + (size_t)i*dim, dim), (int)i);
+    sort(hashes.begin(), hashes.end());
+    order.resize(graph.size());
+    FOR(i, graph.size())
+    {
+        const float *point = graph.row(i);
+        unsigned long long hash = SampleHash(point, dim);
+        vector< pair<unsigned long long,int> >::iterator it = lower_bound(hashes.begin(), hashes.end(), make_pair(hash, -1));
+        int sample = -1;
+        for(; it != hashes.end() && it->first == hash; ++it)
+        {
+            const float *row = data + (size_t)it->second*dim;
+            if(!used[it->second] && equal(row, row + dim, point))
+            {
+                sample = it->second;
+                break;
+            }
+        }
+        if(sample == -1)
+        {
+            order.clear();
+            return false;
+        }
+        order[i] = sample;
+        used[sample] = true;
+    }
+    return true;
+}
+
+KNNSearch::KNNSearch()
+    : metric(NeighborIndex::METRIC_L2), power(2), indexType(INDEX_KDTREE), efBuild(100), efSearch(50)
+{
+}
+
+void KNNSearch::SetParams(NeighborIndex::Metric metric, int power, int indexType, int buildBreadth, int searchBreadth)
+{
+    this->metric = metric;
+    this->power = power;
+    this->indexType = indexType;
+    efBuild = buildBreadth;
+    efSearch = searchBreadth;
+    tree.SetMetric(metric, power);
+    graph.SetMetric(metric, power);
+    graph.SetParams(GRAPH_LINKS, efBuild, efSearch);
+}
+
+void KNNSearch::Build(const float *data, int count, int dim)
+{
+    if(indexType != INDEX_GRAPH)
+    {
+        graph.Clear();
+        order.clear();
+        points.assign(data, data + (size_t)count*dim);
+        tree.Build(&points[0], count, dim);
+        return;
+    }
+    tree.Clear();
+    points.clear();
+    GraphCacheState &cache = GraphCache();
+    bvec inserted;
+    {
+        QMutexLocker lock(&cache.mutex);
+        if(cache.metric == metric && cache.power == power && cache.buildBreadth == efBuild && cache.graph.size() &&
+                MatchSamples(cache.graph, data, count, dim, order, inserted)) graph = cache.graph;
+        else
+        {
+            graph.Clear();
+            order.clear();
+            inserted.assign(count, false);
+        }
+    }
+    graph.SetMetric(metric, power);
+    graph.SetParams(GRAPH_LINKS, efBuild, efSearch);
+    FOR(i, count)
+    {
+        if(inserted[i]) continue;
+        graph.Insert(data + (size_t)i*dim, dim);
+        order.push_back(i);
+    }
+    QMutexLocker lock(&cache.mutex);
+    cache.graph = graph;
+    cache.metric = metric;
+    cache.power = power;
+    cache.buildBreadth = efBuild;
+}
+
+void KNNSearch::KNearest(const float *query, int k, NeighborQuery &scratch) const
+{
+    if(indexType != INDEX_GRAPH)
+    {
+        tree.KNearest(query, k, scratch);
+        return;
+    }
+    graph.KNearest(query, k, scratch);
+    FOR(i, scratch.indices.size()) scratch.indices[i] = order[scratch.indices[i]];
+}
+
+void KNNSearch::Save(ostream &file) const
+{
+    file << "KNNSearch " << indexType << " " << (int)metric << " " << power << " " << efBuild << " " << efSearch << "\n";
+    if(indexType == INDEX_GRAPH) graph.Save(file);
+}
+
+bool KNNSearch::Load(istream &file, const float *data, int count, int dim)
+{
+    string header;
+    int type, metricType, power, buildBreadth, searchBreadth;
+    file >> header >> type >> metricType >> power >> buildBreadth >> searchBreadth;
+    if(!file || header != "KNNSearch") return false;
+    SetParams((NeighborIndex::Metric)metricType, power, type, buildBreadth, searchBreadth);
+    if(indexType != INDEX_GRAPH)
+    {
+        Build(data, count, dim);
+        return true;
+    }
+    // the points of the graph may be in another order than the samples of the model
+    bvec matched;
+    if(!graph.Load(file) || graph.size() != count || !MatchSamples(graph, data, count, dim, order, matched)) return false;
+    graph.SetParams(GRAPH_LINKS, efBuild, efSearch);
+    return true;
+}
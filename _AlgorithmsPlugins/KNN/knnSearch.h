@@ -0,0 +1,62 @@
+/*********************************************************************
+MLDemos: A User-Friendly visualization toolkit for machine learning
+Copyright (C) 2010  Basilio Noris
+Contact: mldemos@b4silio.com
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public License,
+version 3 as published by the Free Software Foundation.
+
+This library is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free
+Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*********************************************************************/
+#ifndef _KNN_SEARCH_H_
+#define _KNN_SEARCH_H_
+
+#include <iostream>
+#include "neighborIndex.h"
+#include "neighborGraph.h"
+
+/*!
+ * the neighbor search of the KNN models: the exact kd-tree, or the approximate graph that
+ * stays fast in high dimensions. The kd-tree is rebuilt by Build. The last graph built is kept
+ * aside: when a model is then trained on the same samples plus new ones, in any order (as when
+ * samples are added on the canvas), Build starts from a copy of it and only inserts the new samples.
+ */
+class KNNSearch
+{
+public:
+    enum IndexType {INDEX_KDTREE, INDEX_GRAPH};
+
+    KNNSearch();
+    void SetParams(NeighborIndex::Metric metric, int power, int indexType=INDEX_KDTREE, int buildBreadth=100, int searchBreadth=50);
+    void Build(const float *data, int count, int dim);
+    void KNearest(const float *query, int k, NeighborQuery &scratch) const;
+    int dimension() const {return indexType == INDEX_GRAPH ? graph.dimension() : tree.dimension();}
+    int size() const {return indexType == INDEX_GRAPH ? graph.size() : tree.size();}
+    int type() const {return indexType;}
+    int buildBreadth() const {return efBuild;}
+    int searchBreadth() const {return efSearch;}
+
+    // the graph is stored as is, the kd-tree is rebuilt on loading from the points of the model
+    void Save(std::ostream &file) const;
+    bool Load(std::istream &file, const float *data, int count, int dim);
+
+private:
+    NeighborIndex::Metric metric;
+    int power;
+    int indexType;
+    int efBuild, efSearch;
+    fvec points;
+    NeighborIndex tree;
+    NeighborGraph graph;
+    ivec order; // the sample each point of the graph was inserted from
+};
+
+#endif // _KNN_SEARCH_H_
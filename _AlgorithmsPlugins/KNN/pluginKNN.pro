@@ -15,6 +15,7 @@ HEADERS +=	\
 			canvas.h \
 			datasetManager.h \
 			mymaths.h \
+			knnSearch.h \
 			classifierKNN.h \
 			regressorKNN.h \
 			dynamicalKNN.h \
@@ -24,6 +25,7 @@ HEADERS +=	\
 			pluginKNN.h
 
 SOURCES += 	\
+			knnSearch.cpp \
 			classifierKNN.cpp \
 			regressorKNN.cpp \
 			dynamicalKNN.cpp \
@@ -32,21 +34,5 @@ SOURCES += 	\
 			interfaceKNNDynamic.cpp \
 			pluginKNN.cpp
 
-###########################
-# Dependencies            #
-###########################
-HEADERS += ANN/ANN.h \
-	ANN/ANNperf.h \
-	ANN/ANNx.h \
-	ANN/bd_tree.h \
-	ANN/kd_fix_rad_search.h \
-	ANN/kd_pr_search.h \
-	ANN/kd_search.h \
-	ANN/kd_split.h \
-	ANN/kd_tree.h \
-	ANN/kd_util.h \
-	ANN/pr_queue.h \
-	ANN/pr_queue_k.h
-
 OTHER_FILES += \
     plugin.json
@@ -20,35 +20,63 @@ Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
 #include "public.h"
 #include "basicMath.h"
 #include "regressorKNN.h"
+#include <fstream>
 using namespace std;
 
 void RegressorKNN::Train( std::vector< fvec > samples, ivec labels )
 {
 	if(!samples.size()) return;
     dim = samples[0].size()-1;
-	DEL(kdTree);
-	annClose();
-	ANN::MetricType = (ANN_METRIC)metricType;
-	ANN::MetricPower = metricP;
 	this->samples = samples;
 	this->labels = labels;
+	fvec points = Points();
+	index.Build(&points[0], samples.size(), dim);
+}
 
-	dataPts = annAllocPts(samples.size(), dim);			// allocate data points
+// the inputs of the samples (row order), with the output dimension swapped in if there is one
+fvec RegressorKNN::Points() const
+{
+	fvec points(samples.size()*dim);
 	FOR(i, samples.size())
 	{
-		FOR(j, dim) dataPts[i][j] = samples[i][j];
+		FOR(j, dim) points[i*dim + j] = samples[i][j];
         if(outputDim != -1 && outputDim < dim)
         {
-            dataPts[i][outputDim] = samples[i][dim];
+            points[i*dim + outputDim] = samples[i][dim];
         }
 	}
-	kdTree = new ANNkd_tree(dataPts, samples.size(), dim);
+	return points;
 }
 
 RegressorKNN::~RegressorKNN()
 {
-	annClose();
-	DEL(kdTree);
+}
+
+// distance-weighted mean of the outputs of the neighbors found by the query, and their spread
+void RegressorKNN::Estimate( const NeighborQuery &query, int oDim, float &mean, float &stdev ) const
+{
+	const ivec &nnIdx = query.indices;
+	const fvec &dists = query.distances;
+	int cnt = nnIdx.size();
+	float dsum = 0;
+	FOR(i, cnt)
+	{
+		if(dists[i] != 0) dsum += 1./dists[i];
+	}
+	mean = 0;
+	stdev = 0;
+	FOR(i, cnt)
+	{
+		if(dists[i] == 0) continue;
+		mean += samples[nnIdx[i]][oDim] * (1./dists[i]/dsum);
+	}
+	FOR(i, cnt)
+	{
+		float score = samples[nnIdx[i]][oDim];
+		stdev += (score - mean)*(score - mean);
+	}
+	if(cnt) stdev /= cnt;
+	stdev = sqrtf(stdev);
 }
 
 fvec RegressorKNN::Test( const fvec &sample )
@@ -58,60 +86,16 @@ fvec RegressorKNN::Test( const fvec &sample )
 	if(!samples.size()) return res;
 	int dim = sample.size()-1;
     int oDim = outputDim == -1 || outputDim > dim ? dim : outputDim;
-	double eps = 0; // error bound
-    ANNpoint queryPt; // query point
-	queryPt = annAllocPt(dim); // allocate query point
-	ANNidxArray nnIdx = new ANNidx[k]; // allocate near neigh indices
-	ANNdistArray dists = new ANNdist[k]; // allocate near neighbor dists
-    FOR(i, dim) queryPt[i] = sample[i];
+	if(dim < index.dimension()) return res;
+	// the query buffers belong to the calling thread and are reused from one call to the next
+	NeighborQuery &query = NeighborQuery::Local();
+	query.point.assign(sample.begin(), sample.begin() + dim);
     if(outputDim != -1 && outputDim < dim)
     {
-        queryPt[outputDim] = sample[dim];
+        query.point[outputDim] = sample[dim];
     }
-    if(k > samples.size()) k = samples.size();
-	kdTree->annkSearch(queryPt, k, nnIdx, dists, eps);
-
-    float dsum = 0;
-	fvec scores;
-        scores.resize(k,0);
-        FOR(i, k)
-	{
-                if(nnIdx[i] >= samples.size()) continue;
-                if(dists[i] == 0) dsum += 0;
-                else dsum += 1./dists[i];
-                scores[i] = samples[nnIdx[i]][oDim];
-	}
-        FOR(i, k)
-        {
-               if(nnIdx[i] >= samples.size()) continue;
-               if(dists[i] == 0) continue;
-               dists[i] = 1./(dists[i])/dsum;
-        }
-
-	float mean = 0, stdev = 0;
-        int cnt = 0;
-        FOR(i, k)
-	{
-                if(nnIdx[i] >= samples.size()) continue;
-                //mean += scores[i] / (scores.size());
-		mean += scores[i] * dists[i];
-                cnt++;
-	}
-        FOR(i, k)
-	{
-                if(nnIdx[i] >= samples.size()) continue;
-                stdev += (scores[i] - mean)*(scores[i] - mean);
-	}
-        if(cnt) stdev /= cnt;
-        else stdev = 0;
-	stdev = sqrtf(stdev);
-
-	delete [] nnIdx; // clean things up
-	delete [] dists;
-
-	res[0] = mean;
-	res[1] = stdev;
-
+	index.KNearest(&query.point[0], k, query);
+	Estimate(query, oDim, res[0], res[1]);
 	return res;
 }
 
@@ -119,83 +103,36 @@ fvec RegressorKNN::Test( const fvec &sample )
 fVec RegressorKNN::Test( const fVec &sample )
 {
 	fVec res;
-	if(!samples.size()) return res;
-	int dim = 1;
-	double eps = 0; // error bound
-	ANNpoint queryPt; // query point
-	queryPt = annAllocPt(dim); // allocate query point
-	ANNidxArray nnIdx = new ANNidx[k]; // allocate near neigh indices
-	ANNdistArray dists = new ANNdist[k]; // allocate near neighbor dists
-	FOR(i, dim) queryPt[i] = sample._[i];
-	if(k > samples.size()) k = samples.size();
-	kdTree->annkSearch(queryPt, k, nnIdx, dists, eps);
-
-	float dsum = 0;
-	fvec scores;
-		scores.resize(k,0);
-		FOR(i, k)
-	{
-				if(nnIdx[i] >= samples.size()) continue;
-				if(dists[i] == 0) dsum += 0;
-				else dsum += 1./dists[i];
-				scores[i] = samples[nnIdx[i]][dim];
-	}
-		FOR(i, k)
-		{
-			   if(nnIdx[i] >= samples.size()) continue;
-			   if(dists[i] == 0) continue;
-			   dists[i] = 1./(dists[i])/dsum;
-		}
-
-	float mean = 0, stdev = 0;
-		int cnt = 0;
-		FOR(i, k)
-	{
-				if(nnIdx[i] >= samples.size()) continue;
-				//mean += scores[i] / (scores.size());
-		mean += scores[i] * dists[i];
-				cnt++;
-	}
-		FOR(i, k)
-	{
-				if(nnIdx[i] >= samples.size()) continue;
-				stdev += (scores[i] - mean)*(scores[i] - mean);
-	}
-		if(cnt) stdev /= cnt;
-		else stdev = 0;
-	stdev = sqrtf(stdev);
-
-	delete [] nnIdx; // clean things up
-	delete [] dists;
-
-	res[0] = mean;
-	res[1] = stdev;
-
+	if(!samples.size() || index.dimension() != 1) return res;
+	NeighborQuery &query = NeighborQuery::Local();
+	index.KNearest(sample._, k, query);
+	Estimate(query, 1, res[0], res[1]);
 	return res;
 }
 
-void RegressorKNN::SetParams( u32 k, int metricType, u32 metricP )
+void RegressorKNN::SetParams( u32 k, int metricType, u32 metricP, int indexType, int buildBreadth, int searchBreadth )
 {
 	this->k = k;
 	switch(metricType)
 	{
 	case 0:
-		this->metricType = ANN_METRIC1;
+		this->metricType = NeighborIndex::METRIC_L1;
 		this->metricP = 1;
 		break;
 	case 1:
-		this->metricType = ANN_METRIC2;
+		this->metricType = NeighborIndex::METRIC_L2;
 		this->metricP = 2;
 		break;
 	case 2:
-		this->metricType = ANN_METRICP;
+		this->metricType = NeighborIndex::METRIC_LP;
 		this->metricP = metricP;
 		break;
 	case 3:
-		this->metricType = ANN_METRIC0;
+		this->metricType = NeighborIndex::METRIC_INF;
 		this->metricP = 0;
 		break;
 	}
+	index.SetParams((NeighborIndex::Metric)this->metricType, this->metricP, indexType, buildBreadth, searchBreadth);
 }
 
 const char *RegressorKNN::GetInfoString()
@@ -219,5 +156,54 @@ const char *RegressorKNN::GetInfoString()
 		sprintf(text, "%s%d-norm\n", text, metricP);
 		break;
 	}
+	if(index.type() == KNNSearch::INDEX_GRAPH) sprintf(text, "%sIndex: graph (build %d, search %d)\n", text, index.buildBreadth(), index.searchBreadth());
+	else sprintf(text, "%sIndex: kd-tree\n", text);
 	return text;
 }
+
+void RegressorKNN::SaveModel(std::string filename)
+{
+	if(!samples.size())
+	{
+		std::cout << "Error: Nothing to save!" << std::endl;
+		return;
+	}
+	std::ofstream file(filename.c_str());
+	if(!file)
+	{
+		std::cout << "Error: Could not open the file!" << std::endl;
+		return;
+	}
+	file.precision(9);
+	file << "KNN " << k << " " << metricType << " " << metricP << " " << outputDim << "\n";
+	file << samples.size() << " " << samples[0].size() << "\n";
+	FOR(i, samples.size())
+	{
+		FOR(d, samples[i].size()) file << samples[i][d] << " ";
+		file << "\n";
+	}
+	index.Save(file);
+}
+
+bool RegressorKNN::LoadModel(std::string filename)
+{
+	std::ifstream file(filename.c_str());
+	if(!file.is_open())
+	{
+		std::cout << "Error: Could not open the file!" << std::endl;
+		return false;
+	}
+	string header;
+	int count = 0, sampleDim = 0;
+	file >> header >> k >> metricType >> metricP >> outputDim >> count >> sampleDim;
+	if(!file || header != "KNN" || count <= 0 || sampleDim < 2) return false;
+	samples.assign(count, fvec(sampleDim));
+	FOR(i, count)
+	{
+		FOR(d, sampleDim) file >> samples[i][d];
+	}
+	if(!file) return false;
+	dim = sampleDim-1;
+	fvec points = Points();
+	return index.Load(file, &points[0], count, dim);
+}
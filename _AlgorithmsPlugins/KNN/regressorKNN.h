@@ -21,28 +21,28 @@ Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
 
 #include <vector>
 #include "regressor.h"
-#include "ANN/ANN.h"
+#include "knnSearch.h"
 
 class RegressorKNN : public Regressor
 {
 private:
-	int					nPts;					// actual number of data points
-	ANNpointArray		dataPts;				// data points
-	ANNidxArray			nnIdx;					// near neighbor indices
-	ANNdistArray		dists;					// near neighbor distances
-	ANNkd_tree*			kdTree;					// search structure
+	KNNSearch			index;					// search structure
 	int metricType;
 	int metricP;
 	int k;
+	void Estimate(const NeighborQuery &query, int oDim, float &mean, float &stdev) const;
+	fvec Points() const;
 public:
-    RegressorKNN(): k(1), nPts(0), dataPts(0), nnIdx(0), dists(0), kdTree(0), metricType(2), metricP(2){type = REGR_KNN;}
+    RegressorKNN(): k(1), metricType(2), metricP(2){type = REGR_KNN;}
 	~RegressorKNN();
 	void Train(std::vector< fvec > samples, ivec labels);
 	fvec Test( const fvec &sample);
 	fVec Test( const fVec &sample);
     const char *GetInfoString();
 
-	void SetParams(u32 k, int metricType, u32 metricP);
+	void SetParams(u32 k, int metricType, u32 metricP, int indexType=KNNSearch::INDEX_KDTREE, int buildBreadth=100, int searchBreadth=50);
+	void SaveModel(std::string filename);
+	bool LoadModel(std::string filename);
 };
 
 #endif // _REGRESSOR_KNN_H_
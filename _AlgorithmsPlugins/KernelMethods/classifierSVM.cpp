@@ -19,6 +19,7 @@ Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
 *********************************************************************/
 #include <public.h>
 #include "classifierSVM.h"
+#include "gramCache.h"
 #include <nlopt/nlopt.hpp>
 #include <QDebug>
 #include <iostream>
@@ -29,10 +30,11 @@ Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
 using namespace std;
 
 ClassifierSVM::ClassifierSVM()
-    : svm(0), node(0), x_space(0)
+    : svm(0), x_space(0)
 {
     dim = 2;
     bMultiClass = true;
+    bThreadSafe = bConcurrentTraining = true;
     classCount = 0;
     // default values
     param.svm_type = C_SVC;
@@ -60,7 +62,6 @@ ClassifierSVM::ClassifierSVM()
 
 ClassifierSVM::~ClassifierSVM()
 {
-    DEL(node);
     DEL(svm);
     DEL(x_space);
 }
@@ -485,10 +486,11 @@ void ClassifierSVM::Train(std::vector< fvec > samples, ivec labels)
     }
 
     delete(svm);
-    DEL(node);
-    svm = svm_train(&problem, &param);
+    param.nr_threads = threadCount;
+    svm = GramCache::Train(&problem, &param);
 
     if(bOptimize) OptimizeGradient(&problem);
+    predictor.Build(svm, dim);
 
     delete [] problem.x;
     delete [] problem.y;
@@ -582,43 +584,45 @@ void ClassifierSVM::Train(std::vector< fvec > samples, ivec labels)
     */
 }
 
-float ClassifierSVM::Test( const fvec &sample ) const
+// the output of svm_predict computed from the decision values of the dense predictor
+float ClassifierSVM::Estimate(const double *decisions) const
 {
-    int data_dimension = sample.size();
-    if(!svm) return 0;
     float estimate;
-    svm_node *node = new svm_node[data_dimension+1];
-    FOR(i, data_dimension)
-    {
-        node[i].index = i+1;
-        node[i].value = sample[i];
-    }
-    node[data_dimension].index = -1;
-    estimate = (float)svm_predict(svm, node);
+    if(svm->nr_class == 2) estimate = (float)(svm->label[0] == 1 ? decisions[0] : -decisions[0]);
+    else estimate = (float)svm->label[predictor.Winner(decisions)];
     // if we have a binary class in which the negative class is not the first
     if(svm->label[0] != -1) estimate *= -1;
     return estimate;
 }
 
-float ClassifierSVM::Test( const fVec &sample ) const
+float ClassifierSVM::Predict(const float *sample, int dim) const
 {
-    int data_dimension = 2;
-    if(!svm) return 0;
-    float estimate;
-    svm_node *node = new svm_node[data_dimension+1];
-    node[data_dimension].index = -1;
-
-    FOR(i, data_dimension)
+    if(predictor.IsValid() && dim == predictor.Dimension()) return Estimate(predictor.DecisionValues(sample));
+    // kernels the predictor does not handle go through the sparse nodes of libsvm
+    vector<svm_node> node(dim+1);
+    FOR(i, dim)
     {
         node[i].index = i+1;
-        node[i].value = sample._[i];
+        node[i].value = sample[i];
     }
-    estimate = (float)svm_predict(svm, node);
-    // if we have a binary class in which the negative class is not the first
+    node[dim].index = -1;
+    float estimate = (float)svm_predict(svm, &node[0]);
     if(svm->label[0] != -1) estimate *= -1;
     return estimate;
 }
 
+float ClassifierSVM::Test( const fvec &sample ) const
+{
+    if(!svm || !sample.size()) return 0;
+    return Predict(&sample[0], sample.size());
+}
+
+float ClassifierSVM::Test( const fVec &sample ) const
+{
+    if(!svm) return 0;
+    return Predict(sample._, 2);
+}
+
 fvec ClassifierSVM::TestMulti(const fvec &sample) const
 {
     if(classCount == 2)
@@ -631,28 +635,109 @@ fvec ClassifierSVM::TestMulti(const fvec &sample) const
     FOR(i, classCount) maxClass = max(maxClass, classes.at(i));
     fvec resp(maxClass,0);
     int data_dimension = sample.size();
-    if(!svm) return resp;
+    if(!svm || !data_dimension) return resp;
 
-    svm_node *node = new svm_node[data_dimension+1];
-    node[data_dimension].index = -1;
-    FOR(i, data_dimension)
+    dvec votes(classCount);
+    if(predictor.IsValid() && data_dimension == predictor.Dimension())
     {
-        node[i].index = i+1;
-        node[i].value = sample[i];
+        predictor.Votes(predictor.DecisionValues(&sample[0]), &votes[0]);
     }
-    double *decisions = new double[classCount];
-    svm_predict_votes(svm, node, decisions);
-    //int max = 0;
-    FOR(i, classCount)
+    else
     {
-        resp[classes.at(i)] = decisions[i];
-        //if(resp[max] < resp[classes[i]]) max = i;
+        vector<svm_node> node(data_dimension+1);
+        node[data_dimension].index = -1;
+        FOR(i, data_dimension)
+        {
+            node[i].index = i+1;
+            node[i].value = sample[i];
+        }
+        svm_predict_votes(svm, &node[0], &votes[0]);
     }
-    //resp[max] += classCount;
-    delete [] decisions;
+    FOR(i, classCount) resp[classes.at(i)] = votes[i];
     return resp;
 }
 
+void ClassifierSVM::TestBatch(const float *rowMajor, int count, int dim, float *out) const
+{
+    if(!svm)
+    {
+        FOR(i, count) out[i] = 0;
+        return;
+    }
+    if(predictor.IsValid() && dim == predictor.Dimension())
+    {
+        // the points are evaluated in blocks sharing a single decision buffer
+        const int blockSize = 256;
+        int decisionCount = predictor.DecisionCount();
+        dvec decisions(min(count, blockSize)*decisionCount);
+        for(int b=0; b<count; b+=blockSize)
+        {
+            int blockCount = min(blockSize, count-b);
+            predictor.Decisions(rowMajor + b*dim, blockCount, &decisions[0]);
+            FOR(i, blockCount) out[b+i] = Estimate(&decisions[i*decisionCount]);
+        }
+        return;
+    }
+    // a single node buffer is reused for the whole batch
+    vector<svm_node> node(dim+1);
+    FOR(d, dim) node[d].index = d+1;
+    node[dim].index = -1;
+    float sign = svm->label[0] != -1 ? -1.f : 1.f;
+    FOR(i, count)
+    {
+        FOR(d, dim) node[d].value = rowMajor[i*dim + d];
+        out[i] = (float)svm_predict(svm, &node[0]) * sign;
+    }
+}
+
+int ClassifierSVM::TestMultiBatch(const float *rowMajor, int count, int dim, fvec &out) const
+{
+    if(classCount == 2)
+    {
+        out.resize(count);
+        TestBatch(rowMajor, count, dim, &out[0]);
+        return 1;
+    }
+    int maxClass = classCount;
+    FOR(i, classCount) maxClass = max(maxClass, classes.at(i));
+    out.clear();
+    out.resize(count*maxClass, 0);
+    if(!svm) return maxClass;
+
+    dvec votes(classCount);
+    ivec classIndex(classCount);
+    FOR(c, classCount) classIndex[c] = classes.at(c);
+    if(predictor.IsValid() && dim == predictor.Dimension())
+    {
+        const int blockSize = 256;
+        int decisionCount = predictor.DecisionCount();
+        dvec decisions(min(count, blockSize)*decisionCount);
+        for(int b=0; b<count; b+=blockSize)
+        {
+            int blockCount = min(blockSize, count-b);
+            predictor.Decisions(rowMajor + b*dim, blockCount, &decisions[0]);
+            FOR(i, blockCount)
+            {
+                predictor.Votes(&decisions[i*decisionCount], &votes[0]);
+                float *resp = &out[(b+i)*maxClass];
+                FOR(c, classCount) resp[classIndex[c]] = votes[c];
+            }
+        }
+        return maxClass;
+    }
+    vector<svm_node> node(dim+1);
+    FOR(d, dim) node[d].index = d+1;
+    node[dim].index = -1;
+    FOR(i, count)
+    {
+        FOR(d, dim) node[d].value = rowMajor[i*dim + d];
+        svm_predict_votes(svm, &node[0], &votes[0]);
+        float *resp = &out[i*maxClass];
+        FOR(c, classCount) resp[classIndex[c]] = votes[c];
+    }
+    return maxClass;
+}
+
 const char *ClassifierSVM::GetInfoString() const
 {
     if(!svm) return NULL;
@@ -788,8 +873,8 @@ bool ClassifierSVM::LoadModel(std::string filename)
 {
     std::cout << "Loading SVM model" << std::endl;
     if(svm) DEL(svm);
-    if(node) DEL(node);
     if(x_space) DEL(x_space);
+    predictor.Clear();
 
     std::ifstream file(filename.c_str());
     if(!file.is_open()){
@@ -905,6 +990,7 @@ bool ClassifierSVM::LoadModel(std::string filename)
 
     file.close();
     svm->param = param;
+    predictor.Build(svm, dim);
 
     return true;
 }
@@ -23,15 +23,18 @@ Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
 #include <map>
 #include <classifier.h>
 #include "svm.h"
+#include "svmPredictor.h"
 
 class ClassifierSVM : public Classifier
 {
 private:
 	svm_model *svm;
-	svm_node *node;
 	svm_node *x_space;
 	int classCount;
     int type;
+    SVMPredictor predictor;
+    float Estimate(const double *decisions) const;
+    float Predict(const float *sample, int dim) const;
 public:
 	svm_parameter param;
     bool bOptimize;
@@ -44,6 +47,8 @@ public:
     float Test(const fvec &sample) const ;
     float Test(const fVec &sample) const ;
     fvec TestMulti(const fvec &sample) const ;
+    void TestBatch(const float *rowMajor, int count, int dim, float *out) const ;
+    int TestMultiBatch(const float *rowMajor, int count, int dim, fvec &out) const ;
     const char *GetInfoString() const ;
 	void SetParams(int svmType, float svmC, u32 kernelType, float kernelParam);
     svm_model *GetModel(){return svm;}
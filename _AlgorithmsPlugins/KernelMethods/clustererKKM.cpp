@@ -116,6 +116,32 @@ void ClustererKKM::KillDim()
         break;
     }
     decFunction = 0;
+    basis.clear();
+    alpha.clear();
+    centerNorm.clear();
+    centerStart.clear();
+}
+
+template <typename K>
+void ClustererKKM::FlattenCenters(void *function)
+{
+    kkmeans<K> &fun = *(kkmeans<K>*)function;
+    basis.clear();
+    alpha.clear();
+    centerNorm.clear();
+    centerStart.clear();
+    FOR(i, fun.number_of_centers())
+    {
+        distance_function<K> df = fun.get_kcentroid(i).get_distance_function();
+        centerStart.push_back(alpha.size());
+        centerNorm.push_back(df.get_squared_norm());
+        FOR(j, df.get_alpha().size())
+        {
+            alpha.push_back(df.get_alpha()(j));
+            FOR(d, dim) basis.push_back(df.get_basis_vectors()(j)(d));
+        }
+    }
+    centerStart.push_back(alpha.size());
 }
 
 template <int N>
@@ -155,6 +181,7 @@ void ClustererKKM::TrainDim(std::vector< fvec > _samples)
         fun->train(samples,initial_centers);
         decFunction = (void *)fun;
         kernelTypeTrained = 0;
+        FlattenCenters<linkernel>(decFunction);
     }
         break;
     case 1:
@@ -170,6 +197,10 @@ void ClustererKKM::TrainDim(std::vector< fvec > _samples)
         fun->train(samples,initial_centers);
         decFunction = (void *)fun;
         kernelTypeTrained = 1;
+        FlattenCenters<polkernel>(decFunction);
+        expGamma = 1;
+        expCoef = 1;
+        expDegree = kernelDegree;
     }
         break;
     case 2:
@@ -185,6 +216,8 @@ void ClustererKKM::TrainDim(std::vector< fvec > _samples)
         fun->train(samples,initial_centers);
         decFunction = (void *)fun;
         kernelTypeTrained = 2;
+        FlattenCenters<rbfkernel>(decFunction);
+        expGamma = 1./kernelGamma;
     }
         break;
     }
@@ -340,6 +373,64 @@ fvec ClustererKKM::Test( const fvec &_sample )
     }
 }
 
+fvec ClustererKKM::TestMany(const fvec &sampleMatrix, const int sampleDim, const int count)
+{
+    fvec results(count*nbClusters, 0);
+    if(!decFunction || !centerStart.size() || sampleMatrix.size() != sampleDim*count) return results;
+    int clusterCount = min((int)nbClusters, (int)centerStart.size()-1);
+    int basisCount = alpha.size();
+    std::vector<double> kernelRow(basisCount);
+    std::vector<double> sample(dim, 0);
+    FOR(i, count)
+    {
+        FOR(d, min(dim, (u32)sampleDim)) sample[d] = sampleMatrix[i*sampleDim + d];
+        // the kernel between the sample and every basis vector of every center, in one pass
+        double kxx = 0;
+        FOR(d, dim) kxx += sample[d]*sample[d];
+        FOR(j, basisCount)
+        {
+            const double *b = &basis[j*dim];
+            double value = 0;
+            if(kernelTypeTrained == 2)
+            {
+                FOR(d, dim) value += (sample[d]-b[d])*(sample[d]-b[d]);
+                value = exp(-expGamma*value);
+            }
+            else
+            {
+                FOR(d, dim) value += sample[d]*b[d];
+                if(kernelTypeTrained == 1) value = pow(expGamma*value + expCoef, expDegree);
+            }
+            kernelRow[j] = value;
+        }
+        if(kernelTypeTrained == 2) kxx = 1;
+        else if(kernelTypeTrained == 1) kxx = pow(expGamma*kxx + expCoef, expDegree);
+
+        // same scoring as TestDim
+        float *res = &results[i*nbClusters];
+        float sum = 0;
+        float vmax = -FLT_MAX;
+        int index = 0;
+        FOR(c, clusterCount)
+        {
+            double dot = 0;
+            for(int j=centerStart[c]; j<centerStart[c+1]; j++) dot += alpha[j]*kernelRow[j];
+            double value = kxx + centerNorm[c] - 2*dot;
+            value = value > 0 ? sqrt(value) : 0;
+            res[c] = exp(-value);
+            if(vmax < res[c])
+            {
+                vmax = res[c];
+                index = c;
+            }
+            sum += res[c];
+        }
+        if(sum > 0) FOR(c, clusterCount) res[c] /= sum;
+        res[index] = 1;
+    }
+    return results;
+}
+
 double ClustererKKM::TestScore(const fvec &_sample, const int index)
 {
 #define SCORECASE(a) case a:{return TestScoreDim<a>(_sample, index);}
@@ -38,9 +38,15 @@ private:
     int kernelTypeTrained;
     void *decFunction;
 
+    // kernel expansion of the trained centers, flattened for the batched tests
+    std::vector<double> basis, alpha, centerNorm;
+    ivec centerStart;
+    double expGamma, expCoef, expDegree;
+    template <typename K> void FlattenCenters(void *function);
+
 public:
 
-    ClustererKKM() : decFunction(NULL), kernelType(2), kernelGamma(0.01), kernelDegree(2), maxVectors(8) {}
+    ClustererKKM() : decFunction(NULL), kernelType(2), kernelGamma(0.01), kernelDegree(2), maxVectors(8), expGamma(1), expCoef(0), expDegree(1) {}
     ~ClustererKKM();
 
 	void Train(std::vector< fvec > samples);
@@ -51,6 +57,7 @@ public:
     template <int N> double TestScoreDim(const fvec &sample, int index);
     template <int N> fvec TestUnnormalizedDim(const fvec &sample);
     fvec Test( const fvec &sample);
+    fvec TestMany(const fvec &sampleMatrix, const int sampleDim, const int count);
     double TestScore(const fvec &_sample, const int index);
     fvec TestUnnormalized( const fvec &sample);
     const char *GetInfoString();
@@ -49,12 +49,15 @@ void ClustererKM::Train(std::vector< fvec > samples)
     kmeans->SetGMM(bGmm);
     kmeans->SetBeta(beta);
     kmeans->SetPower(power);
+    kmeans->SetMiniBatch(miniBatch);
 
     kmeans->Update(bInit);
 
     if(!bIterative)
     {
         int iterations = 20;
+        // the mini-batches go through the data about twice
+        if(miniBatch && !bSoft && !bGmm) iterations = max(iterations, 2*(int)samples.size()/miniBatch);
         FOR(i, iterations) kmeans->Update();
     }
 }
@@ -83,13 +86,30 @@ fvec ClustererKM::Test( const fVec &sample)
     return res;
 }
 
-void ClustererKM::SetParams(u32 clusters, int method, float beta, int power, bool kmeansPlusPlus)
+fvec ClustererKM::TestMany(const fvec &sampleMatrix, const int sampleDim, const int count)
+{
+    fvec results(count*nbClusters, 0);
+    if(!kmeans || !count || sampleMatrix.size() != sampleDim*count) return results;
+    if(kmeans->GetClusters() != nbClusters) return Clusterer::TestMany(sampleMatrix, sampleDim, count);
+    kmeans->TestMany(&sampleMatrix[0], count, sampleDim, &results[0]);
+    FOR(n, count)
+    {
+        float *res = &results[n*nbClusters];
+        float sum = 0;
+        FOR(i, nbClusters) sum += res[i];
+        FOR(i, nbClusters) res[i] /= sum;
+    }
+    return results;
+}
+
+void ClustererKM::SetParams(u32 clusters, int method, float beta, int power, bool kmeansPlusPlus, int miniBatch)
 {
 
     this->nbClusters = clusters;
     this->beta = beta;
     this->power = power;
     this->kmeansPlusPlus = kmeansPlusPlus;
+    this->miniBatch = miniBatch;
 
     switch(method)
     {
@@ -115,7 +135,8 @@ const char *ClustererKM::GetInfoString()
     sprintf(text, "K-Means\n");
     sprintf(text, "%sClusters: %d\n", text, nbClusters);
     sprintf(text, "%sType:", text);
-    if(!bSoft && !bGmm) sprintf(text, "%sK-Means (plusplus: %i)\n", text, kmeansPlusPlus);
+    if(!bSoft && !bGmm && miniBatch) sprintf(text, "%sMini-Batch K-Means (batch: %d, plusplus: %i)\n", text, miniBatch, kmeansPlusPlus);
+    else if(!bSoft && !bGmm) sprintf(text, "%sK-Means (plusplus: %i)\n", text, kmeansPlusPlus);
     else if(bSoft) sprintf(text, "%sSoft K-Means (beta: %.3f, plusplus: %i)\n", text, beta, kmeansPlusPlus);
     else sprintf(text, "%sGMM\n", text);
     sprintf(text, "%sMetric: ", text);
@@ -31,14 +31,15 @@ private:
 	bool bGmm;
 	int power;
 	bool kmeansPlusPlus;
+    int miniBatch;
 
 public:
 	KMeansCluster *kmeans;
 
-    ClustererKM() : beta(1), bSoft(false), bGmm(false), kmeans(0), kmeansPlusPlus(true) {}
+    ClustererKM() : beta(1), bSoft(false), bGmm(false), kmeans(0), kmeansPlusPlus(true), miniBatch(0) {}
     ~ClustererKM();
     ClustererKM(const ClustererKM& other) : beta(other.beta), bSoft(other.bSoft), bGmm(other.bGmm),
-        power(other.power), kmeansPlusPlus(other.kmeansPlusPlus)
+        power(other.power), kmeansPlusPlus(other.kmeansPlusPlus), miniBatch(other.miniBatch)
     {
         if(other.kmeans)
             kmeans = new KMeansCluster(*other.kmeans);
@@ -47,9 +48,10 @@ public:
 	void Train(std::vector< fvec > samples);
 	fvec Test( const fvec &sample);
 	fvec Test( const fVec &sample);
+    fvec TestMany(const fvec &sampleMatrix, const int sampleDim, const int count);
     const char *GetInfoString();
 
-    void SetParams(u32 nbClusters, int method, float beta, int power, bool kmeansPlusPlus);
+    void SetParams(u32 nbClusters, int method, float beta, int power, bool kmeansPlusPlus, int miniBatch=0);
 };
 
 #endif // _CLUSTERER_KM_H_
@@ -19,11 +19,12 @@ Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
 *********************************************************************/
 #include <public.h>
 #include "clustererSVR.h"
+#include "gramCache.h"
 
 using namespace std;
 
 ClustererSVR::ClustererSVR()
-: svm(0)
+: svm(0), x_space(0)
 {
 	// default values
 	param.svm_type = ONE_CLASS;
@@ -52,17 +53,19 @@ ClustererSVR::ClustererSVR()
 ClustererSVR::~ClustererSVR()
 {
     DEL(svm);
+    KILL(x_space);
 }
 
 void ClustererSVR::Train(std::vector< fvec > samples)
 {
 	svm_problem problem;
-	svm_node *x_space;
 
 	int data_dimension = samples[0].size();
 	problem.l = samples.size();
 	problem.y = new double[problem.l];
 	problem.x = new svm_node *[problem.l];
+	DEL(svm);
+	KILL(x_space);
 	x_space = new svm_node[(data_dimension+1)*problem.l];
 
 	FOR(i, problem.l)
@@ -77,26 +80,29 @@ void ClustererSVR::Train(std::vector< fvec > samples)
 		problem.y[i] = 0;
 	}
 
-	if(svm) delete [] svm;
-	svm = svm_train(&problem, &param);
+	svm = GramCache::Train(&problem, &param);
+	predictor.Build(svm, data_dimension);
 
 	delete [] problem.x;
 	delete [] problem.y;
 }
 
-fvec ClustererSVR::Test( const fvec &sample )
+float ClustererSVR::Predict(const float *sample, int dim) const
 {
-	int data_dimension = sample.size();
-	float estimate;
-	svm_node *x = new svm_node[data_dimension+1];
-	FOR(i, data_dimension)
+	if(predictor.IsValid() && dim == predictor.Dimension()) return (float)predictor.Decision(sample);
+	vector<svm_node> x(dim+1);
+	FOR(i, dim)
 	{
 		x[i].index = i+1;
 		x[i].value = sample[i];
 	}
-	x[data_dimension].index = -1;
-	estimate = (float)svm_predict(svm, x);
-	delete [] x;
+	x[dim].index = -1;
+	return (float)svm_predict(svm, &x[0]);
+}
+
+fvec ClustererSVR::Test( const fvec &sample )
+{
+	float estimate = svm && sample.size() ? Predict(&sample[0], sample.size()) : 0;
 	fvec res;
 	estimate = std::max(-1.f,min(1.f,estimate))/2 + 0.5f;
 	res.push_back(estimate);
@@ -105,17 +111,7 @@ fvec ClustererSVR::Test( const fvec &sample )
 
 fvec ClustererSVR::Test( const fVec &sample )
 {
-	int data_dimension = 2;
-	float estimate;
-	svm_node *x = new svm_node[data_dimension+1];
-	FOR(i, data_dimension)
-	{
-		x[i].index = i+1;
-		x[i].value = sample._[i];
-	}
-	x[data_dimension].index = -1;
-	estimate = (float)svm_predict(svm, x);
-	delete [] x;
+	float estimate = svm ? Predict(sample._, 2) : 0;
 	fvec res;
 	estimate = std::max(-1.f,min(1.f,estimate))/2 + 0.5f;
 	res.push_back(estimate);
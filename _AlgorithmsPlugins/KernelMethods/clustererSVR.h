@@ -22,11 +22,15 @@ Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
 #include <vector>
 #include <clusterer.h>
 #include "svm.h"
+#include "svmPredictor.h"
 
 class ClustererSVR : public Clusterer
 {
 private:
 	svm_model *svm;
+	svm_node *x_space; // the support vectors of svm point into it
+    SVMPredictor predictor;
+    float Predict(const float *sample, int dim) const;
 
 public:
 	svm_parameter param;
@@ -19,6 +19,7 @@ Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
 *********************************************************************/
 #include "public.h"
 #include "dynamicalSVR.h"
+#include "gramCache.h"
 
 using namespace std;
 
@@ -49,7 +50,7 @@ const char *DynamicalSVR::GetInfoString()
 }
 
 DynamicalSVR::DynamicalSVR()
-: node(0)
+: x_space(0)
 {
 	type = DYN_SVR;
 	// default values
@@ -80,7 +81,7 @@ DynamicalSVR::~DynamicalSVR()
 {
     FOR(i, svms.size()) DEL(svms[i]);
     svms.clear();
-	DEL(node);
+	KILL(x_space);
 }
 
 void DynamicalSVR::Train(std::vector< std::vector<fvec> > trajectories, ivec labels)
@@ -101,10 +102,10 @@ void DynamicalSVR::Train(std::vector< std::vector<fvec> > trajectories, ivec lab
 	if(!samples.size()) return;
     FOR(i, svms.size()) DEL(svms[i]);
     svms.clear();
-	DEL(node);
+    predictors.clear();
+	KILL(x_space);
 
 	svm_problem problem;
-	svm_node *x_space;
 
 	problem.l = samples.size();
     problem.x = new svm_node *[problem.l];
@@ -126,8 +127,10 @@ void DynamicalSVR::Train(std::vector< std::vector<fvec> > trajectories, ivec lab
     FOR(d, dim)
     {
         FOR(i, problem.l) problem.y[i] = samples[i][dim + d];
-        svms.push_back(svm_train(&problem, &param));
+        svms.push_back(GramCache::Train(&problem, &param)); // the kernel matrix is shared by all dimensions
     }
+    predictors.resize(dim);
+    FOR(d, dim) predictors[d].Build(svms[d], dim);
 
     delete [] problem.x;
     delete [] problem.y;
@@ -142,21 +145,12 @@ std::vector<fvec> DynamicalSVR::Test( const fvec &sample, const int count)
     if(svms.size() < dim) return res;
     fvec velocity(dim,0);
 
-	if(!node) node = new svm_node[dim+1];
-	FOR(i, dim)
-	{
-		node[i].index = i+1;
-		node[i].value = start[i];
-	}
-	node[dim].index = -1;
-
 	FOR(i, count)
 	{
 		res[i] = start;
 		start += velocity*dT;
 
-		FOR(d, dim) node[d].value = start[d];
-        FOR(d, dim) velocity[d] = (float)svm_predict(svms[d], node);
+        FOR(d, dim) velocity[d] = Predict(d, &start[0], dim);
 	}
 	return res;
 }
@@ -165,32 +159,32 @@ fvec DynamicalSVR::Test( const fvec &sample )
 {
 	int dim = sample.size();
     if(svms.size() != dim) return sample;
-	if(!node) node = new svm_node[dim+1];
-	FOR(i, dim)
-	{
-		node[i].index = i+1;
-		node[i].value = sample[i];
-	}
-	node[dim].index = -1;
     fvec res(dim);
-    FOR(d, dim) res[d] = (float)svm_predict(svms[d], node);
+    FOR(d, dim) res[d] = Predict(d, &sample[0], dim);
 	return res;
 }
 
 fVec DynamicalSVR::Test( const fVec &sample )
 {
-	int dim = 2;
-	if(!node) node = new svm_node[dim+1];
+	fVec res;
+    if(svms.size() < 2) return res;
+    res[0] = Predict(0, sample._, 2);
+    res[1] = Predict(1, sample._, 2);
+	return res;
+}
+
+float DynamicalSVR::Predict(int d, const float *sample, int dim) const
+{
+    const SVMPredictor &predictor = predictors[d];
+    if(predictor.IsValid() && dim == predictor.Dimension()) return (float)predictor.Decision(sample);
+    vector<svm_node> node(dim+1);
 	FOR(i, dim)
 	{
 		node[i].index = i+1;
-		node[i].value = sample._[i];
+		node[i].value = sample[i];
 	}
 	node[dim].index = -1;
-	fVec res;
-    res[0] = (float)svm_predict(svms[0], node);
-    res[1] = (float)svm_predict(svms[1], node);
-	return res;
+    return (float)svm_predict(svms[d], &node[0]);
 }
 
 void DynamicalSVR::SetParams(int svmType, float svmC, float svmP, u32 kernelType, float kernelParam)
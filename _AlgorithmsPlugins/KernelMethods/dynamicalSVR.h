@@ -22,12 +22,15 @@ Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
 #include <vector>
 #include "dynamical.h"
 #include "svm.h"
+#include "svmPredictor.h"
 
 class DynamicalSVR : public Dynamical
 {
 private:
     std::vector<svm_model*> svms;
-	svm_node *node;
+    std::vector<SVMPredictor> predictors; // one per output dimension
+	svm_node *x_space; // shared by the support vectors of all svms
+    float Predict(int d, const float *sample, int dim) const;
 public:
 	svm_parameter param;
 
@@ -0,0 +1,264 @@
+/*********************************************************************
+MLDemos: A User-Friendly visualization toolkit for machine learning
+Copyright (C) 2010  Basilio Noris
+Contact: mldemos@b4silio.com
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public License,
+version 3 as published by the Free Software Foundation.
+
+This library is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free
+Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*********************************************************************/
+#include "gramCache.h"
+#include "svmPredictor.h"
+#include <QMutex>
+#include <QMutexLocker>
+#include <algorithm>
+#include <cstring>
+
+using namespace std;
+
+// the kernel matrix of one training set, in the layout of the precomputed kernel of libsvm:
+// l rows of l+2 nodes, the serial number of the sample (from 1), its l kernel values and a terminator
+struct GramEntry
+{
+    unsigned long long fingerprint;
+    int l, dim;
+    int kernelType, degree;
+    double gamma, coef0;
+    fvec samples; // to tell apart the sets that share a fingerprint
+    vector<svm_node> rows;
+    size_t bytes;
+    QMutex mutex; // held while the matrix is computed
+    bool bReady;
+    int users;
+    unsigned long long lastUse;
+};
+
+struct GramCacheState
+{
+    QMutex mutex;
+    vector<GramEntry*> entries;
+    size_t budget, bytes;
+    unsigned long long clock;
+
+    GramCacheState() : budget(128*1024*1024), bytes(0), clock(0) {}
+    ~GramCacheState()
+    {
+        FOR(i, entries.size()) delete entries[i];
+    }
+
+    // drops the least recently used entries nobody is training on until extra more bytes fit in the budget
+    bool MakeRoom(size_t extra)
+    {
+        while(bytes + extra > budget)
+        {
+            int oldest = -1;
+            FOR(i, entries.size())
+            {
+                if(entries[i]->users) continue;
+                if(oldest == -1 || entries[i]->lastUse < entries[oldest]->lastUse) oldest = i;
+            }
+            if(oldest == -1) return false;
+            bytes -= entries[oldest]->bytes;
+            delete entries[oldest];
+            entries.erase(entries.begin() + oldest);
+        }
+        return true;
+    }
+};
+
+static GramCacheState &State()
+{
+    static GramCacheState state;
+    return state;
+}
+
+// FNV-1a over the dimensions and the bits of the samples
+static unsigned long long Fingerprint(const fvec &samples, int l, int dim)
+{
+    unsigned long long hash = 14695981039346656037ULL;
+    const unsigned long long prime = 1099511628211ULL;
+    hash = (hash ^ (unsigned)l) * prime;
+    hash = (hash ^ (unsigned)dim) * prime;
+    FOR(i, samples.size())
+    {
+        unsigned int bits;
+        memcpy(&bits, &samples[i], sizeof(bits));
+        hash = (hash ^ bits) * prime;
+    }
+    return hash;
+}
+
+// the entry holding the matrix of the problem, computed on first use, or 0 if it cannot be cached
+static GramEntry *Acquire(const svm_problem *problem, const svm_parameter &param)
+{
+    int degree = 0;
+    double gamma = 0, coef0 = 0; // only the parameters the kernel uses are part of the key
+    switch(param.kernel_type)
+    {
+    case LINEAR:
+        break;
+    case POLY:
+        degree = param.degree;
+        gamma = param.gamma;
+        coef0 = param.coef0;
+        break;
+    case RBF:
+        gamma = param.gamma;
+        break;
+    case SIGMOID:
+        gamma = param.gamma;
+        coef0 = param.coef0;
+        break;
+    default:
+        return 0;
+    }
+    // the training kernels and k_function do not agree on when to apply the normalization
+    if(param.kernel_norm != 1.) return 0;
+    int l = problem->l;
+    if(l < 2) return 0;
+    int dim = 0;
+    FOR(i, l)
+    {
+        for(const svm_node *node = problem->x[i]; node->index != -1; node++)
+        {
+            if(node->index < 1) return 0;
+            dim = max(dim, node->index);
+        }
+    }
+    if(!dim) return 0;
+
+    GramCacheState &state = State();
+    size_t bytes = (size_t)l*(l+2)*sizeof(svm_node) + (size_t)l*dim*sizeof(float);
+    fvec samples((size_t)l*dim, 0.f);
+    FOR(i, l)
+    {
+        for(const svm_node *node = problem->x[i]; node->index != -1; node++)
+        {
+            samples[(size_t)i*dim + node->index-1] = (float)node->value;
+        }
+    }
+    unsigned long long fingerprint = Fingerprint(samples, l, dim);
+
+    GramEntry *entry = 0;
+    {
+        QMutexLocker lock(&state.mutex);
+        if(bytes > state.budget) return 0;
+        FOR(i, state.entries.size())
+        {
+            GramEntry *e = state.entries[i];
+            if(e->fingerprint != fingerprint || e->l != l || e->dim != dim) continue;
+            if(e->kernelType != param.kernel_type || e->degree != degree || e->gamma != gamma || e->coef0 != coef0) continue;
+            if(e->samples != samples) continue;
+            entry = e;
+            break;
+        }
+        if(!entry)
+        {
+            if(!state.MakeRoom(bytes)) return 0;
+            entry = new GramEntry;
+            entry->fingerprint = fingerprint;
+            entry->l = l;
+            entry->dim = dim;
+            entry->kernelType = param.kernel_type;
+            entry->degree = degree;
+            entry->gamma = gamma;
+            entry->coef0 = coef0;
+            entry->samples.swap(samples);
+            entry->bytes = bytes;
+            entry->bReady = false;
+            entry->users = 0;
+            state.entries.push_back(entry);
+            state.bytes += bytes;
+        }
+        entry->users++;
+        entry->lastUse = ++state.clock;
+    }
+
+    // the first user computes the matrix, the others wait for it
+    QMutexLocker lock(&entry->mutex);
+    if(!entry->bReady)
+    {
+        SVMPredictor kernel;
+        kernel.SetVectors(problem->x, l, dim, param);
+        int stride = l+2;
+        entry->rows.resize((size_t)l*stride);
+        const int blockSize = 64;
+        dvec values((size_t)min(l, blockSize)*l);
+        for(int b=0; b<l; b+=blockSize)
+        {
+            int count = min(blockSize, l-b);
+            kernel.KernelValues(&entry->samples[(size_t)b*dim], count, &values[0]);
+            FOR(i, count)
+            {
+                svm_node *row = &entry->rows[(size_t)(b+i)*stride];
+                row[0].index = 0;
+                row[0].value = b+i+1;
+                FOR(j, l)
+                {
+                    row[j+1].index = j+1;
+                    row[j+1].value = values[(size_t)i*l + j];
+                }
+                row[l+1].index = -1;
+                row[l+1].value = 0;
+            }
+        }
+        entry->bReady = true;
+    }
+    return entry;
+}
+
+static void Release(GramEntry *entry)
+{
+    GramCacheState &state = State();
+    QMutexLocker lock(&state.mutex);
+    entry->users--;
+    state.MakeRoom(0);
+}
+
+svm_model *GramCache::Train(const svm_problem *problem, const svm_parameter *param)
+{
+    GramEntry *entry = Acquire(problem, *param);
+    if(!entry) return svm_train(problem, param);
+    int l = problem->l;
+    vector<svm_node*> rows(l);
+    FOR(i, l) rows[i] = &entry->rows[(size_t)i*(l+2)];
+    svm_problem precomputed;
+    precomputed.l = l;
+    precomputed.y = problem->y;
+    precomputed.x = &rows[0];
+    svm_parameter precomputedParam = *param;
+    precomputedParam.kernel_type = PRECOMPUTED;
+    svm_model *model = svm_train(&precomputed, &precomputedParam);
+    // the rows are only borrowed: the support vectors go back to the samples, and the model to the actual kernel
+    FOR(i, model->l) model->SV[i] = problem->x[(int)model->SV[i][0].value - 1];
+    model->param = *param;
+    Release(entry);
+    return model;
+}
+
+void GramCache::SetBudget(size_t bytes)
+{
+    GramCacheState &state = State();
+    QMutexLocker lock(&state.mutex);
+    state.budget = bytes;
+    state.MakeRoom(0);
+}
+
+void GramCache::Clear()
+{
+    GramCacheState &state = State();
+    QMutexLocker lock(&state.mutex);
+    size_t budget = state.budget;
+    state.budget = 0;
+    state.MakeRoom(0);
+    state.budget = budget;
+}
@@ -0,0 +1,43 @@
+/*********************************************************************
+MLDemos: A User-Friendly visualization toolkit for machine learning
+Copyright (C) 2010  Basilio Noris
+Contact: mldemos@b4silio.com
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public License,
+version 3 as published by the Free Software Foundation.
+
+This library is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free
+Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*********************************************************************/
+#ifndef _GRAM_CACHE_H_
+#define _GRAM_CACHE_H_
+
+#include <cstddef>
+#include "svm.h"
+
+/*!
+ * Process-wide cache of the kernel (Gram) matrices of the training sets, keyed by a fingerprint
+ * of the samples and the kernel parameters. Train computes the whole matrix once with the dense
+ * SVMPredictor kernels and hands it to svm_train through the precomputed kernel, so that models
+ * retrained on the same samples with a different C, nu, epsilon or target (grid searches,
+ * comparisons, one svm per output dimension) skip the kernel evaluations altogether.
+ * Matrices above the memory budget, or with kernels that cannot be cached, go straight to svm_train.
+ * The least recently used matrices are dropped when the budget is exceeded. Thread-safe.
+ */
+class GramCache
+{
+public:
+    // svm_train through the cached matrix; the support vectors of the model point into problem->x as usual
+    static svm_model *Train(const svm_problem *problem, const svm_parameter *param);
+    static void SetBudget(size_t bytes);
+    static void Clear();
+};
+
+#endif // _GRAM_CACHE_H_
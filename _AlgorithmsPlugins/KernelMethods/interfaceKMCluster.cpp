@@ -59,6 +59,8 @@ void ClustKM::ChangeOptions()
         params->kmeansMethodCombo->setVisible(true);
         params->kmeansNormCombo->setVisible(true);
         params->kernelTypeCombo->setVisible(false);
+        params->kmeansBatchLabel->setVisible(true);
+        params->kmeansBatchSpin->setVisible(true);
         break;
     case 1: // Soft K-Means
         params->param1Label->setText("Beta");
@@ -69,6 +71,8 @@ void ClustKM::ChangeOptions()
         params->KMeansPlusPlusCheckBox->setVisible(true);
         params->kmeansNormCombo->setVisible(false);
         params->kernelTypeCombo->setVisible(false);
+        params->kmeansBatchLabel->setVisible(false);
+        params->kmeansBatchSpin->setVisible(false);
         break;
     case 2: // Kernel K-Means
         params->param1Label->setText(kernel == 2 ? "Width" : "Degree");
@@ -79,6 +83,8 @@ void ClustKM::ChangeOptions()
         params->KMeansPlusPlusCheckBox->setVisible(false);
         params->kmeansNormCombo->setVisible(false);
         params->kernelTypeCombo->setVisible(true);
+        params->kmeansBatchLabel->setVisible(false);
+        params->kmeansBatchSpin->setVisible(false);
         break;
     }
 }
@@ -101,10 +107,11 @@ void ClustKM::SetParams(Clusterer *clusterer)
         int metrictype = params->kmeansNormCombo->currentIndex();
         float beta = params->param2Spin->value();
         bool kmeansPlusPlus = params->KMeansPlusPlusCheckBox->isChecked();
+        int miniBatch = params->kmeansBatchSpin->value();
         if (metrictype < 3) power = metrictype;
         ClustererKM *clust = dynamic_cast<ClustererKM*>(clusterer);
         if(!clust) return;
-        clust->SetParams(clusters, method, beta, power, kmeansPlusPlus);
+        clust->SetParams(clusters, method, beta, power, kmeansPlusPlus, miniBatch);
     }
 }
 
@@ -123,11 +130,12 @@ fvec ClustKM::GetParams()
     }
     else
     {
-        par.resize(4);
+        par.resize(5);
         par[0] = params->kmeansClusterSpin->value();
         par[1] = params->param1Spin->value();
         par[2] = params->param2Spin->value();
         par[3] = params->KMeansPlusPlusCheckBox->isChecked();
+        par[4] = params->kmeansBatchSpin->value();
     }
     return par;
 }
@@ -151,11 +159,12 @@ void ClustKM::SetParams(Clusterer *clusterer, fvec parameters)
     {
         int clusters = parameters.size() > 0 ? parameters[0] : 1;
         int power = parameters.size() > 1 ? parameters[1] : 1;
-        float beta = parameters.size() > 3 ? parameters[3] : 0.1;
-        bool kmeansPlusPlus = parameters.size() > 4 ? parameters[4] : 0;
+        float beta = parameters.size() > 2 ? parameters[2] : 0.1;
+        bool kmeansPlusPlus = parameters.size() > 3 ? parameters[3] : 0;
+        int miniBatch = parameters.size() > 4 ? parameters[4] : 0;
         ClustererKM *clust = dynamic_cast<ClustererKM*>(clusterer);
         if(!clust) return;
-        clust->SetParams(clusters, method, beta, power, kmeansPlusPlus);
+        clust->SetParams(clusters, method, beta, power, kmeansPlusPlus, miniBatch);
     }
 }
 
@@ -195,9 +204,11 @@ void ClustKM::GetParameterList(std::vector<QString> &parameterNames,
         parameterNames.push_back("Metric Power");
         parameterNames.push_back("beta");
         parameterNames.push_back("KMeans PlusPlus");
+        parameterNames.push_back("Mini-Batch Size");
         parameterTypes.push_back("List");
         parameterTypes.push_back("Real");
         parameterTypes.push_back("List");
+        parameterTypes.push_back("Integer");
         parameterValues.push_back(vector<QString>());
         parameterValues.back().push_back("Manhattan");
         parameterValues.back().push_back("Euclidean");
@@ -209,6 +220,9 @@ void ClustKM::GetParameterList(std::vector<QString> &parameterNames,
         parameterValues.push_back(vector<QString>());
         parameterValues.back().push_back("False");
         parameterValues.back().push_back("True");
+        parameterValues.push_back(vector<QString>());
+        parameterValues.back().push_back("0");
+        parameterValues.back().push_back("100000");
     }
 }
 
@@ -406,6 +420,7 @@ void ClustKM::SaveOptions(QSettings &settings)
     settings.setValue("kmeansCluster", params->kmeansClusterSpin->value());
     settings.setValue("kmeansMethod", params->kmeansMethodCombo->currentIndex());
     settings.setValue("kernelType", params->kernelTypeCombo->currentIndex());
+    settings.setValue("kmeansBatch", params->kmeansBatchSpin->value());
 }
 
 bool ClustKM::LoadOptions(QSettings &settings)
@@ -415,6 +430,7 @@ bool ClustKM::LoadOptions(QSettings &settings)
     if(settings.contains("kmeansCluster")) params->kmeansClusterSpin->setValue(settings.value("kmeansCluster").toFloat());
     if(settings.contains("kmeansMethod")) params->kmeansMethodCombo->setCurrentIndex(settings.value("kmeansMethod").toInt());
     if(settings.contains("kernelType")) params->kernelTypeCombo->setCurrentIndex(settings.value("kernelType").toInt());
+    if(settings.contains("kmeansBatch")) params->kmeansBatchSpin->setValue(settings.value("kmeansBatch").toInt());
     ChangeOptions();
     return true;
 }
@@ -426,6 +442,7 @@ void ClustKM::SaveParams(QTextStream &file)
     file << "clusterOptions" << ":" << "kmeansCluster" << " " << params->kmeansClusterSpin->value() << "\n";
     file << "clusterOptions" << ":" << "kmeansMethod" << " " << params->kmeansMethodCombo->currentIndex() << "\n";
     file << "clusterOptions" << ":" << "kernelType" << " " << params->kernelTypeCombo->currentIndex() << "\n";
+    file << "clusterOptions" << ":" << "kmeansBatch" << " " << params->kmeansBatchSpin->value() << "\n";
 }
 
 bool ClustKM::LoadParams(QString name, float value)
@@ -435,6 +452,7 @@ bool ClustKM::LoadParams(QString name, float value)
     if(name.endsWith("kmeansCluster")) params->kmeansClusterSpin->setValue((int)value);
     if(name.endsWith("kmeansMethod")) params->kmeansMethodCombo->setCurrentIndex((int)value);
     if(name.endsWith("kernelType")) params->kernelTypeCombo->setCurrentIndex((int)value);
+    if(name.endsWith("kmeansBatch")) params->kmeansBatchSpin->setValue((int)value);
     ChangeOptions();
     return true;
 }
@@ -25,12 +25,28 @@ Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
 #include "kmeans.h"
 #include <QTime>
 #include <QDebug>
+#include <QThread>
+#include <QThreadPool>
+#include <QRunnable>
 
 using namespace std;
 
+// points handed to a thread at a time during the assignment steps
+#define KMEANS_BLOCK 256
+
+class KMeansWorker : public QRunnable
+{
+    KMeansCluster *kmeans;
+    KMeansJob job;
+    int count;
+public:
+    KMeansWorker(KMeansCluster *kmeans, KMeansJob job, int count) : kmeans(kmeans), job(job), count(count){}
+    void run(){kmeans->PullBlocks(job, count);}
+};
 
 KMeansCluster::KMeansCluster(u32 cnt)
-    : clusters(cnt), sigma(NULL), pi(NULL), bGMM(false), bSoft(false), beta(1), dim(2), power(2), plusPlus(true)
+    : clusters(cnt), sigma(NULL), pi(NULL), bGMM(false), bSoft(false), beta(1), dim(2), power(2), plusPlus(true),
+      miniBatch(0), bBounds(false), bClosest(true), maxDrift(0), secondDrift(0), maxDriftIndex(-1), activeClusters(0)
 {
     InitClusters();
 }
@@ -40,27 +56,37 @@ KMeansCluster::~KMeansCluster()
     Clear();
 }
 
-float KMeansCluster::Distance( fvec a, fvec b )
+float KMeansCluster::Distance(const fvec &a, const fvec &b) const
+{
+    if(!a.size() || a.size() != b.size()) return 0;
+    return Distance(&a[0], &b[0]);
+}
+
+// distance between two points of dim coordinates, to the power-th power for the p-norms
+float KMeansCluster::Distance(const float *a, const float *b) const
 {
-    fvec dif = a-b;
     float d = 0;
     if(power == 0) // infinite distance
     {
-        FOR(i, dif.size()) d = max(d, abs(dif[i]));
+        FOR(i, dim) d = max(d, abs(a[i]-b[i]));
     }
     else if(power == 1) // manhattan distance
     {
-        FOR(i, dif.size()) d += abs(dif[i]);
+        FOR(i, dim) d += abs(a[i]-b[i]);
     }
     else if(power == 2)
     {
-        d = dif*dif;
+        FOR(i, dim)
+        {
+            float dif = a[i]-b[i];
+            d += dif*dif;
+        }
     }
     else if(power > 2)
     {
-        FOR(i, dif.size())
+        FOR(i, dim)
         {
-            float p = abs(dif[i]);
+            float p = abs(a[i]-b[i]);
             float p2 = 1;
             FOR(j, power) p2 *= p;
             d += p2;
@@ -69,7 +95,20 @@ float KMeansCluster::Distance( fvec a, fvec b )
     return d;
 }
 
-float KMeansCluster::Distance2( fvec a, fvec b )
+// takes a Distance back to the distance itself, for which the triangle inequality holds
+inline float DistanceRoot(float d, int power)
+{
+    if(power == 2) return sqrtf(d);
+    if(power > 2) return powf(d, 1.f/power);
+    return d;
+}
+
+float KMeansCluster::MetricDistance(const float *a, const float *b) const
+{
+    return DistanceRoot(Distance(a, b), power);
+}
+
+float KMeansCluster::Distance2(const fvec &a, const fvec &b) const
 {
     float d = 0;
     if(power == 0) // infinite distance
@@ -120,16 +159,32 @@ void KMeansCluster::Update(bool bFirstIteration)
     }
     if(bSuperposed) InitClusters();
 
+    if(bGMM || bSoft) bBounds = false; // the soft assignments do not maintain the bounds
     if(bGMM) GMMClustering(points, means, sigma, pi, clusters, bFirstIteration);
     else if (bSoft) SoftKmeansClustering(points, means, clusters, beta, bFirstIteration);
-    else if(!bFirstIteration) KmeansClustering(points, means, clusters);
+    else if(!bFirstIteration)
+    {
+        if(miniBatch && (u32)miniBatch < points.size()) MiniBatchKmeansClustering(points, means, clusters);
+        else KmeansClustering(points, means, clusters);
+    }
+    bClosest = false;
+}
+
+// finds the point closest to each mean, only when they are asked for as it takes a full pass over the points
+ivec KMeansCluster::GetClosestPoints()
+{
+    if(bClosest) return closestIndices;
+    FlattenPoints();
     FOR(i, clusters)
     {
         float mindist = 1;
         u32 closest = 0;
+        const float *mean = &means[i][0];
         FOR(p, points.size())
         {
-            float d = (points[p].point - means[i])*(points[p].point - means[i]);
+            const float *point = &flatPoints[p*dim];
+            float d = 0;
+            FOR(k, dim) d += (point[k]-mean[k])*(point[k]-mean[k]);
             if (d < mindist)
             {
                 mindist = d;
@@ -138,6 +193,8 @@ void KMeansCluster::Update(bool bFirstIteration)
         }
         closestIndices[i] = closest;
     }
+    bClosest = true;
+    return closestIndices;
 }
 
 void KMeansCluster::AddPoint(fvec point)
@@ -146,6 +203,8 @@ void KMeansCluster::AddPoint(fvec point)
     ClusterPoint cpoint;
     cpoint.point = point;
     points.push_back(cpoint);
+    flatPoints.clear();
+    bBounds = false;
 }
 
 void KMeansCluster::AddPoints(std::vector<fvec> points)
@@ -156,6 +215,49 @@ void KMeansCluster::AddPoints(std::vector<fvec> points)
 void KMeansCluster::Clear()
 {
     points.clear();
+    flatPoints.clear();
+    bBounds = false;
+    batchCounts.clear();
+}
+
+// copies the points in a single row-wise block (points.size() x dim), unless it is already up to date
+void KMeansCluster::FlattenPoints()
+{
+    if(flatPoints.size() == points.size()*dim) return;
+    flatPoints.resize(points.size()*dim);
+    FOR(i, points.size()) FOR(d, dim) flatPoints[i*dim + d] = points[i].point[d];
+}
+
+void KMeansCluster::FlattenMeans(const vector<fvec> &means, int nbClusters)
+{
+    flatMeans.resize(nbClusters*dim);
+    FOR(j, nbClusters) FOR(d, dim) flatMeans[j*dim + d] = means[j][d];
+}
+
+// runs job over [0,count) in blocks of KMEANS_BLOCK, spread over the available threads
+void KMeansCluster::RunBlocks(int count, KMeansJob job)
+{
+    int blocks = (count + KMEANS_BLOCK - 1) / KMEANS_BLOCK;
+    int threadCount = min(QThread::idealThreadCount(), blocks);
+    nextBlock = 0;
+    if(threadCount <= 1)
+    {
+        PullBlocks(job, count);
+        return;
+    }
+    QThreadPool pool;
+    pool.setMaxThreadCount(threadCount);
+    FOR(i, threadCount) pool.start(new KMeansWorker(this, job, count));
+    pool.waitForDone();
+}
+
+void KMeansCluster::PullBlocks(KMeansJob job, int count)
+{
+    int first;
+    while((first = nextBlock.fetchAndAddOrdered(KMEANS_BLOCK)) < count)
+    {
+        (this->*job)(first, min(first + KMEANS_BLOCK, count));
+    }
 }
 
 void KMeansCluster::SetClusters(u32 clusters)
@@ -167,6 +269,9 @@ void KMeansCluster::SetClusters(u32 clusters)
 void KMeansCluster::InitClusters()
 {
     srand(QTime::currentTime().msec());
+    bBounds = false;
+    bClosest = true;
+    batchCounts.clear();
 
     KILL(pi);
     if(sigma) FOR(i, clusters) KILL(sigma[i]);
@@ -222,26 +327,24 @@ void KMeansCluster::InitClustersPlusPlus()
     means[0] = points[firstPointIndex].point;
     closestIndices[0] = firstPointIndex;
     pointTaken[firstPointIndex] = true; // must mark it as taken
-    qDebug("first point at rand = %d[%f;%f]", firstPointIndex, points[firstPointIndex].point[0], points[firstPointIndex].point[1]);
+    FlattenPoints();
 
     // Stores the squared minimum distance of each point to its nearest cluster center
     fvec minDistSquared(points.size(), 0.0f);
 
     // Initialize the distances. Easy, since the only cluster is the first point
+    const float *first = &flatPoints[firstPointIndex*dim];
     FOR(i, points.size())
     {
         if (i != firstPointIndex) // first point isn't considered
         {
-            float d = Distance(points[firstPointIndex].point, points[i].point);
-            qDebug("initial minDistSquared to %i[%f;%f] = %f", i, points[i].point[0], points[i].point[1], d);
+            float d = Distance(first, &flatPoints[i*dim]);
             minDistSquared[i] = d * d;
         }
     }
 
     for(u32 centerCount = 1; centerCount < clusters; ++centerCount) // start at 1!
     {
-        qDebug("picking cluster center %i----------------------------", centerCount);
-
         // Sum up the squared distances for the points not already taken.
         float distSqSum = 0.0f;
         FOR(j,points.size())
@@ -250,12 +353,10 @@ void KMeansCluster::InitClustersPlusPlus()
                 distSqSum += minDistSquared[j];
             }
         }
-        qDebug(" distSqSum=%f",distSqSum);
 
         // Choose one new point at random as a new center, using a weighted
         // probability distribution where a point x is chosen with probability proportional to D(x)^2
         float r = (rand() / float(RAND_MAX)) * distSqSum;
-        qDebug(" random index %f",r);
         // The index of the next point to be added to the resultSet.
         bool nextPointFound= false;
         u32 nextPointIndex = 0;
@@ -279,7 +380,6 @@ void KMeansCluster::InitClustersPlusPlus()
         // Just pick the last available point.
         if (!nextPointFound)
         {
-            qDebug("loop empty, pick one at rand");
             for(size_t j=0; j < points.size() && !nextPointFound; ++j)
             {
                 if (!pointTaken[j])
@@ -296,14 +396,14 @@ void KMeansCluster::InitClustersPlusPlus()
         means[centerCount] = points[nextPointIndex].point;
         closestIndices[centerCount] = nextPointIndex;
         pointTaken[nextPointIndex] = true;
-        qDebug(" new point %d[%f;%f]", nextPointIndex, points[nextPointIndex].point[0], points[nextPointIndex].point[1]);
 
         // Update minDistSquared. We only have to compute the distance to the new center, and update it if it is shorter
+        const float *center = &flatPoints[nextPointIndex*dim];
         for(size_t j=0; j < points.size(); ++j)
         {
             if (!pointTaken[j])
             {
-                float d = Distance(points[nextPointIndex].point, points[j].point);
+                float d = Distance(center, &flatPoints[j*dim]);
                 float dSqr = d * d;
                 if (dSqr < minDistSquared[j]) {
                     minDistSquared[j] = dSqr;
@@ -314,12 +414,6 @@ void KMeansCluster::InitClustersPlusPlus()
 }
 
 
-
-ivec KMeansCluster::GetClosestPoints()
-{
-    return closestIndices;
-}
-
 inline float fastExp(const float x)
 {
     if(-x>90) return 0;
@@ -392,6 +486,86 @@ void KMeansCluster::Test( fvec sample, fvec &res )
 }
 
 
+/**
+* tests count samples at once (same results as Test)
+*
+* @param samples   : the samples, stored row-wise (count*sampleDim)
+* @param res       : the cluster weights, stored row-wise (count*clusters)
+*
+* the distances to the means are computed as a single count x clusters matrix
+*/
+void KMeansCluster::TestMany(const float *samples, int count, int sampleDim, float *res)
+{
+    if(!count || !clusters) return;
+    int d = min(dim, sampleDim);
+    // the means are copied in a contiguous block
+    fvec flatMeans(clusters*d);
+    FOR(j, clusters) FOR(i, d) flatMeans[j*d + i] = means[j][i];
+
+    fvec distances(count*clusters);
+    FOR(n, count)
+    {
+        const float *sample = samples + n*sampleDim;
+        float *dist = &distances[n*clusters];
+        FOR(j, clusters)
+        {
+            const float *mean = &flatMeans[j*d];
+            float value = 0;
+            if(bSoft || power == 2)
+            {
+                FOR(i, d) value += (mean[i]-sample[i])*(mean[i]-sample[i]);
+                if(bSoft) value = sqrtf(value);
+            }
+            else if(power == 0)
+            {
+                FOR(i, d) value = max(value, fabsf(mean[i]-sample[i]));
+            }
+            else if(power == 1)
+            {
+                FOR(i, d) value += fabsf(mean[i]-sample[i]);
+            }
+            else if(power > 2)
+            {
+                FOR(i, d)
+                {
+                    float p = fabsf(mean[i]-sample[i]);
+                    float p2 = 1;
+                    FOR(k, power) p2 *= p;
+                    value += p2;
+                }
+            }
+            dist[j] = value;
+        }
+    }
+
+    FOR(n, count)
+    {
+        float *dist = &distances[n*clusters];
+        float *r = res + n*clusters;
+        if(bSoft)
+        {
+            float distanceSum = 0;
+            FOR(j, clusters)
+            {
+                r[j] = fastExp(-beta * dist[j]);
+                distanceSum += r[j];
+            }
+            FOR(j, clusters) r[j] /= distanceSum;
+        }
+        else
+        {
+            int minIndex = 0;
+            FOR(j, clusters)
+            {
+                r[j] = 0;
+                if(dist[j] < dist[minIndex]) minIndex = j;
+            }
+            r[minIndex] = 1;
+        }
+    }
+}
+
+
 /**
 * performs the K-mean clustering algorithm
 *
@@ -403,6 +577,10 @@ void KMeansCluster::Test( fvec sample, fvec &res )
 * @param nbCluster : number of clusters
 * @param limits    : boundaries of the values for the points coordinates (default is the image size [320x240])
 *
+* the assignment step keeps Hamerly's bounds between iterations: an upper bound on the distance
+* of each point to its mean and a lower bound on its distance to any other mean, loosened by
+* how far the means moved. Points whose bounds stay apart keep their cluster without computing
+* any distance, the others are assigned as before.
 */
 
 void KMeansCluster::KmeansClustering(std::vector<ClusterPoint> &points, vector<fvec> &oldMeans, int nbClusters)
@@ -413,43 +591,128 @@ void KMeansCluster::KmeansClustering(std::vector<ClusterPoint> &points, vector<f
     if((u32)nbClusters > points.size()) nbClusters = points.size();
 
     // new means (centers) for the clusters
-    vector<fvec>means;
-    means.resize(nbClusters);
-
-    // used to check all the distances from the current point to each cluster
-    fvec distances;
-    distances.resize(nbClusters);
-
-    means = oldMeans;
+    vector<fvec> means = oldMeans;
 
     int nbPoints = points.size();
 
-    // did at least one point move from one cluster to another ?
-    //bool bSomethingChanged = true;
+    FlattenPoints();
+    FlattenMeans(means, nbClusters);
+    if(activeClusters != nbClusters || upperBounds.size() != nbPoints) bBounds = false;
+    activeClusters = nbClusters;
+    if(bBounds)
+    {
+        // how far each mean moved since the bounds were computed, and the two largest moves
+        drifts.resize(nbClusters);
+        maxDrift = secondDrift = 0;
+        maxDriftIndex = -1;
+        FOR(j, nbClusters)
+        {
+            drifts[j] = MetricDistance(&flatMeans[j*dim], &boundMeans[j*dim]);
+            if(drifts[j] > maxDrift)
+            {
+                secondDrift = maxDrift;
+                maxDrift = drifts[j];
+                maxDriftIndex = j;
+            }
+            else if(drifts[j] > secondDrift) secondDrift = drifts[j];
+        }
+    }
+    else
+    {
+        upperBounds.resize(nbPoints);
+        lowerBounds.resize(nbPoints);
+    }
 
-    // the kmeans loop
-    //while(bSomethingChanged){
-        //bSomethingChanged = false;
+    //classify the points into clusters
+    RunBlocks(nbPoints, &KMeansCluster::AssignPoints);
+    boundMeans = flatMeans;
+    bBounds = true;
 
-        //classify the points into clusters
-        for (register int i=0; i<nbPoints; i++){
-            // compute the distance to each clusters
-            for (register int j=0;j<nbClusters;j++){
-                distances[j] = Distance(points[i].point, means[j]);
-            }
+    //compute the new means for each cluster
+    Mean(points, means, nbClusters);
 
-            // find the closest cluster
-            if (points[i].cluster != FindSmallest(distances)){
-                //bSomethingChanged = true;
-                points[i].cluster = FindSmallest(distances);
-            }
+    oldMeans = means;
+}
+
+// assigns points [first,last) to their closest mean, skipping those whose bounds prove it unchanged
+void KMeansCluster::AssignPoints(int first, int last)
+{
+    int nbClusters = activeClusters;
+    fvec distances(nbClusters);
+    for(int i=first; i<last; i++)
+    {
+        const float *point = &flatPoints[i*dim];
+        u32 &cluster = points[i].cluster;
+        if(bBounds)
+        {
+            upperBounds[i] += drifts[cluster];
+            lowerBounds[i] -= (int)cluster == maxDriftIndex ? secondDrift : maxDrift;
+            // the margin covers the rounding of the bounds, a tie is always recomputed
+            if(upperBounds[i]*1.0001f < lowerBounds[i]) continue;
+            upperBounds[i] = MetricDistance(point, &flatMeans[cluster*dim]);
+            if(upperBounds[i]*1.0001f < lowerBounds[i]) continue;
         }
 
-        //compute the new means for each cluster
-        Mean(points, means, nbClusters);
-    //}
+        // compute the distance to each clusters
+        FOR(j, nbClusters) distances[j] = Distance(point, &flatMeans[j*dim]);
+
+        // find the closest cluster, and the second closest for the lower bound
+        cluster = FindSmallest(distances);
+        float second = FLT_MAX;
+        FOR(j, nbClusters) if(j != cluster && distances[j] < second) second = distances[j];
+        upperBounds[i] = DistanceRoot(distances[cluster], power);
+        lowerBounds[i] = second == FLT_MAX ? FLT_MAX : DistanceRoot(second, power);
+    }
+}
 
-    oldMeans = means;
+/**
+* performs one mini-batch K-means iteration (Sculley, Web-Scale K-Means Clustering)
+*
+* miniBatch points drawn at random are assigned to their closest mean, which then moves
+* towards each of them with a learning rate of one over the number of points it received
+* so far. The points outside of the batch keep their previous cluster.
+*/
+void KMeansCluster::MiniBatchKmeansClustering(std::vector<ClusterPoint> &points, vector<fvec> &oldMeans, int nbClusters)
+{
+    nbClusters = !nbClusters ? 1 : nbClusters;
+
+    if((u32)nbClusters > points.size()) nbClusters = points.size();
+
+    int nbPoints = points.size();
+
+    FlattenPoints();
+    FlattenMeans(oldMeans, nbClusters);
+    bBounds = false; // the means move without all the points being assigned
+    if(activeClusters != nbClusters || batchCounts.size() != nbClusters) batchCounts.assign(nbClusters, 0);
+    activeClusters = nbClusters;
+
+    int batchSize = min(miniBatch, nbPoints);
+    batch.resize(batchSize);
+    batchClusters.resize(batchSize);
+    FOR(i, batchSize) batch[i] = rand()%nbPoints;
+    RunBlocks(batchSize, &KMeansCluster::AssignBatch);
+
+    FOR(i, batchSize)
+    {
+        int cluster = batchClusters[i];
+        float eta = 1.f / ++batchCounts[cluster];
+        float *mean = &flatMeans[cluster*dim];
+        const float *point = &flatPoints[batch[i]*dim];
+        FOR(d, dim) mean[d] += eta*(point[d] - mean[d]);
+        points[batch[i]].cluster = cluster;
+    }
+    FOR(j, nbClusters) FOR(d, dim) oldMeans[j][d] = flatMeans[j*dim + d];
+}
+
+void KMeansCluster::AssignBatch(int first, int last)
+{
+    fvec distances(activeClusters);
+    for(int i=first; i<last; i++)
+    {
+        const float *point = &flatPoints[batch[i]*dim];
+        FOR(j, activeClusters) distances[j] = Distance(point, &flatMeans[j*dim]);
+        batchClusters[i] = FindSmallest(distances);
+    }
 }
 
 
@@ -463,7 +726,7 @@ void KMeansCluster::KmeansClustering(std::vector<ClusterPoint> &points, vector<f
 *       note: if this function is more than a couple of lines long,
 *             you're doing something wrong!
 */
-float SquareNorm(fvec p1, fvec p2)
+float SquareNorm(const fvec &p1, const fvec &p2)
 {
     return p1*p2;
 }
@@ -477,7 +740,7 @@ float SquareNorm(fvec p1, fvec p2)
 * @return   : the index of the smallest distance in the array
 *
 */
-int FindSmallest(fvec values)
+int FindSmallest(const fvec &values)
 {
 
     // initialize the minimum value and index to the first values in the array
@@ -20,6 +20,7 @@ Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
 #define _KMEANS_H_
 
 #include <vector>
+#include <QAtomicInt>
 
 struct ClusterPoint{
 	fvec point;
@@ -32,14 +33,18 @@ struct ClusterPoint{
     }
 };
 
-inline float SquareNorm(fvec p1, fvec p2);
-inline int FindSmallest(fvec values);
+float SquareNorm(const fvec &p1, const fvec &p2);
+int FindSmallest(const fvec &values);
 inline void Mean(std::vector<ClusterPoint>, std::vector<fvec> means, int nbClusters);
 inline void SoftMean(std::vector<ClusterPoint> &points, std::vector<fvec> means, int nbClusters);
 
 
+class KMeansCluster;
+typedef void (KMeansCluster::*KMeansJob)(int first, int last);
+
 class KMeansCluster
 {
+    friend class KMeansWorker;
 private:
 	float beta;
 	u32 clusters;
@@ -47,6 +52,7 @@ private:
 	std::vector<fvec> means;
 	std::vector<ClusterPoint> points;
 	ivec closestIndices;
+    bool bClosest; // closestIndices is up to date with the means
 	int dim;
 	int power;
         bool plusPlus;
@@ -55,12 +61,36 @@ private:
 	double **sigma;
 	double *pi;
 
+    int miniBatch; // points drawn at each mini-batch iteration, 0 for full passes
+
+    // contiguous copy of the points and means for the hard assignment steps
+    fvec flatPoints;
+    fvec flatMeans;
+    // Hamerly bounds on the distance of each point to its mean and to the closest other mean,
+    // valid for the means in boundMeans
+    fvec upperBounds;
+    fvec lowerBounds;
+    fvec boundMeans;
+    bool bBounds;
+    fvec drifts; // distance each mean moved since the bounds were set
+    float maxDrift, secondDrift;
+    int maxDriftIndex;
+    // points assigned to each mean by the mini-batch iterations so far
+    fvec batchCounts;
+    ivec batch;
+    ivec batchClusters;
+    int activeClusters;
+    QAtomicInt nextBlock;
+
 public:
 	KMeansCluster(u32 cnt=1);
 	~KMeansCluster();
     KMeansCluster(const KMeansCluster& other) : beta(other.beta), clusters(other.clusters), bSoft(other.bSoft),
         dim(other.dim), power(other.power), plusPlus(other.plusPlus), bGMM(other.bGMM), means(other.means),
-        points(other.points), closestIndices(other.closestIndices)
+        points(other.points), closestIndices(other.closestIndices), bClosest(other.bClosest), miniBatch(other.miniBatch),
+        flatPoints(other.flatPoints), flatMeans(other.flatMeans), upperBounds(other.upperBounds),
+        lowerBounds(other.lowerBounds), boundMeans(other.boundMeans), bBounds(other.bBounds),
+        batchCounts(other.batchCounts), activeClusters(other.activeClusters)
     {
         if(other.sigma)
         {
@@ -84,8 +114,9 @@ public:
 
 	void Clear();
 	void Test(fvec sample, fvec &res);
+    void TestMany(const float *samples, int count, int sampleDim, float *res);
 
-    void SetPoint(u32 index, fvec point){if(index<points.size()) points[index].point = point;}
+    void SetPoint(u32 index, fvec point){if(index<points.size()) points[index].point = point; flatPoints.clear();}
 
 	void AddPoint(fvec sample);
 	void AddPoints(std::vector<fvec> points);
@@ -99,13 +130,15 @@ public:
         void InitClusters();
         void InitClustersPlusPlus();
 
-	inline float Distance(fvec a, fvec b);
-	inline float Distance2(fvec a, fvec b);
+	float Distance(const fvec &a, const fvec &b) const;
+	float Distance2(const fvec &a, const fvec &b) const;
+	float Distance(const float *a, const float *b) const;
 
     void SetSoft(bool soft){bSoft = soft;}
     void SetBeta(float b){beta = b > 0 ? b : 0.01f;}
     void SetGMM(bool gmm){bGMM = gmm;}
-    void SetPower(int p){power = p;}
+    void SetPower(int p){if(p != power) bBounds = false; power = p;}
+    void SetMiniBatch(int size){miniBatch = size > 0 ? size : 0;}
     void SetPlusPlus(bool p){plusPlus = p;}
     float GetBeta(){return beta;}
 
@@ -113,6 +146,14 @@ private:
 	void Mean(std::vector<ClusterPoint> &points, std::vector<fvec> &means, int nbClusters);
 	void SoftMean(std::vector<ClusterPoint> &points, std::vector<fvec> &means, int nbClusters);
     void KmeansClustering(std::vector<ClusterPoint> &points, std::vector<fvec> &oldMeans, int nbClusters);
+    void MiniBatchKmeansClustering(std::vector<ClusterPoint> &points, std::vector<fvec> &oldMeans, int nbClusters);
+    void FlattenPoints();
+    void FlattenMeans(const std::vector<fvec> &means, int nbClusters);
+    float MetricDistance(const float *a, const float *b) const;
+    void RunBlocks(int count, KMeansJob job);
+    void PullBlocks(KMeansJob job, int count);
+    void AssignPoints(int first, int last);
+    void AssignBatch(int first, int last);
 	void SoftKmeansClustering(std::vector<ClusterPoint> &points, std::vector<fvec> &oldMeans, int nbClusters, float beta, bool bEStep);
 	void GMMClustering(std::vector<ClusterPoint> &points, std::vector<fvec> &oldMeans, double **oldSigma, double*oldPi, int nbClusters, bool bEStep);
 
@@ -17,6 +17,8 @@ HEADERS +=	\
 			datasetManager.h \
 			mymaths.h \
 			svm.h \
+			svmPredictor.h \
+			gramCache.h \
             classifierSVM.h \
             classifierMVM.h \
             classifierRVM.h \
@@ -43,6 +45,8 @@ HEADERS +=	\
     classifierMRVM.h
 SOURCES += 	\
 			svm.cpp \
+			svmPredictor.cpp \
+			gramCache.cpp \
             classifierSVM.cpp \
             classifierMVM.cpp \
             classifierRVM.cpp \
@@ -19,6 +19,7 @@ Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
 *********************************************************************/
 #include <public.h>
 #include "regressorSVR.h"
+#include "gramCache.h"
 #include <nlopt/nlopt.hpp>
 #include <QDebug>
 
@@ -51,7 +52,7 @@ const char *RegressorSVR::GetInfoString()
 }
 
 RegressorSVR::RegressorSVR()
-    : svm(0), node(0)
+    : svm(0), x_space(0)
 {
     type = REGR_SVR;
     // default values
@@ -80,7 +81,8 @@ RegressorSVR::RegressorSVR()
 
 RegressorSVR::~RegressorSVR()
 {
-    DEL(node);
+    DEL(svm);
+    KILL(x_space);
 }
 
 struct OptData
@@ -259,13 +261,14 @@ void RegressorSVR::Optimize(svm_problem *problem)
 void RegressorSVR::Train(std::vector< fvec > samples, ivec labels)
 {
     svm_problem problem;
-    svm_node *x_space;
 
     dim = samples[0].size()-1;
     int oDim = outputDim != -1 && outputDim < dim ? outputDim : dim;
     problem.l = samples.size();
     problem.y = new double[problem.l];
     problem.x = new svm_node *[problem.l];
+    DEL(svm);
+    KILL(x_space);
     x_space = new svm_node[(dim+1)*problem.l];
 
     FOR(i, problem.l)
@@ -281,10 +284,9 @@ void RegressorSVR::Train(std::vector< fvec > samples, ivec labels)
         problem.y[i] = samples[i][oDim];
     }
 
-    DEL(svm);
-    DEL(node);
-    svm = svm_train(&problem, &param);
+    svm = GramCache::Train(&problem, &param);
     if(bOptimize) Optimize(&problem);
+    predictor.Build(svm, dim);
 
     delete [] problem.x;
     delete [] problem.y;
@@ -293,41 +295,35 @@ void RegressorSVR::Train(std::vector< fvec > samples, ivec labels)
     classThresh = 0.5f;
 }
 
-fvec RegressorSVR::Test( const fvec &sample )
+float RegressorSVR::Predict(const float *sample, int dim) const
 {
-    int dim = sample.size()-1;
-    float estimate;
-    if(!node)
-    {
-        node = new svm_node[dim+1];
-        node[dim].index = -1;
-    }
+    if(predictor.IsValid() && dim == predictor.Dimension()) return (float)predictor.Decision(sample);
+    vector<svm_node> node(dim+1);
     FOR(i, dim)
     {
         node[i].index = i+1;
         node[i].value = sample[i];
     }
-    if(outputDim != -1 && outputDim < dim) node[outputDim].value = sample[dim];
-    estimate = (float)svm_predict(svm, node);
-    fvec res;
-    res.push_back(estimate);
-    res.push_back(1);
+    node[dim].index = -1;
+    return (float)svm_predict(svm, &node[0]);
+}
+
+fvec RegressorSVR::Test( const fvec &sample )
+{
+    int dim = sample.size()-1;
+    fvec res(2, 1.f);
+    res[0] = 0;
+    if(!svm || dim <= 0) return res;
+    query.assign(sample.begin(), sample.begin()+dim);
+    if(outputDim != -1 && outputDim < dim) query[outputDim] = sample[dim];
+    res[0] = Predict(&query[0], dim);
     return res;
 }
 
 fVec RegressorSVR::Test( const fVec &sample )
 {
-    int dim = 1;
-    float estimate;
-    if(!node) node = new svm_node[dim+1];
-    FOR(i, dim)
-    {
-        node[i].index = i+1;
-        node[i].value = sample._[i];
-    }
-    node[dim].index = -1;
-    estimate = (float)svm_predict(svm, node);
-    return fVec(estimate,1);
+    if(!svm) return fVec(0,1);
+    return fVec(Predict(sample._, 1),1);
 }
 
 void RegressorSVR::SetParams(int svmType, float svmC, float svmP, u32 kernelType, float kernelParam)
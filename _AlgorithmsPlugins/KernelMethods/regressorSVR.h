@@ -22,12 +22,16 @@ Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
 #include <vector>
 #include <regressor.h>
 #include "svm.h"
+#include "svmPredictor.h"
 
 class RegressorSVR : public Regressor
 {
 private:
 	svm_model *svm;
-	svm_node *node;
+	svm_node *x_space; // the support vectors of svm point into it
+    SVMPredictor predictor;
+    fvec query;
+    float Predict(const float *sample, int dim) const;
 public:
 	svm_parameter param;
     bool bOptimize;
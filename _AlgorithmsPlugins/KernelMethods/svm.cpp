@@ -24,6 +24,10 @@ Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
 #include <float.h>
 #include <string.h>
 #include <stdarg.h>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <random>
 #include "svm.h"
 #ifdef WIN32
 #pragma warning(disable : 4996)
@@ -1563,6 +1567,7 @@ svm_parameter& svm_parameter::operator= (const svm_parameter &param) {
     p = param.p;
     shrinking = param.shrinking;
     probability = param.probability;
+    nr_threads = param.nr_threads;
     return *this;
 }
 
@@ -1776,6 +1781,61 @@ struct decision_function
 	double eps;
 };
 
+decision_function svm_train_one(
+	const svm_problem *prob, const svm_parameter *param,
+	double Cp, double Cn);
+void svm_binary_svc_probability(
+	const svm_problem *prob, const svm_parameter *param,
+	double Cp, double Cn, double& probA, double& probB, unsigned int seed);
+
+// the k*(k-1)/2 one-against-one problems of a multi-class svm, which are independent
+// and are handed out to the threads one pair at a time
+struct ovo_pass
+{
+	svm_parameter param;
+	svm_node **x;
+	const int *start, *count;
+	const double *weighted_C;
+	decision_function *f;
+	double *probA, *probB;
+	std::vector<int> first, second; // the classes of each pair
+	std::atomic<int> next_pair;
+
+	ovo_pass(const svm_parameter *param, svm_node **x, const int *start, const int *count, const double *weighted_C,
+			 decision_function *f, double *probA, double *probB)
+		: param(*param), x(x), start(start), count(count), weighted_C(weighted_C), f(f), probA(probA), probB(probB), next_pair(0) {}
+};
+
+static void ovo_worker(ovo_pass *pass)
+{
+	int p;
+	while((p = pass->next_pair++) < (int)pass->first.size())
+	{
+		int i = pass->first[p], j = pass->second[p];
+		svm_problem sub_prob;
+		int si = pass->start[i], sj = pass->start[j];
+		int ci = pass->count[i], cj = pass->count[j];
+		sub_prob.l = ci+cj;
+		sub_prob.x = new svm_node*[sub_prob.l];
+		sub_prob.y = new double[sub_prob.l];
+		int k;
+		for(k=0;k<ci;k++) {
+			sub_prob.x[k] = pass->x[si+k];
+			sub_prob.y[k] = +1;
+		}
+		for(k=0;k<cj;k++) {
+			sub_prob.x[ci+k] = pass->x[sj+k];
+			sub_prob.y[ci+k] = -1;
+		}
+
+		if(pass->param.probability)
+			svm_binary_svc_probability(&sub_prob,&pass->param,pass->weighted_C[i],pass->weighted_C[j],pass->probA[p],pass->probB[p],p+1);
+		pass->f[p] = svm_train_one(&sub_prob,&pass->param,pass->weighted_C[i],pass->weighted_C[j]);
+		delete [] sub_prob.x;
+		delete [] sub_prob.y;
+	}
+}
+
 decision_function svm_train_one(
 	const svm_problem *prob, const svm_parameter *param,
 	double Cp, double Cn)
@@ -2023,9 +2083,11 @@ void multiclass_probability(int k, double **r, double *p)
 }
 
 // Cross-validation decision values for probability estimates
+// the folds are drawn from their own generator rather than rand(), so that
+// the pairs trained on different threads do not depend on each other
 void svm_binary_svc_probability(
 	const svm_problem *prob, const svm_parameter *param,
-	double Cp, double Cn, double& probA, double& probB)
+	double Cp, double Cn, double& probA, double& probB, unsigned int seed)
 {
 	int i;
 	int nr_fold = 5;
@@ -2033,10 +2095,11 @@ void svm_binary_svc_probability(
     double *dec_values = new double[prob->l];
 
 	// random shuffle
+	std::minstd_rand generator(seed);
 	for(i=0;i<prob->l;i++) perm[i]=i;
 	for(i=0;i<prob->l;i++)
 	{
-		int j = i+rand()%(prob->l-i);
+		int j = i+generator()%(prob->l-i);
 		swap(perm[i],perm[j]);
 	}
 	for(i=0;i<nr_fold;i++)
@@ -2295,38 +2358,42 @@ svm_model *svm_train(const svm_problem *prob, const svm_parameter *param)
             probB = new double[nr_class*(nr_class-1)/2];
 		}
 
-		int p = 0;
+		ovo_pass pass(param, x, start, count, weighted_C, f, probA, probB);
 		for(i=0;i<nr_class;i++)
-            for(int j=i+1;j<nr_class;j++) {
-				svm_problem sub_prob;
-				int si = start[i], sj = start[j];
-				int ci = count[i], cj = count[j];
-				sub_prob.l = ci+cj;
-                sub_prob.x = new svm_node*[sub_prob.l];
-                sub_prob.y = new double[sub_prob.l];
-				int k;
-                for(k=0;k<ci;k++) {
-					sub_prob.x[k] = x[si+k];
-					sub_prob.y[k] = +1;
-				}
-                for(k=0;k<cj;k++) {
-					sub_prob.x[ci+k] = x[sj+k];
-					sub_prob.y[ci+k] = -1;
-				}
-
-				if(param->probability)
-					svm_binary_svc_probability(&sub_prob,param,weighted_C[i],weighted_C[j],probA[p],probB[p]);
-				f[p] = svm_train_one(&sub_prob,param,weighted_C[i],weighted_C[j]);
-				for(k=0;k<ci;k++)
-					if(!nonzero[si+k] && fabs(f[p].alpha[k]) > 0)
-						nonzero[si+k] = true;
-				for(k=0;k<cj;k++)
-					if(!nonzero[sj+k] && fabs(f[p].alpha[ci+k]) > 0)
-						nonzero[sj+k] = true;
-                delete [] sub_prob.x;
-                delete [] sub_prob.y;
-				++p;
+			for(int j=i+1;j<nr_class;j++)
+			{
+				pass.first.push_back(i);
+				pass.second.push_back(j);
 			}
+		int pair_count = (int)pass.first.size();
+		int nthreads = param->nr_threads > 0 ? param->nr_threads : (int)std::thread::hardware_concurrency();
+		if(nthreads > pair_count) nthreads = pair_count;
+		if(nthreads <= 1)
+			ovo_worker(&pass);
+		else
+		{
+			// the kernel cache budget is split between the problems trained at the same time
+			pass.param.cache_size = param->cache_size / nthreads;
+			std::vector<std::thread> threads;
+			for(int t=0;t<nthreads;t++)
+				threads.push_back(std::thread(ovo_worker,&pass));
+			for(int t=0;t<nthreads;t++)
+				threads[t].join();
+		}
+
+		int p;
+		for(p=0;p<pair_count;p++)
+		{
+			int si = start[pass.first[p]], sj = start[pass.second[p]];
+			int ci = count[pass.first[p]], cj = count[pass.second[p]];
+			int k;
+			for(k=0;k<ci;k++)
+				if(!nonzero[si+k] && fabs(f[p].alpha[k]) > 0)
+					nonzero[si+k] = true;
+			for(k=0;k<cj;k++)
+				if(!nonzero[sj+k] && fabs(f[p].alpha[ci+k]) > 0)
+					nonzero[sj+k] = true;
+		}
 
 		// build output
 
@@ -77,8 +77,9 @@ struct svm_parameter
 	double p;				/* for EPSILON_SVR */
 	int shrinking;			/* use the shrinking heuristics */
 	int probability;		/* do probability estimates */
+	int nr_threads;			/* for the one-against-one problems, 0: one per core */
 
-    svm_parameter() : kernel_weight(0), weight_label(0), weight(0), kernel_dim(0), nr_weight(0){}
+    svm_parameter() : kernel_weight(0), weight_label(0), weight(0), kernel_dim(0), nr_weight(0), nr_threads(1){}
     svm_parameter& operator= (const svm_parameter &param);
 
 };
@@ -0,0 +1,327 @@
+/*********************************************************************
+MLDemos: A User-Friendly visualization toolkit for machine learning
+Copyright (C) 2010  Basilio Noris
+Contact: mldemos@b4silio.com
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public License,
+version 3 as published by the Free Software Foundation.
+
+This library is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free
+Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*********************************************************************/
+#include "svmPredictor.h"
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#define SVM_PREDICTOR_SSE
+#ifndef USE_SSE2
+#define USE_SSE2
+#endif
+#include "sse_mathfun.h"
+#endif
+
+using namespace std;
+
+#define SVM_BLOCK 4 // points evaluated together
+
+// per-thread buffers so that concurrent evaluations do not allocate nor share memory
+struct SVMPredictorScratch
+{
+    vector<double> kernels; // SVM_BLOCK x stride
+    fvec points; // SVM_BLOCK x dim, scaled for the weighted rbf kernel
+    vector<double> decisions;
+    ivec votes;
+};
+
+static SVMPredictorScratch &Scratch()
+{
+    static thread_local SVMPredictorScratch scratch;
+    return scratch;
+}
+
+static inline double powi(double base, int times)
+{
+    double tmp = base, ret = 1.0;
+    for(int t=times; t>0; t/=2)
+    {
+        if(t%2==1) ret*=tmp;
+        tmp = tmp * tmp;
+    }
+    return ret;
+}
+
+SVMPredictor::SVMPredictor()
+    : kernelType(LINEAR), degree(0), gamma(0), coef0(0), kernelNorm(1),
+      dim(0), svCount(0), stride(0), classCount(0), decisionCount(0)
+{
+}
+
+void SVMPredictor::Clear()
+{
+    dim = svCount = stride = classCount = decisionCount = 0;
+    sv.clear();
+    scale.clear();
+    coef.clear();
+    rho.clear();
+    start.clear();
+    nSV.clear();
+}
+
+bool SVMPredictor::SetVectors(const svm_node * const *x, int l, int dim, const svm_parameter &param)
+{
+    Clear();
+    if(!x || dim <= 0 || l <= 0) return false;
+    switch(param.kernel_type)
+    {
+    case LINEAR:
+    case POLY:
+    case RBF:
+    case SIGMOID:
+        break;
+    case RBFWEIGH:
+        if(!param.kernel_weight) return false;
+        break;
+    default:
+        return false;
+    }
+    int stride = (l + 3) & ~3;
+    sv.assign((size_t)dim*stride, 0.f);
+    FOR(i, l)
+    {
+        for(const svm_node *node = x[i]; node->index != -1; node++)
+        {
+            if(node->index < 1 || node->index > dim)
+            {
+                sv.clear();
+                return false;
+            }
+            sv[(size_t)(node->index-1)*stride + i] = (float)node->value;
+        }
+    }
+    if(param.kernel_type == RBFWEIGH)
+    {
+        scale.resize(dim);
+        FOR(d, dim) scale[d] = sqrtf((float)max(0., param.kernel_weight[d]));
+        FOR(d, dim) FOR(i, l) sv[(size_t)d*stride + i] *= scale[d];
+    }
+    kernelType = param.kernel_type;
+    degree = param.degree;
+    gamma = param.gamma;
+    coef0 = param.coef0;
+    kernelNorm = ((kernelType == RBF || kernelType == RBFWEIGH) && param.normalizeKernel) ? (float)param.kernel_norm : 1.f;
+    this->dim = dim;
+    this->stride = stride;
+    svCount = l;
+    return true;
+}
+
+bool SVMPredictor::Build(const svm_model *model, int dim)
+{
+    if(!model || !SetVectors(model->SV, model->l, dim, model->param)) return false;
+    const svm_parameter &param = model->param;
+    int l = model->l;
+    bool bRegression = param.svm_type == ONE_CLASS || param.svm_type == EPSILON_SVR || param.svm_type == NU_SVR;
+    classCount = bRegression ? 2 : model->nr_class;
+    decisionCount = bRegression ? 1 : classCount*(classCount-1)/2;
+    coef.resize((size_t)(classCount-1)*l);
+    FOR(c, classCount-1) FOR(i, l) coef[(size_t)c*l + i] = model->sv_coef[c][i];
+    rho.assign(model->rho, model->rho + decisionCount);
+    if(!bRegression)
+    {
+        nSV.assign(model->nSV, model->nSV + classCount);
+        start.resize(classCount);
+        start[0] = 0;
+        for(int i=1; i<classCount; i++) start[i] = start[i-1] + nSV[i-1];
+    }
+    return true;
+}
+
+// kernel values of count (<= SVM_BLOCK) points against all support vectors, one row of stride values per point.
+// The rbf distances are accumulated directly rather than expanded in norms and a dot product, which would
+// cancel out in single precision for points far from the origin; the dot products are accumulated in double
+// as the polynomial kernel amplifies their rounding errors
+void SVMPredictor::Kernels(const float *points, int count, double *kernels) const
+{
+    bool bDistance = kernelType == RBF || kernelType == RBFWEIGH;
+#ifdef SVM_PREDICTOR_SSE
+    for(int j=0; j<stride; j+=4)
+    {
+        if(bDistance)
+        {
+            __m128 acc[SVM_BLOCK];
+            FOR(p, SVM_BLOCK) acc[p] = _mm_setzero_ps();
+            FOR(d, dim)
+            {
+                __m128 s = _mm_loadu_ps(&sv[(size_t)d*stride + j]);
+                FOR(p, count)
+                {
+                    __m128 diff = _mm_sub_ps(_mm_set1_ps(points[p*dim + d]), s);
+                    acc[p] = _mm_add_ps(acc[p], _mm_mul_ps(diff, diff));
+                }
+            }
+            __m128 g = _mm_set1_ps((float)-gamma), n = _mm_set1_ps(kernelNorm);
+            FOR(p, count)
+            {
+                __m128 k = _mm_mul_ps(n, exp_ps(_mm_mul_ps(g, acc[p])));
+                _mm_storeu_pd(&kernels[p*stride + j], _mm_cvtps_pd(k));
+                _mm_storeu_pd(&kernels[p*stride + j + 2], _mm_cvtps_pd(_mm_movehl_ps(k, k)));
+            }
+        }
+        else
+        {
+            __m128d lo[SVM_BLOCK], hi[SVM_BLOCK];
+            FOR(p, SVM_BLOCK) lo[p] = hi[p] = _mm_setzero_pd();
+            FOR(d, dim)
+            {
+                __m128 s = _mm_loadu_ps(&sv[(size_t)d*stride + j]);
+                __m128d sLo = _mm_cvtps_pd(s), sHi = _mm_cvtps_pd(_mm_movehl_ps(s, s));
+                FOR(p, count)
+                {
+                    __m128d x = _mm_set1_pd(points[p*dim + d]);
+                    lo[p] = _mm_add_pd(lo[p], _mm_mul_pd(x, sLo));
+                    hi[p] = _mm_add_pd(hi[p], _mm_mul_pd(x, sHi));
+                }
+            }
+            FOR(p, count)
+            {
+                _mm_storeu_pd(&kernels[p*stride + j], lo[p]);
+                _mm_storeu_pd(&kernels[p*stride + j + 2], hi[p]);
+            }
+        }
+    }
+#else
+    for(int j=0; j<stride; j+=4)
+    {
+        double acc[SVM_BLOCK][4] = {{0}};
+        FOR(d, dim)
+        {
+            const float *s = &sv[(size_t)d*stride + j];
+            FOR(p, count)
+            {
+                float x = points[p*dim + d];
+                if(bDistance) FOR(k, 4) acc[p][k] += (x - s[k])*(x - s[k]);
+                else FOR(k, 4) acc[p][k] += (double)x*s[k];
+            }
+        }
+        FOR(p, count) FOR(k, 4) kernels[p*stride + j + k] = bDistance ? kernelNorm*exp(-gamma*acc[p][k]) : acc[p][k];
+    }
+#endif
+    if(kernelType == POLY)
+    {
+        FOR(p, count) FOR(i, svCount) kernels[p*stride + i] = powi(gamma*kernels[p*stride + i] + coef0, degree);
+    }
+    else if(kernelType == SIGMOID)
+    {
+        FOR(p, count) FOR(i, svCount) kernels[p*stride + i] = tanh(gamma*kernels[p*stride + i] + coef0);
+    }
+}
+
+// the points of a block in the scaled space of the weighted rbf kernel
+const float *SVMPredictor::Scaled(const float *points, int count) const
+{
+    if(!scale.size()) return points;
+    fvec &scaled = Scratch().points;
+    if((int)scaled.size() < SVM_BLOCK*dim) scaled.resize(SVM_BLOCK*dim);
+    FOR(p, count) FOR(d, dim) scaled[p*dim + d] = points[p*dim + d]*scale[d];
+    return &scaled[0];
+}
+
+void SVMPredictor::KernelValues(const float *points, int count, double *out) const
+{
+    if(!svCount || count <= 0) return;
+    vector<double> &kernels = Scratch().kernels;
+    if((int)kernels.size() < SVM_BLOCK*stride) kernels.resize(SVM_BLOCK*stride);
+    for(int b=0; b<count; b+=SVM_BLOCK)
+    {
+        int blockCount = min(SVM_BLOCK, count-b);
+        Kernels(Scaled(points + (size_t)b*dim, blockCount), blockCount, &kernels[0]);
+        FOR(p, blockCount) copy(kernels.begin() + p*stride, kernels.begin() + p*stride + svCount, out + (size_t)(b+p)*svCount);
+    }
+}
+
+void SVMPredictor::Decisions(const float *points, int count, double *out) const
+{
+    if(!svCount || count <= 0) return;
+    SVMPredictorScratch &scratch = Scratch();
+    if((int)scratch.kernels.size() < SVM_BLOCK*stride) scratch.kernels.resize(SVM_BLOCK*stride);
+    double *kernels = &scratch.kernels[0];
+    for(int b=0; b<count; b+=SVM_BLOCK)
+    {
+        int blockCount = min(SVM_BLOCK, count-b);
+        Kernels(Scaled(points + (size_t)b*dim, blockCount), blockCount, kernels);
+        FOR(p, blockCount)
+        {
+            const double *k = kernels + p*stride;
+            double *dec = out + (size_t)(b+p)*decisionCount;
+            if(!start.size())
+            {
+                double sum = 0;
+                FOR(i, svCount) sum += coef[i]*k[i];
+                dec[0] = sum - rho[0];
+                continue;
+            }
+            int pos = 0;
+            FOR(i, classCount)
+            {
+                for(int j=i+1; j<classCount; j++)
+                {
+                    const double *coef1 = &coef[(size_t)(j-1)*svCount];
+                    const double *coef2 = &coef[(size_t)i*svCount];
+                    double sum = 0;
+                    for(int s=start[i]; s<start[i]+nSV[i]; s++) sum += coef1[s]*k[s];
+                    for(int s=start[j]; s<start[j]+nSV[j]; s++) sum += coef2[s]*k[s];
+                    dec[pos] = sum - rho[pos];
+                    pos++;
+                }
+            }
+        }
+    }
+}
+
+const double *SVMPredictor::DecisionValues(const float *point) const
+{
+    vector<double> &decisions = Scratch().decisions;
+    if((int)decisions.size() < decisionCount) decisions.resize(decisionCount);
+    Decisions(point, 1, &decisions[0]);
+    return &decisions[0];
+}
+
+void SVMPredictor::Votes(const double *decisions, double *votes) const
+{
+    FOR(i, classCount) votes[i] = 0;
+    int pos = 0;
+    FOR(i, classCount)
+    {
+        for(int j=i+1; j<classCount; j++)
+        {
+            if(decisions[pos++] > 0) votes[i] += 1;
+            else votes[j] += 1;
+        }
+    }
+}
+
+int SVMPredictor::Winner(const double *decisions) const
+{
+    ivec &votes = Scratch().votes;
+    votes.assign(classCount, 0);
+    int pos = 0;
+    FOR(i, classCount)
+    {
+        for(int j=i+1; j<classCount; j++)
+        {
+            if(decisions[pos++] > 0) ++votes[i];
+            else ++votes[j];
+        }
+    }
+    int winner = 0;
+    for(int i=1; i<classCount; i++) if(votes[i] > votes[winner]) winner = i;
+    return winner;
+}
@@ -0,0 +1,78 @@
+/*********************************************************************
+MLDemos: A User-Friendly visualization toolkit for machine learning
+Copyright (C) 2010  Basilio Noris
+Contact: mldemos@b4silio.com
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public License,
+version 3 as published by the Free Software Foundation.
+
+This library is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free
+Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*********************************************************************/
+#ifndef _SVM_PREDICTOR_H_
+#define _SVM_PREDICTOR_H_
+
+#include <vector>
+#include <types.h>
+#include "svm.h"
+
+/*!
+ * Dense evaluation of the decision functions of a libsvm model. The support vectors are
+ * copied once into a contiguous matrix stored dimension by dimension, and the kernel values
+ * of a block of points against groups of four support vectors are computed together (with
+ * SSE and exp_ps when available) instead of walking the sparse svm_node lists of svm_predict.
+ * Linear, polynomial, rbf (weighted or not) and sigmoid kernels are handled, Build returns
+ * false for the other ones and the caller keeps using svm_predict.
+ * Evaluations do not modify the predictor and can be run concurrently.
+ */
+class SVMPredictor
+{
+public:
+    SVMPredictor();
+
+    bool Build(const svm_model *model, int dim);
+    // loads l vectors for KernelValues only, with the kernel of param
+    bool SetVectors(const svm_node * const *x, int l, int dim, const svm_parameter &param);
+    void Clear();
+    bool IsValid() const {return svCount > 0;}
+    int Dimension() const {return dim;}
+    int VectorCount() const {return svCount;}
+    // decision values per point: 1 for regression and one-class models, one per pair of classes otherwise
+    int DecisionCount() const {return decisionCount;}
+
+    // the kernel values of count points against the loaded vectors, count rows of VectorCount() values
+    void KernelValues(const float *points, int count, double *out) const;
+    // the decision values of svm_predict_values for count points of Dimension() floats (row-major)
+    void Decisions(const float *points, int count, double *out) const;
+    // the decision values of a single point, kept in a per-thread buffer until the next call
+    const double *DecisionValues(const float *point) const;
+    double Decision(const float *point) const {return svCount ? DecisionValues(point)[0] : 0;}
+    // the votes of svm_predict_votes from the decision values of a point
+    void Votes(const double *decisions, double *votes) const;
+    // the index of the class with the most votes, the first one on ties as in svm_predict
+    int Winner(const double *decisions) const;
+
+private:
+    int kernelType, degree;
+    double gamma, coef0;
+    float kernelNorm;
+    int dim, svCount, stride; // stride: svCount rounded up to a multiple of 4
+    int classCount, decisionCount;
+    fvec sv; // dim x stride, the padding is zero
+    fvec scale; // per-dimension factors of the weighted rbf kernel, applied to the points as well
+    std::vector<double> coef; // (classCount-1) x svCount, as model->sv_coef
+    std::vector<double> rho;
+    ivec start, nSV; // support vectors of each class
+
+    void Kernels(const float *points, int count, double *kernels) const;
+    const float *Scaled(const float *points, int count) const;
+};
+
+#endif // _SVM_PREDICTOR_H_
@@ -191,6 +191,9 @@ void RegrLowess::DrawModel(Canvas *canvas, QPainter &painter, Regressor *regress
 	QPointF oldPointDown(-FLT_MAX,-FLT_MAX);
 	fvec sample;sample.resize(2, 0);
 
+    // precompute the local fits at every pixel column in parallel
+    myRegressor->SetGrid(canvas->toSampleCoords(0, 0)[0], canvas->toSampleCoords(steps-1, 0)[0], steps);
+
     // make the painter beautiful
     painter.setRenderHint(QPainter::Antialiasing, true);
     painter.setBrush(Qt::NoBrush);
@@ -240,6 +243,7 @@ void RegrLowess::DrawModel(Canvas *canvas, QPainter &painter, Regressor *regress
         //the regression window at each point Test() was called above.
         myRegressor->StoreLastRadius();
 	}
+    myRegressor->ClearGrid();
 }
 
 //Visualize the changing size of the regression window by painting lines
@@ -25,6 +25,10 @@ Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
 #include "gsl/matrix/gsl_matrix.h"
 #include <algorithm>
 #include <QMessageBox>
+#include <QMutexLocker>
+#include <QThread>
+#include <QThreadPool>
+#include <QRunnable>
 #include <QDebug>
 #include <assert.h>
 
@@ -69,6 +73,42 @@ Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
 
 using namespace std;
 
+LowessFit::LowessFit(int numPoints, int numParams)
+{
+    workspace = gsl_multifit_linear_alloc(numPoints, numParams);
+    //Zeroed: the linear fits leave the cross-product columns empty
+    X         = gsl_matrix_calloc(numPoints, numParams);
+    y         = gsl_vector_alloc(numPoints);
+    cov       = gsl_matrix_alloc(numParams, numParams);
+    weights   = gsl_vector_alloc(numPoints);
+    c         = gsl_vector_alloc(numParams);
+    x         = gsl_vector_alloc(numParams);
+}
+
+LowessFit::~LowessFit()
+{
+    gsl_multifit_linear_free(workspace);
+    gsl_matrix_free(X);
+    gsl_vector_free(y);
+    gsl_matrix_free(cov);
+    gsl_vector_free(weights);
+    gsl_vector_free(c);
+    gsl_vector_free(x);
+}
+
+//Fills the interpolation grid of a regressor, one grid point at a time
+class LowessGridWorker : public QRunnable
+{
+public:
+    LowessGridWorker(RegressorLowess *regressor, fvec *values, float minX, float maxX)
+        : regressor(regressor), values(values), minX(minX), maxX(maxX){}
+    void run(){ regressor->FillGrid(*values, minX, maxX); }
+private:
+    RegressorLowess *regressor;
+    fvec *values;
+    float minX, maxX;
+};
+
 RegressorLowess::RegressorLowess()
     : smoothingFac (0.01),
       weightingFunc(kLowessWeightFunc_Tricube),
@@ -76,45 +116,23 @@ RegressorLowess::RegressorLowess()
       normType     (kLowessNormType_None),
       zeroSpread   (true),
       tooFewPoints (true),
-      workspace    (NULL),
-      X            (NULL),
-      y            (NULL),
-      cov          (NULL),
-      weights      (NULL),
-      c            (NULL),
-      x            (NULL)
+      gridMin      (0.0f),
+      gridMax      (0.0f),
+      gridSize     (0)
 {
 }
 
 RegressorLowess::~RegressorLowess()
 {
-    if (workspace != NULL)
-        gsl_multifit_linear_free(workspace);
-    workspace = NULL;
-
-    if (X != NULL)
-        gsl_matrix_free(X);
-    X = NULL;
-
-    if (y != NULL)
-        gsl_vector_free(y);
-    y = NULL;
-
-    if (cov != NULL)
-        gsl_matrix_free(cov);
-    cov = NULL;
-
-    if (weights != NULL)
-        gsl_vector_free(weights);
-    weights = NULL;
-
-    if (c != NULL)
-        gsl_vector_free(c);
-    c = NULL;
+    clearFits();
+}
 
-    if (x != NULL)
-        gsl_vector_free(x);
-    x = NULL;
+void RegressorLowess::clearFits()
+{
+    QMutexLocker lock(&fitMutex);
+    FOR(i, freeFits.size())
+        delete freeFits[i];
+    freeFits.clear();
 }
 
 void RegressorLowess::SetParams(double param1, lowessWeightFunc param2,
@@ -196,62 +214,177 @@ void RegressorLowess::Train(std::vector< fvec > trainSamples, ivec labels)
         return; //we can already stop here
     }
 
-    //Initialize various arrays for GSL multifit
+    //The GSL work arrays depend on the number of neighbors and fit
+    //parameters, they are allocated again by the first calls to Test
+    clearFits();
+    ClearGrid();
+
+    //Index the (scaled) predictors for the nearest neighbor search.
+    //In the case of multivariate regression, it is sensible to divide
+    //each variable by a measure of its spread, otherwise the distance
+    //measure is comparing apples with oranges.
+    //We use the reciprocal of the selected measure of spread, so we can
+    //omit a variable from the total distance if its spread is 0.
+    //(Also, multiplication is much faster than division on x86 processors)
+    recipSpread.clear();
+    if (dim >= 3 && normType == kLowessNormType_StDev)
+        FOR(j, dim-1)
+            recipSpread.push_back(stdevs[j] > 0.0f ? 1/stdevs[j] : 0.0f);
+    else if (dim >= 3 && normType == kLowessNormType_IQR)
+        FOR(j, dim-1)
+            recipSpread.push_back(iqrs  [j] > 0.0f ? 1/iqrs  [j] : 0.0f);
+    else //normType == kLowessNormType_None or simple regression
+        recipSpread.resize(dim-1, 1.0f);
 
-    if (workspace != NULL)
-        gsl_multifit_linear_free(workspace);
-    workspace = gsl_multifit_linear_alloc(numNearestNeighbors, numFitParams);
+    points.resize(samples.size()*(dim-1));
+    float pointScale = 0.0f;
+    FOR(i, samples.size())
+        FOR(j, dim-1)
+        {
+            points[i*(dim-1) + j] = samples[i][j]*recipSpread[j];
+            pointScale = MAX(pointScale, fabs(points[i*(dim-1) + j]));
+        }
+    //Bound on the difference between the distances of the index and calcDistance,
+    //which are rounded differently
+    roundingMargin = 1e-6f * pointScale * (dim-1);
+    index.SetMetric(NeighborIndex::METRIC_L2);
+    index.Build(&points[0], samples.size(), dim-1);
 
-    if (X != NULL)
-        gsl_matrix_free(X);
-    X = gsl_matrix_alloc(numNearestNeighbors, numFitParams);
+    return;
+}
 
-    if (y != NULL)
-        gsl_vector_free(y);
-    y = gsl_vector_alloc(numNearestNeighbors);
+LowessFit *RegressorLowess::acquireFit()
+{
+    QMutexLocker lock(&fitMutex);
+    if (freeFits.empty())
+        return new LowessFit(numNearestNeighbors, numFitParams);
+    LowessFit *fit = freeFits.back();
+    freeFits.pop_back();
+    return fit;
+}
 
-    if (cov != NULL)
-        gsl_matrix_free(cov);
-    cov = gsl_matrix_alloc(numFitParams, numFitParams);
+void RegressorLowess::releaseFit(LowessFit *fit, float radius)
+{
+    QMutexLocker lock(&fitMutex);
+    freeFits.push_back(fit);
+    this->radius = radius; //the radius of the last estimate, for StoreLastRadius
+}
 
-    if (weights != NULL)
-        gsl_vector_free(weights);
-    weights = gsl_vector_alloc(numNearestNeighbors);
+fvec RegressorLowess::Test(const fvec &sample)
+{
+    if (!Ready()) //no regression possible, exit directly
+        return fvec(2, 0.0f);
 
-    if (c != NULL)
-        gsl_vector_free(c);
-    c = gsl_vector_alloc(numFitParams);
+    //Interpolate between the two closest grid points if there is a grid.
+    //SetGrid and ClearGrid replace it under the same lock
+    if (dim == 2)
+    {
+        QMutexLocker lock(&fitMutex);
+        if (gridSize > 1 && sample[0] >= gridMin && sample[0] <= gridMax)
+        {
+            float pos = (sample[0] - gridMin) / (gridMax - gridMin) * (gridSize-1);
+            int   i   = MIN((int)pos, gridSize-2);
+            float t   = pos - i;
+            fvec res(2);
+            FOR(j, 2)
+                res[j] = (1-t)*grid[3*i + j] + t*grid[3*(i+1) + j];
+            radius = (1-t)*grid[3*i + 2] + t*grid[3*(i+1) + 2];
+            return res;
+        }
+    }
 
-    if (x != NULL)
-        gsl_vector_free(x);
-    x = gsl_vector_alloc(numFitParams);
+    float fitRadius;
+    fvec res = calcFit(sample, fitRadius);
+    return res;
+}
 
-    return;
+void RegressorLowess::SetGrid(float minX, float maxX, int resolution)
+{
+    ClearGrid();
+    if (!Ready() || dim != 2 || resolution < 2 || maxX <= minX)
+        return;
+
+    //The grid is filled aside, the workers fit every point through calcFit,
+    //then it is swapped in under the lock that Test reads it with
+    fvec values(3*resolution);
+    nextGridPoint = 0;
+    int threadCount = MIN(QThread::idealThreadCount(), resolution);
+    if (threadCount <= 1)
+        FillGrid(values, minX, maxX);
+    else
+    {
+        QThreadPool pool;
+        pool.setMaxThreadCount(threadCount);
+        FOR(i, threadCount)
+            pool.start(new LowessGridWorker(this, &values, minX, maxX));
+        pool.waitForDone();
+    }
+    QMutexLocker lock(&fitMutex);
+    grid.swap(values);
+    gridMin = minX;
+    gridMax = maxX;
+    gridSize = resolution;
 }
 
-fvec RegressorLowess::Test(const fvec &sample)
+void RegressorLowess::ClearGrid()
 {
-    fvec res;
-    res.resize(2,0);
+    QMutexLocker lock(&fitMutex);
+    gridSize = 0;
+    grid.clear();
+}
 
-    if (!Ready()) //no regression possible, exit directly
+void RegressorLowess::FillGrid(fvec &values, float minX, float maxX)
+{
+    int resolution = values.size() / 3;
+    fvec sample(2, 0.0f);
+    int i;
+    while ((i = nextGridPoint.fetchAndAddOrdered(1)) < resolution)
     {
-        res[0] = res[1] = 0.0f;
-        return res;
+        sample[0] = minX + (maxX - minX) * i / (resolution-1);
+        float fitRadius;
+        fvec res = calcFit(sample, fitRadius);
+        values[3*i]     = res[0];
+        values[3*i + 1] = res[1];
+        values[3*i + 2] = fitRadius;
     }
+}
 
-    //Compute distance of current sample to training samples
-    fvec distances(samples.size());
-    calcDistances(sample, distances);
+fvec RegressorLowess::calcFit(const fvec &sample, float &radius)
+{
+    fvec res;
+    res.resize(2,0);
 
-    //Sort the distances to find the nearest neighbors
-    //We need to use a stable sort, otherwise points that have identical
-    //coordinates except for outputDim may be selected in a random fashion.
-    size_t *sortIndexes = new size_t[samples.size()];
-    FOR(i, samples.size())
-        sortIndexes[i] = i;
-    mergesort_perm(&distances[0], sortIndexes, 0, samples.size()-1);
-    radius = distances[sortIndexes[numNearestNeighbors-1]];
+    LowessFit *fit = acquireFit();
+    gsl_matrix *X       = fit->X;
+    gsl_vector *y       = fit->y;
+    gsl_vector *weights = fit->weights;
+    gsl_vector *c       = fit->c;
+    gsl_vector *x       = fit->x;
+
+    //Find the nearest neighbors of the sample in the (scaled) predictor space
+    NeighborQuery &query = fit->query;
+    query.point.resize(dim-1);
+    FOR(j, dim-1)
+        query.point[j] = sample[j]*recipSpread[j];
+    //The index works on squared distances, rounded differently than calcDistance,
+    //so we gather all the samples about as far as the farthest neighbor it found
+    //and pick the nearest among them with calcDistance.
+    index.KNearest(&query.point[0], numNearestNeighbors, query);
+    float farthest = sqrtf(query.distances[numNearestNeighbors-1])*(1 + 1e-5f) + roundingMargin;
+    index.RadiusQuery(&query.point[0], farthest*farthest, query.indices);
+
+    //Sort the distances to find the nearest neighbors.
+    //We need a deterministic order, otherwise points that have identical
+    //coordinates except for outputDim may be selected in a random fashion:
+    //equal distances are sorted by decreasing sample index, as mergesort_perm did.
+    vector< pair<float,int> > &nearest = fit->nearest;
+    nearest.resize(query.indices.size());
+    FOR(i, query.indices.size())
+        nearest[i] = make_pair(calcDistance(sample, samples[query.indices[i]]), -query.indices[i]);
+    partial_sort(nearest.begin(), nearest.begin() + numNearestNeighbors, nearest.end());
+    FOR(i, numNearestNeighbors)
+        nearest[i].second = -nearest[i].second;
+    radius = nearest[numNearestNeighbors-1].first;
 
     //The Tricube and Hann weightings have smooth contact with zero, therefore
     //the farthest datapoint with distance=radius will actually have zero weight!
@@ -260,7 +393,7 @@ fvec RegressorLowess::Test(const fvec &sample)
     if (weightingFunc != kLowessWeightFunc_Uniform)
     {
         int nextLowerDist = numNearestNeighbors-1;
-        while(nextLowerDist >= 0 && distances[sortIndexes[nextLowerDist]] > radius - 1e-6f)
+        while(nextLowerDist >= 0 && nearest[nextLowerDist].first > radius - 1e-6f)
             nextLowerDist--;
         if ((fitType == kLowessFitType_Quadratic && nextLowerDist < 2) ||
             (fitType == kLowessFitType_Linear    && nextLowerDist < 1) ||
@@ -270,7 +403,7 @@ fvec RegressorLowess::Test(const fvec &sample)
 
     //Set weights for samples within current regression window
     FOR(i, numNearestNeighbors)
-        gsl_vector_set(weights, i, calcWeighting(distances[sortIndexes[i]], radius, minWeight));
+        gsl_vector_set(weights, i, calcWeighting(nearest[i].first, radius, minWeight));
 
     //Copy nearest samples to GSL matrix
     if (fitType == kLowessFitType_Linear)
@@ -278,12 +411,12 @@ fvec RegressorLowess::Test(const fvec &sample)
         {
             gsl_matrix_set(X, i, 0, 1.0); //constant term
             FOR(j, dim-1)
-                gsl_matrix_set(X, i, j+1, samples[sortIndexes[i]][j]);
+                gsl_matrix_set(X, i, j+1, samples[nearest[i].second][j]);
         }
     else //fitType == kLowessFitType_Quadratic
         FOR(i, numNearestNeighbors)
         {
-            fvec const &curSamp = samples[sortIndexes[i]]; //local shorthand
+            fvec const &curSamp = samples[nearest[i].second]; //local shorthand
             gsl_matrix_set(X, i, 0, 1.0); //constant term
             FOR(j, dim-1)
             {
@@ -301,12 +434,11 @@ fvec RegressorLowess::Test(const fvec &sample)
 
     //Copy sorted target values to y vector
     FOR(i, numNearestNeighbors)
-        gsl_vector_set(y, i, samples[sortIndexes[i]][dim-1]);
+        gsl_vector_set(y, i, samples[nearest[i].second][dim-1]);
 
     //Run multifit
     double chisq = 0.0;
-    gsl_multifit_wlinear(X, weights, y, c, cov, &chisq, workspace);
-
+    gsl_multifit_wlinear(X, weights, y, c, fit->cov, &chisq, fit->workspace);
     //Get regression estimate at current sample location
     if (fitType == kLowessFitType_Linear)
     {
@@ -330,15 +462,13 @@ fvec RegressorLowess::Test(const fvec &sample)
         assert(vecOffset - (2*dim-1) == numCrossProds);
     }
     double y_est, y_err;
-    gsl_multifit_linear_est(x, c, cov, &y_est, &y_err);
+    gsl_multifit_linear_est(x, c, fit->cov, &y_est, &y_err);
 
     res[0]  = y_est;  // the regression estimation
     res[1]  = y_err;  // stdev of the estimation
     res[1] *= res[1]; //convert stdev to variance
 
-    //Clean up
-    delete[] sortIndexes;
-    sortIndexes = NULL;
+    releaseFit(fit, radius);
 
     return res;
 }
@@ -378,39 +508,16 @@ const char *RegressorLowess::GetInfoString()
 }
 
 
-void RegressorLowess::calcDistances(const fvec &sample, fvec &distances)
+float RegressorLowess::calcDistance(const fvec &sample, const fvec &point)
 {
     if (dim < 3) //simple regression
-        FOR(i, samples.size())
-            distances[i] = fabs(samples[i][0] - sample[0]);
-    else
-    {
-        //In the case of multivariate regression, it is sensible to divide
-        //each variable by a measure of its spread, otherwise the distance
-        //measure is comparing apples with oranges.
-        //We first compute the reciprocal of the selected measure of spread, so
-        //we can omit a variable from the total distance below if its spread is 0.
-        //(Also, multiplication is much faster than division on x86 processors)
-        fvec recipSpread;
-        if (normType == kLowessNormType_StDev)
-            FOR(j, dim-1)
-                recipSpread.push_back(stdevs[j] > 0.0f ? 1/stdevs[j] : 0.0f);
-        else if (normType == kLowessNormType_IQR)
-            FOR(j, dim-1)
-                recipSpread.push_back(iqrs  [j] > 0.0f ? 1/iqrs  [j] : 0.0f);
-        else //normType == kLowessNormType_None
-            recipSpread.resize(dim-1, 1.0f);
+        return fabs(point[0] - sample[0]);
 
-        FOR(i, samples.size())
-        {
-            float distance = 0.0f;
-            FOR(j, dim-1)
-                distance += pow((samples[i][j] - sample[j]) * recipSpread[j], 2);
-            distances[i] = sqrtf(distance);
-        }
-    }
-
-    return;
+    //Multivariate regression: each variable is divided by its spread
+    float distance = 0.0f;
+    FOR(j, dim-1)
+        distance += pow((point[j] - sample[j]) * recipSpread[j], 2);
+    return sqrtf(distance);
 }
 
 float RegressorLowess::calcWeighting(float distance, float radius, float minWeight)
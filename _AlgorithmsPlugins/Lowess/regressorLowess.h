@@ -20,7 +20,10 @@ Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
 #define _REGRESSOR_LOWESS_H_
 
 #include <vector>
+#include <QMutex>
+#include <QAtomicInt>
 #include "regressor.h"
+#include "neighborIndex.h"
 #include "gsl/multifit/gsl_multifit.h"
 #include "gsl/matrix/gsl_matrix.h"
 
@@ -42,6 +45,24 @@ enum lowessNormType
     kLowessNormType_IQR
 };
 
+//GSL work arrays and neighbor buffers of one local fit. Each thread running
+//Test borrows its own set, so that several estimates can be computed at once.
+struct LowessFit
+{
+    LowessFit(int numPoints, int numParams);
+    ~LowessFit();
+
+    gsl_multifit_linear_workspace *workspace;
+    gsl_matrix *X;
+    gsl_vector *y;
+    gsl_matrix *cov;
+    gsl_vector *weights;
+    gsl_vector *c;
+    gsl_vector *x;
+    NeighborQuery query;
+    std::vector< std::pair<float,int> > nearest; //distance, sample index
+};
+
 class RegressorLowess : public Regressor
 {
 public:
@@ -56,6 +77,13 @@ public:
     void StoreLastRadius();
     fvec const &GetRadiusVec() { return radiusVec; }
 
+    //Precomputes the local fits on resolution regularly spaced points between
+    //minX and maxX (in parallel), Test then interpolates between them instead
+    //of fitting. Only available when there is a single predictor.
+    void SetGrid(float minX, float maxX, int resolution);
+    void ClearGrid();
+    void FillGrid(fvec &values, float minX, float maxX); //called by the worker threads of SetGrid
+
 private:
     //Model parameters
     double           smoothingFac;
@@ -75,16 +103,27 @@ private:
     float radius;
     fvec radiusVec;
 
-    //GSL work arrays
-    gsl_multifit_linear_workspace *workspace;
-    gsl_matrix *X;
-    gsl_vector *y;
-    gsl_matrix *cov;
-    gsl_vector *weights;
-    gsl_vector *c;
-    gsl_vector *x;
+    //Nearest neighbor search over the predictors, scaled by recipSpread
+    fvec recipSpread;
+    fvec points;
+    float roundingMargin;
+    NeighborIndex index;
+
+    //Unused local fits, shared by the threads calling Test
+    std::vector<LowessFit*> freeFits;
+    QMutex fitMutex;
+
+    //Interpolation grid: estimate, variance and radius at each grid point
+    float gridMin, gridMax;
+    int gridSize;
+    fvec grid;
+    QAtomicInt nextGridPoint;
 
-    void  calcDistances(const fvec &sample, fvec &distances);
+    fvec  calcFit(const fvec &sample, float &radius);
+    LowessFit *acquireFit();
+    void  releaseFit(LowessFit *fit, float radius);
+    void  clearFits();
+    float calcDistance(const fvec &sample, const fvec &point);
     float calcWeighting(float distance, float radius, float minWeight);
     void  showErrorMsg_zeroSpread  ();
     void  showErrorMsg_tooFewPoints();
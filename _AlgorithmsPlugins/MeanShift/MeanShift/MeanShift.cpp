@@ -2,10 +2,12 @@
 #include <math.h>
 #include "MeanShift.h"
 #include <types.h>
+#include <neighborIndex.h>
 
 using namespace std;
 
 #define CLUSTER_EPSILON 0.5
+#define MAX_SHIFT_ITERATIONS 1000
 
 double euclidean_distance(const vector<double> &point_a, const vector<double> &point_b){
     double total = 0;
@@ -64,6 +66,59 @@ void MeanShift::shift_point(const Point &point,
     }
 }
 
+void MeanShift::shift_point(const Point &point,
+                            const NeighborIndex &index,
+                            double kernel_bandwidth,
+                            double support,
+                            Point &shifted_point,
+                            NeighborQuery &query) const
+{
+    const int dim = point.size();
+    query.point.resize(dim);
+    for(int d=0; d<dim; d++) query.point[d] = point[d];
+    const double radius = support*kernel_bandwidth;
+    // the index returns squared euclidean distances
+    index.RadiusQuery(&query.point[0], radius*radius, query.indices, &query.distances);
+    if(query.indices.empty()){
+        shifted_point = point;
+        return;
+    }
+    shifted_point.assign(dim, 0);
+    double total_weight = 0;
+    for(int i=0; i<query.indices.size(); i++){
+        const float *temp_point = index.row(query.indices[i]);
+        double weight = kernel_func(sqrt(query.distances[i]), kernel_bandwidth);
+        for(int j=0; j<dim; j++){
+            shifted_point[j] += temp_point[j] * weight;
+        }
+        total_weight += weight;
+    }
+
+    const double total_weight_inv = 1.0/total_weight;
+    for(int i=0; i<dim; i++){
+        shifted_point[i] *= total_weight_inv;
+    }
+}
+
+void MeanShift::seek_mode(const Point &start,
+                          const NeighborIndex &index,
+                          double kernel_bandwidth,
+                          double support,
+                          Point &mode,
+                          NeighborQuery &query,
+                          double EPSILON) const
+{
+    const double EPSILON_SQR = EPSILON*EPSILON;
+    mode = start;
+    Point point_new;
+    for(int i=0; i<MAX_SHIFT_ITERATIONS; i++){
+        shift_point(mode, index, kernel_bandwidth, support, point_new, query);
+        double shift_distance_sqr = euclidean_distance_sqr(point_new, mode);
+        mode.swap(point_new);
+        if(shift_distance_sqr <= EPSILON_SQR) break;
+    }
+}
+
 std::vector<MeanShift::Point> MeanShift::meanshift(const std::vector<Point> &points,
                                              double kernel_bandwidth,
                                              double EPSILON){
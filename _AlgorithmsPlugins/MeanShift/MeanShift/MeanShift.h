@@ -2,6 +2,9 @@
 
 #include <vector>
 
+class NeighborIndex;
+struct NeighborQuery;
+
 struct MeanShiftCluster {
     std::vector<double> mode;
     std::vector<std::vector<double> > original_points;
@@ -20,6 +23,13 @@ public:
     std::vector<MeanShiftCluster> cluster(const std::vector<Point> &points, double kernel_bandwidth, double min_cluster_distance);
     double distance(const Point &a, const Point &b) const;
     void shift_point(const Point&, const std::vector<Point> &, double, Point&) const;
+    // same as above, with the kernel sum restricted to the points within support*kernel_bandwidth,
+    // found through an (euclidean) kd-tree over the points. Thread-safe, query holds the buffers
+    void shift_point(const Point &point, const NeighborIndex &index, double kernel_bandwidth,
+                     double support, Point &shifted_point, NeighborQuery &query) const;
+    // shifts start until it moves by less than EPSILON and writes where it ended up in mode
+    void seek_mode(const Point &start, const NeighborIndex &index, double kernel_bandwidth,
+                   double support, Point &mode, NeighborQuery &query, double EPSILON = 0.00001) const;
 
 private:
     double (*kernel_func)(double,double);
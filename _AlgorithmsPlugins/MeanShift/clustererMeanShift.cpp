@@ -30,11 +30,29 @@ Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
 #include <public.h>
 #include <string>
 #include <sstream>
+#include <map>
+#include <unordered_map>
+#include <QThread>
+#include <QThreadPool>
+#include <QRunnable>
 
 using namespace std;
 
+// the gaussian kernel weighs less than 1% beyond 3 bandwidths, the points further away are ignored
+#define KERNEL_SUPPORT 3
+// the points in the same bin of a quarter of the kernel width converge together
+#define SEED_BIN_RATIO 0.25
+
+class MeanShiftWorker : public QRunnable
+{
+    ClustererMeanShift *clusterer;
+public:
+    MeanShiftWorker(ClustererMeanShift *clusterer) : clusterer(clusterer) {}
+    void run() { clusterer->SeekModes(); }
+};
+
 ClustererMeanShift::ClustererMeanShift()
-    :meanShift(0), kernelWidth(0.1), mergeRadius(0.05), testMax(1), testCount(0)
+    :meanShift(0), kernelWidth(0.1), mergeRadius(0.05), testMax(1), testCount(0), trainKernel(0.1)
 {}
 
 ClustererMeanShift::~ClustererMeanShift()
@@ -70,34 +88,124 @@ void ClustererMeanShift::Train(std::vector<fvec> samples) {
         points[i].resize(dim,0);
         FOR(d, dim) points[i][d] = samples[i][d];
     }
-    clusters = meanShift->cluster(points, kernelW, mergeRadius);
+    data = flatten(samples, dim);
+    index.Build(&data[0], samples.size(), dim);
+    trainKernel = kernelW;
+
+    // the points are binned, and the mean of each bin climbs to its mode on its own
+    seeds.clear();
+    pointSeed.resize(points.size());
+    double binSize = kernelW*SEED_BIN_RATIO;
+    map<ivec,int> bins;
+    ivec cell(dim), seedCounts;
+    FOR(i, points.size()) {
+        int s = seeds.size();
+        if(binSize > 0) {
+            FOR(d, dim) cell[d] = (int)floor(points[i][d] / binSize);
+            map<ivec,int>::iterator it = bins.find(cell);
+            if(it == bins.end()) bins[cell] = s;
+            else s = it->second;
+        }
+        if(s == (int)seeds.size()) {
+            seeds.push_back(dvec(dim, 0));
+            seedCounts.push_back(0);
+        }
+        FOR(d, dim) seeds[s][d] += points[i][d];
+        seedCounts[s]++;
+        pointSeed[i] = s;
+    }
+    FOR(s, seeds.size()) {
+        FOR(d, dim) seeds[s][d] /= seedCounts[s];
+    }
+
+    // the threads share the seeds out
+    seedModes.resize(seeds.size());
+    nextSeed = 0;
+    int threadCount = min(QThread::idealThreadCount(), (int)seeds.size());
+    if(threadCount <= 1) SeekModes();
+    else {
+        QThreadPool pool;
+        pool.setMaxThreadCount(threadCount);
+        FOR(i, threadCount) pool.start(new MeanShiftWorker(this));
+        pool.waitForDone();
+    }
+    MergeModes();
     nbClusters = clusters.size();
 }
 
+void ClustererMeanShift::SeekModes() {
+    NeighborQuery query;
+    int i;
+    while((i = nextSeed.fetchAndAddOrdered(1)) < (int)seeds.size()) {
+        meanShift->seek_mode(seeds[i], index, trainKernel, KERNEL_SUPPORT, seedModes[i], query);
+    }
+}
+
+// a mode joins the first cluster whose mode is within mergeRadius, or starts a new one.
+// The clusters are hashed on a grid of their first (up to 3) coordinates with cells of
+// mergeRadius, so only the clusters in the surrounding cells need to be checked
+void ClustererMeanShift::MergeModes() {
+    clusters.clear();
+    pointCluster.assign(points.size(), 0);
+    int hashDim = min((int)dim, 3);
+    int neighborCells = hashDim == 3 ? 27 : hashDim == 2 ? 9 : 3;
+    double cellSize = mergeRadius > 0 ? mergeRadius : 1.;
+    unordered_map<long long, ivec> grid;
+    int cell[3];
+    FOR(i, points.size()) {
+        const dvec &mode = seedModes[pointSeed[i]];
+        FOR(d, hashDim) cell[d] = (int)floor(mode[d] / cellSize);
+        int c = clusters.size();
+        FOR(n, neighborCells) {
+            long long key = 0;
+            for(int d=0, code=n; d<hashDim; d++, code/=3) key = key*2097152 + cell[d] + code%3 - 1;
+            unordered_map<long long, ivec>::iterator it = grid.find(key);
+            if(it == grid.end()) continue;
+            FOR(j, it->second.size()) {
+                int k = it->second[j];
+                if(k < c && meanShift->distance(mode, clusters[k].mode) <= mergeRadius) c = k;
+            }
+        }
+        if(c == (int)clusters.size()) {
+            MeanShiftCluster cluster;
+            cluster.mode = mode;
+            clusters.push_back(cluster);
+            long long key = 0;
+            FOR(d, hashDim) key = key*2097152 + cell[d];
+            grid[key].push_back(c);
+        }
+        clusters[c].original_points.push_back(points[i]);
+        clusters[c].shifted_points.push_back(mode);
+        pointCluster[i] = c;
+    }
+}
+
 fvec ClustererMeanShift::Test( const fvec &sample) {
     fvec res;
     res.resize(nbClusters, 0);
-    if(clusters.empty()) return res;
-    dvec point(sample.size());
-    FOR(d, point.size()) point[d] = sample[d];
-    float kernelW = kernelWidth;
+    if(clusters.empty() || sample.size() < dim) return res;
+    NeighborQuery &query = NeighborQuery::Local();
     if(testMax > 1) {
-        float ratio = (testCount) / (float)testMax;
-        kernelW = kernelW*(1-ratio);
-    }
-    dvec outputPoint;
-    meanShift->shift_point(point, points, kernelW, outputPoint);
-    int closest = 0;
-    float closestDistance = FLT_MAX;
-    FOR(c, clusters.size()) {
-
-        float distance = meanShift->distance(outputPoint, clusters[c].mode);
-        if(distance < closestDistance) {
-            closest = c;
-            closestDistance = distance;
+        // while the cluster count is swept (SetClusterTestValue), the sample is shifted once with the
+        // shrinking kernel of the current step and goes to the closest mode, as it always did
+        dvec point(dim), shifted;
+        FOR(d, dim) point[d] = sample[d];
+        meanShift->shift_point(point, index, trainKernel, KERNEL_SUPPORT, shifted, query);
+        int closest = 0;
+        double closestDistance = DBL_MAX;
+        FOR(c, clusters.size()) {
+            double distance = meanShift->distance(shifted, clusters[c].mode);
+            if(distance < closestDistance) {
+                closest = c;
+                closestDistance = distance;
+            }
         }
+        res[closest] = 1;
+        return res;
     }
-    res[closest] = 1;
+    // the sample belongs to the basin of attraction of its closest training point
+    index.KNearest(&sample[0], 1, query);
+    if(query.indices.size()) res[pointCluster[query.indices[0]]] = 1;
     return res;
 }
 
@@ -27,6 +27,8 @@ Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
 #define _CLUSTERER_MEAN_SHIFT_H_
 
 #include <clusterer.h>
+#include <neighborIndex.h>
+#include <QAtomicInt>
 #include "MeanShift/MeanShift.h"
 
 class ClustererMeanShift : public Clusterer {
@@ -40,15 +42,26 @@ public:
     const char *GetInfoString();
     void SetParams(float kernelWidth, float mergeRadius);
     bool SetClusterTestValue(int count, int max);
+    void SeekModes();
 
     MeanShift* meanShift;
     std::vector<MeanShiftCluster> clusters;
     std::vector<dvec> points;
+    std::vector<dvec> seeds; // the means of the bins of points, where the mode seeking starts
+    std::vector<dvec> seedModes; // where each seed converged
+    ivec pointSeed; // the bin of each point
+    ivec pointCluster; // the cluster of each point, i.e. the basin of attraction it lies in
+    fvec data;
+    NeighborIndex index;
     float kernelWidth;
     float mergeRadius;
-    float testCount;
+    float testCount; // step of the cluster count sweep, the kernel shrinks as it goes
     float testMax;
 
+private:
+    float trainKernel;
+    QAtomicInt nextSeed;
+    void MergeModes();
 };
 
 #endif // _CLUSTERER_MEAN_SHIFT_H_
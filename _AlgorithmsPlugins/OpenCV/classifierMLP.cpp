@@ -88,6 +88,20 @@ float ClassifierMLP::Test( const fvec &sample) const
     return output.at<float>(0);
 }
 
+void ClassifierMLP::TestBatch(const float *rowMajor, int count, int dim, float *out) const
+{
+    if(!mlp || !count)
+    {
+        FOR(i, count) out[i] = 0;
+        return;
+    }
+    // the whole batch is propagated through the network as a single matrix
+    Mat input = Mat(count, dim, CV_32FC1, (void*)rowMajor);
+    Mat output = Mat(count, 1, CV_32FC1, (void*)out);
+    mlp->predict(input, output);
+    if(output.data != (uchar*)out) FOR(i, count) out[i] = output.at<float>(i);
+}
+
 void ClassifierMLP::SetParams(u32 functionType, u32 neuronCount, u32 layerCount, f32 alpha, f32 beta, u32 trainingType)
 {
 	this->functionType = functionType;
@@ -33,10 +33,11 @@ private:
 	float alpha, beta;
     cv::Ptr<cv::ml::ANN_MLP> mlp;
 public:
-    ClassifierMLP() : functionType(1), neuronCount(2), alpha(0), beta(0), trainingType(1){}
+    ClassifierMLP() : functionType(1), neuronCount(2), alpha(0), beta(0), trainingType(1){bThreadSafe = true;}
 	~ClassifierMLP();
 	void Train(std::vector< fvec > samples, ivec labels);
     float Test( const fvec &sample) const ;
+    void TestBatch(const float *rowMajor, int count, int dim, float *out) const ;
     const char *GetInfoString() const ;
     void SetParams(u32 functionType, u32 neuronCount, u32 layerCount, f32 alpha, f32 beta, u32 trainingType);
 };
@@ -32,6 +32,7 @@ ClassifierTrees::ClassifierTrees()
 {
     negativeClass = 0;
     maxClass = 2;
+    bThreadSafe = true;
     bComputeImportance = true;
     minSampleCount = 2;
 
@@ -281,6 +282,44 @@ float ClassifierTrees::Test( const fvec &sample) const
     return res;
 }
 
+void ClassifierTrees::TestBatch(const float *rowMajor, int count, int dim, float *out) const
+{
+    if (tree == NULL || !count){
+        FOR(i, count) out[i] = 0;
+        return;
+    }
+    // the binary case needs the fuzzy response, which is only available per sample
+    if(classMap.size() == 2)
+    {
+        Classifier::TestBatch(rowMajor, count, dim, out);
+        return;
+    }
+    Mat test_samples = Mat(count, dim, CV_32FC1, (void*)rowMajor);
+    Mat results = Mat(count, 1, CV_32FC1, (void*)out);
+    tree->predict(test_samples, results);
+    if(results.data != (uchar*)out) FOR(i, count) out[i] = results.at<float>(i);
+}
+
+int ClassifierTrees::TestMultiBatch(const float *rowMajor, int count, int dim, fvec &out) const
+{
+    fvec c(count);
+    if(count) TestBatch(rowMajor, count, dim, &c[0]);
+    if(classMap.size() == 2)
+    {
+        out.resize(count);
+        FOR(i, count) out[i] = (c[i]-0.5)*3;
+        return 1;
+    }
+    out.clear();
+    out.resize(count*maxClass, 0);
+    FOR(i, count)
+    {
+        int index = (int)c[i];
+        if(index >= 0 && index < maxClass) out[i*maxClass + index] = 1.0f;
+    }
+    return maxClass;
+}
+
 void ClassifierTrees::SetParams(bool bBalanceClasses,
                                 int minSampleCount, int maxDepth, int maxTrees,
                                 float accuracyTolerance)
@@ -55,6 +55,8 @@ public:
 	void Train(std::vector< fvec > samples, ivec labels);
     float Test(const fvec &sample) const ;
     fvec TestMulti(const fvec &sample) const ;
+    void TestBatch(const float *rowMajor, int count, int dim, float *out) const ;
+    int TestMultiBatch(const float *rowMajor, int count, int dim, fvec &out) const ;
     const char *GetInfoString() const ;
     fvec GetImportance() const ;
     void PrintTree(cv::ml::DTrees *tree, int count) const;
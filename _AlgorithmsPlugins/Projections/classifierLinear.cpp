@@ -145,6 +145,25 @@ float ClassifierLinear::Test(const fvec &sample ) const
     return response;
 }
 
+void ClassifierLinear::TestBatch(const float *rowMajor, int count, int dim, float *out) const
+{
+    if(linearType >= 4 || dim < 2 || meanAll.size() < 2)
+    {
+        Classifier::TestBatch(rowMajor, count, dim, out);
+        return;
+    }
+    const float m0 = meanAll[0], m1 = meanAll[1];
+    const bool bNormalize = minResponse != FLT_MAX;
+    const float responseScale = bNormalize ? 1.f/fabs(maxResponse-minResponse) : 1.f;
+    FOR(i, count)
+    {
+        const float *sample = rowMajor + i*dim;
+        float response = -(W.x*(sample[0]-m0) + W.y*(sample[1]-m1) - threshold);
+        if(bNormalize) response = ((response-minResponse)*responseScale - midResponse)*6.f;
+        out[i] = response;
+    }
+}
+
 const char *ClassifierLinear::GetInfoString() const
 {
 	char *text = new char[1024];
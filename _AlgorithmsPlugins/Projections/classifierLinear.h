@@ -75,7 +75,7 @@ public:
 	 * @brief Default Constructor
 	 *
 	 */
-    ClassifierLinear() : threshold(0), linearType(0), Transf(0) {bUsesDrawTimer = false;}
+    ClassifierLinear() : threshold(0), linearType(0), Transf(0) {bUsesDrawTimer = false; bThreadSafe = bConcurrentTraining = true;}
     ~ClassifierLinear();
 	/**
 	 * @brief Perform the training, by gather the training parameters from the ui, and then training the corresponding classifier
@@ -90,6 +90,15 @@ public:
 	 * @param sample
 	 */
     float Test(const fvec &sample) const ;
+	/**
+	 * @brief Test a row-major batch of samples, the projection is computed inline for the PCA/LDA/Fisher methods
+	 *
+	 * @param rowMajor
+	 * @param count
+	 * @param dim
+	 * @param out
+	 */
+    void TestBatch(const float *rowMajor, int count, int dim, float *out) const ;
 	/**
 	 * @brief Get the algorithm information and statistics to be displayed in the main interface
 	 *
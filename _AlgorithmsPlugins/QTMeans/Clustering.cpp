@@ -1,7 +1,13 @@
 #include "Clustering.h"
 #include <limits>
-#include <boost/foreach.hpp>
 #include <map>
+#include <algorithm>
+#include <math.h>
+#include <QThread>
+#include <QThreadPool>
+#include <QRunnable>
+#include <QAtomicInt>
+#include "neighborIndex.h"
 using namespace std;
 namespace AG
 {
@@ -29,18 +35,14 @@ void operator /= (Vect &a, const float b)
 	for(int i=0; i<a.size(); i++) a[i] /= b;
 }
 
-bool diameterInf(Vect x, double maxDist, double *limits)
+// grows the box limits (low and high bound for each dimension) so that it contains x,
+// unless this would make the box wider than maxDist along any dimension
+bool diameterInf(const double *x, int dim, double maxDist, double *limits)
 {
-	int dim = x.size();
-	double *newLimits = new double[dim*2];
-	memcpy(newLimits, limits, sizeof(double)*dim*2);
-
 	bool bInside = true;
 	for (int d=0; d < dim; d++)
 	{
-		double dLow = limits[2*d];
-		double dHigh = limits[2*d+1];
-		if(dLow > x[d] || dHigh < x[d])
+		if(limits[2*d] > x[d] || limits[2*d+1] < x[d])
 		{
 			bInside = false;
 			break;
@@ -48,24 +50,16 @@ bool diameterInf(Vect x, double maxDist, double *limits)
 	}
 	if(bInside) return true;
 
-	bool bOk = true;
 	for (int d=0; d < dim; d++)
 	{
-		double xd = x[d];
-		double dLow = min(xd, limits[d*2]);
-		double dHigh = max(xd, limits[d*2+1]);
-		if(dHigh - dLow > maxDist)
-		{
-			bOk = false;
-			break;
-		}
-		newLimits[2*d] = dLow;
-		newLimits[2*d+1] = dHigh;
+		if(max(x[d], limits[d*2+1]) - min(x[d], limits[d*2]) > maxDist) return false;
 	}
-
-	if(bOk) memcpy(limits, newLimits, sizeof(double)*dim*2);
-	delete [] newLimits;
-	return bOk;
+	for (int d=0; d < dim; d++)
+	{
+		limits[2*d] = min(x[d], limits[2*d]);
+		limits[2*d+1] = max(x[d], limits[2*d+1]);
+	}
+	return true;
 }
 
 bool diameter2(Vect x, double maxDist, std::vector<Vect> clust, Vect sum, int count)
@@ -89,70 +83,163 @@ bool diameter2(Vect x, double maxDist, std::vector<Vect> clust, Vect sum, int co
 	return true;
 }
 
-Clusters qt_clustering(VectorSpace & vs, double max_diameter, int minCount)
+/*!
+ * The candidate clusters of the unassigned samples. The candidate of a seed is grown greedily
+ * by adding the unassigned samples in index order, as long as the cluster fits in a box of
+ * max_diameter. Only the samples within max_diameter of the seed along every dimension can
+ * join it, which the kd-tree finds directly. Assigning a cluster only changes the candidates
+ * that contained one of its samples (the samples a candidate rejected never changed its box),
+ * so these are the only ones grown again, in parallel.
+ */
+class QTCandidates
 {
-	Clusters clusters(vs.size(), std::numeric_limits<index>::max());  // assign all the vectors to no cluster
-	int assignedCount = 0;
-	int clusterId = 0;
-	int count = vs.size();
-	int dim = vs[0].size();
-	while(assignedCount < vs.size())
+public:
+	QTCandidates(VectorSpace &vs, double max_diameter)
+		: count(vs.size()), dim(count ? vs[0].size() : 0), candidates(count), maxDiameter(max_diameter),
+		  points(count*dim), fpoints(count*dim), assigned(count, false)
 	{
-		std::vector < std::vector<Vect> > clusts;
-		std::vector < std::vector<int> > clustsIdx;
-		clusts.resize(vs.size());
-		clustsIdx.resize(vs.size());
-		double *limits = new double[dim*2];
-		int skipped = 0;
-		int docId_i = 0;
-		BOOST_FOREACH(Vect d_i, vs)         // foreach document
+		double maxCoordinate = 0;
+		FOR(i, count)
 		{
-			if (clusters[docId_i] != std::numeric_limits<index>::max())
-			{
-				skipped++;
-				docId_i++;
-				continue; // sample taken already
-			}
-			for(int d=0; d<dim; d++)
+			const Vect &v = vs[i];
+			FOR(d, dim)
 			{
-				limits[2*d] = d_i[d];
-				limits[2*d+1] = d_i[d];
+				points[i*dim + d] = v(d);
+				fpoints[i*dim + d] = v(d);
+				maxCoordinate = max(maxCoordinate, fabs(points[i*dim + d]));
 			}
-			std::vector<Vect> &clust = clusts[docId_i];
-			std::vector<int> &clustIdx = clustsIdx[docId_i];
-			clust.push_back(d_i);
-			clustIdx.push_back(docId_i);
+		}
+		// the tree works in single precision, its box is padded so that it never misses a sample
+		radius = max_diameter*(1 + 1e-5) + maxCoordinate*1e-6;
+		tree.SetMetric(NeighborIndex::METRIC_INF);
+		if(count) tree.Build(&fpoints[0], count, dim);
+	}
 
-			for(index docId_j = 0; docId_j < vs.size(); docId_j++)
+	// grows the candidates of the seeds in dirty
+	void Grow()
+	{
+		int threadCount = min(QThread::idealThreadCount(), (int)dirty.size());
+		nextSeed = 0;
+		if(threadCount <= 1)
+		{
+			GrowSeeds();
+			return;
+		}
+		QThreadPool pool;
+		pool.setMaxThreadCount(threadCount);
+		FOR(i, threadCount) pool.start(new QTCandidatesWorker(this));
+		pool.waitForDone();
+	}
+
+	void GrowSeeds()
+	{
+		ivec neighbors;
+		std::vector<double> limits(dim*2);
+		int i;
+		while((i = nextSeed.fetchAndAddOrdered(1)) < (int)dirty.size()) GrowSeed(dirty[i], neighbors, &limits[0]);
+	}
+
+	// assigns the candidate cluster of seed and lists the seeds whose candidates it affects in dirty
+	void Assign(int seed)
+	{
+		ivec members;
+		members.swap(candidates[seed]);
+		FOR(i, members.size()) assigned[members[i]] = true;
+		FOR(i, members.size()) candidates[members[i]].clear();
+		dirty.clear();
+		std::vector<bool> checked(count, false);
+		ivec neighbors;
+		FOR(i, members.size())
+		{
+			tree.BoxQuery(tree.row(members[i]), radius, neighbors);
+			FOR(j, neighbors.size())
 			{
-				if(docId_j == docId_i) continue;
-				if (clusters[docId_j] != std::numeric_limits<index>::max()) continue; // sample taken already
-				if(diameterInf(vs[docId_j], max_diameter, limits))
+				int n = neighbors[j];
+				if(assigned[n] || checked[n]) continue;
+				checked[n] = true;
+				const ivec &candidate = candidates[n];
+				FOR(k, candidate.size())
 				{
-					clust.push_back(vs[docId_j]);
-					clustIdx.push_back(docId_j);
+					if(!assigned[candidate[k]]) continue;
+					dirty.push_back(n);
+					break;
 				}
 			}
-			docId_i++;
-		} // foreach document
-		delete [] limits;
+		}
+	}
+
+	int count, dim;
+	std::vector<ivec> candidates;
+	ivec dirty;
+
+private:
+	class QTCandidatesWorker : public QRunnable
+	{
+	public:
+		QTCandidatesWorker(QTCandidates *candidates) : candidates(candidates){}
+		void run(){candidates->GrowSeeds();}
+	private:
+		QTCandidates *candidates;
+	};
+
+	double maxDiameter;
+	float radius;
+	std::vector<double> points;
+	fvec fpoints;
+	std::vector<bool> assigned;
+	NeighborIndex tree;
+	QAtomicInt nextSeed;
+
+	void GrowSeed(int seed, ivec &neighbors, double *limits)
+	{
+		const double *x = &points[seed*dim];
+		FOR(d, dim)
+		{
+			limits[2*d] = x[d];
+			limits[2*d+1] = x[d];
+		}
+		ivec &clust = candidates[seed];
+		clust.clear();
+		clust.push_back(seed);
+		tree.BoxQuery(tree.row(seed), radius, neighbors);
+		sort(neighbors.begin(), neighbors.end());
+		FOR(i, neighbors.size())
+		{
+			int n = neighbors[i];
+			if(n == seed || assigned[n]) continue; // sample taken already
+			if(diameterInf(&points[n*dim], dim, maxDiameter, limits)) clust.push_back(n);
+		}
+	}
+};
+
+Clusters qt_clustering(VectorSpace & vs, double max_diameter, int minCount)
+{
+	Clusters clusters(vs.size(), std::numeric_limits<index>::max());  // assign all the vectors to no cluster
+	int assignedCount = 0;
+	int clusterId = 0;
+	QTCandidates candidates(vs, max_diameter);
+	FOR(i, candidates.count) candidates.dirty.push_back(i);
+	while(assignedCount < vs.size())
+	{
+		candidates.Grow();
 		// find the cluster with the maximum count
 		int maxIndex = 0, maxCnt = 0;
-		for(int i=0; i<clustsIdx.size(); i++)
+		for(int i=0; i<candidates.count; i++)
 		{
-			if(maxCnt < clustsIdx[i].size())
+			if(maxCnt < candidates.candidates[i].size())
 			{
 				maxIndex = i;
-				maxCnt = clustsIdx[i].size();
+				maxCnt = candidates.candidates[i].size();
 			}
 		}
 		std::cout << "maximum cluster: " << maxIndex << " with " << maxCnt << " samples"<< std::endl;
 		if(maxCnt < minCount) break;
-		for(int i=0; i<clustsIdx[maxIndex].size(); i++)
+		const ivec &members = candidates.candidates[maxIndex];
+		for(int i=0; i<members.size(); i++)
 		{
-			int index = clustsIdx[maxIndex][i];
-			clusters[index] = clusterId;
+			clusters[members[i]] = clusterId;
 		}
+		candidates.Assign(maxIndex);
 		clusterId++;
 		assignedCount += maxCnt;
 	}
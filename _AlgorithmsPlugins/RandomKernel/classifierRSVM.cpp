@@ -13,6 +13,7 @@ ClassifierRSVM::ClassifierRSVM()
     //cout << "initializing classifier RSVM" << endl;
     dim = 2;
     bMultiClass = true;
+    bThreadSafe = true;
     classCount = 0;
 
     //default solver type for L2 regularized and L2 loss primal problem for Support Vector Classification
@@ -274,6 +275,74 @@ fvec ClassifierRSVM::TestMulti(const fvec &sample) const
     return resp;
 }
 
+void ClassifierRSVM::TestBatch(const float *rowMajor, int count, int dim, float *out) const
+{
+    if(!svm || W.size() != dim || kernelParms.eRandFeatureType != RANDOM_FOURIER || kernelParms.eRandKernelType != RAND_KERNEL_RBF)
+    {
+        FOR(i, count) out[i] = 0;
+        return;
+    }
+    // the feature nodes and decision values are allocated once for the whole batch
+    int feat_dimension = W[0].size();
+    feature_node *node = Malloc(feature_node, feat_dimension+1);
+    double *decisions = Malloc(double, max(2,classCount));
+    FOR(r, feat_dimension) node[r].index = r+1;
+    node[feat_dimension].index = -1;
+    float norm = sqrt(2.0 / feat_dimension);
+    float sign = svm->label[0] == -1 ? -1.f : 1.f;
+    FOR(i, count)
+    {
+        const float *sample = rowMajor + i*dim;
+        FOR(r, feat_dimension)
+        {
+            float sum = 0;
+            FOR(d, dim) sum += W[d][r] * sample[d];
+            node[r].value = norm * cos(sum + b[r]);
+        }
+        out[i] = svm_predict_values(svm, node, decisions) * sign;
+    }
+    free(decisions);
+    free(node);
+}
+
+int ClassifierRSVM::TestMultiBatch(const float *rowMajor, int count, int dim, fvec &out) const
+{
+    if(classCount == 2)
+    {
+        out.resize(count);
+        if(count) TestBatch(rowMajor, count, dim, &out[0]);
+        return 1;
+    }
+    int maxClass = classCount;
+    FOR(i, classCount) maxClass = max(maxClass, classes.at(i));
+    out.clear();
+    out.resize(count*maxClass, 0);
+    if(!svm || W.size() != dim || kernelParms.eRandFeatureType != RANDOM_FOURIER || kernelParms.eRandKernelType != RAND_KERNEL_RBF) return maxClass;
+
+    int feat_dimension = W[0].size();
+    feature_node *node = Malloc(feature_node, feat_dimension+1);
+    double *decisions = Malloc(double, classCount);
+    FOR(r, feat_dimension) node[r].index = r+1;
+    node[feat_dimension].index = -1;
+    float norm = sqrt(2.0 / feat_dimension);
+    FOR(i, count)
+    {
+        const float *sample = rowMajor + i*dim;
+        FOR(r, feat_dimension)
+        {
+            float sum = 0;
+            FOR(d, dim) sum += W[d][r] * sample[d];
+            node[r].value = norm * cos(sum + b[r]);
+        }
+        svm_predict_values(svm, node, decisions);
+        float *resp = &out[i*maxClass];
+        FOR(c, classCount) resp[classes.at(c)] = decisions[c];
+    }
+    free(decisions);
+    free(node);
+    return maxClass;
+}
+
 const char *ClassifierRSVM::GetInfoString() const
 {
     char* text = new char[1024];
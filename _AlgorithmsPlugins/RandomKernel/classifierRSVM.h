@@ -39,6 +39,8 @@ public:
     float Test(const fvec &sample) const ;
     float Test(const fVec &sample) const ;
     fvec TestMulti(const fvec &sample) const ;
+    void TestBatch(const float *rowMajor, int count, int dim, float *out) const ;
+    int TestMultiBatch(const float *rowMajor, int count, int dim, fvec &out) const ;
     const char *GetInfoString() const ;
     void SetParams(int eRandKernelType, float svmC, int kernelDim, float fGamma);
     model *GetModel(){return svm;}
@@ -102,7 +102,7 @@ void CSVImport::Parse(QString filename)
     if(filename.isEmpty()) return;
     inputParser->clear();
     inputParser->parse(filename.toStdString().c_str());
-    vector<vector<string> > rawData = inputParser->getRawData();
+    vector<vector<string> > rawData = inputParser->getRawData(CSV_PREVIEW_ROWS);
     qDebug() << "Dataset extracted";
     if(rawData.size() < 2) return;
     bool bUseHeader = gui->headerCheck->isChecked();
@@ -143,7 +143,7 @@ void CSVImport::classIgnoreChanged()
 
 void CSVImport::headerChanged()
 {
-    vector<vector<string> > rawData = inputParser->getRawData();
+    vector<vector<string> > rawData = inputParser->getRawData(CSV_PREVIEW_ROWS);
     qDebug() << "Dataset extracted";
     if(rawData.size() < 2) return;
     bool bUseHeader = gui->headerCheck->isChecked();